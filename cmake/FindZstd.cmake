@@ -0,0 +1,46 @@
+# - Try to find the Zstandard compression library
+# Once done this will define
+#
+#  ZSTD_FOUND - system has Zstandard
+#  ZSTD_INCLUDE_DIR - the Zstandard include directory
+#  ZSTD_LIBRARIES - Link these to use Zstandard
+#
+# and the imported target Zstd::Zstd.
+#
+# Hints to find Zstandard
+#
+#  Set ZSTD_ROOT_DIR to the root directory of a Zstandard installation
+
+if( NOT WIN32 )
+  find_package(PkgConfig QUIET)
+  if(PKG_CONFIG_FOUND)
+    pkg_check_modules(PC_ZSTD QUIET libzstd)
+  endif()
+endif( NOT WIN32 )
+
+find_path(ZSTD_INCLUDE_DIR NAMES zstd.h
+  PATHS
+    ${ZSTD_ROOT_DIR}/include
+    ${PC_ZSTD_INCLUDEDIR}
+    ${PC_ZSTD_INCLUDE_DIRS}
+)
+
+find_library(ZSTD_LIBRARIES NAMES zstd zstd_static
+  PATHS
+    ${ZSTD_ROOT_DIR}/lib
+    ${PC_ZSTD_LIBDIR}
+    ${PC_ZSTD_LIBRARY_DIRS}
+)
+
+include(FindPackageHandleStandardArgs)
+find_package_handle_standard_args(Zstd DEFAULT_MSG ZSTD_INCLUDE_DIR ZSTD_LIBRARIES)
+
+if(ZSTD_FOUND AND NOT TARGET Zstd::Zstd)
+  add_library(Zstd::Zstd UNKNOWN IMPORTED)
+  set_target_properties(Zstd::Zstd PROPERTIES
+    IMPORTED_LOCATION "${ZSTD_LIBRARIES}"
+    INTERFACE_INCLUDE_DIRECTORIES "${ZSTD_INCLUDE_DIR}"
+  )
+endif()
+
+mark_as_advanced(ZSTD_INCLUDE_DIR ZSTD_LIBRARIES)
@@ -192,6 +192,14 @@ Application::Application(int& argc, char** argv) :
                           tr("Import this CSV file into the passed DB or into a new DB"));
             printArgument(QString("-t, --table <%1>").arg(tr("table")),
                           tr("Browse this table, or use it as target of a data import"));
+            printArgument(QString("--headless"),
+                          tr("Run without user interface, see --headless --help"));
+            printArgument(QString("--export-csv <%1>").arg(tr("file")),
+                          tr("Export the table passed with -t to this CSV file without user interface"));
+            printArgument(QString("--export-json <%1>").arg(tr("file")),
+                          tr("Export the table passed with -t to this JSON file without user interface"));
+            printArgument(QString("--export-sql <%1>").arg(tr("file")),
+                          tr("Export the database to this SQL file without user interface"));
             printArgument(QString("-R, --read-only"),
                           tr("Open database in read-only mode"));
             printArgument(QString("-S, --settings <%1>").arg(tr("settings_file")),
@@ -245,27 +253,8 @@ Application::Application(int& argc, char** argv) :
                   arguments().at(i) == "-O" || arguments().at(i) == "--save-option") {
             const QString optionWarning = tr("The -o/--option and -O/--save-option options require an argument in the form group/setting=value");
             bool saveToDisk = arguments().at(i) == "-O" || arguments().at(i) == "--save-option";
-            if(++i >= arguments().size())
+            if(++i >= arguments().size() || !Settings::setValueFromArgument(arguments().at(i), saveToDisk))
                 qWarning() << qPrintable(optionWarning);
-            else {
-                QStringList option = arguments().at(i).split("=");
-                if (option.size() != 2)
-                    qWarning() << qPrintable(optionWarning);
-                else {
-                    QStringList setting = option.at(0).split("/");
-                    if (setting.size() != 2)
-                        qWarning() << qPrintable(optionWarning);
-                    else {
-                        QVariant value;
-                        // Split string lists. This assumes they are always named "*list"
-                        if (setting.at(1).endsWith("list", Qt::CaseInsensitive))
-                            value = option.at(1).split(",");
-                        else
-                            value = option.at(1);
-                        Settings::setValue(setting.at(0).toStdString(), setting.at(1).toStdString(), value, saveToDisk);
-                    }
-                }
-            }
         } else {
             // Other: Check if it's a valid file name
             if(QFile::exists(arguments().at(i)))
@@ -38,6 +38,9 @@ private:
     QTranslator* m_translatorApp;
 };
 
+// Print a line of the command line usage message
+void printArgument(const QString& argument, const QString& description);
+
 void addShortcutsTooltip(QAction* action, const QList<QKeySequence>& extraKeys = QList<QKeySequence>());
 
 #endif
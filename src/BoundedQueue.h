@@ -0,0 +1,89 @@
+#ifndef BOUNDED_QUEUE_H
+#define BOUNDED_QUEUE_H
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+/**
+
+   queue for handing items from one thread to another. pushing blocks
+   while the queue holds capacity items already, so a producer cannot
+   run arbitrarily far ahead of its consumer.
+
+   the producer calls close() after pushing its last item. the
+   consumer then still gets all remaining items before pop() fails.
+   abort() makes all pending and future calls on both sides fail
+   right away, e.g. when one side has run into an error.
+
+**/
+template <typename T>
+class BoundedQueue
+{
+public:
+    explicit BoundedQueue (size_t capacity)
+        : capacity(capacity > 0 ? capacity : 1)
+        , closed(false)
+        , aborted(false)
+    {
+    }
+
+    /// append item, waiting while the queue is full. \returns false
+    /// if the queue was aborted
+    bool push (T item)
+    {
+        std::unique_lock<std::mutex> lk(m);
+        cv_not_full.wait(lk, [this]() { return aborted || items.size() < capacity; });
+        if(aborted)
+            return false;
+
+        items.push_back(std::move(item));
+        cv_not_empty.notify_one();
+        return true;
+    }
+
+    /// take the first item, waiting while the queue is empty. \returns
+    /// false if the queue was aborted, or closed and all items taken
+    bool pop (T & item)
+    {
+        std::unique_lock<std::mutex> lk(m);
+        cv_not_empty.wait(lk, [this]() { return aborted || closed || !items.empty(); });
+        if(aborted || items.empty())
+            return false;
+
+        item = std::move(items.front());
+        items.pop_front();
+        cv_not_full.notify_one();
+        return true;
+    }
+
+    /// no more items are going to be pushed
+    void close ()
+    {
+        std::lock_guard<std::mutex> lk(m);
+        closed = true;
+        cv_not_empty.notify_all();
+    }
+
+    /// throw away all items and make all calls fail from now on
+    void abort ()
+    {
+        std::lock_guard<std::mutex> lk(m);
+        aborted = true;
+        items.clear();
+        cv_not_empty.notify_all();
+        cv_not_full.notify_all();
+    }
+
+private:
+    const size_t capacity;
+    bool closed;
+    bool aborted;
+    std::deque<T> items;
+
+    std::mutex m;
+    std::condition_variable cv_not_empty;
+    std::condition_variable cv_not_full;
+};
+
+#endif
@@ -0,0 +1,616 @@
+#include "ColumnarRowCache.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+#include <stdexcept>
+
+namespace {
+
+using LengthPrefix = quint32;
+
+// REAL values are stored in the 64 bit slots of the columns
+static_assert(sizeof(double) == sizeof(qint64), "a double must fit into a value slot");
+
+ColumnarRowCache::CellRow toCells(const std::vector<QByteArray>& row)
+{
+    ColumnarRowCache::CellRow cells;
+    cells.reserve(row.size());
+    for(const auto& v : row)
+        cells.push_back(ColumnarRowCache::Cell::fromByteArray(v));
+    return cells;
+}
+
+}
+
+ColumnarRowCache::Cell ColumnarRowCache::Cell::fromByteArray(const QByteArray& value)
+{
+    // Keep the distinction between NULL values and empty strings
+    if(value.isNull())
+        return null();
+    return fromBytes(value.constData(), static_cast<size_t>(value.size()));
+}
+
+QByteArray ColumnarRowCache::Cell::formatReal(double value)
+{
+    QByteArray text = QByteArray::number(value, 'g', 15);
+
+    // Mark whole numbers as REAL values
+    if(std::isfinite(value) && !text.contains('.') && !text.contains('e'))
+        text.append(".0");
+    return text;
+}
+
+QByteArray ColumnarRowCache::Cell::toByteArray() const
+{
+    switch(kind)
+    {
+    case Null:
+        return QByteArray();
+    case Integer:
+        return QByteArray::number(integer);
+    case Real:
+        return formatReal(real);
+    case Bytes:
+        break;
+    }
+
+    // Empty values are empty strings, not NULL
+    if(size == 0)
+        return QByteArray("");
+    return QByteArray(data, static_cast<int>(size));
+}
+
+size_t ColumnarRowCache::RowRef::size() const
+{
+    return chunk->columns.size();
+}
+
+QByteArray ColumnarRowCache::RowRef::at(size_t column) const
+{
+    return cell(column).toByteArray();
+}
+
+ColumnarRowCache::Cell ColumnarRowCache::RowRef::cell(size_t column) const
+{
+    if(column >= chunk->columns.size())
+        throw std::out_of_range("no such column");
+
+    const Column& c = chunk->columns[column];
+    if(c.nulls[index])
+        return Cell::null();
+    if(c.integers[index])
+        return Cell::fromInteger(c.values[index]);
+    if(c.reals[index])
+    {
+        double real;
+        std::memcpy(&real, &c.values[index], sizeof(real));
+        return Cell::fromReal(real);
+    }
+
+    const char* p = chunk->arena.data() + c.values[index];
+    LengthPrefix size;
+    std::memcpy(&size, p, sizeof(size));
+    return Cell::fromBytes(p + sizeof(size), size);
+}
+
+bool ColumnarRowCache::RowRef::isNull(size_t column) const
+{
+    if(column >= chunk->columns.size())
+        throw std::out_of_range("no such column");
+
+    return chunk->columns[column].nulls[index];
+}
+
+int ColumnarRowCache::RowRef::format(size_t column) const
+{
+    if(column >= chunk->columns.size() || chunk->columns[column].formats.empty())
+        return -1;
+
+    return chunk->columns[column].formats[index];
+}
+
+ColumnarRowCache::ColumnarRowCache (size_t max_chunk_size_)
+    : max_chunk_size(max_chunk_size_)
+    , memory_limit(0)
+    , memory_usage(0)
+    , protected_begin(0)
+    , protected_end(0)
+    , pin_count(0)
+    , num_evicted(0)
+    , use_clock(0)
+{
+    if(max_chunk_size == 0)
+        throw std::invalid_argument("maximum chunk size must be > 0");
+}
+
+size_t ColumnarRowCache::numSet () const
+{
+    return std::accumulate(chunks.begin(), chunks.end(), size_t(0),
+                           [](size_t r, const Chunk & c) { return r + c.num_rows; });
+}
+
+size_t ColumnarRowCache::numSegments () const
+{
+    return chunks.size();
+}
+
+size_t ColumnarRowCache::count (size_t pos) const
+{
+    return getChunkContaining(pos) != chunks.end();
+}
+
+ColumnarRowCache::RowRef ColumnarRowCache::at (size_t pos) const
+{
+    auto it = getChunkContaining(pos);
+
+    if(it != chunks.end())
+    {
+        it->last_use = ++use_clock;
+        return RowRef(&*it, pos - it->pos_begin);
+    }
+
+    throw std::out_of_range("no matching chunk found");
+}
+
+void ColumnarRowCache::set (size_t pos, const CellRow & row)
+{
+    auto it = getChunkBeyond(pos);
+
+    if(it != chunks.begin())
+    {
+        auto prev_it = it - 1;
+        auto d = pos - prev_it->pos_begin; // distance from chunk start (>=0)
+
+        if(d < prev_it->num_rows || (d == prev_it->num_rows && d < max_chunk_size))
+        {
+            if(d == prev_it->num_rows)
+            {
+                // extend existing chunk
+                insertSlot(*prev_it, d);
+            }
+
+            // replace value
+            writeRow(*prev_it, d, row);
+            compact(*prev_it);
+
+            // Once a chunk is full it won't grow anymore, so give back the memory reserved for growing it further
+            if(prev_it->num_rows == max_chunk_size && d + 1 == max_chunk_size)
+            {
+                for(auto& c : prev_it->columns)
+                    c.values.shrink_to_fit();
+                prev_it->arena.shrink_to_fit();
+            }
+
+            prev_it->last_use = ++use_clock;
+            updateBytes(*prev_it);
+            evict(pos);
+            return;
+        }
+    }
+
+    // make new chunk
+    it = newChunk(it, pos);
+    insertSlot(*it, 0);
+    writeRow(*it, 0, row);
+    updateBytes(*it);
+    evict(pos);
+}
+
+void ColumnarRowCache::set (size_t pos, const std::vector<QByteArray> & row)
+{
+    set(pos, toCells(row));
+}
+
+void ColumnarRowCache::setCell (size_t pos, size_t column, const QByteArray & value)
+{
+    auto it = getChunkContaining(pos);
+    if(it == chunks.end())
+        throw std::out_of_range("no matching chunk found");
+
+    ensureColumns(*it, column + 1);
+    assignCell(*it, column, pos - it->pos_begin, Cell::fromByteArray(value));
+    compact(*it);
+    it->last_use = ++use_clock;
+    updateBytes(*it);
+    evict(pos);
+}
+
+void ColumnarRowCache::setFormats (size_t pos, const std::vector<int> & formats)
+{
+    auto it = getChunkContaining(pos);
+    if(it == chunks.end())
+        return;
+
+    const size_t index = pos - it->pos_begin;
+    ensureColumns(*it, formats.size());
+    for(size_t i=0;i<formats.size();i++)
+    {
+        // Only allocate memory for columns which actually have some formatting
+        auto& c = it->columns[i];
+        if(c.formats.empty())
+        {
+            if(formats[i] < 0)
+                continue;
+            c.formats.assign(it->num_rows, -1);
+        }
+        c.formats[index] = formats[i];
+    }
+    updateBytes(*it);
+}
+
+void ColumnarRowCache::insert (size_t pos, const std::vector<QByteArray> & row)
+{
+    const CellRow cells = toCells(row);
+    auto it = getChunkBeyond(pos);
+
+    if(it != chunks.begin())
+    {
+        auto prev_it = it - 1;
+        auto d = pos - prev_it->pos_begin; // distance from chunk start (>=0)
+
+        if(d <= prev_it->num_rows)
+        {
+            // can extend existing chunk
+            insertSlot(*prev_it, d);
+            writeRow(*prev_it, d, cells);
+            updateBytes(*prev_it);
+            goto push;
+        }
+    }
+
+    // make new chunk
+    it = newChunk(it, pos);
+    insertSlot(*it, 0);
+    writeRow(*it, 0, cells);
+    updateBytes(*it);
+    ++it;
+
+push:
+    // push back all later chunks
+    std::for_each(it, chunks.end(), [](Chunk &c){ c.pos_begin++; });
+}
+
+void ColumnarRowCache::erase (size_t pos)
+{
+    auto it = getChunkBeyond(pos);
+
+    // if previous chunk actually contains pos, shorten it
+    if(it != chunks.begin())
+    {
+        auto prev_it = it - 1;
+        auto d = pos - prev_it->pos_begin; // distance from chunk start (>=0)
+
+        if(d < prev_it->num_rows)
+        {
+            eraseSlots(*prev_it, d, d + 1);
+            if(prev_it->num_rows == 0)
+            {
+                memory_usage -= prev_it->bytes;
+                it = chunks.erase(prev_it);
+            } else {
+                compact(*prev_it);
+                updateBytes(*prev_it);
+            }
+        }
+    }
+
+    // pull forward all later chunks
+    std::for_each(it, chunks.end(), [](Chunk &c){ c.pos_begin--; });
+}
+
+void ColumnarRowCache::remove (size_t pos)
+{
+    auto it = getChunkContaining(pos);
+    if(it == chunks.end())
+        return;
+
+    const size_t index = pos - it->pos_begin;
+
+    // move the rows following the removed one into a chunk of their own
+    if(index + 1 < it->num_rows)
+    {
+        Chunk tail;
+        tail.pos_begin = pos + 1;
+        tail.num_rows = 0;
+        tail.wasted = 0;
+        tail.bytes = 0;
+        tail.last_use = it->last_use;
+
+        CellRow row(it->columns.size());
+        for(size_t i=index+1;i<it->num_rows;i++)
+        {
+            const RowRef ref(&*it, i);
+            for(size_t c=0;c<row.size();c++)
+                row[c] = ref.cell(c);
+            insertSlot(tail, tail.num_rows);
+            writeRow(tail, tail.num_rows - 1, row);
+        }
+        for(size_t c=0;c<it->columns.size();c++)
+        {
+            const auto& formats = it->columns[c].formats;
+            if(!formats.empty())
+                tail.columns[c].formats.assign(formats.begin() + static_cast<std::ptrdiff_t>(index) + 1, formats.end());
+        }
+
+        it = chunks.insert(it + 1, std::move(tail));
+        updateBytes(*it);
+        --it;
+    }
+
+    eraseSlots(*it, index, it->num_rows);
+    if(it->num_rows == 0)
+    {
+        memory_usage -= it->bytes;
+        chunks.erase(it);
+    } else {
+        compact(*it);
+        updateBytes(*it);
+    }
+}
+
+void ColumnarRowCache::clear ()
+{
+    // Whoever pinned the cache is going to unpin it again, so keep the pins
+    chunks.clear();
+    memory_usage = 0;
+    protected_begin = protected_end = 0;
+}
+
+void ColumnarRowCache::smallestNonAvailableRange (size_t & row_begin, size_t & row_end) const
+{
+    if(row_end < row_begin)
+        throw std::invalid_argument("end must be >= begin");
+
+    while(row_begin < row_end) {
+        auto it = getChunkContaining(row_begin);
+        if(it == chunks.end())
+            break;
+        row_begin = it->pos_end();
+    }
+
+    while(row_end > row_begin) {
+        auto it = getChunkContaining(row_end - 1);
+        if(it == chunks.end())
+            break;
+        row_end = it->pos_begin;
+    }
+
+    if(row_end < row_begin)
+        row_end = row_begin;
+}
+
+void ColumnarRowCache::setMemoryLimit (size_t bytes)
+{
+    memory_limit = bytes;
+    evict(protected_begin);
+}
+
+void ColumnarRowCache::setProtectedRange (size_t row_begin, size_t row_end)
+{
+    if(row_end < row_begin)
+        throw std::invalid_argument("end must be >= begin");
+
+    protected_begin = row_begin;
+    protected_end = row_end;
+}
+
+void ColumnarRowCache::unpin ()
+{
+    if(pin_count == 0)
+        throw std::logic_error("cache is not pinned");
+
+    if(--pin_count == 0)
+        evict(protected_begin);
+}
+
+ColumnarRowCache::Chunks::const_iterator ColumnarRowCache::getChunkBeyond (size_t pos) const
+{
+    // first chunk whose pos_begin > pos (so can't contain pos itself):
+    return std::upper_bound(chunks.begin(), chunks.end(), pos, [](size_t p, const Chunk & c) { return p < c.pos_begin; });
+}
+
+ColumnarRowCache::Chunks::iterator ColumnarRowCache::getChunkBeyond (size_t pos)
+{
+    return std::upper_bound(chunks.begin(), chunks.end(), pos, [](size_t p, const Chunk & c) { return p < c.pos_begin; });
+}
+
+ColumnarRowCache::Chunks::const_iterator ColumnarRowCache::getChunkContaining (size_t pos) const
+{
+    auto it = getChunkBeyond(pos);
+
+    if(it != chunks.begin()) {
+        auto prev_it = it - 1;
+        if(pos < prev_it->pos_end())
+            return prev_it;
+    }
+
+    return chunks.end();
+}
+
+ColumnarRowCache::Chunks::iterator ColumnarRowCache::getChunkContaining (size_t pos)
+{
+    auto it = getChunkBeyond(pos);
+
+    if(it != chunks.begin()) {
+        auto prev_it = it - 1;
+        if(pos < prev_it->pos_end())
+            return prev_it;
+    }
+
+    return chunks.end();
+}
+
+ColumnarRowCache::Chunks::iterator ColumnarRowCache::newChunk (Chunks::iterator it, size_t pos)
+{
+    Chunk c;
+    c.pos_begin = pos;
+    c.num_rows = 0;
+    c.wasted = 0;
+    c.bytes = 0;
+    c.last_use = ++use_clock;
+    return chunks.insert(it, std::move(c));
+}
+
+void ColumnarRowCache::ensureColumns (Chunk & chunk, size_t num_columns)
+{
+    // Columns added later are NULL in all rows which are already there
+    while(chunk.columns.size() < num_columns)
+    {
+        Column c;
+        c.values.assign(chunk.num_rows, 0);
+        c.nulls.assign(chunk.num_rows, true);
+        c.integers.assign(chunk.num_rows, false);
+        c.reals.assign(chunk.num_rows, false);
+        chunk.columns.push_back(std::move(c));
+    }
+}
+
+void ColumnarRowCache::insertSlot (Chunk & chunk, size_t index)
+{
+    for(auto& c : chunk.columns)
+    {
+        c.values.insert(c.values.begin() + static_cast<std::ptrdiff_t>(index), 0);
+        c.nulls.insert(c.nulls.begin() + static_cast<std::ptrdiff_t>(index), true);
+        c.integers.insert(c.integers.begin() + static_cast<std::ptrdiff_t>(index), false);
+        c.reals.insert(c.reals.begin() + static_cast<std::ptrdiff_t>(index), false);
+        if(!c.formats.empty())
+            c.formats.insert(c.formats.begin() + static_cast<std::ptrdiff_t>(index), -1);
+    }
+    chunk.num_rows++;
+}
+
+void ColumnarRowCache::eraseSlots (Chunk & chunk, size_t index_begin, size_t index_end)
+{
+    const auto first = static_cast<std::ptrdiff_t>(index_begin);
+    const auto last = static_cast<std::ptrdiff_t>(index_end);
+    for(size_t i=0;i<chunk.columns.size();i++)
+    {
+        for(size_t index=index_begin;index<index_end;index++)
+            releaseCell(chunk, i, index);
+
+        auto& c = chunk.columns[i];
+        c.values.erase(c.values.begin() + first, c.values.begin() + last);
+        c.nulls.erase(c.nulls.begin() + first, c.nulls.begin() + last);
+        c.integers.erase(c.integers.begin() + first, c.integers.begin() + last);
+        c.reals.erase(c.reals.begin() + first, c.reals.begin() + last);
+        if(!c.formats.empty())
+            c.formats.erase(c.formats.begin() + first, c.formats.begin() + last);
+    }
+    chunk.num_rows -= index_end - index_begin;
+}
+
+void ColumnarRowCache::assignCell (Chunk & chunk, size_t column, size_t index, const Cell & cell)
+{
+    releaseCell(chunk, column, index);
+
+    Column& c = chunk.columns[column];
+    c.nulls[index] = cell.kind == Cell::Null;
+    c.integers[index] = cell.kind == Cell::Integer;
+    c.reals[index] = cell.kind == Cell::Real;
+
+    switch(cell.kind)
+    {
+    case Cell::Null:
+        c.values[index] = 0;
+        break;
+    case Cell::Integer:
+        c.values[index] = cell.integer;
+        break;
+    case Cell::Real:
+        std::memcpy(&c.values[index], &cell.real, sizeof(cell.real));
+        break;
+    case Cell::Bytes:
+    {
+        const LengthPrefix size = static_cast<LengthPrefix>(cell.size);
+        c.values[index] = static_cast<qint64>(chunk.arena.size());
+        const char* size_bytes = reinterpret_cast<const char*>(&size);
+        chunk.arena.insert(chunk.arena.end(), size_bytes, size_bytes + sizeof(size));
+        chunk.arena.insert(chunk.arena.end(), cell.data, cell.data + cell.size);
+        break;
+    }
+    }
+}
+
+void ColumnarRowCache::releaseCell (Chunk & chunk, size_t column, size_t index)
+{
+    const Column& c = chunk.columns[column];
+    if(c.nulls[index] || c.integers[index] || c.reals[index])
+        return;
+
+    LengthPrefix size;
+    std::memcpy(&size, chunk.arena.data() + c.values[index], sizeof(size));
+    chunk.wasted += sizeof(size) + size;
+}
+
+void ColumnarRowCache::writeRow (Chunk & chunk, size_t index, const CellRow & row)
+{
+    ensureColumns(chunk, row.size());
+    for(size_t i=0;i<chunk.columns.size();i++)
+        assignCell(chunk, i, index, i < row.size() ? row[i] : Cell::null());
+}
+
+void ColumnarRowCache::compact (Chunk & chunk)
+{
+    // Only rewrite the arena when at least half of it is garbage left behind by overwritten or removed values
+    if(chunk.wasted < 4096 || chunk.wasted < chunk.arena.size() / 2)
+        return;
+
+    std::vector<char> arena;
+    arena.reserve(chunk.arena.size() - chunk.wasted);
+    for(auto& c : chunk.columns)
+    {
+        for(size_t i=0;i<chunk.num_rows;i++)
+        {
+            if(c.nulls[i] || c.integers[i] || c.reals[i])
+                continue;
+
+            const char* p = chunk.arena.data() + c.values[i];
+            LengthPrefix size;
+            std::memcpy(&size, p, sizeof(size));
+            c.values[i] = static_cast<qint64>(arena.size());
+            arena.insert(arena.end(), p, p + sizeof(size) + size);
+        }
+    }
+    chunk.arena = std::move(arena);
+    chunk.wasted = 0;
+}
+
+void ColumnarRowCache::updateBytes (Chunk & chunk)
+{
+    size_t bytes = sizeof(Chunk) + chunk.columns.capacity() * sizeof(Column) + chunk.arena.capacity();
+    for(const auto& c : chunk.columns)
+        bytes += c.values.capacity() * sizeof(qint64) + (c.nulls.capacity() + c.integers.capacity() + c.reals.capacity()) / 8 + c.formats.capacity() * sizeof(int);
+
+    memory_usage = memory_usage - chunk.bytes + bytes;
+    chunk.bytes = bytes;
+}
+
+void ColumnarRowCache::evict (size_t keep_pos)
+{
+    if(memory_limit == 0 || pin_count > 0)
+        return;
+
+    while(memory_usage > memory_limit)
+    {
+        // find the least recently used chunk which we are allowed to throw away
+        auto victim = chunks.end();
+        for(auto it = chunks.begin(); it != chunks.end(); ++it)
+        {
+            if(keep_pos >= it->pos_begin && keep_pos < it->pos_end())
+                continue;
+            if(it->pos_begin < protected_end && protected_begin < it->pos_end())
+                continue;
+            if(victim == chunks.end() || it->last_use < victim->last_use)
+                victim = it;
+        }
+
+        if(victim == chunks.end())
+            return;
+
+        memory_usage -= victim->bytes;
+        chunks.erase(victim);
+        num_evicted++;
+    }
+}
@@ -0,0 +1,239 @@
+#ifndef COLUMNAR_ROW_CACHE_H
+#define COLUMNAR_ROW_CACHE_H
+
+#include <QByteArray>
+
+#include <vector>
+
+/**
+
+   row cache for SqliteTableModel which stores its rows in columnar,
+   arena-backed chunks instead of one heap allocated byte array per
+   cell.
+
+   this logically resembles a std::vector<std::optional<row>> and is
+   organised as a sorted list of non-overlapping chunks of contiguous
+   rows with gaps in between. each chunk holds at most max_chunk_size
+   rows appended through set(). per column, a chunk stores one 64 bit
+   slot per row and bitmaps marking NULL, INTEGER and REAL values.
+   integers and the bits of reals are stored directly in the slot, all
+   other values are stored length-prefixed in a single byte arena per
+   chunk and the slot holds their offset. reals are converted to text
+   by formatReal(), so callers only store a REAL value as such when
+   that gives the same text as SQLite and keep its text otherwise.
+
+   memory usage is accounted per chunk. once the memory limit is
+   exceeded, whole chunks are evicted in least-recently-used order,
+   sparing the protected range, the chunk being written to and
+   everything while the cache is pinned.
+
+**/
+class ColumnarRowCache
+{
+    struct Chunk;
+
+public:
+    /// a single value to be stored. the bytes are referenced, not
+    /// owned, and are copied into the cache by set() and insert().
+    struct Cell
+    {
+        enum Kind : unsigned char
+        {
+            Null,
+            Integer,
+            Real,
+            Bytes
+        };
+
+        Kind kind;
+        qint64 integer;
+        double real;
+        const char* data;
+        size_t size;
+
+        static Cell null() { return { Null, 0, 0.0, nullptr, 0 }; }
+        static Cell fromInteger(qint64 value) { return { Integer, value, 0.0, nullptr, 0 }; }
+        static Cell fromReal(double value) { return { Real, 0, value, nullptr, 0 }; }
+        static Cell fromBytes(const char* data, size_t size) { return { Bytes, 0, 0.0, data, size }; }
+        static Cell fromByteArray(const QByteArray& value);
+
+        /// \returns the text shown for a REAL value: 15 significant
+        /// digits and a trailing ".0" for whole numbers, like SQLite
+        /// does for most values
+        static QByteArray formatReal(double value);
+
+        /// \returns a copy of the value, a null byte array for NULL
+        QByteArray toByteArray() const;
+    };
+
+    using CellRow = std::vector<Cell>;
+
+    /// read access to a single cached row. only valid until the cache
+    /// is modified.
+    class RowRef
+    {
+    public:
+        /// \returns number of columns
+        size_t size() const;
+
+        /// \returns copy of the value of specified column, a null byte
+        /// array for NULL values. \throws if column does not exist
+        QByteArray at(size_t column) const;
+
+        /// \returns value of specified column without copying it. text
+        /// and BLOB values point into the cache. \throws if column does
+        /// not exist
+        Cell cell(size_t column) const;
+
+        bool isNull(size_t column) const;
+
+        /// \returns index of the conditional format stored for the
+        /// specified column, -1 if there is none
+        int format(size_t column) const;
+
+    private:
+        friend class ColumnarRowCache;
+        RowRef(const Chunk* chunk_, size_t index_) : chunk(chunk_), index(index_) {}
+
+        const Chunk* chunk;
+        size_t index;
+    };
+
+    static constexpr size_t default_max_chunk_size = 4096;
+
+    /// constructs an empty cache
+    explicit ColumnarRowCache (size_t max_chunk_size = default_max_chunk_size);
+
+    /// \returns number of cached rows
+    size_t numSet () const;
+
+    /// \returns number of chunks
+    size_t numSegments () const;
+
+    /// \returns 1 if specified row is loaded, 0 otherwise
+    size_t count (size_t pos) const;
+
+    /// \returns specified row. \throws if not available
+    RowRef at (size_t pos) const;
+
+    /// assigns value to specified row; may increase numSet() by one
+    void set (size_t pos, const CellRow & row);
+    void set (size_t pos, const std::vector<QByteArray> & row);
+
+    /// assigns value to a single column of the specified row. \throws
+    /// if not available
+    void setCell (size_t pos, size_t column, const QByteArray & value);
+
+    /// stores the index of the matching conditional format for each
+    /// column of the specified row, -1 meaning none. does nothing if
+    /// the row is not available.
+    void setFormats (size_t pos, const std::vector<int> & formats);
+
+    /// insert new row; increases numSet() by one
+    void insert (size_t pos, const std::vector<QByteArray> & row);
+
+    /// delete row; decreases numSet() by one
+    void erase (size_t pos);
+
+    /// forget the value of specified row so it needs to be set again,
+    /// without moving the following rows. does nothing if the row is
+    /// not available.
+    void remove (size_t pos);
+
+    /// reset to state after construction, except for the memory limit
+    /// and pins, which still need their matching unpin() calls
+    void clear ();
+
+    /// given a range of rows (end is exclusive), narrow it in order
+    /// to remove already-loaded rows from both ends.
+    void smallestNonAvailableRange (size_t & row_begin, size_t & row_end) const;
+
+    /// set the memory budget in bytes; 0 means unlimited. evicts
+    /// chunks right away if the new limit is exceeded.
+    void setMemoryLimit (size_t bytes);
+    size_t memoryLimit () const { return memory_limit; }
+
+    /// \returns memory used by all chunks in bytes
+    size_t memoryUsage () const { return memory_usage; }
+
+    /// never evict chunks overlapping the specified range of rows
+    /// (end is exclusive)
+    void setProtectedRange (size_t row_begin, size_t row_end);
+    size_t protectedBegin () const { return protected_begin; }
+    size_t protectedEnd () const { return protected_end; }
+
+    /// disable eviction until the matching unpin() call. calls nest.
+    void pin () { pin_count++; }
+    void unpin ();
+    bool isPinned () const { return pin_count > 0; }
+
+    /// \returns number of chunks evicted since construction
+    size_t numEvicted () const { return num_evicted; }
+
+private:
+    struct Column
+    {
+        std::vector<qint64> values;     ///< integer value, bits of the real value or offset of the value in the arena
+        std::vector<bool> nulls;
+        std::vector<bool> integers;
+        std::vector<bool> reals;
+        std::vector<int> formats;       ///< empty unless a conditional format matched any row of the chunk
+    };
+
+    /// a single chunk containing contiguous rows
+    struct Chunk
+    {
+        size_t pos_begin;
+        size_t num_rows;
+        std::vector<Column> columns;
+        std::vector<char> arena;        ///< length-prefixed values of all text and BLOB cells
+        size_t wasted;                  ///< bytes in the arena which are not referenced anymore
+        size_t bytes;                   ///< memory used by this chunk
+        mutable size_t last_use;        ///< value of use_clock when last accessed
+
+        /// returns past-the-end position of this chunk
+        size_t pos_end () const { return pos_begin + num_rows; }
+    };
+
+    /// collection of non-overlapping chunks, in order of increasing
+    /// position
+    using Chunks = std::vector<Chunk>;
+    Chunks chunks;
+
+    size_t max_chunk_size;
+    size_t memory_limit;
+    size_t memory_usage;
+    size_t protected_begin;
+    size_t protected_end;
+    size_t pin_count;
+    size_t num_evicted;
+    mutable size_t use_clock;
+
+    /// \returns first chunk that definitely cannot contain 'pos',
+    /// because it starts at some later position.
+    Chunks::const_iterator getChunkBeyond (size_t pos) const;
+    Chunks::iterator getChunkBeyond (size_t pos);
+
+    /// \returns chunk containing 'pos'
+    Chunks::const_iterator getChunkContaining (size_t pos) const;
+    Chunks::iterator getChunkContaining (size_t pos);
+
+    Chunks::iterator newChunk (Chunks::iterator it, size_t pos);
+
+    static void ensureColumns (Chunk & chunk, size_t num_columns);
+    static void insertSlot (Chunk & chunk, size_t index);
+    static void eraseSlots (Chunk & chunk, size_t index_begin, size_t index_end);
+    static void assignCell (Chunk & chunk, size_t column, size_t index, const Cell & cell);
+    static void releaseCell (Chunk & chunk, size_t column, size_t index);
+    static void writeRow (Chunk & chunk, size_t index, const CellRow & row);
+    static void compact (Chunk & chunk);
+
+    /// recalculate the memory used by a chunk after it was modified
+    void updateBytes (Chunk & chunk);
+
+    /// throw away least recently used chunks until memory usage is
+    /// within the limit again, sparing the chunk containing 'keep_pos'
+    void evict (size_t keep_pos);
+};
+
+#endif
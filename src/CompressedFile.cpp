@@ -0,0 +1,781 @@
+#include "CompressedFile.h"
+
+#include <QFileInfo>
+
+#include <algorithm>
+
+#ifdef ENABLE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef ENABLE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace {
+// Data is handed to the compression thread in chunks of this size
+constexpr int chunkBytes = 1024 * 1024;
+
+// Number of chunks which may be waiting for the compression thread
+constexpr size_t maxQueuedChunks = 4;
+
+// Chunks are compressed in pieces of this size, so the size of split parts can be checked often enough
+constexpr int inputPieceBytes = 64 * 1024;
+
+// Size of the compressed data read at once
+constexpr int inputBytes = 256 * 1024;
+
+// The output buffers grow in steps of this size
+constexpr int outputBytes = 256 * 1024;
+
+#ifdef ENABLE_ZLIB
+constexpr int gzipLevel = 6;
+#endif
+#ifdef ENABLE_ZSTD
+constexpr int zstdLevel = 3;
+#endif
+
+Compression detectCompression(const QByteArray& header)
+{
+    if(header.startsWith("\x1f\x8b"))
+        return Compression::Gzip;
+    if(header.startsWith("\x28\xb5\x2f\xfd"))
+        return Compression::Zstd;
+    return Compression::None;
+}
+
+QString partFileName(const QString& fileName, int number)
+{
+    return QString("%1.%2").arg(fileName).arg(number, 3, 10, QChar('0'));
+}
+
+QString tempFileName(const QString& fileName)
+{
+    return fileName + ".part";
+}
+}
+
+std::vector<Compression> availableCompressions()
+{
+    std::vector<Compression> compressions = {Compression::None};
+#ifdef ENABLE_ZLIB
+    compressions.push_back(Compression::Gzip);
+#endif
+#ifdef ENABLE_ZSTD
+    compressions.push_back(Compression::Zstd);
+#endif
+    return compressions;
+}
+
+QString compressionName(Compression compression)
+{
+    switch(compression)
+    {
+    case Compression::None:
+        return QObject::tr("No compression");
+    case Compression::Gzip:
+        return QObject::tr("gzip");
+    case Compression::Zstd:
+        return QObject::tr("Zstandard");
+    }
+
+    return QString();
+}
+
+QString compressionSuffix(Compression compression)
+{
+    switch(compression)
+    {
+    case Compression::None:
+        return QString();
+    case Compression::Gzip:
+        return ".gz";
+    case Compression::Zstd:
+        return ".zst";
+    }
+
+    return QString();
+}
+
+// Compresses a stream of data. Each call with finish set ends a complete stream and the next call starts a new one.
+class CompressedFileWriter::Encoder
+{
+public:
+    explicit Encoder(Compression compression)
+        : m_compression(compression),
+          m_valid(true)
+    {
+        if(m_compression == Compression::Gzip)
+        {
+#ifdef ENABLE_ZLIB
+            m_zlib.zalloc = Z_NULL;
+            m_zlib.zfree = Z_NULL;
+            m_zlib.opaque = Z_NULL;
+
+            // Adding 16 to the window bits writes a gzip header instead of a zlib header
+            m_valid = deflateInit2(&m_zlib, gzipLevel, Z_DEFLATED, MAX_WBITS + 16, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+#else
+            m_valid = false;
+#endif
+        } else if(m_compression == Compression::Zstd) {
+#ifdef ENABLE_ZSTD
+            m_zstd = ZSTD_createCCtx();
+            m_valid = m_zstd && !ZSTD_isError(ZSTD_CCtx_setParameter(m_zstd, ZSTD_c_compressionLevel, zstdLevel));
+#else
+            m_valid = false;
+#endif
+        }
+    }
+
+    ~Encoder()
+    {
+#ifdef ENABLE_ZLIB
+        if(m_compression == Compression::Gzip && m_valid)
+            deflateEnd(&m_zlib);
+#endif
+#ifdef ENABLE_ZSTD
+        if(m_compression == Compression::Zstd)
+            ZSTD_freeCCtx(m_zstd);
+#endif
+    }
+
+    bool isValid() const { return m_valid; }
+
+    // Append the compressed data to the output buffer
+    bool encode(const char* data, int size, bool finish, QByteArray& out)
+    {
+        switch(m_compression)
+        {
+        case Compression::None:
+            out.append(data, size);
+            return true;
+        case Compression::Gzip:
+        {
+#ifdef ENABLE_ZLIB
+            m_zlib.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+            m_zlib.avail_in = static_cast<uInt>(size);
+            int status;
+            do
+            {
+                const int start = out.size();
+                out.resize(start + outputBytes);
+                m_zlib.next_out = reinterpret_cast<Bytef*>(out.data() + start);
+                m_zlib.avail_out = outputBytes;
+                status = deflate(&m_zlib, finish ? Z_FINISH : Z_NO_FLUSH);
+                out.resize(start + outputBytes - static_cast<int>(m_zlib.avail_out));
+                if(status == Z_STREAM_ERROR)
+                    return false;
+            } while(m_zlib.avail_out == 0 || (finish && status != Z_STREAM_END));
+
+            return !finish || deflateReset(&m_zlib) == Z_OK;
+#else
+            return false;
+#endif
+        }
+        case Compression::Zstd:
+        {
+#ifdef ENABLE_ZSTD
+            ZSTD_inBuffer input = {data, static_cast<size_t>(size), 0};
+            size_t remaining;
+            do
+            {
+                const int start = out.size();
+                out.resize(start + outputBytes);
+                ZSTD_outBuffer output = {out.data() + start, outputBytes, 0};
+                remaining = ZSTD_compressStream2(m_zstd, &output, &input, finish ? ZSTD_e_end : ZSTD_e_continue);
+                out.resize(start + static_cast<int>(output.pos));
+                if(ZSTD_isError(remaining))
+                    return false;
+            } while(finish ? remaining != 0 : input.pos < input.size);
+
+            return true;
+#else
+            return false;
+#endif
+        }
+        }
+
+        return false;
+    }
+
+private:
+    Compression m_compression;
+    bool m_valid;
+#ifdef ENABLE_ZLIB
+    z_stream m_zlib;
+#endif
+#ifdef ENABLE_ZSTD
+    ZSTD_CCtx* m_zstd = nullptr;
+#endif
+};
+
+CompressedFileWriter::CompressedFileWriter(const QString& fileName, Compression compression, qint64 splitSize, QObject* parent)
+    : QIODevice(parent),
+      m_fileName(fileName),
+      m_compression(compression),
+      m_splitSize(splitSize),
+      m_chunks(maxQueuedChunks),
+      m_failed(false),
+      m_cancelled(false),
+      m_partSize(0)
+{
+}
+
+CompressedFileWriter::~CompressedFileWriter()
+{
+    if(isOpen())
+        cancelWriting();
+}
+
+bool CompressedFileWriter::open(OpenMode mode)
+{
+    if((mode & ReadOnly) || isOpen())
+        return false;
+
+    m_encoder = std::make_unique<Encoder>(m_compression);
+    if(!m_encoder->isValid())
+    {
+        setErrorString(tr("Compressing with %1 isn't supported.").arg(compressionName(m_compression)));
+        return false;
+    }
+
+    // Open the first file right away, so it is known whether it can be written at all
+    if(!openPart())
+    {
+        setErrorString(m_error);
+        return false;
+    }
+
+    m_buffer.reserve(chunkBytes);
+    m_thread = std::thread(&CompressedFileWriter::compress, this);
+    return QIODevice::open(mode);
+}
+
+void CompressedFileWriter::close()
+{
+    // Closing without committing throws away the file
+    if(isOpen())
+        cancelWriting();
+}
+
+qint64 CompressedFileWriter::writeData(const char* data, qint64 len)
+{
+    m_buffer.append(data, static_cast<int>(len));
+    if(m_buffer.size() >= chunkBytes)
+    {
+        if(!m_chunks.push(std::move(m_buffer)))
+        {
+            std::lock_guard<std::mutex> lk(m_mutexError);
+            setErrorString(m_error);
+            return -1;
+        }
+        m_buffer = QByteArray();
+        m_buffer.reserve(chunkBytes);
+    }
+
+    return len;
+}
+
+bool CompressedFileWriter::commit()
+{
+    if(!isOpen())
+        return false;
+
+    if(!m_buffer.isEmpty())
+        m_chunks.push(std::move(m_buffer));
+    m_buffer = QByteArray();
+    m_chunks.close();
+    m_thread.join();
+    QIODevice::close();
+
+    if(m_failed || !renameParts())
+    {
+        setErrorString(m_error);
+        removeParts();
+        return false;
+    }
+
+    return true;
+}
+
+void CompressedFileWriter::cancelWriting()
+{
+    if(!isOpen())
+        return;
+
+    m_cancelled = true;
+    m_chunks.abort();
+    m_thread.join();
+    QIODevice::close();
+
+    removeParts();
+}
+
+void CompressedFileWriter::fail(const QString& message)
+{
+    {
+        std::lock_guard<std::mutex> lk(m_mutexError);
+        if(!m_failed)
+            m_error = message;
+        m_failed = true;
+    }
+
+    m_chunks.abort();
+}
+
+bool CompressedFileWriter::renameParts()
+{
+    // Only now that all parts have been written, replace any existing files by them
+    for(int i=0;i<m_tempParts.size();i++)
+    {
+        QFile::remove(m_parts.at(i));
+        if(!QFile::rename(m_tempParts.at(i), m_parts.at(i)))
+        {
+            m_error = tr("Could not rename %1 to %2").arg(m_tempParts.at(i), m_parts.at(i));
+
+            // The parts renamed so far are incomplete without the others
+            for(int j=0;j<i;j++)
+                QFile::remove(m_parts.at(j));
+            m_tempParts = m_tempParts.mid(i);
+            return false;
+        }
+    }
+
+    m_tempParts.clear();
+    return true;
+}
+
+void CompressedFileWriter::removeParts()
+{
+    for(const QString& part : m_tempParts)
+        QFile::remove(part);
+    m_tempParts.clear();
+    m_parts.clear();
+}
+
+bool CompressedFileWriter::openPart()
+{
+    const QString fileName = m_splitSize > 0 ? partFileName(m_fileName, m_parts.size() + 1) : m_fileName;
+    m_part = std::make_unique<QFile>(tempFileName(fileName));
+    m_partSize = 0;
+    if(!m_part->open(QIODevice::WriteOnly))
+    {
+        fail(tr("Could not open output file: %1").arg(m_part->fileName()));
+        m_part.reset();
+        return false;
+    }
+
+    m_parts.push_back(fileName);
+    m_tempParts.push_back(m_part->fileName());
+    return true;
+}
+
+bool CompressedFileWriter::writePart(const QByteArray& data)
+{
+    if(m_part->write(data) != data.size())
+    {
+        fail(m_part->errorString());
+        return false;
+    }
+
+    m_partSize += data.size();
+    return true;
+}
+
+bool CompressedFileWriter::finishPart()
+{
+    QByteArray output;
+    if(!m_encoder->encode(nullptr, 0, true, output))
+    {
+        fail(tr("Compressing the data failed."));
+        return false;
+    }
+    if(!writePart(output))
+        return false;
+
+    const bool flushed = m_part->flush();
+    if(!flushed)
+        fail(m_part->errorString());
+    m_part.reset();
+    return flushed;
+}
+
+void CompressedFileWriter::compress()
+{
+    QByteArray chunk;
+    QByteArray output;
+    while(!m_failed && m_chunks.pop(chunk))
+    {
+        for(int offset=0;offset<chunk.size();)
+        {
+            if(!m_part && !openPart())
+                break;
+
+            // Without compression, split parts can be cut exactly at the maximum size
+            int size = std::min(chunk.size() - offset, inputPieceBytes);
+            if(m_splitSize > 0 && m_compression == Compression::None)
+                size = static_cast<int>(std::min<qint64>(size, m_splitSize - m_partSize));
+
+            output.clear();
+            if(!m_encoder->encode(chunk.constData() + offset, size, false, output))
+            {
+                fail(tr("Compressing the data failed."));
+                break;
+            }
+            if(!writePart(output))
+                break;
+            offset += size;
+
+            if(m_splitSize > 0 && m_partSize >= m_splitSize && !finishPart())
+                break;
+        }
+    }
+
+    // After the last chunk, finish the current part. When the data ended exactly at the end of a part, there is nothing left to do.
+    if(!m_failed && !m_cancelled && m_part)
+        finishPart();
+
+    // The unfinished part is removed along with all others
+    m_part.reset();
+}
+
+// Decompresses a stream of data. Several complete streams can follow each other.
+class CompressedFileReader::Decoder
+{
+public:
+    explicit Decoder(Compression compression)
+        : m_compression(compression),
+          m_valid(true),
+          m_complete(true)
+    {
+        if(m_compression == Compression::Gzip)
+        {
+#ifdef ENABLE_ZLIB
+            m_zlib.zalloc = Z_NULL;
+            m_zlib.zfree = Z_NULL;
+            m_zlib.opaque = Z_NULL;
+            m_zlib.next_in = Z_NULL;
+            m_zlib.avail_in = 0;
+
+            // Adding 32 to the window bits detects gzip and zlib headers automatically
+            m_valid = inflateInit2(&m_zlib, MAX_WBITS + 32) == Z_OK;
+#else
+            m_valid = false;
+#endif
+        } else if(m_compression == Compression::Zstd) {
+#ifdef ENABLE_ZSTD
+            m_zstd = ZSTD_createDCtx();
+            m_valid = m_zstd != nullptr;
+#else
+            m_valid = false;
+#endif
+        }
+    }
+
+    ~Decoder()
+    {
+#ifdef ENABLE_ZLIB
+        if(m_compression == Compression::Gzip && m_valid)
+            inflateEnd(&m_zlib);
+#endif
+#ifdef ENABLE_ZSTD
+        if(m_compression == Compression::Zstd)
+            ZSTD_freeDCtx(m_zstd);
+#endif
+    }
+
+    bool isValid() const { return m_valid; }
+
+    // Whether all streams so far have been completely decompressed
+    bool isComplete() const { return m_complete; }
+
+    // Append decompressed data to the output buffer. Returns the number of input bytes used or -1 if the data is corrupt.
+    int decode(const char* data, int size, QByteArray& out)
+    {
+        switch(m_compression)
+        {
+        case Compression::None:
+            out.append(data, size);
+            return size;
+        case Compression::Gzip:
+        {
+#ifdef ENABLE_ZLIB
+            // Another stream following the last one
+            if(m_complete && size > 0)
+            {
+                if(inflateReset(&m_zlib) != Z_OK)
+                    return -1;
+                m_complete = false;
+            }
+
+            m_zlib.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+            m_zlib.avail_in = static_cast<uInt>(size);
+            do
+            {
+                const int start = out.size();
+                out.resize(start + outputBytes);
+                m_zlib.next_out = reinterpret_cast<Bytef*>(out.data() + start);
+                m_zlib.avail_out = outputBytes;
+                const int status = inflate(&m_zlib, Z_NO_FLUSH);
+                out.resize(start + outputBytes - static_cast<int>(m_zlib.avail_out));
+
+                if(status == Z_STREAM_END)
+                {
+                    m_complete = true;
+                    break;
+                } else if(status == Z_BUF_ERROR) {
+                    // More input is needed
+                    break;
+                } else if(status != Z_OK) {
+                    return -1;
+                }
+            } while(m_zlib.avail_in > 0 || m_zlib.avail_out == 0);
+
+            return size - static_cast<int>(m_zlib.avail_in);
+#else
+            return -1;
+#endif
+        }
+        case Compression::Zstd:
+        {
+#ifdef ENABLE_ZSTD
+            ZSTD_inBuffer input = {data, static_cast<size_t>(size), 0};
+            ZSTD_outBuffer output;
+            do
+            {
+                const int start = out.size();
+                out.resize(start + outputBytes);
+                output = {out.data() + start, outputBytes, 0};
+                const size_t result = ZSTD_decompressStream(m_zstd, &output, &input);
+                out.resize(start + static_cast<int>(output.pos));
+                if(ZSTD_isError(result))
+                    return -1;
+
+                // A result of 0 means a frame has been completely decoded and flushed
+                m_complete = result == 0;
+            } while(input.pos < input.size || output.pos == output.size);
+
+            return static_cast<int>(input.pos);
+#else
+            return -1;
+#endif
+        }
+        }
+
+        return -1;
+    }
+
+private:
+    Compression m_compression;
+    bool m_valid;
+    bool m_complete;
+#ifdef ENABLE_ZLIB
+    z_stream m_zlib;
+#endif
+#ifdef ENABLE_ZSTD
+    ZSTD_DCtx* m_zstd = nullptr;
+#endif
+};
+
+CompressedFileReader::CompressedFileReader(const QString& fileName, QObject* parent)
+    : QIODevice(parent),
+      m_parts(fileNames(fileName)),
+      m_currentPart(0),
+      m_fileSize(0),
+      m_previousPartsSize(0),
+      m_compression(Compression::None),
+      m_inputPos(0),
+      m_outputPos(0),
+      m_end(false),
+      m_error(false)
+{
+}
+
+CompressedFileReader::~CompressedFileReader() = default;
+
+QStringList CompressedFileReader::fileNames(const QString& fileName)
+{
+    if(!fileName.endsWith(".001"))
+        return {fileName};
+
+    const QString base = fileName.left(fileName.size() - 4);
+    QStringList parts;
+    for(int i=1;i<1000 && QFile::exists(partFileName(base, i));i++)
+        parts.push_back(partFileName(base, i));
+    return parts;
+}
+
+std::unique_ptr<QIODevice> CompressedFileReader::openFile(const QString& fileName, QString& error)
+{
+    auto reader = std::make_unique<CompressedFileReader>(fileName);
+    if(!reader->open(QIODevice::ReadOnly))
+    {
+        error = reader->errorString();
+        return nullptr;
+    }
+    if(reader->compression() != Compression::None || reader->m_parts.size() > 1)
+        return reader;
+
+    // Unlike the reader, a QFile is not sequential. So the progress of reading it can be shown without any special handling.
+    reader.reset();
+    auto file = std::make_unique<QFile>(fileName);
+    if(!file->open(QIODevice::ReadOnly))
+    {
+        error = file->errorString();
+        return nullptr;
+    }
+    return file;
+}
+
+qint64 CompressedFileReader::filePosition() const
+{
+    // Data which has been read from the file but not decoded yet doesn't count
+    return m_previousPartsSize + m_file.pos() - (m_input.size() - m_inputPos);
+}
+
+bool CompressedFileReader::open(OpenMode mode)
+{
+    if((mode & WriteOnly) || isOpen())
+        return false;
+
+    if(!openPart(0))
+        return false;
+
+    m_fileSize = 0;
+    for(const QString& part : m_parts)
+        m_fileSize += QFileInfo(part).size();
+
+    // Look at the start of the file to find out how it is compressed
+    m_compression = detectCompression(m_file.peek(4));
+    m_decoder = std::make_unique<Decoder>(m_compression);
+    if(!m_decoder->isValid())
+    {
+        setErrorString(tr("Decompressing %1 files isn't supported.").arg(compressionName(m_compression)));
+        m_file.close();
+        return false;
+    }
+
+    m_input.clear();
+    m_inputPos = 0;
+    m_output.clear();
+    m_outputPos = 0;
+    m_end = false;
+    m_error = false;
+    return QIODevice::open(mode);
+}
+
+void CompressedFileReader::close()
+{
+    m_file.close();
+    m_decoder.reset();
+    m_input.clear();
+    m_output.clear();
+    QIODevice::close();
+}
+
+bool CompressedFileReader::atEnd() const
+{
+    // Only report the end of the data when it has been reached without an error
+    return m_end && !m_error && m_outputPos == m_output.size() && QIODevice::atEnd();
+}
+
+qint64 CompressedFileReader::bytesAvailable() const
+{
+    return m_output.size() - m_outputPos + QIODevice::bytesAvailable();
+}
+
+bool CompressedFileReader::openPart(int index)
+{
+    m_previousPartsSize = index == 0 ? 0 : m_previousPartsSize + m_file.size();
+    m_file.close();
+    m_currentPart = index;
+    if(index >= m_parts.size())
+    {
+        setErrorString(tr("File not found"));
+        return false;
+    }
+
+    m_file.setFileName(m_parts.at(index));
+    if(!m_file.open(QIODevice::ReadOnly))
+    {
+        setErrorString(m_file.errorString());
+        return false;
+    }
+
+    return true;
+}
+
+qint64 CompressedFileReader::readData(char* data, qint64 maxlen)
+{
+    qint64 done = 0;
+    while(done < maxlen)
+    {
+        if(m_outputPos == m_output.size())
+        {
+            if(m_end || m_error)
+                break;
+            if(!decodeMore())
+            {
+                m_error = true;
+                break;
+            }
+            continue;
+        }
+
+        const int size = static_cast<int>(std::min<qint64>(maxlen - done, m_output.size() - m_outputPos));
+        std::copy(m_output.constData() + m_outputPos, m_output.constData() + m_outputPos + size, data + done);
+        m_outputPos += size;
+        done += size;
+    }
+
+    // Report an error only when there is nothing left to return
+    return done == 0 && m_error ? -1 : done;
+}
+
+bool CompressedFileReader::decodeMore()
+{
+    m_output.clear();
+    m_outputPos = 0;
+    while(m_output.isEmpty())
+    {
+        if(m_inputPos == m_input.size())
+        {
+            m_input = m_file.read(inputBytes);
+            m_inputPos = 0;
+            if(m_input.isEmpty())
+            {
+                if(m_file.error() != QFileDevice::NoError)
+                {
+                    setErrorString(m_file.errorString());
+                    return false;
+                }
+
+                // Continue with the next part. A compressed stream may well go on in there.
+                if(m_currentPart + 1 < m_parts.size())
+                {
+                    if(!openPart(m_currentPart + 1))
+                        return false;
+                    continue;
+                }
+
+                if(!m_decoder->isComplete())
+                {
+                    setErrorString(tr("Unexpected end of the compressed data"));
+                    return false;
+                }
+
+                m_end = true;
+                return true;
+            }
+        }
+
+        const int used = m_decoder->decode(m_input.constData() + m_inputPos, m_input.size() - m_inputPos, m_output);
+        if(used < 0 || (used == 0 && m_output.isEmpty()))
+        {
+            setErrorString(tr("The compressed data is corrupt"));
+            return false;
+        }
+        m_inputPos += used;
+    }
+
+    return true;
+}
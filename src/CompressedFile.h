@@ -0,0 +1,158 @@
+#ifndef COMPRESSEDFILE_H
+#define COMPRESSEDFILE_H
+
+#include "BoundedQueue.h"
+
+#include <QByteArray>
+#include <QFile>
+#include <QIODevice>
+#include <QStringList>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+enum class Compression
+{
+    None,
+    Gzip,
+    Zstd,
+};
+
+// Compression formats supported by this build, starting with None
+std::vector<Compression> availableCompressions();
+
+// Name of a compression format for the user interface
+QString compressionName(Compression compression);
+
+// Usual file name extension of a compression format including the dot, or an empty string for None
+QString compressionSuffix(Compression compression);
+
+/*
+ * This device writes a file, optionally compressing it and splitting it into several parts of a maximum size each. The parts are
+ * named like the file with a three-digit number appended, starting with .001. Each of them is complete in itself, so it can be
+ * decompressed on its own, but they can just as well be concatenated again. The data is compressed and written on a separate thread,
+ * so this overlaps with producing the data.
+ *
+ * Like QSaveFile, the files only appear under their final names when commit() succeeds. Until then, all parts are written to
+ * temporary files next to them. Should writing fail or should the device be closed or destroyed before committing, these are removed.
+ */
+class CompressedFileWriter : public QIODevice
+{
+    Q_OBJECT
+
+public:
+    // A split size of 0 writes a single file. Compressed parts can be slightly bigger than the split size.
+    CompressedFileWriter(const QString& fileName, Compression compression, qint64 splitSize = 0, QObject* parent = nullptr);
+    ~CompressedFileWriter() override;
+
+    bool open(OpenMode mode) override;
+    void close() override;
+    bool isSequential() const override { return true; }
+
+    // Write the remaining data and wait until everything is on disk. Returns false if anything went wrong.
+    bool commit();
+
+    // Stop writing and remove all parts written so far
+    void cancelWriting();
+
+    // Names of all parts which have been written. Only valid after commit().
+    QStringList fileNames() const { return m_parts; }
+
+protected:
+    qint64 readData(char*, qint64) override { return -1; }
+    qint64 writeData(const char* data, qint64 len) override;
+
+private:
+    class Encoder;
+
+    QString m_fileName;
+    Compression m_compression;
+    qint64 m_splitSize;
+
+    QByteArray m_buffer;                        // Data which hasn't been handed to the compression thread yet
+    BoundedQueue<QByteArray> m_chunks;
+    std::thread m_thread;
+    std::atomic<bool> m_failed;
+    std::atomic<bool> m_cancelled;
+    std::mutex m_mutexError;
+    QString m_error;
+
+    // These are only used by the compression thread while it is running
+    std::unique_ptr<Encoder> m_encoder;
+    std::unique_ptr<QFile> m_part;
+    qint64 m_partSize;
+    QStringList m_parts;                        // Final names of the parts
+    QStringList m_tempParts;                    // Names the parts are written to until they are committed
+
+    void compress();
+    bool openPart();
+    bool writePart(const QByteArray& data);
+    bool finishPart();
+    void fail(const QString& message);
+    bool renameParts();
+    void removeParts();
+};
+
+/*
+ * This device reads a file written by CompressedFileWriter or by the usual command line tools. The compression format is detected
+ * from the contents. If the file name ends with .001, all following parts of a split file are read as well.
+ */
+class CompressedFileReader : public QIODevice
+{
+    Q_OBJECT
+
+public:
+    explicit CompressedFileReader(const QString& fileName, QObject* parent = nullptr);
+    ~CompressedFileReader() override;
+
+    bool open(OpenMode mode) override;
+    void close() override;
+    bool isSequential() const override { return true; }
+    bool atEnd() const override;
+    qint64 bytesAvailable() const override;
+
+    // Compression format of the file. Only valid after opening it.
+    Compression compression() const { return m_compression; }
+
+    // Names of all parts of a file, in order
+    static QStringList fileNames(const QString& fileName);
+
+    // Opens a file for reading. Plain files which aren't split are read by a QFile, all others by a CompressedFileReader. Returns
+    // nullptr and sets the error message if the file can't be opened.
+    static std::unique_ptr<QIODevice> openFile(const QString& fileName, QString& error);
+
+    // Size of all parts on disk and how much of it has been read so far. Unlike the position in the decompressed data, these tell
+    // how far reading the file has got. Only valid after opening it.
+    qint64 fileSize() const { return m_fileSize; }
+    qint64 filePosition() const;
+
+protected:
+    qint64 readData(char* data, qint64 maxlen) override;
+    qint64 writeData(const char*, qint64) override { return -1; }
+
+private:
+    class Decoder;
+
+    QStringList m_parts;
+    int m_currentPart;
+    QFile m_file;
+    qint64 m_fileSize;
+    qint64 m_previousPartsSize;                 // Size of the parts before the current one
+    Compression m_compression;
+    std::unique_ptr<Decoder> m_decoder;
+
+    QByteArray m_input;                         // Compressed data read from the file
+    int m_inputPos;
+    QByteArray m_output;                        // Decompressed data which hasn't been read yet
+    int m_outputPos;
+    bool m_end;
+    bool m_error;
+
+    bool openPart(int index);
+    bool decodeMore();
+};
+
+#endif
@@ -0,0 +1,343 @@
+#include "CsvImportPipeline.h"
+#include "sqlite.h"
+
+#include <QElapsedTimer>
+#include <QLocale>
+
+namespace {
+// A batch is handed to the next stage once it has this many rows or bytes, whichever comes first
+constexpr size_t maxBatchRows = 1024;
+constexpr size_t maxBatchBytes = 1024 * 1024;
+
+// Number of batches which may be waiting between two stages
+constexpr size_t maxQueuedBatches = 4;
+
+// Minimum time in milliseconds between two progress signals
+constexpr qint64 progressInterval = 50;
+}
+
+// Passes the parser progress on as signals and stops the parser once the import has been stopped
+class CsvImportPipeline::Progress : public CSVProgress
+{
+public:
+    explicit Progress(CsvImportPipeline* pipeline) : m_pipeline(pipeline) {}
+
+    void start() override
+    {
+        m_timer.start();
+    }
+
+    bool update(int64_t pos) override
+    {
+        if(m_timer.elapsed() >= progressInterval)
+        {
+            emit m_pipeline->progress(pos);
+            m_timer.restart();
+        }
+
+        return !m_pipeline->m_stopped;
+    }
+
+    void end() override
+    {
+    }
+
+private:
+    CsvImportPipeline* m_pipeline;
+    QElapsedTimer m_timer;
+};
+
+CsvImportPipeline::CsvImportPipeline(sqlite3_stmt* stmt, Options options, QObject* parent)
+    : QObject(parent),
+      m_stmt(stmt),
+      m_options(std::move(options)),
+      m_parsedRows(maxQueuedBatches),
+      m_convertedRows(maxQueuedBatches),
+      m_runningStages(0),
+      m_cancelled(false),
+      m_stopped(false),
+      m_parseTime(0),
+      m_convertTime(0),
+      m_insertTime(0),
+      m_result(CSVParser::ParserResultSuccess),
+      m_lastRowNum(0),
+      m_failed(false)
+{
+}
+
+CsvImportPipeline::~CsvImportPipeline()
+{
+    if(m_runningStages)
+        cancel();
+
+    for(std::thread* t : {&m_parseThread, &m_convertThread, &m_insertThread})
+    {
+        if(t->joinable())
+            t->join();
+    }
+}
+
+void CsvImportPipeline::start(ParseFunction parse)
+{
+    m_runningStages = 3;
+    m_insertThread = std::thread(&CsvImportPipeline::insert, this);
+    m_convertThread = std::thread(&CsvImportPipeline::convert, this);
+    m_parseThread = std::thread(&CsvImportPipeline::parse, this, std::move(parse));
+}
+
+void CsvImportPipeline::cancel()
+{
+    m_cancelled = true;
+    m_stopped = true;
+    m_parsedRows.abort();
+    m_convertedRows.abort();
+}
+
+CsvImportPipeline::Timings CsvImportPipeline::timings() const
+{
+    return { m_parseTime / 1000000, m_convertTime / 1000000, m_insertTime / 1000000 };
+}
+
+void CsvImportPipeline::fail(size_t rowNum, const QString& message)
+{
+    {
+        std::lock_guard<std::mutex> lk(m_mutexResult);
+        if(!m_failed)
+        {
+            m_failed = true;
+            m_result = CSVParser::ParserResultError;
+            m_lastRowNum = rowNum;
+            m_errorMessage = message;
+        }
+    }
+
+    m_stopped = true;
+    m_parsedRows.abort();
+    m_convertedRows.abort();
+}
+
+void CsvImportPipeline::stageFinished()
+{
+    if(--m_runningStages > 0)
+        return;
+
+    // If the import was cancelled while the last rows were being inserted, the parser might have finished successfully
+    {
+        std::lock_guard<std::mutex> lk(m_mutexResult);
+        if(m_cancelled && !m_failed)
+            m_result = CSVParser::ParserResultCancelled;
+    }
+
+    emit finished();
+}
+
+void CsvImportPipeline::parse(ParseFunction parseFunction)
+{
+    QElapsedTimer timer;
+    timer.start();
+    qint64 waitTime = 0;
+
+    RawBatch batch;
+    size_t lastRowNum = 0;
+
+    auto pushBatch = [&]() {
+        QElapsedTimer waitTimer;
+        waitTimer.start();
+        const bool pushed = m_parsedRows.push(std::move(batch));
+        waitTime += waitTimer.nsecsElapsed();
+
+        batch = RawBatch();
+        return pushed;
+    };
+
+    CSVParser::ParserResult result = parseFunction([&](size_t rowNum, const CSVRow& rowData) -> bool {
+        // Save row num for later use. This is used in the case of an error to tell the user in which row the error occurred
+        lastRowNum = rowNum;
+
+        if(m_stopped)
+            return false;
+
+        // If this is the first row and we want to use the first row as table header, skip it now because this is the data import, not the header parsing
+        if(rowNum == 0 && m_options.skipFirstRow)
+            return true;
+
+        // Copy the fields because the parser reuses its buffers for the next row
+        if(batch.rowEnds.empty())
+            batch.firstRow = rowNum;
+        for(size_t i=0;i<rowData.num_fields;i++)
+        {
+            batch.data.insert(batch.data.end(), rowData.fields[i].data, rowData.fields[i].data + rowData.fields[i].data_length);
+            batch.fieldEnds.push_back(batch.data.size());
+        }
+        batch.rowEnds.push_back(batch.fieldEnds.size());
+
+        if(batch.rowEnds.size() >= maxBatchRows || batch.data.size() >= maxBatchBytes)
+            return pushBatch();
+        return true;
+    }, new Progress(this));
+
+    // Only insert the remaining rows if the whole file could be parsed. Otherwise the import is rolled back anyway.
+    if(result == CSVParser::ParserResultSuccess && !batch.rowEnds.empty())
+        pushBatch();
+    m_parsedRows.close();
+
+    {
+        std::lock_guard<std::mutex> lk(m_mutexResult);
+        if(!m_failed)
+        {
+            m_result = m_cancelled ? CSVParser::ParserResultCancelled : result;
+            m_lastRowNum = lastRowNum;
+        }
+    }
+
+    m_parseTime = timer.nsecsElapsed() - waitTime;
+    stageFinished();
+}
+
+void CsvImportPipeline::convert()
+{
+    const QLocale locale = QLocale::system();
+    qint64 workTime = 0;
+
+    RawBatch raw;
+    while(m_parsedRows.pop(raw))
+    {
+        QElapsedTimer timer;
+        timer.start();
+
+        ConvertedBatch batch;
+        batch.values.resize(raw.fieldEnds.size());
+
+        size_t field = 0;
+        for(size_t row=0;row<raw.rowEnds.size();row++)
+        {
+            for(size_t column=0;field<raw.rowEnds[row];field++,column++)
+            {
+                const size_t begin = field ? raw.fieldEnds[field-1] : 0;
+                const char* data = raw.data.data() + begin;
+                const int length = static_cast<int>(raw.fieldEnds[field] - begin);
+                Value& value = batch.values[field];
+                value.type = Value::Null;
+
+                // Empty values need special treatment
+                // When importing into an existing table where we could find out something about its table definition
+                if(m_options.importToExistingTable && length == 0 && m_options.nullValues.size() > column)
+                {
+                    // Do we want to fail when trying to import an empty value into this field? Then exit with an error.
+                    if(m_options.failOnMissing.at(column))
+                    {
+                        fail(raw.firstRow + row, tr("Missing value in column %1").arg(column + 1));
+                        m_convertTime = workTime + timer.nsecsElapsed();
+                        stageFinished();
+                        return;
+                    }
+
+                    // This is an empty value. We'll need to look up how to handle it depending on the field to be inserted into.
+                    const QByteArray& val = m_options.nullValues.at(column);
+                    if(!val.isNull())
+                    {
+                        value.type = Value::Text;
+                        value.text = val.constData();
+                        value.length = val.size();
+                    }
+                // When importing into a new table, use the missing values setting directly
+                } else if(!m_options.importToExistingTable && length == 0) {
+                    // Leave it NULL
+                } else {
+                    // This is a non-empty value, or we want to insert the empty string.
+                    bool convert_ok = false;
+                    if(m_options.localConventions) {
+                        // Find the correct data type taking into account the locale.
+                        QString content = QString::fromUtf8(data, length);
+                        value.integer = locale.toLongLong(content, &convert_ok);
+                        if(convert_ok) {
+                            value.type = Value::Integer;
+                        } else {
+                            value.real = locale.toDouble(content, &convert_ok);
+                            if(convert_ok)
+                                value.type = Value::Real;
+                        }
+                    }
+
+                    if(!convert_ok) {
+                        // If we don't find any better data type or we want SQLite to apply the type affinity
+                        // (impossible when using local conventions), we fall back to the TEXT data type.
+                        value.type = Value::Text;
+                        value.text = length ? data : "";
+                        value.length = length;
+                    }
+                }
+            }
+        }
+
+        // Moving the raw batch keeps its buffers and thus all text pointers valid
+        batch.raw = std::move(raw);
+        workTime += timer.nsecsElapsed();
+
+        if(!m_convertedRows.push(std::move(batch)))
+            break;
+        raw = RawBatch();
+    }
+    m_convertedRows.close();
+
+    m_convertTime = workTime;
+    stageFinished();
+}
+
+void CsvImportPipeline::insert()
+{
+    qint64 workTime = 0;
+
+    ConvertedBatch batch;
+    while(m_convertedRows.pop(batch))
+    {
+        QElapsedTimer timer;
+        timer.start();
+
+        size_t field = 0;
+        for(size_t row=0;row<batch.raw.rowEnds.size();row++)
+        {
+            // Bind all values. Columns without a value are NULL because the bindings are cleared after each row.
+            for(int column=1;field<batch.raw.rowEnds[row];field++,column++)
+            {
+                const Value& value = batch.values[field];
+                switch(value.type)
+                {
+                case Value::Null:
+                    break;
+                case Value::Integer:
+                    sqlite3_bind_int64(m_stmt, column, value.integer);
+                    break;
+                case Value::Real:
+                    sqlite3_bind_double(m_stmt, column, value.real);
+                    break;
+                case Value::Text:
+                    sqlite3_bind_text(m_stmt, column, value.text, value.length, SQLITE_STATIC);
+                    break;
+                }
+            }
+
+            // Insert row
+            const bool inserted = sqlite3_step(m_stmt) == SQLITE_DONE;
+            const QString error = inserted ? QString() : QString::fromUtf8(sqlite3_errmsg(sqlite3_db_handle(m_stmt)));
+
+            // Reset statement for next use. Also reset all bindings to NULL. This is important, so we don't need to bind missing columns or empty values in NULL
+            // columns manually.
+            sqlite3_reset(m_stmt);
+            sqlite3_clear_bindings(m_stmt);
+
+            if(!inserted)
+            {
+                fail(batch.raw.firstRow + row, error);
+                m_insertTime = workTime + timer.nsecsElapsed();
+                stageFinished();
+                return;
+            }
+        }
+
+        workTime += timer.nsecsElapsed();
+    }
+
+    m_insertTime = workTime;
+    stageFinished();
+}
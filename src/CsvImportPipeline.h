@@ -0,0 +1,142 @@
+#ifndef CSVIMPORTPIPELINE_H
+#define CSVIMPORTPIPELINE_H
+
+#include "BoundedQueue.h"
+#include "csvparser.h"
+
+#include <QByteArray>
+#include <QObject>
+#include <QString>
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct sqlite3_stmt;
+
+/*
+ * This class imports the rows of a CSV file using a prepared INSERT statement. The work is split up into three stages which run on
+ * their own thread each: parsing the file, converting the field values to the types they are inserted as, and inserting them. The
+ * stages hand batches of rows to each other through bounded queues, so the memory usage does not depend on the size of the file.
+ */
+class CsvImportPipeline : public QObject
+{
+    Q_OBJECT
+
+public:
+    // Parses the file by calling the row function for each row. The progress object is to be handed to the parser, which takes
+    // ownership of it.
+    using ParseFunction = std::function<CSVParser::ParserResult(CSVParser::csvRowFunction, CSVProgress*)>;
+
+    struct Options
+    {
+        bool skipFirstRow;                      // The first row contains the column names and is not imported
+        bool localConventions;                  // Convert numbers using the number format of the system locale
+        bool importToExistingTable;             // Empty fields are replaced by nullValues instead of being imported as NULL
+        std::vector<QByteArray> nullValues;     // Values for empty fields per column when importing into an existing table
+        std::vector<bool> failOnMissing;        // Columns for which empty fields make the import fail
+    };
+
+    // Time in milliseconds each stage spent working, not counting the time it had to wait for the other stages
+    struct Timings
+    {
+        qint64 parse;
+        qint64 convert;
+        qint64 insert;
+    };
+
+    CsvImportPipeline(sqlite3_stmt* stmt, Options options, QObject* parent = nullptr);
+    ~CsvImportPipeline() override;
+
+    // Start importing. The statement must not be used otherwise until finished() has been emitted.
+    void start(ParseFunction parse);
+
+    // Stop importing as soon as possible
+    void cancel();
+
+    // These return the outcome of the import and may only be called after finished() has been emitted. The result is
+    // ParserResultError if inserting or converting a row failed, in which case the error message is set and the last row number
+    // is the number of that row. Otherwise it is the number of the last parsed row.
+    CSVParser::ParserResult result() const { return m_result; }
+    size_t lastRowNum() const { return m_lastRowNum; }
+    QString errorMessage() const { return m_errorMessage; }
+    Timings timings() const;
+
+signals:
+    // Position in the file up to which it has been parsed
+    void progress(qint64 position);
+
+    // All stages have stopped
+    void finished();
+
+private:
+    class Progress;
+
+    // Unparsed contents of some rows
+    struct RawBatch
+    {
+        size_t firstRow;                        // Number of the first row in the batch
+        std::vector<char> data;                 // Contents of all fields
+        std::vector<size_t> fieldEnds;          // Position in data after each field
+        std::vector<size_t> rowEnds;            // Index in fieldEnds after the last field of each row
+    };
+
+    // Field value as it is bound to the INSERT statement
+    struct Value
+    {
+        enum Type
+        {
+            Null,
+            Integer,
+            Real,
+            Text
+        };
+
+        Type type;
+        qint64 integer;
+        double real;
+        const char* text;                       // Points into the raw batch or into the null values
+        int length;
+    };
+
+    struct ConvertedBatch
+    {
+        RawBatch raw;
+        std::vector<Value> values;              // One value per field of the raw batch
+    };
+
+    sqlite3_stmt* m_stmt;
+    Options m_options;
+
+    BoundedQueue<RawBatch> m_parsedRows;
+    BoundedQueue<ConvertedBatch> m_convertedRows;
+    std::thread m_parseThread;
+    std::thread m_convertThread;
+    std::thread m_insertThread;
+    std::atomic<int> m_runningStages;
+    std::atomic<bool> m_cancelled;              // The user has cancelled the import
+    std::atomic<bool> m_stopped;                // The import was cancelled or has failed
+
+    std::atomic<qint64> m_parseTime;            // Nanoseconds spent working in each stage
+    std::atomic<qint64> m_convertTime;
+    std::atomic<qint64> m_insertTime;
+
+    std::mutex m_mutexResult;
+    CSVParser::ParserResult m_result;
+    size_t m_lastRowNum;
+    QString m_errorMessage;
+    bool m_failed;
+
+    void parse(ParseFunction parseFunction);
+    void convert();
+    void insert();
+
+    // Stop all stages because of an error in the specified row. Only the first error is kept.
+    void fail(size_t rowNum, const QString& message);
+
+    void stageFinished();
+};
+
+#endif
@@ -0,0 +1,397 @@
+#include "CsvImporter.h"
+#include "sqlitedb.h"
+#include "sqlite.h"
+#include "Settings.h"
+
+#include <QEventLoop>
+#include <QFile>
+#include <QFileInfo>
+#include <QLocale>
+#include <QTextStream>
+
+#include <algorithm>
+#include <cctype>
+
+namespace {
+// The data types of the columns are detected by looking at the first rows of a file and at blocks of rows spread evenly across the rest
+// of it. This bounds the time it takes for files of any size.
+constexpr size_t typeDetectionHeadRows = 1000;
+constexpr size_t typeDetectionBlocks = 64;
+constexpr int64_t typeDetectionBlockSize = 64 * 1024;
+}
+
+CsvImporter::CsvImporter(DBBrowserDB& db, Options options, QObject* parent)
+    : QObject(parent),
+      m_db(db),
+      m_options(std::move(options)),
+      m_pipeline(nullptr),
+      m_cancelled(false),
+      m_errorRow(0),
+      m_timings{0, 0, 0}
+{
+}
+
+CsvImporter::Options CsvImporter::optionsFromSettings()
+{
+    Options options;
+    options.header = Settings::getValue("importcsv", "firstrowheader").toBool();
+    options.trimFields = Settings::getValue("importcsv", "trimfields").toBool();
+    options.separator = toUtf8(settingsChar("importcsv", "separator"));
+    options.quote = toUtf8(settingsChar("importcsv", "quotecharacter"));
+    options.encoding = Settings::getValue("importcsv", "encoding").toString();
+    options.localConventions = Settings::getValue("importcsv", "localconventions").toBool();
+    options.bulkLoad = Settings::getValue("importcsv", "bulkload").toBool();
+    return options;
+}
+
+QChar CsvImporter::settingsChar(const std::string& group, const std::string& name)
+{
+    QVariant value = Settings::getValue(group, name);
+    // QVariant is not able to return the character as a QChar when QString is stored.
+    // We do it manually, since it is versatile, when the option is passed from the command line,
+    // for example.
+    if(value.userType() == QMetaType::QString)
+        return value.toString().isEmpty() ? QChar() : value.toString().at(0);
+    else
+        return value.toChar();
+}
+
+char32_t CsvImporter::toUtf8(const QString& s)
+{
+    if(s.isEmpty())
+        return 0;
+
+    QByteArray ba = s.toUtf8();
+
+    char32_t result = 0;
+    for(QByteArray::size_type i=std::min(ba.size()-1,QByteArray::size_type(3));i>=0;i--)
+        result = (result << 8) + static_cast<unsigned char>(ba.at(i));
+
+    return result;
+}
+
+CSVParser::ParserResult CsvImporter::parse(const QString& fileName, CSVParser::csvRowFunction rowFunction, size_t count, CSVProgress* progress) const
+{
+    QFile file(fileName);
+    file.open(QIODevice::ReadOnly);
+
+    CSVParser csv(m_options.trimFields, m_options.separator, m_options.quote);
+    if(progress)
+        csv.setCSVProgress(progress);
+
+    // Files in any other encoding than UTF-8 need to be decoded while reading them.
+    // This is no longer needed in Qt6 since QTextStream defaults to utf-8 there anyway.
+#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+    if(m_options.encoding.compare("UTF-8", Qt::CaseInsensitive) != 0 && m_options.encoding.compare("UTF8", Qt::CaseInsensitive) != 0)
+    {
+        QTextStream tstream(&file);
+        tstream.setCodec(m_options.encoding.toUtf8());
+        return csv.parse(rowFunction, tstream, count);
+    }
+#endif
+
+    // UTF-8 encoded files are parsed directly from memory
+    return csv.parse(rowFunction, file, count);
+}
+
+// Parses the head and some blocks of rows spread across the rest of a CSV file, see CSVParser::sample(). Files which are not UTF-8 encoded
+// are only parsed up to the end of the head.
+CSVParser::ParserResult CsvImporter::sample(const QString& fileName, CSVParser::csvRowFunction rowFunction, size_t headRows, size_t blocks) const
+{
+#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+    if(m_options.encoding.compare("UTF-8", Qt::CaseInsensitive) != 0 && m_options.encoding.compare("UTF8", Qt::CaseInsensitive) != 0)
+        return parse(fileName, rowFunction, headRows);
+#endif
+
+    QFile file(fileName);
+    file.open(QIODevice::ReadOnly);
+
+    CSVParser csv(m_options.trimFields, m_options.separator, m_options.quote);
+    return csv.sample(rowFunction, file, headRows, blocks, typeDetectionBlockSize);
+}
+
+sqlb::FieldVector CsvImporter::generateFieldList(const QString& fileName, std::vector<ColumnStatistics>* statistics) const
+{
+    sqlb::FieldVector fieldList;        // List of fields in the file
+    std::vector<ColumnStatistics> columns;
+
+    const bool header = m_options.header;
+    const bool detectTypes = m_options.detectTypes;
+    const QLocale locale = m_options.localConventions ? QLocale::system() : QLocale::c();
+
+    // Parse a sample of the records of the CSV file and only analyse them. Without type detection, only the first couple of records
+    // are needed for the field names.
+    sample(fileName, [&](size_t rowNum, const CSVRow& rowData) -> bool {
+        // The rows after the head might not start at a record boundary. Ignore all of them which do not fit the fields found in the head
+        // because most likely they don't.
+        if(rowNum >= typeDetectionHeadRows && rowData.num_fields != fieldList.size())
+            return true;
+
+        // Has this row more columns than the previous one? Then add more fields to the field list as necessary.
+        for(size_t i=fieldList.size();i<rowData.num_fields;i++)
+        {
+            std::string fieldname;
+
+            // If the user wants to use the first row as table header and if this is the first row, extract a field name
+            if(rowNum == 0 && header)
+            {
+                // Take field name from CSV
+                fieldname = std::string(rowData.fields[i].data, rowData.fields[i].data_length);
+            }
+
+            // If we don't have a field name by now, generate one
+            if(fieldname.empty())
+                fieldname = "field" + std::to_string(i + 1);
+
+            // Add field to the column list. For now we set the data type to nothing but this might be overwritten later in the automatic
+            // type detection code.
+            fieldList.emplace_back(fieldname, "");
+            columns.emplace_back();
+        }
+
+        // Skip the header row if there is one
+        if(rowNum == 0 && header)
+            return true;
+
+        for(size_t i=0;i<rowData.num_fields;i++)
+        {
+            const char* data = rowData.fields[i].data;
+            const size_t length = rowData.fields[i].data_length;
+            ColumnStatistics& column = columns.at(i);
+
+            // Empty values are imported as NULL into new tables, so they don't tell anything about the data type
+            column.values++;
+            if(length == 0)
+            {
+                column.nulls++;
+                continue;
+            }
+
+            // Count the characters, i.e. all bytes which are not UTF-8 continuation bytes
+            const size_t characters = static_cast<size_t>(std::count_if(data, data + length, [](char c) { return (c & 0xC0) != 0x80; }));
+            column.maxLength = std::max(column.maxLength, characters);
+
+            // Try to find out a data type for each column.
+            // If the data type has been set to TEXT, there's no going back because it means we had at least one row with text-only
+            // content and that means we don't want to set the data type to any number type.
+            if(!detectTypes || fieldList.at(i).type() == "TEXT")
+                continue;
+
+            // Check if the content can be converted to an integer or to real. Numbers with leading zeros, like many IDs or
+            // postal codes, are kept as text because converting them would lose the zeros.
+            const QString content = QString::fromUtf8(data, static_cast<int>(length));
+            bool convert_to_integer = false, convert_to_real = false;
+            double value = 0.0;
+            if(!(length > 1 && data[0] == '0' && std::isdigit(static_cast<unsigned char>(data[1]))))
+            {
+                locale.toLongLong(content, &convert_to_integer);
+                value = locale.toDouble(content, &convert_to_real);
+            }
+
+            // Set new data type. If we don't find any better data type, we fall back to the TEXT data type
+            const std::string old_type = fieldList.at(i).type();
+            std::string new_type = "TEXT";
+            if((old_type.empty() || old_type == "INTEGER") && convert_to_integer)     // No type yet or integer so far, and this bit is an integer too
+                new_type = "INTEGER";
+            else if(convert_to_real)                                                    // Convertible to float, so at least one value is not an integer
+                new_type = "REAL";
+            fieldList.at(i).setType(new_type);
+
+            // Keep track of the numeric range
+            if(convert_to_real)
+            {
+                column.min = column.numeric ? std::min(column.min, value) : value;
+                column.max = column.numeric ? std::max(column.max, value) : value;
+                column.numeric = true;
+            }
+        }
+
+        // All good
+        return true;
+    }, detectTypes ? typeDetectionHeadRows : 20, detectTypes ? typeDetectionBlocks : 0);
+
+    if(statistics)
+        *statistics = std::move(columns);
+
+    return fieldList;
+}
+
+bool CsvImporter::import(const QString& fileName, const std::string& tableName, const sqlb::FieldVector& fieldList)
+{
+    m_cancelled = false;
+    m_errorMessage.clear();
+    m_errorRow = 0;
+    m_timings = {0, 0, 0};
+
+    // Are we importing into an existing table?
+    const sqlb::ObjectIdentifier table("main", tableName);
+    const sqlb::TablePtr tbl = m_db.getTableByName(table);
+    if(tbl && tbl->fields.size() != fieldList.size())
+    {
+        m_errorMessage = tr("There is already a table named '%1' and an import into an existing table is only possible if the number of columns match.")
+                .arg(QString::fromStdString(tableName));
+        return false;
+    }
+
+    // Create a savepoint, so we can rollback in case of any errors during importing
+    // db needs to be saved or an error will occur
+    std::string restorepointName = m_db.generateSavepointName("csvimport");
+    if(!m_db.setSavepoint(restorepointName))
+    {
+        fail(restorepointName, 0, tr("Creating restore point failed: %1").arg(m_db.lastError()));
+        return false;
+    }
+
+    // Create table
+    std::vector<QByteArray> nullValues;
+    std::vector<bool> failOnMissingFieldList;
+    if(!tbl)
+    {
+        if(!m_db.createTable(table, fieldList))
+        {
+            fail(restorepointName, 0, tr("Creating the table failed: %1").arg(m_db.lastError()));
+            return false;
+        }
+    } else {
+        // Importing into an existing table. So find out something about it's structure.
+
+        // Prepare the values for each table column that are to be inserted if the field in the CSV file is empty. Depending on the data type
+        // and the constraints of a field, we need to handle this case differently.
+        for(const sqlb::Field& f : tbl->fields)
+        {
+            // For determining the value for empty fields we follow a set of rules
+
+            // Normally we don't have to fail the import when importing an empty field. This last value of the vector
+            // is changed to true later if we actually do want to fail the import for this field.
+            failOnMissingFieldList.push_back(false);
+
+            // If a field has a default value, that gets priority over everything else.
+            // Exception: if the user wants to ignore default values we never use them.
+            if(!m_options.ignoreDefaults && !f.defaultValue().empty())
+            {
+                nullValues.push_back(f.defaultValue().c_str());
+            } else {
+                // If it has no default value, check if the field is NOT NULL
+                if(f.notnull())
+                {
+                    // The field is NOT NULL
+
+                    // If this is an integer column insert 0. Otherwise insert an empty string.
+                    if(f.isInteger())
+                        nullValues.push_back("0");
+                    else
+                        nullValues.push_back("");
+
+                    // If the user wants to fail the import, remember this field
+                    if(m_options.failOnMissing)
+                        failOnMissingFieldList.back() = true;
+                } else {
+                    // The field is not NOT NULL (stupid double negation here! NULL values are allowed in this case)
+
+                    // Just insert a NULL value
+                    nullValues.push_back(QByteArray());
+                }
+            }
+        }
+    }
+
+    // In bulk load mode, drop the indexes of the table for now and create them again after all rows have been inserted
+    if(m_options.bulkLoad && !m_db.beginBulkLoad({table}))
+    {
+        fail(restorepointName, 0, tr("Preparing the bulk load failed: %1").arg(m_db.lastError()));
+        m_db.endBulkLoad(false);
+        return false;
+    }
+
+    // Prepare the INSERT statement. The prepared statement can then be reused for each row to insert
+    std::string sQuery = "INSERT " + m_options.onConflict + " INTO " + sqlb::escapeIdentifier(tableName) + " VALUES(";
+    for(size_t i=1;i<=fieldList.size();i++)
+        sQuery += "?" + std::to_string(i) + ",";
+    sQuery.pop_back();  // Remove last comma
+    sQuery.append(")");
+    sqlite3_stmt* stmt;
+    auto pDb = m_db.get(tr("importing CSV"));
+    if(sqlite3_prepare_v2(pDb.get(), sQuery.c_str(), static_cast<int>(sQuery.size()), &stmt, nullptr) != SQLITE_OK)
+    {
+        // Release the DB handle before undoing the changes as that needs to acquire its own handle
+        pDb = nullptr;
+        fail(restorepointName, 0, tr("Could not prepare INSERT statement: %1").arg(m_db.lastError()));
+        if(m_options.bulkLoad)
+            m_db.endBulkLoad(false);
+        return false;
+    }
+
+    // Parse, convert and insert the rows of the entire file on separate threads
+    CsvImportPipeline::Options options;
+    options.skipFirstRow = m_options.header;
+    options.localConventions = m_options.localConventions;
+    options.importToExistingTable = tbl != nullptr;
+    options.nullValues = nullValues;
+    options.failOnMissing = failOnMissingFieldList;
+    CsvImportPipeline pipeline(stmt, options);
+
+    const qint64 fileSize = std::max<qint64>(QFileInfo(fileName).size(), 1);
+    connect(&pipeline, &CsvImportPipeline::progress, this, [this, fileSize](qint64 pos) {
+        emit progress(pos, fileSize);
+    });
+    QEventLoop loop;
+    connect(&pipeline, &CsvImportPipeline::finished, &loop, &QEventLoop::quit, Qt::QueuedConnection);
+
+    m_pipeline = &pipeline;
+    if(m_cancelled)
+        pipeline.cancel();
+    pipeline.start([this, fileName](CSVParser::csvRowFunction rowFunction, CSVProgress* progress) {
+        return parse(fileName, rowFunction, 0, progress);
+    });
+    loop.exec();
+    m_pipeline = nullptr;
+    m_timings = pipeline.timings();
+
+    // Clean up prepared statement
+    sqlite3_finalize(stmt);
+    pDb = nullptr;
+
+    // Success?
+    CSVParser::ParserResult result = pipeline.result();
+    if(result != CSVParser::ParserResult::ParserResultSuccess)
+    {
+        // Some error occurred or the user cancelled the action. Rollback the entire import. If the action was cancelled, there is no
+        // error message.
+        QString message;
+        if(result == CSVParser::ParserResult::ParserResultError)
+        {
+            message = tr("Inserting row failed: %1").arg(pipeline.errorMessage());
+        } else if(result == CSVParser::ParserResult::ParserResultUnexpectedEOF) {
+            message = tr("Unexpected end of file. Please make sure that you have configured the correct quote characters and "
+                         "the file is not malformed.");
+        }
+
+        fail(restorepointName, pipeline.lastRowNum(), message);
+        if(m_options.bulkLoad)
+            m_db.endBulkLoad(false);
+        return false;
+    }
+
+    // Create the dropped indexes again. This needs the DB handle to be released.
+    if(m_options.bulkLoad && !m_db.endBulkLoad())
+    {
+        fail(restorepointName, 0, tr("Creating the indexes failed: %1").arg(m_db.lastError()));
+        return false;
+    }
+
+    return true;
+}
+
+void CsvImporter::cancel()
+{
+    m_cancelled = true;
+    if(m_pipeline)
+        m_pipeline->cancel();
+}
+
+void CsvImporter::fail(const std::string& savepointName, size_t row, const QString& message)
+{
+    m_errorMessage = message;
+    m_errorRow = row;
+    m_db.revertToSavepoint(savepointName);
+}
@@ -0,0 +1,104 @@
+#ifndef CSVIMPORTER_H
+#define CSVIMPORTER_H
+
+#include "CsvImportPipeline.h"
+#include "csvparser.h"
+#include "sql/sqlitetypes.h"
+
+#include <QObject>
+#include <QString>
+
+#include <string>
+#include <vector>
+
+class DBBrowserDB;
+
+/*
+ * This class imports CSV files into tables. It doesn't use any widgets, so it serves both the import dialog and the headless command
+ * line mode.
+ */
+class CsvImporter : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Options
+    {
+        bool header = false;                    // The first row contains the column names
+        bool trimFields = true;
+        char32_t separator = ',';               // UTF-8 bytes of the character, see toUtf8()
+        char32_t quote = '"';
+        QString encoding = "UTF-8";
+        bool localConventions = false;          // Convert numbers using the number format of the system locale
+        bool detectTypes = true;                // Create columns with the detected data types instead of without any types
+        bool ignoreDefaults = false;            // Don't use the default values of an existing table for empty fields
+        bool failOnMissing = false;             // Fail on empty fields for NOT NULL columns of an existing table without a default value
+        bool bulkLoad = false;                  // Drop the indexes of the table while importing and create them again afterwards
+        std::string onConflict;                 // Conflict clause of the INSERT statement like "OR IGNORE" or empty for the default
+    };
+
+    // Statistics of the values of a column as found by generateFieldList()
+    struct ColumnStatistics
+    {
+        size_t values = 0;          // Number of values looked at
+        size_t nulls = 0;           // Number of empty values
+        size_t maxLength = 0;       // Maximum length of the values in characters
+        bool numeric = false;       // Whether any numeric values were found. If so, min and max are their range.
+        double min = 0.0;
+        double max = 0.0;
+    };
+
+    CsvImporter(DBBrowserDB& db, Options options, QObject* parent = nullptr);
+
+    // The options as they were last used in the import dialog
+    static Options optionsFromSettings();
+
+    // Read a character from the settings. This works for characters passed on the command line as well.
+    static QChar settingsChar(const std::string& group, const std::string& name);
+
+    // Pack the UTF-8 bytes of the first character of a string into one number as the parser expects them
+    static char32_t toUtf8(const QString& s);
+
+    // Parse the first count rows of a file, or all rows if count is 0. This can be called from any thread.
+    CSVParser::ParserResult parse(const QString& fileName, CSVParser::csvRowFunction rowFunction, size_t count = 0,
+                                  CSVProgress* progress = nullptr) const;
+
+    // Find out the column names and data types from a sample of the rows of a file
+    sqlb::FieldVector generateFieldList(const QString& fileName, std::vector<ColumnStatistics>* statistics = nullptr) const;
+
+    // Import a file into a table. If the table exists, the rows are added to it, which needs the number of columns to match the field
+    // list. Otherwise the table is created from the field list. All changes are undone if the import fails or is cancelled.
+    bool import(const QString& fileName, const std::string& tableName, const sqlb::FieldVector& fieldList);
+
+    // These describe why the last import has failed. The message is empty if it has been cancelled. The row number is 0 if the error
+    // doesn't belong to a certain row.
+    QString errorMessage() const { return m_errorMessage; }
+    size_t errorRow() const { return m_errorRow; }
+
+    CsvImportPipeline::Timings timings() const { return m_timings; }
+
+public slots:
+    // Stop the running import as soon as possible
+    void cancel();
+
+signals:
+    // Position in the file up to which it has been imported
+    void progress(qint64 position, qint64 fileSize);
+
+private:
+    DBBrowserDB& m_db;
+    Options m_options;
+
+    CsvImportPipeline* m_pipeline;
+    bool m_cancelled;
+    QString m_errorMessage;
+    size_t m_errorRow;
+    CsvImportPipeline::Timings m_timings;
+
+    CSVParser::ParserResult sample(const QString& fileName, CSVParser::csvRowFunction rowFunction, size_t headRows, size_t blocks) const;
+
+    // Undo everything since the savepoint and remember the error
+    void fail(const std::string& savepointName, size_t row, const QString& message);
+};
+
+#endif
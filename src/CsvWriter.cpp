@@ -0,0 +1,270 @@
+#include "CsvWriter.h"
+#include "Data.h"
+#include "sqlite.h"
+
+#include <QIODevice>
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CSVWRITER_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+// The buffered data is handed to the device once it is at least this big
+constexpr int bufferBytes = 1024 * 1024;
+
+bool isByteOrderMark(const char* data, int size)
+{
+    return startsWithBom(QByteArray::fromRawData(data, size));
+}
+
+// Returns the same as isTextOnly() for data without a byte order mark, but checks the UTF-8 data directly instead of converting it
+// back and forth. That is, the data must be valid UTF-8 and must not contain any noncharacters or control characters apart from
+// white space.
+bool isUtf8Text(const char* data, int size)
+{
+    if(isByteOrderMark(data, size))
+        return isTextOnly(QByteArray::fromRawData(data, size));
+
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(data);
+    const unsigned char* end = p + size;
+    while(p < end)
+    {
+        const unsigned char c = *p;
+        if(c < 0x80)
+        {
+            if((c < 0x20 && (c < '\t' || c > '\r')) || c == 0x7f)
+                return false;
+            p++;
+            continue;
+        }
+
+        int length;
+        char32_t codepoint;
+        if(c >= 0xc2 && c <= 0xdf)
+        {
+            length = 2;
+            codepoint = c & 0x1f;
+        } else if(c >= 0xe0 && c <= 0xef) {
+            length = 3;
+            codepoint = c & 0x0f;
+        } else if(c >= 0xf0 && c <= 0xf4) {
+            length = 4;
+            codepoint = c & 0x07;
+        } else {
+            return false;
+        }
+        if(end - p < length)
+            return false;
+        for(int i=1;i<length;i++)
+        {
+            if((p[i] & 0xc0) != 0x80)
+                return false;
+            codepoint = (codepoint << 6) | (p[i] & 0x3f);
+        }
+
+        // Overlong encodings, surrogates and code points beyond the Unicode range are invalid
+        if((length == 3 && codepoint < 0x800) || (length == 4 && (codepoint < 0x10000 || codepoint > 0x10ffff)) ||
+                (codepoint >= 0xd800 && codepoint <= 0xdfff))
+            return false;
+
+        // C1 control characters apart from the next line character, which counts as white space, and noncharacters. Like in isTextOnly()
+        // the noncharacters are only checked for in the Basic Multilingual Plane.
+        if((codepoint < 0xa0 && codepoint != 0x85) || (codepoint >= 0xfdd0 && codepoint <= 0xfdef) ||
+                (codepoint <= 0xffff && (codepoint & 0xfffe) == 0xfffe))
+            return false;
+
+        p += length;
+    }
+    return true;
+}
+}
+
+CsvWriter::CsvWriter(QIODevice& device, QChar separator, QChar quote, const QString& newline)
+    : m_device(device),
+      m_quoteNewlineOnly(quote.isNull()),
+      m_canScan(false),
+      m_scanIsExact(false),
+      m_rowStarted(false),
+      m_error(false)
+{
+    if(!separator.isNull())
+        m_separator = QString(separator).toUtf8();
+    m_newline = newline.toUtf8();
+
+    if(m_quoteNewlineOnly)
+    {
+        // If no quote character is set but the content contains a line break, we enforce some quote characters. This probably isn't
+        // entirely correct but still better than having the line breaks unquoted and effectively outputting a garbage file.
+        m_quote = "\"";
+        if(!m_newline.isEmpty())
+            m_specials.push_back(m_newline);
+    } else {
+        m_quote = QString(quote).toUtf8();
+        for(QChar c : newline)
+            m_specials.push_back(QString(c).toUtf8());
+        if(!m_separator.isEmpty())
+            m_specials.push_back(m_separator);
+        m_specials.push_back(m_quote);
+    }
+
+    // Collect the distinct first bytes of the special sequences. If there are too many of them, the fields are checked without the scan.
+    std::vector<char> firstBytes;
+    m_scanIsExact = true;
+    for(const QByteArray& special : m_specials)
+    {
+        if(std::find(firstBytes.begin(), firstBytes.end(), special.at(0)) == firstBytes.end())
+            firstBytes.push_back(special.at(0));
+        if(special.size() > 1)
+            m_scanIsExact = false;
+    }
+    m_canScan = firstBytes.size() <= 4;
+    for(size_t i=0;i<4;i++)
+        m_scanSet[i] = firstBytes.empty() ? '\0' : firstBytes.at(std::min(i, firstBytes.size() - 1));
+
+    m_buffer.reserve(bufferBytes + bufferBytes / 4);
+}
+
+CsvWriter::FieldType CsvWriter::classify(const char* data, int size, bool checkBinary) const
+{
+    // Look for the special characters and for anything which isn't printable ASCII in one go. Most fields consist of printable
+    // ASCII characters only. These can neither be binary nor contain a multi-byte special character, so they are settled by the scan.
+    const char* p = data;
+    const char* end = data + size;
+    bool special = false;
+    bool plain = true;
+
+#ifdef CSVWRITER_SSE2
+    if(m_canScan)
+    {
+        const __m128i s0 = _mm_set1_epi8(m_scanSet[0]);
+        const __m128i s1 = _mm_set1_epi8(m_scanSet[1]);
+        const __m128i s2 = _mm_set1_epi8(m_scanSet[2]);
+        const __m128i s3 = _mm_set1_epi8(m_scanSet[3]);
+        const __m128i space = _mm_set1_epi8(0x20);
+        const __m128i del = _mm_set1_epi8(0x7f);
+
+        for(;end-p>=16 && plain;p+=16)
+        {
+            const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+            const __m128i m = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, s0), _mm_cmpeq_epi8(v, s1)),
+                                           _mm_or_si128(_mm_cmpeq_epi8(v, s2), _mm_cmpeq_epi8(v, s3)));
+            special = special || _mm_movemask_epi8(m);
+
+            // The comparison is signed, so all bytes with the highest bit set count as being less than a space as well
+            const __m128i other = _mm_or_si128(_mm_cmplt_epi8(v, space), _mm_cmpeq_epi8(v, del));
+            plain = _mm_movemask_epi8(other) == 0;
+        }
+    }
+#endif
+
+    for(;p<end && plain;++p)
+    {
+        const unsigned char c = static_cast<unsigned char>(*p);
+        if(*p == m_scanSet[0] || *p == m_scanSet[1] || *p == m_scanSet[2] || *p == m_scanSet[3])
+            special = true;
+        if(c < 0x20 || c >= 0x7f)
+            plain = false;
+    }
+
+    if(plain && m_canScan && (!special || m_scanIsExact))
+        return special ? FieldType::Quoted : FieldType::Plain;
+
+    if(!plain && checkBinary && !isUtf8Text(data, size))
+        return FieldType::Binary;
+    return containsSpecial(data, size) ? FieldType::Quoted : FieldType::Plain;
+}
+
+bool CsvWriter::containsSpecial(const char* data, int size) const
+{
+    const QByteArray field = QByteArray::fromRawData(data, size);
+    return std::any_of(m_specials.begin(), m_specials.end(), [&field](const QByteArray& special) {
+        return field.contains(special);
+    });
+}
+
+void CsvWriter::appendQuoted(const char* data, int size)
+{
+    // Double all quote characters
+    m_buffer.append(m_quote);
+    const QByteArray field = QByteArray::fromRawData(data, size);
+    int start = 0;
+    int quote;
+    while((quote = field.indexOf(m_quote, start)) != -1)
+    {
+        m_buffer.append(data + start, quote - start + m_quote.size());
+        m_buffer.append(m_quote);
+        start = quote + m_quote.size();
+    }
+    m_buffer.append(data + start, size - start);
+    m_buffer.append(m_quote);
+}
+
+void CsvWriter::writeField(const char* data, int size, bool checkBinary)
+{
+    if(m_rowStarted)
+        m_buffer.append(m_separator);
+    m_rowStarted = true;
+
+    switch(classify(data, size, checkBinary))
+    {
+    case FieldType::Plain:
+        m_buffer.append(data, size);
+        break;
+    case FieldType::Quoted:
+        appendQuoted(data, size);
+        break;
+    case FieldType::Binary:
+        // Binary data is converted to base64. This case doesn't need quotes.
+        m_buffer.append(QByteArray::fromRawData(data, size).toBase64());
+        break;
+    }
+}
+
+bool CsvWriter::writeHeader(sqlite3_stmt* stmt)
+{
+    const int columns = sqlite3_column_count(stmt);
+    for(int i=0;i<columns;i++)
+    {
+        const char* name = sqlite3_column_name(stmt, i);
+        writeField(name, static_cast<int>(std::strlen(name)), false);
+    }
+    return endRow();
+}
+
+bool CsvWriter::writeRow(sqlite3_stmt* stmt)
+{
+    const int columns = sqlite3_column_count(stmt);
+    for(int i=0;i<columns;i++)
+    {
+        // Blobs are taken as they are, all other values are converted to text by SQLite. NULL values are written as empty fields.
+        const char* data;
+        if(sqlite3_column_type(stmt, i) == SQLITE_BLOB)
+            data = static_cast<const char*>(sqlite3_column_blob(stmt, i));
+        else
+            data = reinterpret_cast<const char*>(sqlite3_column_text(stmt, i));
+        writeField(data, sqlite3_column_bytes(stmt, i));
+    }
+    return endRow();
+}
+
+bool CsvWriter::endRow()
+{
+    m_buffer.append(m_newline);
+    m_rowStarted = false;
+
+    if(m_buffer.size() >= bufferBytes)
+        return flush();
+    return !m_error;
+}
+
+bool CsvWriter::flush()
+{
+    if(!m_error && !m_buffer.isEmpty() && m_device.write(m_buffer) != m_buffer.size())
+        m_error = true;
+    m_buffer.resize(0);                         // This keeps the reserved memory
+    return !m_error;
+}
@@ -0,0 +1,68 @@
+#ifndef CSVWRITER_H
+#define CSVWRITER_H
+
+#include <QByteArray>
+#include <QChar>
+#include <QString>
+
+#include <vector>
+
+class QIODevice;
+struct sqlite3_stmt;
+
+/*
+ * This class writes CSV data to a device. It works directly on the UTF-8 data as it is returned by SQLite and collects the output in a
+ * large buffer before handing it to the device. Fields which need to be quoted are found by scanning for the special characters with
+ * SIMD instructions where these are available. Fields which contain binary data are written as base64 without quotes.
+ */
+class CsvWriter
+{
+public:
+    // A null separator writes the fields without anything in between. A null quote character doesn't quote any fields, except for those
+    // containing the line break, which are quoted using double quotes then.
+    CsvWriter(QIODevice& device, QChar separator, QChar quote, const QString& newline);
+
+    // Append a field to the current row. If checkBinary is false, the data is always written as text.
+    void writeField(const char* data, int size, bool checkBinary = true);
+
+    // Append the column names of a statement as a row
+    bool writeHeader(sqlite3_stmt* stmt);
+
+    // Append the values of the current row of a statement as a row
+    bool writeRow(sqlite3_stmt* stmt);
+
+    // End the current row. Returns false if writing to the device has failed.
+    bool endRow();
+
+    // Hand all buffered data to the device. Returns false if writing to the device has failed.
+    bool flush();
+
+private:
+    enum class FieldType
+    {
+        Plain,
+        Quoted,
+        Binary,
+    };
+
+    QIODevice& m_device;
+    QByteArray m_separator;
+    QByteArray m_quote;                         // Quote used for fields which need to be quoted. Empty if none are.
+    QByteArray m_newline;
+    bool m_quoteNewlineOnly;                    // Only quote fields containing the whole line break, not any of the special characters
+
+    std::vector<QByteArray> m_specials;         // Fields containing any of these need to be quoted
+    char m_scanSet[4];                          // First bytes of the special sequences for the SIMD scan
+    bool m_canScan;                             // All special sequences start with one of the bytes in m_scanSet
+    bool m_scanIsExact;                         // All special sequences are single bytes, so a match in the scan needs no further checks
+
+    QByteArray m_buffer;
+    bool m_rowStarted;
+    bool m_error;
+
+    FieldType classify(const char* data, int size, bool checkBinary) const;
+    bool containsSpecial(const char* data, int size) const;
+    void appendQuoted(const char* data, int size);
+};
+
+#endif
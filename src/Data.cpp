@@ -232,3 +232,17 @@ void removeCommentsFromQuery(QString& query)
         query.replace(QRegularExpression("[ \t]+\n"), "\n");
     }
 }
+
+QRegularExpression findRegularExpression(const QString& pattern, bool wholeCell, bool caseSensitive)
+{
+    QRegularExpression reg_exp(pattern, (caseSensitive ? QRegularExpression::NoPatternOption : QRegularExpression::CaseInsensitiveOption));
+    if(reg_exp.isValid() && wholeCell)
+    {
+#if QT_VERSION < QT_VERSION_CHECK(5, 12, 0)
+        reg_exp.setPattern("\\A(" + reg_exp.pattern() + ")\\Z");
+#else
+        reg_exp.setPattern(QRegularExpression::anchoredPattern(reg_exp.pattern()));
+#endif
+    }
+    return reg_exp;
+}
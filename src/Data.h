@@ -3,6 +3,7 @@
 
 #include <QString>
 #include <QByteArray>
+#include <QRegularExpression>
 
 // This returns false if the data in the data parameter contains binary data. If it is text only, the function returns
 // true. If the second parameter is specified, it will be used to convert the data from the given encoding to Unicode
@@ -40,4 +41,8 @@ QString isoDateTimeStringToLocalDateTimeString(const QString& date_string);
 // Helper function for removing all comments from a SQL query
 void removeCommentsFromQuery(QString& query);
 
+// Returns the regular expression which the Find function of the table browser uses for the given pattern. If wholeCell is true, the
+// expression only matches if it matches the whole text. Check isValid() before using it.
+QRegularExpression findRegularExpression(const QString& pattern, bool wholeCell, bool caseSensitive);
+
 #endif
@@ -0,0 +1,136 @@
+#include "DataExporter.h"
+#include "CsvWriter.h"
+#include "JsonRowWriter.h"
+#include "Settings.h"
+#include "sqlitedb.h"
+#include "sqlite.h"
+
+namespace {
+// The progress is signalled after this many rows
+constexpr quint64 progressRows = 1000;
+
+// Step through all rows of a statement, calling the row function for each of them until it returns false. Returns false if reading or
+// writing has failed and sets the error message.
+template<typename RowFunction>
+bool writeRows(DataExporter& exporter, sqlite3* db, sqlite3_stmt* stmt, QString& errorMessage, RowFunction rowFunction)
+{
+    quint64 rows = 0;
+    int status;
+    while((status = sqlite3_step(stmt)) == SQLITE_ROW)
+    {
+        if(!rowFunction())
+            return false;
+
+        if(++rows % progressRows == 0)
+            emit exporter.progress(rows);
+    }
+    emit exporter.progress(rows);
+
+    if(status != SQLITE_DONE)
+    {
+        errorMessage = QString::fromUtf8(sqlite3_errmsg(db));
+        return false;
+    }
+    return true;
+}
+}
+
+DataExporter::DataExporter(DBBrowserDB& db, Options options, QObject* parent)
+    : QObject(parent),
+      m_db(db),
+      m_options(std::move(options))
+{
+}
+
+DataExporter::Options DataExporter::optionsFromSettings()
+{
+    Options options;
+    options.header = Settings::getValue("exportcsv", "firstrowheader").toBool();
+    options.separator = QChar(Settings::getValue("exportcsv", "separator").toInt());
+    options.quote = QChar(Settings::getValue("exportcsv", "quotecharacter").toInt());
+    options.newline = Settings::getValue("exportcsv", "newlinecharacters").toString();
+    if(Settings::getValue("exportjson", "ndjson").toBool())
+        options.jsonStyle = JsonRowWriter::Lines;
+    else
+        options.jsonStyle = Settings::getValue("exportjson", "prettyprint").toBool() ? JsonRowWriter::Pretty : JsonRowWriter::Compact;
+    options.compression = static_cast<Compression>(Settings::getValue("exportdata", "compression").toInt());
+    options.splitSize = Settings::getValue("exportdata", "splitsize").toLongLong() * 1024 * 1024;
+    return options;
+}
+
+bool DataExporter::exportCsv(const std::string& query, const QString& fileName)
+{
+    m_errorMessage.clear();
+
+    CompressedFileWriter file(fileName, m_options.compression, m_options.splitSize);
+    if(!file.open(QIODevice::WriteOnly))
+    {
+        m_errorMessage = tr("Could not open output file: %1").arg(fileName);
+        return false;
+    }
+
+    // The writer takes care of quoting the fields and of converting binary data
+    CsvWriter writer(file, m_options.separator, m_options.quote, m_options.newline);
+    bool ok;
+    {
+        auto pDb = m_db.getReader(tr("exporting CSV"));
+
+        sqlite3_stmt* stmt;
+        ok = sqlite3_prepare_v2(pDb.get(), query.c_str(), static_cast<int>(query.size()), &stmt, nullptr) == SQLITE_OK;
+        if(!ok)
+            m_errorMessage = QString::fromUtf8(sqlite3_errmsg(pDb.get()));
+        if(ok && m_options.header)
+            ok = writer.writeHeader(stmt);
+        if(ok)
+            ok = writeRows(*this, pDb.get(), stmt, m_errorMessage, [&writer, stmt]() { return writer.writeRow(stmt); });
+        sqlite3_finalize(stmt);
+    }
+
+    // The writer might still hold some of the data
+    ok = writer.flush() && ok;
+    if(ok && file.commit())
+        return true;
+
+    file.cancelWriting();
+    if(m_errorMessage.isEmpty())
+        m_errorMessage = tr("Error while writing the file '%1': %2").arg(fileName, file.errorString());
+    return false;
+}
+
+bool DataExporter::exportJson(const std::string& query, const QString& fileName)
+{
+    m_errorMessage.clear();
+
+    CompressedFileWriter file(fileName, m_options.compression, m_options.splitSize);
+    if(!file.open(QIODevice::WriteOnly))
+    {
+        m_errorMessage = tr("Could not open output file: %1").arg(fileName);
+        return false;
+    }
+
+    // Write each row as soon as it has been read
+    JsonRowWriter writer(file, m_options.jsonStyle);
+    bool ok;
+    {
+        auto pDb = m_db.getReader(tr("exporting JSON"));
+
+        sqlite3_stmt* stmt;
+        ok = sqlite3_prepare_v2(pDb.get(), query.c_str(), static_cast<int>(query.size()), &stmt, nullptr) == SQLITE_OK;
+        if(ok)
+        {
+            writer.setColumns(stmt);
+            ok = writeRows(*this, pDb.get(), stmt, m_errorMessage, [&writer, stmt]() { return writer.writeRow(stmt); });
+        } else {
+            m_errorMessage = QString::fromUtf8(sqlite3_errmsg(pDb.get()));
+        }
+        sqlite3_finalize(stmt);
+    }
+
+    if(ok && writer.finish() && file.commit())
+        return true;
+
+    file.cancelWriting();
+    if(m_errorMessage.isEmpty())
+        m_errorMessage = tr("Error while writing the file '%1': %2").arg(fileName, file.errorString());
+    return false;
+}
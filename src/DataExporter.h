@@ -0,0 +1,56 @@
+#ifndef DATAEXPORTER_H
+#define DATAEXPORTER_H
+
+#include "CompressedFile.h"
+#include "JsonRowWriter.h"
+
+#include <QChar>
+#include <QObject>
+#include <QString>
+
+#include <string>
+
+class DBBrowserDB;
+
+/*
+ * This class exports the results of queries as CSV or JSON files. It doesn't use any widgets, so it serves both the export dialog and
+ * the headless command line mode.
+ */
+class DataExporter : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Options
+    {
+        bool header = true;                     // Write the column names in the first row of CSV files
+        QChar separator = ',';                  // A null character writes the fields without anything in between
+        QChar quote = '"';                      // A null character doesn't quote the fields
+        QString newline = "\n";
+        JsonRowWriter::Style jsonStyle = JsonRowWriter::Pretty;
+        Compression compression = Compression::None;
+        qint64 splitSize = 0;                   // Maximum size of each part of the files in bytes or 0 for not splitting them
+    };
+
+    DataExporter(DBBrowserDB& db, Options options, QObject* parent = nullptr);
+
+    // The options as they were last used in the export dialog
+    static Options optionsFromSettings();
+
+    // These return false if exporting has failed. The error message is set then.
+    bool exportCsv(const std::string& query, const QString& fileName);
+    bool exportJson(const std::string& query, const QString& fileName);
+
+    QString errorMessage() const { return m_errorMessage; }
+
+signals:
+    // Number of rows written to the current file so far
+    void progress(quint64 rows);
+
+private:
+    DBBrowserDB& m_db;
+    Options m_options;
+    QString m_errorMessage;
+};
+
+#endif
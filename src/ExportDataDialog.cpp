@@ -2,18 +2,14 @@
 #include "ui_ExportDataDialog.h"
 #include "sqlitedb.h"
 #include "Settings.h"
-#include "sqlite.h"
 #include "FileDialog.h"
 #include "IconCache.h"
-#include "Data.h"
+#include "CompressedFile.h"
+#include "DataExporter.h"
 
-#include <QSaveFile>
-#include <QTextStream>
 #include <QMessageBox>
-#include <QTextCodec>
-#include <json.hpp>
 
-using json = nlohmann::json;
+#include <algorithm>
 
 ExportDataDialog::ExportDataDialog(DBBrowserDB& db, ExportFormats format, QWidget* parent, const std::string& query, const sqlb::ObjectIdentifier& selection)
     : QDialog(parent),
@@ -37,6 +33,17 @@ ExportDataDialog::ExportDataDialog(DBBrowserDB& db, ExportFormats format, QWidge
     setQuoteChar(QChar(Settings::getValue("exportcsv", "quotecharacter").toInt()));
     setNewLineString(Settings::getValue("exportcsv", "newlinecharacters").toString());
     ui->checkPrettyPrint->setChecked(Settings::getValue("exportjson", "prettyprint").toBool());
+    ui->checkNdjson->setChecked(Settings::getValue("exportjson", "ndjson").toBool());
+
+    // Only offer the compression formats this build supports
+    for(Compression compression : availableCompressions())
+        ui->comboCompression->addItem(compressionName(compression), static_cast<int>(compression));
+    ui->comboCompression->setCurrentIndex(std::max(ui->comboCompression->findData(Settings::getValue("exportdata", "compression").toInt()), 0));
+    ui->spinSplitSize->setValue(Settings::getValue("exportdata", "splitsize").toInt());
+
+    // Line-delimited JSON is never pretty printed
+    connect(ui->checkNdjson, &QCheckBox::toggled, ui->checkPrettyPrint, &QCheckBox::setDisabled);
+    ui->checkPrettyPrint->setDisabled(ui->checkNdjson->isChecked());
 
     // Update the visible/hidden status of the "Other" line edit fields
     showCustomCharEdits();
@@ -86,229 +93,37 @@ ExportDataDialog::~ExportDataDialog()
 
 bool ExportDataDialog::exportQuery(const std::string& sQuery, const QString& sFilename)
 {
+    DataExporter::Options options;
+    options.header = ui->checkHeader->isChecked();
+    options.separator = currentSeparatorChar();
+    options.quote = currentQuoteChar();
+    options.newline = currentNewLineString();
+    options.jsonStyle = ui->checkNdjson->isChecked() ? JsonRowWriter::Lines :
+                                                       (ui->checkPrettyPrint->isChecked() ? JsonRowWriter::Pretty : JsonRowWriter::Compact);
+    options.compression = currentCompression();
+    options.splitSize = currentSplitSize();
+
+    // Keep the user interface responsive while exporting
+    DataExporter exporter(pdb, options);
+    connect(&exporter, &DataExporter::progress, this, []() { qApp->processEvents(); });
+
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    bool success = false;
     switch(m_format)
     {
     case ExportFormatCsv:
-        return exportQueryCsv(sQuery, sFilename);
+        success = exporter.exportCsv(sQuery, sFilename);
+        break;
     case ExportFormatJson:
-        return exportQueryJson(sQuery, sFilename);
-    }
-
-    return false;
-}
-
-bool ExportDataDialog::exportQueryCsv(const std::string& sQuery, const QString& sFilename)
-{
-    // Prepare the quote and separating characters
-    QChar quoteChar = currentQuoteChar();
-    QString quotequoteChar = QString(quoteChar) + quoteChar;
-    QChar sepChar = currentSeparatorChar();
-    QString newlineStr = currentNewLineString();
-
-    // Chars that require escaping
-    std::string special_chars = newlineStr.toStdString() + sepChar.toLatin1() + quoteChar.toLatin1();
-    bool writeError = false;
-    // Open file
-    QSaveFile file(sFilename);
-    if(file.open(QIODevice::WriteOnly))
-    {
-        // Open text stream to the file
-        QTextStream stream(&file);
-
-        auto pDb = pdb.get(tr("exporting CSV"));
-
-        sqlite3_stmt* stmt;
-        int status = sqlite3_prepare_v2(pDb.get(), sQuery.c_str(), static_cast<int>(sQuery.size()), &stmt, nullptr);
-        if(SQLITE_OK == status)
-        {
-            if(ui->checkHeader->isChecked())
-            {
-                int columns = sqlite3_column_count(stmt);
-                for (int i = 0; i < columns; ++i)
-                {
-                    QString content = QString::fromUtf8(sqlite3_column_name(stmt, i));
-                    if(content.toStdString().find_first_of(special_chars) != std::string::npos)
-                        stream << quoteChar << content.replace(quoteChar, quotequoteChar) << quoteChar;
-                    else
-                        stream << content;
-                    if(i != columns - 1)
-                        // Only output the separator value if sepChar isn't 0,
-                        // as that's used to indicate no separator character
-                        // should be used
-                        if(!sepChar.isNull())
-                            stream << sepChar;
-                }
-                stream << newlineStr;
-            }
-
-            QApplication::setOverrideCursor(Qt::WaitCursor);
-            int columns = sqlite3_column_count(stmt);
-            size_t counter = 0;
-            while(!writeError && sqlite3_step(stmt) == SQLITE_ROW)
-            {
-                for (int i = 0; i < columns; ++i)
-                {
-                    QByteArray blob (reinterpret_cast<const char*>(sqlite3_column_blob(stmt, i)),
-                                     sqlite3_column_bytes(stmt, i));
-                    QString content = QString::fromUtf8(blob);
-
-                    // Convert to base64 if the data is binary. This case doesn't need quotes.
-                    if(!isTextOnly(blob))
-                        stream << blob.toBase64();
-                    // If no quote char is set but the content contains a line break, we enforce some quote characters. This probably isn't entirely correct
-                    // but still better than having the line breaks unquoted and effectively outputting a garbage file.
-                    else if(quoteChar.isNull() && content.contains(newlineStr))
-                        stream << '"' << content.replace('"', "\"\"") << '"';
-                    // If the content needs to be quoted, quote it. But only if a quote char has been specified
-                    else if(!quoteChar.isNull() && content.toStdString().find_first_of(special_chars) != std::string::npos)
-                        stream << quoteChar << content.replace(quoteChar, quotequoteChar) << quoteChar;
-                    // If it doesn't need to be quoted, don't quote it
-                    else
-                        stream << content;
-
-                    if(i != columns - 1)
-                        // Only output the separator value if sepChar isn't 0,
-                        // as that's used to indicate no separator character
-                        // should be used
-                        if(!sepChar.isNull())
-                            stream << sepChar;
-                }
-                stream << newlineStr;
-                if(counter % 1000 == 0)
-                    qApp->processEvents();
-                counter++;
-                writeError = stream.status() != QTextStream::Ok;
-            }
-        }
-        sqlite3_finalize(stmt);
-
-        QApplication::restoreOverrideCursor();
-        qApp->processEvents();
-
-        // Done writing the file
-        if(!file.commit()) {
-            writeError = true;
-        }
-
-        if(writeError || file.error() != QFileDevice::NoError) {
-            QMessageBox::warning(this, QApplication::applicationName(),
-                                 tr("Error while writing the file '%1': %2")
-                                 .arg(sFilename, file.errorString()));
-            return false;
-        }
-
-    } else {
-        QMessageBox::warning(this, QApplication::applicationName(),
-                             tr("Could not open output file: %1").arg(sFilename));
-        return false;
-    }
-
-    return true;
-}
-
-bool ExportDataDialog::exportQueryJson(const std::string& sQuery, const QString& sFilename)
-{
-    // Open file
-    QSaveFile file(sFilename);
-    if(file.open(QIODevice::WriteOnly))
-    {
-        auto pDb = pdb.get(tr("exporting JSON"));
-
-        sqlite3_stmt* stmt;
-        int status = sqlite3_prepare_v2(pDb.get(), sQuery.c_str(), static_cast<int>(sQuery.size()), &stmt, nullptr);
-
-        json json_table;
-
-        if(SQLITE_OK == status)
-        {
-            QApplication::setOverrideCursor(Qt::WaitCursor);
-            int columns = sqlite3_column_count(stmt);
-            size_t counter = 0;
-            std::vector<std::string> column_names;
-            while(sqlite3_step(stmt) == SQLITE_ROW)
-            {
-                // Get column names if we didn't do so before
-                if(!column_names.size())
-                {
-                    for(int i=0;i<columns;++i)
-                        column_names.push_back(sqlite3_column_name(stmt, i));
-                }
-
-                json json_row;
-                for(int i=0;i<columns;++i)
-                {
-                    int type = sqlite3_column_type(stmt, i);
-                    std::string column_name = column_names[static_cast<size_t>(i)];
-
-                    switch (type) {
-                    case SQLITE_INTEGER: {
-                        qint64 content = sqlite3_column_int64(stmt, i);
-                        json_row[column_name] = content;
-                        break;
-                    }
-                    case SQLITE_FLOAT: {
-                        double content = sqlite3_column_double(stmt, i);
-                        json_row[column_name] = content;
-                        break;
-                    }
-                    case SQLITE_NULL: {
-                        json_row[column_name] = nullptr;
-                        break;
-                    }
-                    case SQLITE_TEXT: {
-                        QString content = QString::fromUtf8(
-                            reinterpret_cast<const char*>(sqlite3_column_text(stmt, i)),
-                            sqlite3_column_bytes(stmt, i));
-                        json_row[column_name] = content.toStdString();
-                        break;
-                    }
-                    case SQLITE_BLOB: {
-                        QByteArray content(reinterpret_cast<const char*>(sqlite3_column_blob(stmt, i)),
-                                           sqlite3_column_bytes(stmt, i));
-                        QTextCodec *codec = QTextCodec::codecForName("UTF-8");
-                        QString string = codec->toUnicode(content.toBase64(QByteArray::Base64Encoding));
-                        json_row[column_name] = string.toStdString();
-                        break;
-                    }
-                    }
-                }
-
-                json_table.push_back(json_row);
-
-                if(counter % 1000 == 0)
-                    qApp->processEvents();
-                counter++;
-            }
-        }
-
-        sqlite3_finalize(stmt);
-
-        // Create JSON document
-        file.write(json_table.dump(ui->checkPrettyPrint->isChecked() ? 4 : -1).c_str());
-        bool writeError = file.error() != QFileDevice::NoError;
-
-        QApplication::restoreOverrideCursor();
-        qApp->processEvents();
-
-        // Done writing the file
-        if(!file.commit()) {
-            writeError = true;
-        }
-
-        if(writeError || file.error() != QFileDevice::NoError) {
-          QMessageBox::warning(this, QApplication::applicationName(),
-                               tr("Error while writing the file '%1': %2")
-                               .arg(sFilename, file.errorString()));
-          return false;
-        }
-
-    } else {
-        QMessageBox::warning(this, QApplication::applicationName(),
-                             tr("Could not open output file: %1").arg(sFilename));
-        return false;
+        success = exporter.exportJson(sQuery, sFilename);
+        break;
     }
+    QApplication::restoreOverrideCursor();
+    qApp->processEvents();
 
-    return true;
+    if(!success)
+        QMessageBox::warning(this, QApplication::applicationName(), exporter.errorMessage());
+    return success;
 }
 
 void ExportDataDialog::accept()
@@ -326,10 +141,18 @@ void ExportDataDialog::accept()
         default_file_extension = FILE_EXT_CSV_DEFAULT;
         break;
     case ExportFormatJson:
-        file_dialog_filter << FILE_FILTER_JSON
-                           << FILE_FILTER_TXT
+        if(ui->checkNdjson->isChecked())
+        {
+            file_dialog_filter << FILE_FILTER_NDJSON
+                               << FILE_FILTER_JSON;
+            default_file_extension = FILE_EXT_NDJSON_DEFAULT;
+        } else {
+            file_dialog_filter << FILE_FILTER_JSON
+                               << FILE_FILTER_NDJSON;
+            default_file_extension = FILE_EXT_JSON_DEFAULT;
+        }
+        file_dialog_filter << FILE_FILTER_TXT
                            << FILE_FILTER_ALL;
-        default_file_extension = FILE_EXT_JSON_DEFAULT;
         break;
     }
 
@@ -349,7 +172,7 @@ void ExportDataDialog::accept()
             return;
         }
 
-        success = exportQuery(m_sQuery, sFilename);
+        success = exportQuery(m_sQuery, withCompressionSuffix(sFilename));
     } else {
         // called from the File export menu
         const QList<QListWidgetItem*> selectedItems = ui->listTables->selectedItems();
@@ -402,16 +225,19 @@ void ExportDataDialog::accept()
             // if we are called from execute sql tab, query is already set
             // and we only export 1 select
             std::string sQuery = "SELECT * FROM " + sqlb::ObjectIdentifier(selectedItems.at(i)->data(Qt::UserRole).toString().toStdString()).toString() + ";";
-            success = exportQuery(sQuery, filenames.at(i)) && success;
+            success = exportQuery(sQuery, withCompressionSuffix(filenames.at(i))) && success;
         }
     }
 
     // Save the dialog preferences for future use
     Settings::setValue("exportcsv", "firstrowheader", ui->checkHeader->isChecked());
     Settings::setValue("exportjson", "prettyprint", ui->checkPrettyPrint->isChecked());
+    Settings::setValue("exportjson", "ndjson", ui->checkNdjson->isChecked());
     Settings::setValue("exportcsv", "separator", currentSeparatorChar());
     Settings::setValue("exportcsv", "quotecharacter", currentQuoteChar());
     Settings::setValue("exportcsv", "newlinecharacters", currentNewLineString());
+    Settings::setValue("exportdata", "compression", static_cast<int>(currentCompression()));
+    Settings::setValue("exportdata", "splitsize", ui->spinSplitSize->value());
 
     // Notify the user the export has completed
     if(success) {
@@ -607,3 +433,20 @@ QString ExportDataDialog::currentNewLineString() const
         return QString(ui->editCustomNewLine->text().toLatin1());
     }
 }
+
+Compression ExportDataDialog::currentCompression() const
+{
+    return static_cast<Compression>(ui->comboCompression->currentData().toInt());
+}
+
+qint64 ExportDataDialog::currentSplitSize() const
+{
+    return static_cast<qint64>(ui->spinSplitSize->value()) * 1024 * 1024;
+}
+
+QString ExportDataDialog::withCompressionSuffix(const QString& fileName) const
+{
+    // Make sure compressed files have the usual file extension
+    const QString suffix = compressionSuffix(currentCompression());
+    return fileName.endsWith(suffix) ? fileName : fileName + suffix;
+}
@@ -5,6 +5,8 @@
 
 #include "sql/ObjectIdentifier.h"
 
+enum class Compression;
+
 class DBBrowserDB;
 
 namespace Ui {
@@ -40,9 +42,11 @@ private:
     void setNewLineString(const QString& s);
     QString currentNewLineString() const;
 
+    Compression currentCompression() const;
+    qint64 currentSplitSize() const;
+    QString withCompressionSuffix(const QString& fileName) const;
+
     bool exportQuery(const std::string& sQuery, const QString& sFilename);
-    bool exportQueryCsv(const std::string& sQuery, const QString& sFilename);
-    bool exportQueryJson(const std::string& sQuery, const QString& sFilename);
 
 private:
     Ui::ExportDataDialog* ui;
@@ -8,6 +8,8 @@
 #include <QFile>
 #include <QMessageBox>
 
+#include <algorithm>
+
 enum WhatComboEntries
 {
     ExportEverything,
@@ -26,9 +28,16 @@ ExportSqlDialog::ExportSqlDialog(DBBrowserDB* db, QWidget* parent, const QString
     // Load settings
     ui->checkColNames->setChecked(Settings::getValue("exportsql", "insertcolnames").toBool());
     ui->checkMultiple->setChecked(Settings::getValue("exportsql", "insertmultiple").toBool());
+    ui->spinMaxRows->setValue(Settings::getValue("exportsql", "maxrowsperinsert").toInt());
     ui->checkOriginal->setChecked(Settings::getValue("exportsql", "keeporiginal").toBool());
     ui->comboOldSchema->setCurrentIndex(Settings::getValue("exportsql", "oldschema").toInt());
 
+    // Only offer the compression formats this build supports
+    for(Compression compression : availableCompressions())
+        ui->comboCompression->addItem(compressionName(compression), static_cast<int>(compression));
+    ui->comboCompression->setCurrentIndex(std::max(ui->comboCompression->findData(Settings::getValue("exportsql", "compression").toInt()), 0));
+    ui->spinSplitSize->setValue(Settings::getValue("exportsql", "splitsize").toInt());
+
     // Get list of tables to export
     for(const auto& it : pdb->schemata["main"].tables)
         ui->listTables->addItem(new QListWidgetItem(IconCache::get(it.second->isView() ? "view" : "table"), QString::fromStdString(it.first)));
@@ -92,11 +101,19 @@ void ExportSqlDialog::accept()
     if(fileName.isEmpty())
         return;
 
+    // Make sure compressed files have the usual file extension
+    const Compression compression = static_cast<Compression>(ui->comboCompression->currentData().toInt());
+    if(!fileName.endsWith(compressionSuffix(compression)))
+        fileName += compressionSuffix(compression);
+
     // Save settings
     Settings::setValue("exportsql", "insertcolnames", ui->checkColNames->isChecked());
     Settings::setValue("exportsql", "insertmultiple", ui->checkMultiple->isChecked());
+    Settings::setValue("exportsql", "maxrowsperinsert", ui->spinMaxRows->value());
     Settings::setValue("exportsql", "keeporiginal", ui->checkOriginal->isChecked());
     Settings::setValue("exportsql", "oldschema", ui->comboOldSchema->currentIndex());
+    Settings::setValue("exportsql", "compression", static_cast<int>(compression));
+    Settings::setValue("exportsql", "splitsize", ui->spinSplitSize->value());
 
     std::vector<std::string> tables;
     for(const QListWidgetItem* item : ui->listTables->selectedItems())
@@ -115,7 +132,10 @@ void ExportSqlDialog::accept()
                             ui->checkOriginal->isChecked(),
                             exportSchema,
                             exportData,
-                            keepSchema);
+                            keepSchema,
+                            static_cast<size_t>(ui->spinMaxRows->value()),
+                            compression,
+                            static_cast<qint64>(ui->spinSplitSize->value()) * 1024 * 1024);
     if (dumpOk)
         QMessageBox::information(this, QApplication::applicationName(), tr("Export completed."));
     else
@@ -28,6 +28,7 @@
 #include <QShortcut>
 #include <QProgressDialog>
 
+#include <algorithm>
 #include <limits>
 
 using BufferRow = std::vector<QByteArray>;
@@ -164,7 +165,9 @@ QWidget* ExtendedTableWidgetEditorDelegate::createEditor(QWidget* parent, const
 
         QComboBox* combo = new QComboBox(parent);
 
-        // Complete cache so it is ready when setEditorData is invoked.
+        // Complete cache so it is ready when setEditorData is invoked. The model only lives as long as the combo box which needs
+        // all of its rows, so it is never unpinned.
+        fkModel->pinCache();
         fkModel->completeCache();
         combo->setModel(fkModel);
 
@@ -836,11 +839,8 @@ void ExtendedTableWidget::paste()
     if(rows == 1 && columns == 1)
     {
         QByteArray bArrdata = source->front().front();
-        for(int row=firstRow;row<firstRow+selectedRows;row++)
-        {
-            for(int column=firstColumn;column<firstColumn+selectedColumns;column++)
-                m->setTypedData(m->index(row, column), !isTextOnly(bArrdata), bArrdata);
-        }
+        const std::vector<BufferRow> fill(static_cast<size_t>(selectedRows), BufferRow(static_cast<size_t>(selectedColumns), bArrdata));
+        m->setTypedDataRange(indices.front(), !isTextOnly(bArrdata), fill);
         return;
     }
 
@@ -859,24 +859,16 @@ void ExtendedTableWidget::paste()
 
     // If we get here, we can definitely start pasting: either the ranges match in their size or the user agreed to paste anyway
 
-    // Copy the data cell by cell and as-is from the source buffer to the table
-    int row = firstRow;
+    // Copy the data as-is from the source buffer to the table. This updates all the cells in one go.
+    std::vector<BufferRow> range;
+    range.reserve(static_cast<size_t>(lastRow - firstRow + 1));
     for(const auto& source_row : *source)
     {
-        int column = firstColumn;
-        for(const QByteArray& source_cell : source_row)
-        {
-            m->setData(m->index(row, column), source_cell);
-
-            column++;
-            if (column > lastColumn)
-                break;
-        }
-
-        row++;
-        if (row > lastRow)
+        if(static_cast<int>(range.size()) > lastRow - firstRow)
             break;
+        range.emplace_back(source_row.begin(), source_row.begin() + std::min(static_cast<int>(source_row.size()), lastColumn - firstColumn + 1));
     }
+    m->setTypedDataRange(indices.front(), false, range);
 }
 
 void ExtendedTableWidget::cut()
@@ -1076,7 +1068,7 @@ void ExtendedTableWidget::vscrollbarChanged(int value)
     {
         int row_begin = std::min(value, nrows - 1);
         int row_end = std::min(value + numVisibleRows(), nrows);
-        m->triggerCacheLoad(row_begin, row_end);
+        m->triggerViewportLoad(row_begin, row_end);
     }
 }
 
@@ -19,6 +19,7 @@ static const QString FILE_EXT_SQLPRJ_DEFAULT(".sqbpro");
 // SQL File Extensions Filter
 static const QString FILE_FILTER_SQL(QObject::tr("SQL Files (*.sql)"));
 static const QString FILE_EXT_SQL_DEFAULT(".sql");
+static const QString FILE_FILTER_SQL_COMPRESSED(QObject::tr("Compressed or Split SQL Files (*.sql.gz *.sql.zst *.sql.001 *.sql.gz.001 *.sql.zst.001)"));
 
 // All Files Extensions Filter
 static const QString FILE_FILTER_ALL(QObject::tr("All Files (*)"));
@@ -37,6 +38,8 @@ static const QString FILE_FILTER_DAT(QObject::tr("Concordance DAT files (*.dat)"
 // JSON File Extensions Filter
 static const QString FILE_FILTER_JSON(QObject::tr("JSON Files (*.json *.js)"));
 static const QString FILE_EXT_JSON_DEFAULT(".json");
+static const QString FILE_FILTER_NDJSON(QObject::tr("Newline-Delimited JSON Files (*.ndjson *.jsonl)"));
+static const QString FILE_EXT_NDJSON_DEFAULT(".ndjson");
 
 // XML File Extensions Filter
 static const QString FILE_FILTER_XML(QObject::tr("XML Files (*.xml)"));
@@ -0,0 +1,386 @@
+#include "HeadlessRunner.h"
+#include "Application.h"
+#include "CompressedFile.h"
+#include "CsvImporter.h"
+#include "DataExporter.h"
+#include "Settings.h"
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QTextCodec>
+
+#include <cstring>
+
+namespace {
+// Prints the progress of a task to stderr. To not flood logs and terminals, this happens at most once per second, apart from the
+// final message.
+class ProgressPrinter
+{
+public:
+    explicit ProgressPrinter(const QString& task)
+        : m_task(task)
+    {
+        m_timer.start();
+        qInfo().noquote() << m_task;
+    }
+
+    void update(const QString& status)
+    {
+        if(m_timer.elapsed() < 1000)
+            return;
+        qInfo().noquote() << QString("%1: %2").arg(m_task, status);
+        m_timer.restart();
+    }
+
+    void finish(const QString& status)
+    {
+        qInfo().noquote() << QString("%1: %2").arg(m_task, status);
+    }
+
+private:
+    QString m_task;
+    QElapsedTimer m_timer;
+};
+
+void printError(const QString& message)
+{
+    qCritical().noquote() << message;
+}
+}
+
+bool HeadlessRunner::isRequested(int argc, char** argv)
+{
+    for(int i=1;i<argc;i++)
+    {
+        if(std::strcmp(argv[i], "--headless") == 0 ||
+                std::strcmp(argv[i], "--export-csv") == 0 ||
+                std::strcmp(argv[i], "--export-json") == 0 ||
+                std::strcmp(argv[i], "--export-sql") == 0)
+            return true;
+    }
+    return false;
+}
+
+HeadlessRunner::HeadlessRunner(const QStringList& arguments, QObject* parent)
+    : QObject(parent),
+      m_arguments(arguments),
+      m_readOnly(false)
+{
+}
+
+int HeadlessRunner::run()
+{
+    // Get 'DB4S_SETTINGS_FILE' environment variable. The -S/--settings argument takes precedence. It needs to be set before any
+    // of the other arguments change settings.
+    const auto env = qgetenv("DB4S_SETTINGS_FILE");
+    if(!env.isEmpty())
+        Settings::setUserSettingsFile(env);
+    for(int i=1;i<m_arguments.size()-1;i++)
+    {
+        if(m_arguments.at(i) == "-S" || m_arguments.at(i) == "--settings")
+            Settings::setUserSettingsFile(m_arguments.at(++i));
+    }
+
+    // Set organisation and application names, these decide where the settings are read from
+    QCoreApplication::setOrganizationName("sqlitebrowser");
+    QCoreApplication::setApplicationName("DB Browser for SQLite");
+
+    // Set character encoding to UTF8
+    QTextCodec::setCodecForLocale(QTextCodec::codecForName("UTF-8"));
+
+    const int exitCode = parseArguments();
+    if(exitCode != -1)
+        return exitCode;
+
+    bool success = openDatabase() && executeSqlFiles() && importCsvFiles();
+
+    // Only keep the changes if all scripts and imports have succeeded. Otherwise closing the database undoes them.
+    if(success && !m_readOnly && !m_db.releaseAllSavepoints())
+    {
+        printError(tr("Saving the changes failed: %1").arg(m_db.lastError()));
+        success = false;
+    }
+
+    success = success && exportData();
+
+    m_db.close();
+    Settings::sync();
+    return success ? Success : Failure;
+}
+
+int HeadlessRunner::parseArguments()
+{
+    for(int i=1;i<m_arguments.size();i++)
+    {
+        const QString& argument = m_arguments.at(i);
+
+        // Returns the value of an option which needs one or an empty string if it is missing
+        auto value = [this, &i, &argument]() -> QString {
+            if(++i >= m_arguments.size())
+            {
+                printError(tr("The %1 option requires an argument").arg(argument));
+                return QString();
+            }
+            return m_arguments.at(i);
+        };
+
+        if(argument == "-h" || argument == "--help")
+        {
+            printUsage();
+            return Success;
+        } else if(argument == "-v" || argument == "--version") {
+            qWarning() << qPrintable(Application::versionInformation());
+            return Success;
+        } else if(argument == "--headless" || argument == "-q" || argument == "--quit") {
+            // Nothing to do. The user interface is never shown in this mode.
+        } else if(argument == "-s" || argument == "--sql") {
+            const QString file = value();
+            if(file.isEmpty())
+                return UsageError;
+            if(!QFile::exists(file))
+            {
+                printError(tr("The file %1 does not exist").arg(file));
+                return UsageError;
+            }
+            m_sqlFiles.append(file);
+        } else if(argument == "--import-csv") {
+            const QString file = value();
+            if(file.isEmpty())
+                return UsageError;
+            if(!QFile::exists(file))
+            {
+                printError(tr("The file %1 does not exist").arg(file));
+                return UsageError;
+            }
+            m_csvFiles.append(file);
+        } else if(argument == "-t" || argument == "--table") {
+            const QString table = value();
+            if(table.isEmpty())
+                return UsageError;
+            m_tables.push_back(table.toStdString());
+        } else if(argument == "--export-csv") {
+            m_csvExportFile = value();
+            if(m_csvExportFile.isEmpty())
+                return UsageError;
+        } else if(argument == "--export-json") {
+            m_jsonExportFile = value();
+            if(m_jsonExportFile.isEmpty())
+                return UsageError;
+        } else if(argument == "--export-sql") {
+            m_sqlExportFile = value();
+            if(m_sqlExportFile.isEmpty())
+                return UsageError;
+        } else if(argument == "-R" || argument == "--read-only") {
+            m_readOnly = true;
+        } else if(argument == "-S" || argument == "--settings") {
+            // This option has already been handled before
+            if(value().isEmpty())
+                return UsageError;
+        } else if(argument == "-o" || argument == "--option" || argument == "-O" || argument == "--save-option") {
+            const bool saveToDisk = argument == "-O" || argument == "--save-option";
+            if(++i >= m_arguments.size() || !Settings::setValueFromArgument(m_arguments.at(i), saveToDisk))
+            {
+                printError(tr("The -o/--option and -O/--save-option options require an argument in the form group/setting=value"));
+                return UsageError;
+            }
+        } else if(argument.startsWith('-')) {
+            printError(tr("Invalid option: %1").arg(argument));
+            return UsageError;
+        } else if(m_databaseFile.isEmpty()) {
+            m_databaseFile = argument;
+        } else {
+            printError(tr("Only one database can be passed: %1").arg(argument));
+            return UsageError;
+        }
+    }
+
+    if((!m_csvExportFile.isEmpty() || !m_jsonExportFile.isEmpty()) && m_tables.size() != 1)
+    {
+        printError(tr("Exporting to CSV or JSON requires exactly one table passed with -t/--table"));
+        return UsageError;
+    }
+    if(m_readOnly && !m_csvFiles.isEmpty())
+    {
+        printError(tr("Importing CSV files is not possible in read-only mode"));
+        return UsageError;
+    }
+
+    return -1;
+}
+
+void HeadlessRunner::printUsage() const
+{
+    qWarning() << qPrintable(QString("%1: %2 --headless [%3] [<%4>]\n").arg(
+                             tr("Usage"), QFileInfo(m_arguments.at(0)).fileName(), tr("options"), tr("database")));
+
+    qWarning() << qPrintable(tr("Possible command line arguments in headless mode:"));
+    printArgument(QString("-h, --help"),
+                  tr("Show command line options"));
+    printArgument(QString("--headless"),
+                  tr("Run without user interface"));
+    printArgument(QString("-s, --sql <%1>").arg(tr("file")),
+                  tr("Execute this SQL file after opening the DB"));
+    printArgument(QString("--import-csv <%1>").arg(tr("file")),
+                  tr("Import this CSV file into the table passed with -t or into a table named like the file"));
+    printArgument(QString("-t, --table <%1>").arg(tr("table")),
+                  tr("Use this table as target of a data import or as source of an export"));
+    printArgument(QString("--export-csv <%1>").arg(tr("file")),
+                  tr("Export the table passed with -t to this CSV file"));
+    printArgument(QString("--export-json <%1>").arg(tr("file")),
+                  tr("Export the table passed with -t to this JSON file"));
+    printArgument(QString("--export-sql <%1>").arg(tr("file")),
+                  tr("Export the tables passed with -t or all tables to this SQL file"));
+    printArgument(QString("-R, --read-only"),
+                  tr("Open database in read-only mode"));
+    printArgument(QString("-S, --settings <%1>").arg(tr("settings_file")),
+                  tr("Run application based on this settings file"));
+    printArgument(QString("-o, --option <%1>/<%2>=<%3>").arg(tr("group"), tr("settings"), tr("value")),
+                  tr("Run application with this setting temporarily set to value"));
+    printArgument(QString("-O, --save-option <%1>/<%2>=<%3>").arg(tr("group"), tr("settings"), tr("value")),
+                  tr("Run application saving this value for this setting"));
+    printArgument(QString("-v, --version"),
+                  tr("Display the current version"));
+    printArgument(QString("<%1>").arg(tr("database")),
+                  tr("Open this SQLite database, creating it if it doesn't exist, or use an in-memory database if none is passed"));
+    qWarning() << qPrintable(tr("\nThe changes are only saved if all SQL files and imports succeed. The export options are taken from "
+                                "the settings, which can be changed using -o. The exit code is 0 on success, 1 if any step has failed "
+                                "and 2 for invalid command lines."));
+}
+
+bool HeadlessRunner::openDatabase()
+{
+    bool ok;
+    if(m_databaseFile.isEmpty())
+        ok = m_db.open(":memory:");
+    else if(!m_readOnly && !QFile::exists(m_databaseFile))
+        ok = m_db.create(m_databaseFile);
+    else
+        ok = m_db.open(m_databaseFile, m_readOnly);
+
+    if(!ok)
+        printError(tr("Could not open database file %1: %2").arg(m_databaseFile, m_db.lastError()));
+    return ok;
+}
+
+bool HeadlessRunner::executeSqlFiles()
+{
+    for(const QString& fileName : m_sqlFiles)
+    {
+        ProgressPrinter printer(tr("Executing %1").arg(fileName));
+
+        // Compressed and split files are read like in the Import SQL dialog
+        QString error;
+        const std::unique_ptr<QIODevice> file = CompressedFileReader::openFile(fileName, error);
+        if(!file)
+        {
+            printError(tr("Could not open SQL file %1: %2").arg(fileName, error));
+            return false;
+        }
+        if(!m_db.executeMultiSQL(*file, !m_readOnly))
+        {
+            printError(tr("Executing %1 failed: %2").arg(fileName, m_db.lastError()));
+            return false;
+        }
+        printer.finish(tr("done"));
+    }
+    return true;
+}
+
+bool HeadlessRunner::importCsvFiles()
+{
+    for(const QString& fileName : m_csvFiles)
+    {
+        const std::string tableName = m_tables.empty() ? QFileInfo(fileName).baseName().toStdString() : m_tables.front();
+        ProgressPrinter printer(tr("Importing %1 into table %2").arg(fileName, QString::fromStdString(tableName)));
+
+        CsvImporter importer(m_db, CsvImporter::optionsFromSettings());
+        connect(&importer, &CsvImporter::progress, this, [&printer](qint64 pos, qint64 fileSize) {
+            printer.update(QString("%1%").arg(100 * pos / fileSize));
+        });
+
+        const sqlb::FieldVector fieldList = importer.generateFieldList(fileName);
+        if(fieldList.empty())
+        {
+            printError(tr("The CSV file %1 contains no columns").arg(fileName));
+            return false;
+        }
+        if(!importer.import(fileName, tableName, fieldList))
+        {
+            if(importer.errorRow())
+                printError(tr("Error importing %1 from record number %2: %3").arg(fileName).arg(importer.errorRow()).arg(importer.errorMessage()));
+            else
+                printError(tr("Error importing %1: %2").arg(fileName, importer.errorMessage()));
+            return false;
+        }
+        printer.finish(tr("done"));
+    }
+    return true;
+}
+
+bool HeadlessRunner::exportData()
+{
+    DataExporter exporter(m_db, DataExporter::optionsFromSettings());
+
+    const auto exportTable = [this, &exporter](const QString& fileName, const QString& format) {
+        const QString table = QString::fromStdString(m_tables.front());
+        ProgressPrinter printer(tr("Exporting table %1 to %2").arg(table, fileName));
+        auto connection = connect(&exporter, &DataExporter::progress, this, [&printer](quint64 rows) {
+            printer.update(tr("%n row(s)", "", static_cast<int>(rows)));
+        });
+
+        const std::string query = "SELECT * FROM " + sqlb::ObjectIdentifier("main", m_tables.front()).toString();
+        const bool ok = format == "json" ? exporter.exportJson(query, fileName) : exporter.exportCsv(query, fileName);
+        disconnect(connection);
+        if(!ok)
+        {
+            printError(tr("Exporting table %1 failed: %2").arg(table, exporter.errorMessage()));
+            return false;
+        }
+        printer.finish(tr("done"));
+        return true;
+    };
+
+    if(!m_csvExportFile.isEmpty() && !exportTable(m_csvExportFile, "csv"))
+        return false;
+    if(!m_jsonExportFile.isEmpty() && !exportTable(m_jsonExportFile, "json"))
+        return false;
+
+    if(!m_sqlExportFile.isEmpty())
+    {
+        std::vector<std::string> tables = m_tables;
+        if(tables.empty())
+        {
+            for(const auto& it : m_db.schemata["main"].tables)
+                tables.push_back(it.first);
+        }
+
+        ProgressPrinter printer(tr("Exporting database to %1").arg(m_sqlExportFile));
+        auto connection = connect(&m_db, &DBBrowserDB::dumpProgress, this, [&printer](quint64 rows, quint64 totalRows) {
+            printer.update(QString("%1%").arg(100 * rows / totalRows));
+        });
+
+        const bool ok = m_db.dump(m_sqlExportFile,
+                                  tables,
+                                  Settings::getValue("exportsql", "insertcolnames").toBool(),
+                                  Settings::getValue("exportsql", "insertmultiple").toBool(),
+                                  Settings::getValue("exportsql", "keeporiginal").toBool(),
+                                  true,
+                                  true,
+                                  Settings::getValue("exportsql", "oldschema").toInt() == 0,
+                                  static_cast<size_t>(Settings::getValue("exportsql", "maxrowsperinsert").toInt()),
+                                  static_cast<Compression>(Settings::getValue("exportsql", "compression").toInt()),
+                                  Settings::getValue("exportsql", "splitsize").toLongLong() * 1024 * 1024);
+        disconnect(connection);
+        if(!ok)
+        {
+            printError(tr("Exporting the database failed: %1").arg(m_db.lastError()));
+            return false;
+        }
+        printer.finish(tr("done"));
+    }
+
+    return true;
+}
@@ -0,0 +1,59 @@
+#ifndef HEADLESSRUNNER_H
+#define HEADLESSRUNNER_H
+
+#include "sqlitedb.h"
+
+#include <QObject>
+#include <QStringList>
+
+#include <string>
+#include <vector>
+
+/*
+ * This class runs the imports and exports passed on the command line without showing any user interface. It only needs a
+ * QCoreApplication, so it works without a display, for example in scripts and on servers. Progress and errors are printed to stderr.
+ */
+class HeadlessRunner : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum ExitCode
+    {
+        Success = 0,
+        Failure = 1,                // Opening the database, running a script, importing or exporting has failed
+        UsageError = 2,             // The command line is invalid
+    };
+
+    // Whether the command line asks for running without the user interface
+    static bool isRequested(int argc, char** argv);
+
+    explicit HeadlessRunner(const QStringList& arguments, QObject* parent = nullptr);
+
+    // Do everything passed on the command line and return the exit code for the application
+    int run();
+
+private:
+    QStringList m_arguments;
+    QString m_databaseFile;
+    bool m_readOnly;
+    QStringList m_sqlFiles;
+    QStringList m_csvFiles;
+    std::vector<std::string> m_tables;
+    QString m_csvExportFile;
+    QString m_jsonExportFile;
+    QString m_sqlExportFile;
+
+    DBBrowserDB m_db;
+
+    // Returns -1 if running should go on or the exit code otherwise
+    int parseArguments();
+    void printUsage() const;
+
+    bool openDatabase();
+    bool executeSqlFiles();
+    bool importCsvFiles();
+    bool exportData();
+};
+
+#endif
@@ -2,7 +2,7 @@
 #include "ui_ImportCsvDialog.h"
 #include "sqlitedb.h"
 #include "csvparser.h"
-#include "sqlite.h"
+#include "CsvImporter.h"
 #include "Settings.h"
 #include "Data.h"
 
@@ -13,10 +13,9 @@
 #include <QTextCodec>
 #include <QCompleter>
 #include <QComboBox>
-#include <QFile>
-#include <QTextStream>
 #include <QFileInfo>
-#include <memory>
+
+#include <algorithm>
 
 // Enable this line to show basic performance stats after each imported CSV file. Please keep in mind that while these
 // numbers might help to estimate the performance of the algorithm, this is not a proper benchmark.
@@ -26,18 +25,6 @@
 #include <QElapsedTimer>
 #endif
 
-QChar ImportCsvDialog::getSettingsChar(const std::string& group, const std::string& name)
-{
-    QVariant value = Settings::getValue(group, name);
-    // QVariant is not able to return the character as a QChar when QString is stored.
-    // We do it manually, since it is versatile, when the option is passed from the command line,
-    // for example.
-    if(value.userType() == QMetaType::QString)
-        return value.toString().at(0);
-    else
-        return value.toChar();
-}
-
 ImportCsvDialog::ImportCsvDialog(const std::vector<QString>& filenames, DBBrowserDB* db, QWidget* parent, const QString& table)
     : QDialog(parent),
       ui(new Ui::ImportCsvDialog),
@@ -76,8 +63,9 @@ ImportCsvDialog::ImportCsvDialog(const std::vector<QString>& filenames, DBBrowse
     ui->checkBoxTrimFields->setChecked(Settings::getValue("importcsv", "trimfields").toBool());
     ui->checkBoxSeparateTables->setChecked(Settings::getValue("importcsv", "separatetables").toBool());
     ui->checkLocalConventions->setChecked(Settings::getValue("importcsv", "localconventions").toBool());
-    setSeparatorChar(getSettingsChar("importcsv", "separator"));
-    setQuoteChar(getSettingsChar("importcsv", "quotecharacter"));
+    ui->checkBulkLoad->setChecked(Settings::getValue("importcsv", "bulkload").toBool());
+    setSeparatorChar(CsvImporter::settingsChar("importcsv", "separator"));
+    setQuoteChar(CsvImporter::settingsChar("importcsv", "quotecharacter"));
     setEncoding(Settings::getValue("importcsv", "encoding").toString());
 
     ui->checkboxHeader->blockSignals(false);
@@ -113,76 +101,6 @@ ImportCsvDialog::~ImportCsvDialog()
     delete ui;
 }
 
-namespace {
-void rollback(
-        ImportCsvDialog* dialog,
-        DBBrowserDB* pdb,
-        DBBrowserDB::db_pointer_type* db_ptr,
-        const std::string& savepointName,
-        size_t nRecord,
-        const QString& message)
-{
-    // Release DB handle. This needs to be done before calling revertToSavepoint as that function needs to be able to acquire its own handle.
-    if(db_ptr)
-        *db_ptr = nullptr;
-
-    QApplication::restoreOverrideCursor();  // restore original cursor
-    if(!message.isEmpty())
-    {
-        QString sCSVInfo = QObject::tr("Error importing data");
-        if(nRecord)
-            sCSVInfo += QObject::tr(" from record number %1").arg(nRecord);
-        QString error = sCSVInfo + QObject::tr(".\n%1").arg(message);
-        QMessageBox::warning(dialog, QApplication::applicationName(), error);
-    }
-    pdb->revertToSavepoint(savepointName);
-}
-}
-
-class CSVImportProgress : public CSVProgress
-{
-public:
-    explicit CSVImportProgress(int64_t filesize)
-        : m_pProgressDlg(new QProgressDialog(
-                             QObject::tr("Importing CSV file..."),
-                             QObject::tr("Cancel"),
-                             0,
-                             10000)),
-          totalFileSize(filesize)
-    {
-        m_pProgressDlg->setWindowModality(Qt::ApplicationModal);
-        // Disable context help button on Windows
-        m_pProgressDlg->setWindowFlags(m_pProgressDlg->windowFlags()
-                                      & ~Qt::WindowContextHelpButtonHint);
-    }
-
-    CSVImportProgress(const CSVImportProgress&) = delete;
-    bool operator=(const CSVImportProgress&) = delete;
-
-    void start() override
-    {
-        m_pProgressDlg->show();
-    }
-
-    bool update(int64_t pos) override
-    {
-        m_pProgressDlg->setValue(static_cast<int>((static_cast<float>(pos) / static_cast<float>(totalFileSize)) * 10000.0f));
-        qApp->processEvents();
-
-        return !m_pProgressDlg->wasCanceled();
-    }
-
-    void end() override
-    {
-        m_pProgressDlg->hide();
-    }
-
-private:
-    std::unique_ptr<QProgressDialog> m_pProgressDlg;
-
-    int64_t totalFileSize;
-};
-
 void ImportCsvDialog::accept()
 {
     // Save settings
@@ -192,6 +110,7 @@ void ImportCsvDialog::accept()
     Settings::setValue("importcsv", "trimfields", ui->checkBoxTrimFields->isChecked());
     Settings::setValue("importcsv", "separatetables", ui->checkBoxSeparateTables->isChecked());
     Settings::setValue("importcsv", "localconventions", ui->checkLocalConventions->isChecked());
+    Settings::setValue("importcsv", "bulkload", ui->checkBulkLoad->isChecked());
     Settings::setValue("importcsv", "encoding", currentEncoding());
 
     // Get all the selected files and start the import
@@ -253,7 +172,8 @@ void ImportCsvDialog::updatePreview()
     ui->tablePreview->setRowCount(0);
 
     // Analyse CSV file
-    sqlb::FieldVector fieldList = generateFieldList(selectedFile);
+    std::vector<CsvImporter::ColumnStatistics> statistics;
+    sqlb::FieldVector fieldList = generateFieldList(selectedFile, &statistics);
 
     // Reset preview widget
     ui->tablePreview->clear();
@@ -268,6 +188,22 @@ void ImportCsvDialog::updatePreview()
     std::transform(fieldList.begin(), fieldList.end(), std::back_inserter(horizontalHeader), [](const auto& field) { return QString::fromStdString(field.name()); });
     ui->tablePreview->setHorizontalHeaderLabels(horizontalHeader);
 
+    // Show what the analysis found out about each column in the tooltip of its header
+    for(size_t i=0;i<fieldList.size();i++)
+    {
+        const CsvImporter::ColumnStatistics& column = statistics.at(i);
+        QString tooltip = tr("Data type: %1").arg(fieldList.at(i).type().empty() ? tr("none") : QString::fromStdString(fieldList.at(i).type()));
+        if(column.values)
+        {
+            tooltip += "\n" + tr("Empty values: %1%").arg(100.0 * static_cast<double>(column.nulls) / static_cast<double>(column.values), 0, 'f', 1);
+            tooltip += "\n" + tr("Maximum length: %1").arg(column.maxLength);
+            if(column.numeric && fieldList.at(i).type() != "TEXT")
+                tooltip += "\n" + tr("Range: %1 to %2").arg(column.min).arg(column.max);
+            tooltip += "\n" + tr("Based on a sample of %n value(s)", "", static_cast<int>(column.values));
+        }
+        ui->tablePreview->horizontalHeaderItem(static_cast<int>(i))->setToolTip(tooltip);
+    }
+
     // Parse file
     parseCSV(selectedFile, [this](size_t rowNum, const CSVRow& rowData) -> bool {
         // Skip first row if it is to be used as header
@@ -388,97 +324,32 @@ void ImportCsvDialog::matchSimilar()
     checkInput();
 }
 
-CSVParser::ParserResult ImportCsvDialog::parseCSV(const QString &fileName, std::function<bool(size_t, CSVRow)> rowFunction, size_t count) const
+CsvImporter::Options ImportCsvDialog::currentOptions() const
 {
-    // Parse all csv data
-    QFile file(fileName);
-    file.open(QIODevice::ReadOnly);
-
-    CSVParser csv(ui->checkBoxTrimFields->isChecked(), toUtf8(currentSeparatorChar()), toUtf8(currentQuoteChar()));
-
-    // Only show progress dialog if we parse all rows. The assumption here is that if a row count limit has been set, it won't be a very high one.
-    if(count == 0)
-        csv.setCSVProgress(new CSVImportProgress(file.size()));
-    QTextStream tstream(&file);
-    // textstream.setCodec(QTextCodec::codecForName("UTF-8"));
-    // is no longer needed in Qt6 since QTextStream defaults to utf-8.
-#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
-    tstream.setCodec(currentEncoding().toUtf8());
-#endif
-
-    return csv.parse(rowFunction, tstream, count);
+    CsvImporter::Options options;
+    options.header = ui->checkboxHeader->isChecked();
+    options.trimFields = ui->checkBoxTrimFields->isChecked();
+    options.separator = CsvImporter::toUtf8(currentSeparatorChar());
+    options.quote = CsvImporter::toUtf8(currentQuoteChar());
+    options.encoding = currentEncoding();
+    options.localConventions = ui->checkLocalConventions->isChecked();
+    options.detectTypes = !ui->checkNoTypeDetection->isChecked();
+    options.ignoreDefaults = ui->checkIgnoreDefaults->isChecked();
+    options.failOnMissing = ui->checkFailOnMissing->isChecked();
+    options.bulkLoad = ui->checkBulkLoad->isChecked();
+    options.onConflict = currentOnConflictStrategy();
+    return options;
 }
 
-sqlb::FieldVector ImportCsvDialog::generateFieldList(const QString& filename) const
+CSVParser::ParserResult ImportCsvDialog::parseCSV(const QString &fileName, std::function<bool(size_t, CSVRow)> rowFunction, size_t count) const
 {
-    sqlb::FieldVector fieldList;        // List of fields in the file
-
-    // Parse the first couple of records of the CSV file and only analyse them
-    parseCSV(filename, [this, &fieldList](size_t rowNum, const CSVRow& rowData) -> bool {
-        // Has this row more columns than the previous one? Then add more fields to the field list as necessary.
-        for(size_t i=fieldList.size();i<rowData.num_fields;i++)
-        {
-            std::string fieldname;
-
-            // If the user wants to use the first row as table header and if this is the first row, extract a field name
-            if(rowNum == 0 && ui->checkboxHeader->isChecked())
-            {
-                // Take field name from CSV
-                fieldname = std::string(rowData.fields[i].data, rowData.fields[i].data_length);
-            }
-
-            // If we don't have a field name by now, generate one
-            if(fieldname.empty())
-                fieldname = "field" + std::to_string(i + 1);
-
-            // Add field to the column list. For now we set the data type to nothing but this might be overwritten later in the automatic
-            // type detection code.
-            fieldList.emplace_back(fieldname, "");
-        }
-
-        // Try to find out a data type for each column. Skip the header row if there is one.
-        if(!ui->checkNoTypeDetection->isChecked() && !(rowNum == 0 && ui->checkboxHeader->isChecked()))
-        {
-            for(size_t i=0;i<rowData.num_fields;i++)
-            {
-                // If the data type has been set to TEXT, there's no going back because it means we had at least one row with text-only
-                // content and that means we don't want to set the data type to any number type.
-                std::string old_type = fieldList.at(i).type();
-                if(old_type != "TEXT")
-                {
-                    QString content = QString::fromUtf8(rowData.fields[i].data, static_cast<int>(rowData.fields[i].data_length));
-                    const QLocale &locale = ui->checkLocalConventions->isChecked() ? QLocale::system() : QLocale::c();
-
-                    // Check if the content can be converted to an integer or to real
-                    bool convert_to_integer, convert_to_real;
-                    locale.toLongLong(content, &convert_to_integer);
-                    locale.toDouble(content, &convert_to_real);
-
-                    // Set new data type. If we don't find any better data type, we fall back to the TEXT data type
-                    std::string new_type = "TEXT";
-                    if(old_type == "INTEGER" && !convert_to_integer && convert_to_real)  // So far it's integer, but now it's only convertible to float
-                        new_type = "REAL";
-                    else if(old_type.empty() && convert_to_integer)                      // No type yet, but this bit is convertible to integer
-                        new_type = "INTEGER";
-                    else if(old_type.empty() && convert_to_real)                         // No type yet and only convertible to float (less 'difficult' than integer)
-                        new_type = "REAL";
-                    else if(old_type == "REAL" && convert_to_real)                       // It was float so far and still is
-                        new_type = "INTEGER";
-                    else if(old_type == "INTEGER" && convert_to_integer)                 // It was integer so far and still is
-                        new_type = "INTEGER";
-
-                    fieldList.at(i).setType(new_type);
-                }
-            }
-        }
-
-        // All good
-        return true;
-    }, 20);
-
-    return fieldList;
+    return CsvImporter(*pdb, currentOptions()).parse(fileName, rowFunction, count);
 }
 
+sqlb::FieldVector ImportCsvDialog::generateFieldList(const QString& filename, std::vector<CsvImporter::ColumnStatistics>* statistics) const
+{
+    return CsvImporter(*pdb, currentOptions()).generateFieldList(filename, statistics);
+}
 bool ImportCsvDialog::importCsv(const QString& fileName, const QString& name)
 {
     // This function returns a boolean to indicate whether to continue or abort the import process. It's worth keeping in mind that
@@ -490,7 +361,6 @@ bool ImportCsvDialog::importCsv(const QString& fileName, const QString& name)
 
 #ifdef CSV_BENCHMARK
     // If benchmark mode is enabled start measuring the performance now
-    qint64 timesRowFunction = 0;
     QElapsedTimer timer;
     timer.start();
 #endif
@@ -558,195 +428,60 @@ bool ImportCsvDialog::importCsv(const QString& fileName, const QString& name)
         }
     }
 
-    // Create a savepoint, so we can rollback in case of any errors during importing
-    // db needs to be saved or an error will occur
-    std::string restorepointName = pdb->generateSavepointName("csvimport");
-    if(!pdb->setSavepoint(restorepointName))
-    {
-        rollback(this, pdb, nullptr, restorepointName, 0, tr("Creating restore point failed: %1").arg(pdb->lastError()));
-        return false;
-    }
-
-    // Create table
-    std::vector<QByteArray> nullValues;
-    std::vector<bool> failOnMissingFieldList;
-    bool ignoreDefaults = ui->checkIgnoreDefaults->isChecked();
-    bool failOnMissing = ui->checkFailOnMissing->isChecked();
-    if(!importToExistingTable)
-    {
-        if(!pdb->createTable(sqlb::ObjectIdentifier("main", tableName.toStdString()), fieldList))
-        {
-            rollback(this, pdb, nullptr, restorepointName, 0, tr("Creating the table failed: %1").arg(pdb->lastError()));
-            return false;
-        }
-
-        // If we're creating the table in this import session, don't ask the user if it's okay to import more data into it. It seems
-        // safe to just assume that's what they want.
-        dontAskForExistingTableAgain.append(tableName);
-    } else {
-        // Importing into an existing table. So find out something about it's structure.
-
-        // Prepare the values for each table column that are to be inserted if the field in the CSV file is empty. Depending on the data type
-        // and the constraints of a field, we need to handle this case differently.
-        if(tbl)
-        {
-            for(const sqlb::Field& f : tbl->fields)
-            {
-                // For determining the value for empty fields we follow a set of rules
-
-                // Normally we don't have to fail the import when importing an empty field. This last value of the vector
-                // is changed to true later if we actually do want to fail the import for this field.
-                failOnMissingFieldList.push_back(false);
-
-                // If a field has a default value, that gets priority over everything else.
-                // Exception: if the user wants to ignore default values we never use them.
-                if(!ignoreDefaults && !f.defaultValue().empty())
-                {
-                    nullValues.push_back(f.defaultValue().c_str());
-                } else {
-                    // If it has no default value, check if the field is NOT NULL
-                    if(f.notnull())
-                    {
-                        // The field is NOT NULL
-
-                        // If this is an integer column insert 0. Otherwise insert an empty string.
-                        if(f.isInteger())
-                            nullValues.push_back("0");
-                        else
-                            nullValues.push_back("");
-
-                        // If the user wants to fail the import, remember this field
-                        if(failOnMissing)
-                            failOnMissingFieldList.back() = true;
-                    } else {
-                        // The field is not NOT NULL (stupid double negation here! NULL values are allowed in this case)
-
-                        // Just insert a NULL value
-                        nullValues.push_back(QByteArray());
-                    }
-                }
-            }
-        }
-    }
-
-    // Prepare the INSERT statement. The prepared statement can then be reused for each row to insert
-    std::string sQuery = "INSERT " + currentOnConflictStrategy() + " INTO " + sqlb::escapeIdentifier(tableName.toStdString()) + " VALUES(";
-    for(size_t i=1;i<=fieldList.size();i++)
-        sQuery += "?" + std::to_string(i) + ",";
-    sQuery.pop_back();  // Remove last comma
-    sQuery.append(")");
-    sqlite3_stmt* stmt;
-    auto pDb = pdb->get(tr("importing CSV"));
-    if(sqlite3_prepare_v2(pDb.get(), sQuery.c_str(), static_cast<int>(sQuery.size()), &stmt, nullptr) != SQLITE_OK)
-    {
-        rollback(this, pdb, nullptr, restorepointName, 0, tr("Could not prepare INSERT statement: %1").arg(pdb->lastError()));
-        return false;
-    }
-
-    // Parse entire file
-    size_t lastRowNum = 0;
-    CSVParser::ParserResult result = parseCSV(fileName, [&](size_t rowNum, const CSVRow& rowData) -> bool {
-        // Process the parser results row by row
-
-#ifdef CSV_BENCHMARK
-        qint64 timeAtStartOfRowFunction = timer.elapsed();
-#endif
-
-        // Save row num for later use. This is used in the case of an error to tell the user in which row the error occurred
-        lastRowNum = rowNum;
-
-        // If this is the first row and we want to use the first row as table header, skip it now because this is the data import, not the header parsing
-        if(rowNum == 0 && ui->checkboxHeader->isChecked())
-            return true;
-
-        // Bind all values
-        for(size_t i=0;i<rowData.num_fields;i++)
-        {
-            // Empty values need special treatment
-            // When importing into an existing table where we could find out something about its table definition
-            if(importToExistingTable && rowData.fields[i].data_length == 0 && nullValues.size() > i)
-            {
-                // Do we want to fail when trying to import an empty value into this field? Then exit with an error.
-                if(failOnMissingFieldList.at(i))
-                    return false;
-
-                // This is an empty value. We'll need to look up how to handle it depending on the field to be inserted into.
-                const QByteArray& val = nullValues.at(i);
-                if(!val.isNull())       // No need to bind NULL values here as that is the default bound value in SQLite
-                    sqlite3_bind_text(stmt, static_cast<int>(i)+1, val, val.size(), SQLITE_STATIC);
-            // When importing into a new table, use the missing values setting directly
-            } else if(!importToExistingTable && rowData.fields[i].data_length == 0) {
-                // No need to bind NULL values here as that is the default bound value in SQLite
-            } else {
-                // This is a non-empty value, or we want to insert the empty string. Just add it to the statement.
-                bool convert_ok = false;
-                if(ui->checkLocalConventions->isChecked()) {
-                    // Find the correct data type taking into account the locale.
-                    QString content = QString::fromUtf8(rowData.fields[i].data, static_cast<int>(rowData.fields[i].data_length));
-                    sqlite_int64 int64_value = QLocale::system().toLongLong(content, &convert_ok);
-                    if(convert_ok) {
-                        sqlite3_bind_int64(stmt, static_cast<int>(i)+1, int64_value);
-                    } else {
-                        double value = QLocale::system().toDouble(content, &convert_ok);
-                        if(convert_ok)
-                            sqlite3_bind_double(stmt, static_cast<int>(i)+1, value);
-                    }
-                }
-
-                if(!convert_ok) {
-                    // If we don't find any better data type or we want SQLite to apply the type affinity
-                    // (impossible when using local conventions), we fall back to the TEXT data type.
-                    sqlite3_bind_text(stmt, static_cast<int>(i)+1, rowData.fields[i].data, static_cast<int>(rowData.fields[i].data_length), SQLITE_STATIC);
-                }
-            }
-        }
-
-        // Insert row
-        if(sqlite3_step(stmt) != SQLITE_DONE)
-            return false;
-
-        // Reset statement for next use. Also reset all bindings to NULL. This is important, so we don't need to bind missing columns or empty values in NULL
-        // columns manually.
-        sqlite3_reset(stmt);
-        sqlite3_clear_bindings(stmt);
+    // Import the file. This undoes all changes if it fails or is cancelled.
+    CsvImporter importer(*pdb, currentOptions());
 
-#ifdef CSV_BENCHMARK
-        timesRowFunction += timer.elapsed() - timeAtStartOfRowFunction;
-#endif
+    QProgressDialog progressDialog(tr("Importing CSV file..."), tr("Cancel"), 0, 10000);
+    progressDialog.setWindowModality(Qt::ApplicationModal);
+    // Disable context help button on Windows
+    progressDialog.setWindowFlags(progressDialog.windowFlags() & ~Qt::WindowContextHelpButtonHint);
 
-        return true;
+    connect(&importer, &CsvImporter::progress, &progressDialog, [&progressDialog](qint64 pos, qint64 fileSize) {
+        progressDialog.setValue(static_cast<int>((static_cast<float>(pos) / static_cast<float>(fileSize)) * 10000.0f));
     });
+    connect(&progressDialog, &QProgressDialog::canceled, &importer, &CsvImporter::cancel);
 
-    // Success?
-    if(result != CSVParser::ParserResult::ParserResultSuccess)
-    {
-        // Some error occurred or the user cancelled the action
+    progressDialog.show();
+    const bool success = importer.import(fileName, tableName.toStdString(), fieldList);
+    progressDialog.hide();
 
-        // Rollback the entire import. If the action was cancelled, don't show an error message. If it errored, show an error message.
-        QString message;
-        if(result == CSVParser::ParserResult::ParserResultError)
+    if(!success)
+    {
+        // If the action was cancelled, don't show an error message
+        QApplication::restoreOverrideCursor();  // restore original cursor
+        if(!importer.errorMessage().isEmpty())
         {
-            QString error(sqlite3_errmsg(pDb.get()));
-            message = tr("Inserting row failed: %1").arg(error);
-        } else if(result == CSVParser::ParserResult::ParserResultUnexpectedEOF) {
-            message = tr("Unexpected end of file. Please make sure that you have configured the correct quote characters and "
-                         "the file is not malformed.");
+            QString sCSVInfo = tr("Error importing data");
+            if(importer.errorRow())
+                sCSVInfo += tr(" from record number %1").arg(importer.errorRow());
+            QString error = sCSVInfo + tr(".\n%1").arg(importer.errorMessage());
+            QMessageBox::warning(this, QApplication::applicationName(), error);
         }
-
-        sqlite3_finalize(stmt);
-        rollback(this, pdb, &pDb, restorepointName, lastRowNum, message);
         return false;
     }
 
-    // Clean up prepared statement
-    sqlite3_finalize(stmt);
+    // If we're creating the table in this import session, don't ask the user if it's okay to import more data into it. It seems
+    // safe to just assume that's what they want.
+    if(!importToExistingTable)
+        dontAskForExistingTableAgain.append(tableName);
 
 #ifdef CSV_BENCHMARK
+    const CsvImportPipeline::Timings timings = importer.timings();
     QMessageBox::information(this, qApp->applicationName(),
-                             tr("Importing the file '%1' took %2ms. Of this %3ms were spent in the row function.")
+                             tr("Importing the file '%1' took %2ms. Of this %3ms were spent parsing, %4ms converting and %5ms inserting the rows.")
                              .arg(fileName)
                              .arg(timer.elapsed())
-                             .arg(timesRowFunction));
+                             .arg(timings.parse)
+                             .arg(timings.convert)
+                             .arg(timings.insert));
+    if(ui->checkBulkLoad->isChecked())
+    {
+        const DBBrowserDB::BulkLoadTimings bulkLoadTimings = pdb->bulkLoadTimings();
+        QMessageBox::information(this, qApp->applicationName(),
+                                 tr("Creating %1 indexes again after loading the rows took %2ms.")
+                                 .arg(bulkLoadTimings.numIndices)
+                                 .arg(bulkLoadTimings.indices));
+    }
 #endif
 
     return true;
@@ -879,18 +614,7 @@ void ImportCsvDialog::toggleAdvancedSection(bool show)
     ui->checkIgnoreDefaults->setVisible(show);
     ui->labelOnConflictStrategy->setVisible(show);
     ui->comboOnConflictStrategy->setVisible(show);
+    ui->labelBulkLoad->setVisible(show);
+    ui->checkBulkLoad->setVisible(show);
 }
 
-char32_t ImportCsvDialog::toUtf8(const QString& s) const
-{
-    if(s.isEmpty())
-        return 0;
-
-    QByteArray ba = s.toUtf8();
-
-    char32_t result = 0;
-    for(QByteArray::size_type i=std::min(ba.size()-1,QByteArray::size_type(3));i>=0;i--)
-        result = (result << 8) + static_cast<unsigned char>(ba.at(i));
-
-    return result;
-}
@@ -1,7 +1,7 @@
 #ifndef IMPORTCSVDIALOG_H
 #define IMPORTCSVDIALOG_H
 
-#include "csvparser.h"
+#include "CsvImporter.h"
 #include "sql/sqlitetypes.h"
 
 #include <QDialog>
@@ -45,8 +45,10 @@ private:
     QCompleter* encodingCompleter;
     QStringList dontAskForExistingTableAgain;
 
+    CsvImporter::Options currentOptions() const;
+
     CSVParser::ParserResult parseCSV(const QString& fileName, std::function<bool(size_t, CSVRow)> rowFunction, size_t count = 0) const;
-    sqlb::FieldVector generateFieldList(const QString& filename) const;
+    sqlb::FieldVector generateFieldList(const QString& filename, std::vector<CsvImporter::ColumnStatistics>* statistics = nullptr) const;
 
     bool importCsv(const QString& f, const QString& n = QString());
 
@@ -60,10 +62,6 @@ private:
     QString currentEncoding() const;
 
     std::string currentOnConflictStrategy() const;
-
-    char32_t toUtf8(const QString& s) const;
-
-    static QChar getSettingsChar(const std::string& group, const std::string& name);
 };
 
 #endif
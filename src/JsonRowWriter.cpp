@@ -0,0 +1,148 @@
+#include "JsonRowWriter.h"
+#include "sqlite.h"
+
+#include <QIODevice>
+#include <QString>
+
+#include <json.hpp>
+
+#include <cstdio>
+#include <map>
+#include <string>
+
+using json = nlohmann::json;
+
+JsonRowWriter::JsonRowWriter(QIODevice& device, Style style)
+    : m_device(device),
+      m_style(style),
+      m_rows(0)
+{
+}
+
+void JsonRowWriter::setColumns(sqlite3_stmt* stmt)
+{
+    std::map<std::string, int> columns;
+    for(int i=0;i<sqlite3_column_count(stmt);++i)
+        columns[sqlite3_column_name(stmt, i)] = i;
+
+    m_keys.clear();
+    m_columns.clear();
+    for(const auto& it : columns)
+    {
+        m_keys.push_back(QByteArray::fromStdString(json(it.first).dump()));
+        m_columns.push_back(it.second);
+    }
+}
+
+bool JsonRowWriter::writeRow(sqlite3_stmt* stmt)
+{
+    m_buffer.clear();
+    if(m_style == Lines)
+    {
+        writeObject(stmt, "", "");
+        m_buffer += '\n';
+    } else if(m_style == Pretty) {
+        m_buffer += m_rows ? ",\n    " : "[\n    ";
+        writeObject(stmt, "\n        ", "\n    ");
+    } else {
+        m_buffer += m_rows ? ',' : '[';
+        writeObject(stmt, "", "");
+    }
+    m_rows++;
+
+    return m_device.write(m_buffer) == m_buffer.size();
+}
+
+bool JsonRowWriter::finish()
+{
+    QByteArray end;
+    if(m_style == Pretty)
+        end = m_rows ? "\n]" : "[]";
+    else if(m_style == Compact)
+        end = m_rows ? "]" : "[]";
+    return m_device.write(end) == end.size();
+}
+
+void JsonRowWriter::writeObject(sqlite3_stmt* stmt, const char* indent, const char* closing_indent)
+{
+    const char* separator = m_style == Pretty ? ": " : ":";
+
+    m_buffer += '{';
+    for(size_t k=0;k<m_columns.size();++k)
+    {
+        const int i = m_columns[k];
+
+        if(k)
+            m_buffer += ',';
+        m_buffer += indent;
+        m_buffer += m_keys[k];
+        m_buffer += separator;
+
+        switch(sqlite3_column_type(stmt, i))
+        {
+        case SQLITE_INTEGER:
+            m_buffer += QByteArray::number(sqlite3_column_int64(stmt, i));
+            break;
+        case SQLITE_FLOAT:
+            // Let the JSON library format floating point numbers, so they look exactly like they used to
+            m_buffer += QByteArray::fromStdString(json(sqlite3_column_double(stmt, i)).dump());
+            break;
+        case SQLITE_NULL:
+            m_buffer += "null";
+            break;
+        case SQLITE_TEXT:
+            writeString(reinterpret_cast<const char*>(sqlite3_column_text(stmt, i)), sqlite3_column_bytes(stmt, i));
+            break;
+        case SQLITE_BLOB: {
+            const QByteArray content = QByteArray::fromRawData(reinterpret_cast<const char*>(sqlite3_column_blob(stmt, i)),
+                                                               sqlite3_column_bytes(stmt, i));
+            m_buffer += '"';
+            m_buffer += content.toBase64(QByteArray::Base64Encoding);
+            m_buffer += '"';
+            break;
+        }
+        }
+    }
+    if(!m_columns.empty())
+        m_buffer += closing_indent;
+    m_buffer += '}';
+}
+
+void JsonRowWriter::writeString(const char* data, int size)
+{
+    // Text which isn't plain ASCII is passed through QString, which replaces any invalid UTF-8 sequences
+    QByteArray utf8 = QByteArray::fromRawData(data, size);
+    for(int i=0;i<size;++i)
+    {
+        if(static_cast<unsigned char>(data[i]) >= 0x80)
+        {
+            utf8 = QString::fromUtf8(data, size).toUtf8();
+            break;
+        }
+    }
+
+    m_buffer += '"';
+    for(const char c : utf8)
+    {
+        switch(c)
+        {
+        case '"': m_buffer += "\\\""; break;
+        case '\\': m_buffer += "\\\\"; break;
+        case '\b': m_buffer += "\\b"; break;
+        case '\f': m_buffer += "\\f"; break;
+        case '\n': m_buffer += "\\n"; break;
+        case '\r': m_buffer += "\\r"; break;
+        case '\t': m_buffer += "\\t"; break;
+        default:
+            if(static_cast<unsigned char>(c) < 0x20)
+            {
+                char escaped[7];
+                std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                m_buffer += escaped;
+            } else {
+                m_buffer += c;
+            }
+        }
+    }
+    m_buffer += '"';
+}
@@ -0,0 +1,49 @@
+#ifndef JSONROWWRITER_H
+#define JSONROWWRITER_H
+
+#include <QByteArray>
+
+#include <vector>
+
+class QIODevice;
+struct sqlite3_stmt;
+
+/*
+ * This class writes the rows of a query as JSON while stepping through them, so the document never needs to be held in memory. The
+ * output is the same nlohmann::json produces for an array of row objects: keys are in alphabetical order and, if a column name is used
+ * more than once, the last column of that name wins. Binary values are written as base64 strings.
+ */
+class JsonRowWriter
+{
+public:
+    enum Style
+    {
+        Compact,
+        Pretty,
+        Lines       // NDJSON: one compact object per line
+    };
+
+    JsonRowWriter(QIODevice& device, Style style);
+
+    // Use the column names of a statement as the keys of the objects. This needs to be called before writing any rows.
+    void setColumns(sqlite3_stmt* stmt);
+
+    // Append the values of the current row of a statement as an object. Returns false if writing to the device has failed.
+    bool writeRow(sqlite3_stmt* stmt);
+
+    // End the document. Returns false if writing to the device has failed.
+    bool finish();
+
+private:
+    QIODevice& m_device;
+    Style m_style;
+    size_t m_rows;
+    std::vector<QByteArray> m_keys;     // Quoted column names in output order
+    std::vector<int> m_columns;         // Column indices in output order
+    QByteArray m_buffer;
+
+    void writeObject(sqlite3_stmt* stmt, const char* indent, const char* closing_indent);
+    void writeString(const char* data, int size);
+};
+
+#endif
@@ -25,6 +25,7 @@
 #include "RunSql.h"
 #include "ExtendedTableWidget.h"
 #include "Data.h"
+#include "CompressedFile.h"
 #include "TableBrowser.h"
 #include "TableBrowserDock.h"
 
@@ -129,12 +130,16 @@ void MainWindow::init()
     dbStructureModel = new DbStructureModel(db, this,
                                             Settings::getValue("SchemaDock", "dropSelectQuery").toBool(),
                                             Settings::getValue("SchemaDock", "dropInsert").toBool());
-    connect(&db, &DBBrowserDB::structureUpdated, this, [this]() {
+    connect(&db, &DBBrowserDB::structureUpdated, this, [this](const SchemaChanges& changes) {
+        // Nothing to do if the schema is still the same
+        if(changes.empty())
+            return;
+
         std::vector<sqlb::ObjectIdentifier> old_tables;
         for(const auto& d : allTableBrowserDocks())
             old_tables.push_back(d->tableBrowser()->currentlyBrowsedTableName());
 
-        dbStructureModel->reloadData();
+        dbStructureModel->updateData(changes);
 
         populateStructure(old_tables);
     });
@@ -1549,6 +1554,7 @@ void MainWindow::importDatabaseFromSQL()
 {
     QStringList file_filter;
     file_filter << FILE_FILTER_SQL
+                << FILE_FILTER_SQL_COMPRESSED
                 << FILE_FILTER_TXT
                 << FILE_FILTER_ALL;
 
@@ -1563,6 +1569,15 @@ void MainWindow::importDatabaseFromSQL()
     if(!QFile::exists(fileName))
         return;
 
+    // Compressed files are decompressed while reading them. If the first part of a split file has been selected, all parts are read.
+    QString openError;
+    const std::unique_ptr<QIODevice> f = CompressedFileReader::openFile(fileName, openError);
+    if(!f)
+    {
+        QMessageBox::warning(this, QApplication::applicationName(), tr("Could not open the file '%1': %2").arg(fileName, openError));
+        return;
+    }
+
     // If there is already a database file opened ask the user whether to import into
     // this one or a new one. If no DB is opened just ask for a DB name directly
     QString newDbFile;
@@ -1596,22 +1611,61 @@ void MainWindow::importDatabaseFromSQL()
     QString foreignKeysOldSettings = db.getPragma("defer_foreign_keys");
     db.setPragma("defer_foreign_keys", "1");
 
-    // Open, read, execute and close file
+    // In bulk load mode, drop the indexes of all existing tables for now and create them again after the import. This needs its
+    // own savepoint, so the indexes can be restored when the import fails.
     QApplication::setOverrideCursor(Qt::WaitCursor);
-    QFile f(fileName);
-    f.open(QIODevice::ReadOnly);
-    QByteArray filedata = f.readAll();
-    removeBom(filedata);
-    bool ok = db.executeMultiSQL(filedata, newDbFile.size() == 0);
+    const bool bulkLoad = Settings::getValue("db", "bulkloadsqlimport").toBool();
+    std::string bulkLoadSavepoint;
+    if(bulkLoad)
+    {
+        std::vector<sqlb::ObjectIdentifier> tables;
+        for(const auto& it : db.schemata.at("main").tables)
+        {
+            if(!it.second->isView())
+                tables.emplace_back("main", it.first);
+        }
+
+        bulkLoadSavepoint = db.generateSavepointName("sqlimport");
+        if(!db.setSavepoint(bulkLoadSavepoint) || !db.beginBulkLoad(tables))
+        {
+            QApplication::restoreOverrideCursor();
+            QMessageBox::warning(this, QApplication::applicationName(), tr("Error importing data: %1").arg(db.lastError()));
+            db.revertToSavepoint(bulkLoadSavepoint);
+            db.endBulkLoad(false);
+            db.setPragma("defer_foreign_keys", foreignKeysOldSettings);
+            return;
+        }
+    }
+
+    // Execute the statements while reading them
+    bool ok = db.executeMultiSQL(*f, newDbFile.size() == 0);
+    QString error = db.lastError();
+    QString bulkLoadInfo;
+    if(bulkLoad)
+    {
+        ok = ok && db.endBulkLoad();
+        if(ok)
+        {
+            db.releaseSavepoint(bulkLoadSavepoint);
+
+            const DBBrowserDB::BulkLoadTimings timings = db.bulkLoadTimings();
+            bulkLoadInfo = tr("\nLoading the data took %1 ms, creating %2 indexes again took %3 ms.")
+                    .arg(timings.load).arg(timings.numIndices).arg(timings.indices);
+        } else {
+            error = db.lastError();
+            db.revertToSavepoint(bulkLoadSavepoint);
+            db.endBulkLoad(false);
+        }
+    }
     // Restore cursor before asking the user to accept the message
     QApplication::restoreOverrideCursor();
     if(!ok)
-        QMessageBox::warning(this, QApplication::applicationName(), tr("Error importing data: %1").arg(db.lastError()));
+        QMessageBox::warning(this, QApplication::applicationName(), tr("Error importing data: %1").arg(error));
     else if(db.getPragma("foreign_keys") == "1" && !db.querySingleValueFromDb("PRAGMA foreign_key_check").isNull())
-        QMessageBox::warning(this, QApplication::applicationName(), tr("Import completed. Some foreign key constraints are violated. Please fix them before saving."));
+        QMessageBox::warning(this, QApplication::applicationName(), tr("Import completed. Some foreign key constraints are violated. Please fix them before saving.") + bulkLoadInfo);
     else
-        QMessageBox::information(this, QApplication::applicationName(), tr("Import completed."));
-    f.close();
+        QMessageBox::information(this, QApplication::applicationName(), tr("Import completed.") + bulkLoadInfo);
+    f->close();
 
     // Restore the former foreign key settings
     db.setPragma("defer_foreign_keys", foreignKeysOldSettings);
@@ -2438,7 +2492,7 @@ void MainWindow::reloadSettings()
     db.loadExtensionsFromSettings();
 
     // Refresh view
-    emit db.structureUpdated();
+    emit db.structureUpdated(SchemaChanges());
     refreshTableBrowsers();
 
     // Hide or show the remote dock as needed
@@ -3683,6 +3737,10 @@ void MainWindow::printDbStructure ()
         for (int column = 0; column < columnCount; column++) {
             QModelIndex groupIndex = model->index(row, column, treeView->rootIndex());
 
+            // The objects and their fields are only loaded when they are needed
+            if (model->canFetchMore(groupIndex))
+                model->fetchMore(groupIndex);
+
             // A row for the object name
             for (int rowChild = 0; rowChild < model->rowCount(groupIndex); rowChild++) {
                 QModelIndex objectIndex = model->index(rowChild, column, groupIndex);
@@ -3700,6 +3758,8 @@ void MainWindow::printDbStructure ()
                 out << "</tr>";
 
                 // One row for each object's fields
+                if (model->canFetchMore(objectIndex))
+                    model->fetchMore(objectIndex);
                 for (int rowChild2 = 0; rowChild2 < model->rowCount(objectIndex); rowChild2++) {
                     out << "<tr>";
                     for (int column2 = 0; column2 < columnCount; column2++) {
@@ -853,7 +853,8 @@ void PlotDock::fetchAllData()
     timer.start();
 #endif
 
-        // Make sure all data is loaded
+        // Make sure all data is loaded and stays in the cache while plotting it
+        m_currentPlotModel->pinCache();
         m_currentPlotModel->completeCache();
 
 #ifdef LOAD_DATA_BENCHMARK
@@ -864,6 +865,7 @@ void PlotDock::fetchAllData()
 
         // Update plot
         updatePlot(m_currentPlotModel, m_currentTableSettings);
+        m_currentPlotModel->unpinCache();
     }
 }
 
@@ -91,6 +91,8 @@ void PreferencesDialog::loadSettings()
     ui->checkHideSchemaLinebreaks->setChecked(Settings::getValue("db", "hideschemalinebreaks").toBool());
     ui->foreignKeysCheckBox->setChecked(Settings::getValue("db", "foreignkeys").toBool());
     ui->spinPrefetchSize->setValue(Settings::getValue("db", "prefetchsize").toInt());
+    ui->spinCacheMemoryLimit->setValue(Settings::getValue("db", "cachememorylimit").toInt());
+    ui->checkBulkLoadSqlImport->setChecked(Settings::getValue("db", "bulkloadsqlimport").toBool());
     ui->editDatabaseDefaultSqlText->setText(Settings::getValue("db", "defaultsqltext").toString());
 
     ui->defaultFieldTypeComboBox->addItems(DBBrowserDB::Datatypes);
@@ -237,6 +239,8 @@ void PreferencesDialog::saveSettings(bool accept)
     Settings::setValue("db", "hideschemalinebreaks", ui->checkHideSchemaLinebreaks->isChecked());
     Settings::setValue("db", "foreignkeys", ui->foreignKeysCheckBox->isChecked());
     Settings::setValue("db", "prefetchsize", ui->spinPrefetchSize->value());
+    Settings::setValue("db", "cachememorylimit", ui->spinCacheMemoryLimit->value());
+    Settings::setValue("db", "bulkloadsqlimport", ui->checkBulkLoadSqlImport->isChecked());
     Settings::setValue("db", "defaultsqltext", ui->editDatabaseDefaultSqlText->text());
     Settings::setValue("db", "defaultfieldtype", ui->defaultFieldTypeComboBox->currentIndex());
     Settings::setValue("db", "fontsize", ui->spinStructureFontSize->value());
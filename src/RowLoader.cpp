@@ -4,6 +4,9 @@
 #include "RowLoader.h"
 #include "sqlite.h"
 
+#include <algorithm>
+#include <limits>
+
 namespace {
 
     QString rtrimChar(const QString& s, QChar c)
@@ -14,20 +17,142 @@ namespace {
         return r;
     }
 
+    // Binds the value to be tested by a format condition. Like the text shown in the cell, NULL values are tested as empty
+    // strings. Anything which looks like a number is compared as a number unless the condition compares to string literals.
+    void bindFormatValue(sqlite3_stmt* stmt, const RowLoader::Cache::Cell& cell, bool quoted)
+    {
+        switch(cell.kind)
+        {
+        case RowLoader::Cache::Cell::Null:
+            sqlite3_bind_text(stmt, 1, "", 0, SQLITE_STATIC);
+            return;
+        case RowLoader::Cache::Cell::Integer:
+            if(quoted)
+            {
+                const QByteArray text = QByteArray::number(cell.integer);
+                sqlite3_bind_text(stmt, 1, text.constData(), text.size(), SQLITE_TRANSIENT);
+            } else {
+                sqlite3_bind_int64(stmt, 1, cell.integer);
+            }
+            return;
+        case RowLoader::Cache::Cell::Real:
+            if(quoted)
+            {
+                const QByteArray text = RowLoader::Cache::Cell::formatReal(cell.real);
+                sqlite3_bind_text(stmt, 1, text.constData(), text.size(), SQLITE_TRANSIENT);
+            } else {
+                sqlite3_bind_double(stmt, 1, cell.real);
+            }
+            return;
+        case RowLoader::Cache::Cell::Bytes:
+            break;
+        }
+
+        if(!quoted)
+        {
+            const QByteArray text = QByteArray::fromRawData(cell.data, static_cast<int>(cell.size));
+            bool ok;
+            const qint64 integer = text.toLongLong(&ok);
+            if(ok)
+                return static_cast<void>(sqlite3_bind_int64(stmt, 1, integer));
+            const double real = text.toDouble(&ok);
+            if(ok)
+                return static_cast<void>(sqlite3_bind_double(stmt, 1, real));
+        }
+        sqlite3_bind_text(stmt, 1, cell.data, static_cast<int>(cell.size), SQLITE_STATIC);
+    }
+
 } // anon ns
 
 
+RowLoader::FormatEvaluator::FormatEvaluator (sqlite3* db, const FormatConditions& conditions)
+{
+    for(const auto& it : conditions)
+    {
+        std::vector<Condition>& column = columns[it.first];
+        for(const auto& condition : it.second)
+        {
+            Condition c;
+            c.stmt = nullptr;
+            c.any_value = condition.sql_condition.empty();
+            c.on_rowid = condition.on_rowid;
+            c.quoted = condition.sql_condition.find('\'') != std::string::npos;
+
+            // A condition which fails to compile never matches. It is kept nonetheless because the indices need to
+            // correspond to the formats.
+            if(!c.any_value)
+            {
+                const std::string sql = "SELECT ?1 " + condition.sql_condition;
+                if(sqlite3_prepare_v2(db, sql.c_str(), static_cast<int>(sql.size()), &c.stmt, nullptr) != SQLITE_OK)
+                {
+                    sqlite3_finalize(c.stmt);
+                    c.stmt = nullptr;
+                }
+            }
+
+            column.push_back(c);
+        }
+    }
+}
+
+RowLoader::FormatEvaluator::~FormatEvaluator ()
+{
+    for(const auto& it : columns)
+    {
+        for(const auto& c : it.second)
+            sqlite3_finalize(c.stmt);
+    }
+}
+
+std::vector<int> RowLoader::FormatEvaluator::evaluate (const Cache::CellRow& row) const
+{
+    std::vector<int> formats(row.size(), -1);
+    for(const auto& it : columns)
+    {
+        if(it.first >= row.size())
+            continue;
+
+        for(size_t i=0;i<it.second.size();i++)
+        {
+            const Condition& c = it.second[i];
+            bool match = c.any_value;
+            if(c.stmt)
+            {
+                bindFormatValue(c.stmt, row[c.on_rowid ? 0 : it.first], c.quoted);
+                if(sqlite3_step(c.stmt) == SQLITE_ROW)
+                {
+                    const unsigned char* result = sqlite3_column_text(c.stmt, 0);
+                    match = result && sqlite3_column_bytes(c.stmt, 0) == 1 && result[0] == '1';
+                }
+                sqlite3_reset(c.stmt);
+                sqlite3_clear_bindings(c.stmt);
+            }
+
+            if(match)
+            {
+                formats[it.first] = static_cast<int>(i);
+                break;
+            }
+        }
+    }
+
+    return formats;
+}
+
 RowLoader::RowLoader (std::function<std::shared_ptr<sqlite3>(void)> db_getter_,
+    std::function<std::shared_ptr<sqlite3>(void)> reader_getter_,
     std::function<void(QString)> statement_logger_,
     std::vector<std::string> & headers_,
     std::mutex & cache_mutex_,
     Cache & cache_data_
     )
-    : db_getter(db_getter_), statement_logger(statement_logger_)
+    : db_getter(db_getter_), reader_getter(reader_getter_), statement_logger(statement_logger_)
     , headers(headers_)
     , cache_mutex(cache_mutex_), cache_data(cache_data_)
     , query()
     , countQuery()
+    , keysetColumn(0)
+    , last_fetch_mode(FetchMode::Offset)
     , first_chunk_loaded(false)
     , num_tasks(0)
     , pDb(nullptr)
@@ -47,6 +172,134 @@ void RowLoader::setQuery (const QString& new_query, const QString& newCountQuery
         countQuery = QString("SELECT COUNT(*) FROM (%1);").arg(rtrimChar(query, ';'));
     else
         countQuery = newCountQuery;
+    estimateQueries.clear();
+    keyRangeQuery.clear();
+    rangeCountQuery.clear();
+
+    // Fall back to offset based pagination until told otherwise
+    keysetQuery.clear();
+    keysetAnchoredQuery.clear();
+    keysetAnchorQuery.clear();
+    keysetAnchoredAnchorQuery.clear();
+    keysetColumn = 0;
+    std::lock_guard<std::mutex> lk2(anchors_mutex);
+    anchors.clear();
+}
+
+void RowLoader::setKeysetQuery (const QString& rows_query, const QString& anchored_query,
+                                const QString& anchor_query, const QString& anchored_anchor_query, size_t key_column)
+{
+    std::lock_guard<std::mutex> lk(m);
+    keysetQuery = rows_query;
+    keysetAnchoredQuery = anchored_query;
+    keysetAnchorQuery = anchor_query;
+    keysetAnchoredAnchorQuery = anchored_anchor_query;
+    keysetColumn = key_column;
+}
+
+void RowLoader::setRowCountQueries (const QStringList& estimate_queries, const QString& key_range_query, const QString& range_count_query)
+{
+    std::lock_guard<std::mutex> lk(m);
+    estimateQueries = estimate_queries;
+    keyRangeQuery = key_range_query;
+    rangeCountQuery = range_count_query;
+}
+
+void RowLoader::setFormatConditions (const FormatConditions& conditions)
+{
+    std::lock_guard<std::mutex> lk(m);
+    formatConditions = conditions;
+}
+
+void RowLoader::triggerFormatEvaluation (int token, size_t row_begin, size_t row_end)
+{
+    std::unique_lock<std::mutex> lk(m);
+
+    // Extend an evaluation which has not been started yet instead of queueing another one
+    if(format_task && format_task->token == token)
+    {
+        format_task->row_begin = std::min(format_task->row_begin, row_begin);
+        format_task->row_end = std::max(format_task->row_end, row_end);
+        return;
+    }
+
+    nosync_ensureDbAccess();
+    format_task.reset(new Task{ *this, token, row_begin, row_end, false, true });
+
+    lk.unlock();
+    cv.notify_all();
+}
+
+void RowLoader::resetKeysetAnchors ()
+{
+    std::lock_guard<std::mutex> lk(anchors_mutex);
+    anchors.clear();
+}
+
+RowLoader::FetchMode RowLoader::lastFetchMode () const
+{
+    return last_fetch_mode;
+}
+
+void RowLoader::recordAnchor (size_t row, sqlite3_stmt* stmt, int column)
+{
+    Anchor anchor;
+    anchor.type = sqlite3_column_type(stmt, column);
+    anchor.int_value = 0;
+    anchor.float_value = 0.0;
+
+    // Keep numbers in their binary representation. Converting floating point values to text and back is not guaranteed to be
+    // lossless and a slightly off anchor would make us skip or repeat rows.
+    switch(anchor.type)
+    {
+    case SQLITE_INTEGER:
+        anchor.int_value = sqlite3_column_int64(stmt, column);
+        break;
+    case SQLITE_FLOAT:
+        anchor.float_value = sqlite3_column_double(stmt, column);
+        break;
+    case SQLITE_NULL:
+        // The key column is supposed to be NOT NULL. If it is not, there is no way to seek to this row.
+        return;
+    default:
+        anchor.value = QByteArray(static_cast<const char*>(sqlite3_column_blob(stmt, column)), sqlite3_column_bytes(stmt, column));
+    }
+
+    std::lock_guard<std::mutex> lk(anchors_mutex);
+    anchors[row] = std::move(anchor);
+}
+
+bool RowLoader::findAnchor (size_t row, size_t& anchor_row, Anchor& anchor) const
+{
+    std::lock_guard<std::mutex> lk(anchors_mutex);
+
+    // Find the last anchor at or before the requested row
+    auto it = anchors.upper_bound(row);
+    if(it == anchors.begin())
+        return false;
+    --it;
+
+    anchor_row = it->first;
+    anchor = it->second;
+    return true;
+}
+
+void RowLoader::bindAnchor (sqlite3_stmt* stmt, const Anchor& anchor)
+{
+    switch(anchor.type)
+    {
+    case SQLITE_INTEGER:
+        sqlite3_bind_int64(stmt, 1, anchor.int_value);
+        break;
+    case SQLITE_FLOAT:
+        sqlite3_bind_double(stmt, 1, anchor.float_value);
+        break;
+    case SQLITE_BLOB:
+        sqlite3_bind_blob(stmt, 1, anchor.value.constData(), anchor.value.size(), SQLITE_TRANSIENT);
+        break;
+    default:
+        sqlite3_bind_text(stmt, 1, anchor.value.constData(), anchor.value.size(), SQLITE_TRANSIENT);
+    }
 }
 
 void RowLoader::triggerRowCountDetermination(int token)
@@ -56,13 +309,24 @@ void RowLoader::triggerRowCountDetermination(int token)
     num_tasks++;
     nosync_ensureDbAccess();
 
-    // do a count query to get the full row count in a fast manner
-    row_counter = std::async(std::launch::async, [this, token]() {
-        auto nrows = countRows();
+    // Count on the connections reserved for this if there are any, so reading rows doesn't have to wait for the count
+    std::vector<std::shared_ptr<sqlite3>> dbs = count_dbs;
+    if(dbs.empty())
+        dbs.push_back(pDb);
+
+    // do a count query to get the full row count in a fast manner. Because this can still take a long time for big tables,
+    // start with a quick estimate.
+    row_counter = std::async(std::launch::async, [this, token, dbs]() {
+        auto estimate = estimateRows(dbs.front().get());
+        if(estimate >= 0)
+            emit rowCountEstimated(token, estimate);
+
+        auto nrows = countRows(dbs);
         if(nrows >= 0)
             emit rowCountComplete(token, nrows);
 
         std::lock_guard<std::mutex> lk2(m);
+        count_dbs.clear();
         nosync_taskDone();
     });
 }
@@ -79,7 +343,166 @@ std::shared_ptr<sqlite3> RowLoader::getDb () const
     return pDb;
 }
 
-int RowLoader::countRows() const
+int RowLoader::estimateRows(sqlite3* db)
+{
+    for(const QString& estimateQuery : estimateQueries)
+    {
+        statement_logger(estimateQuery);
+        QByteArray utf8Query = estimateQuery.toUtf8();
+
+        // Not every estimate is possible for every database, e.g. there are no statistics before running ANALYZE. So just
+        // try the next one on errors.
+        qint64 estimate = -1;
+        sqlite3_stmt* stmt;
+        if(sqlite3_prepare_v2(db, utf8Query, utf8Query.size(), &stmt, nullptr) == SQLITE_OK)
+        {
+            if(sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_type(stmt, 0) != SQLITE_NULL)
+                estimate = sqlite3_column_int64(stmt, 0);
+            sqlite3_finalize(stmt);
+        }
+
+        if(estimate >= 0)
+            return static_cast<int>(std::min<qint64>(estimate, std::numeric_limits<int>::max()));
+    }
+
+    return -1;
+}
+
+int RowLoader::countRows(const std::vector<std::shared_ptr<sqlite3>>& dbs)
+{
+    int retval = -1;
+    if(dbs.size() > 1 && !rangeCountQuery.isEmpty() && countRowsInRanges(dbs, retval))
+        return retval;
+
+    return countRows(dbs.front().get());
+}
+
+bool RowLoader::countRowsInRanges(const std::vector<std::shared_ptr<sqlite3>>& dbs, int& count)
+{
+    count = -1;
+
+    // Get the smallest and the largest key. This only needs to look at both ends of the table or index.
+    statement_logger(keyRangeQuery);
+    QByteArray utf8Query = keyRangeQuery.toUtf8();
+    sqlite3_stmt* stmt;
+    if(sqlite3_prepare_v2(dbs.front().get(), utf8Query, utf8Query.size(), &stmt, nullptr) != SQLITE_OK)
+        return false;
+
+    int result = sqlite3_step(stmt);
+    if(result == SQLITE_INTERRUPT)
+    {
+        sqlite3_finalize(stmt);
+        return true;
+    }
+
+    // Only integer keys can be split into ranges easily. No keys at all means an empty table.
+    bool splittable = false;
+    qint64 min_key = 0;
+    qint64 max_key = 0;
+    if(result == SQLITE_ROW)
+    {
+        if(sqlite3_column_type(stmt, 0) == SQLITE_NULL && sqlite3_column_type(stmt, 1) == SQLITE_NULL)
+        {
+            sqlite3_finalize(stmt);
+            count = 0;
+            return true;
+        }
+
+        splittable = sqlite3_column_type(stmt, 0) == SQLITE_INTEGER && sqlite3_column_type(stmt, 1) == SQLITE_INTEGER;
+        min_key = sqlite3_column_int64(stmt, 0);
+        max_key = sqlite3_column_int64(stmt, 1);
+    }
+    sqlite3_finalize(stmt);
+    if(!splittable)
+        return false;
+
+    // Split the keys into ranges of equal width, one per connection, and count them at the same time. Calculate with unsigned
+    // numbers because the distance between two 64 bit keys might not fit into a signed 64 bit integer.
+    const quint64 span = static_cast<quint64>(max_key) - static_cast<quint64>(min_key);
+    const quint64 width = span / dbs.size() + 1;
+    const double last_range_end = static_cast<double>(max_key) + 1.0;
+
+    statement_logger(rangeCountQuery);
+    const QByteArray utf8RangeQuery = rangeCountQuery.toUtf8();
+    std::vector<std::future<qint64>> counters;
+    for(quint64 offset=0;;offset+=width)
+    {
+        const qint64 range_begin = static_cast<qint64>(static_cast<quint64>(min_key) + offset);
+        const qint64 range_end = static_cast<qint64>(static_cast<quint64>(range_begin) + width);
+        const bool last = width > span - offset;
+        sqlite3* db = dbs.at(counters.size()).get();
+
+        counters.push_back(std::async(std::launch::async, [db, utf8RangeQuery, range_begin, range_end, last, last_range_end]() -> qint64 {
+            sqlite3_stmt* range_stmt;
+            if(sqlite3_prepare_v2(db, utf8RangeQuery, utf8RangeQuery.size(), &range_stmt, nullptr) != SQLITE_OK)
+                return -1;
+
+            // The end of the last range is bound as a REAL value. It can't overflow this way and non-integer keys
+            // above the largest integer key are included.
+            sqlite3_bind_int64(range_stmt, 1, range_begin);
+            if(last)
+                sqlite3_bind_double(range_stmt, 2, last_range_end);
+            else
+                sqlite3_bind_int64(range_stmt, 2, range_end);
+
+            qint64 range_count = -1;
+            if(sqlite3_step(range_stmt) == SQLITE_ROW)
+                range_count = sqlite3_column_int64(range_stmt, 0);
+            sqlite3_finalize(range_stmt);
+            return range_count;
+        }));
+
+        if(last)
+            break;
+    }
+
+    qint64 total = 0;
+    for(auto& counter : counters)
+    {
+        const qint64 range_count = counter.get();
+        if(range_count < 0)
+            total = -1;
+        else if(total >= 0)
+            total += range_count;
+    }
+
+    if(total >= 0)
+        count = static_cast<int>(std::min<qint64>(total, std::numeric_limits<int>::max()));
+    return true;
+}
+
+void RowLoader::collectAnchors(Task& t, const QString& anchor_query, const QString& anchored_anchor_query)
+{
+    size_t row = 0;
+    Anchor anchor;
+    const bool anchored = findAnchor(t.row_begin, row, anchor);
+    if(t.row_begin - row < keyset_anchor_stride)
+        return;
+
+    // Only walk up to the first row of the task. The anchored query starts with the anchor itself.
+    const QString sql = (anchored ? anchored_anchor_query : anchor_query) + QString(" LIMIT %1;").arg(t.row_begin - row + 1);
+    statement_logger(sql);
+    QByteArray utf8Query = sql.toUtf8();
+
+    sqlite3_stmt* stmt;
+    if(sqlite3_prepare_v2(pDb.get(), utf8Query, utf8Query.size(), &stmt, nullptr) != SQLITE_OK)
+    {
+        qWarning() << "Keyset anchor query failed: " << sql;
+        return;
+    }
+
+    if(anchored)
+        bindAnchor(stmt, anchor);
+    while(!t.cancel && sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        if(row % keyset_anchor_stride == 0)
+            recordAnchor(row, stmt, 0);
+        row++;
+    }
+    sqlite3_finalize(stmt);
+}
+
+int RowLoader::countRows(sqlite3* db)
 {
     int retval = -1;
 
@@ -89,7 +512,7 @@ int RowLoader::countRows() const
         // So just execute the statement as it is and fetch all results counting the rows
         sqlite3_stmt* stmt;
         QByteArray utf8Query = query.toUtf8();
-        if(sqlite3_prepare_v2(pDb.get(), utf8Query, utf8Query.size(), &stmt, nullptr) == SQLITE_OK)
+        if(sqlite3_prepare_v2(db, utf8Query, utf8Query.size(), &stmt, nullptr) == SQLITE_OK)
         {
             retval = 0;
             while(sqlite3_step(stmt) == SQLITE_ROW)
@@ -102,7 +525,7 @@ int RowLoader::countRows() const
         QByteArray utf8Query = countQuery.toUtf8();
 
         sqlite3_stmt* stmt;
-        if(sqlite3_prepare_v2(pDb.get(), utf8Query, utf8Query.size(), &stmt, nullptr) == SQLITE_OK)
+        if(sqlite3_prepare_v2(db, utf8Query, utf8Query.size(), &stmt, nullptr) == SQLITE_OK)
         {
             if(sqlite3_step(stmt) == SQLITE_ROW)
                 retval = sqlite3_column_int(stmt, 0);
@@ -119,18 +542,40 @@ void RowLoader::triggerFetch (int token, size_t row_begin, size_t row_end)
 {
     std::unique_lock<std::mutex> lk(m);
 
-    if(pDb) {
-        if(!row_counter.valid() || row_counter.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
-            // only if row count is complete, we can safely interrupt SQLite to speed up cancellation
-            sqlite3_interrupt(pDb.get());
-        }
+    // Rows which are being read right now do not need to be requested again
+    if(current_task && !current_task->cancel && !current_task->formats_only && current_task->token == token &&
+            current_task->row_begin <= row_begin && row_end <= current_task->row_end)
+    {
+        next_task = nullptr;
+        return;
     }
 
-    if(current_task)
-        current_task->cancel = true;
+    // Only cancel what is not going to be needed soon. When scrolling quickly, cancelling every chunk as soon as the
+    // next one is requested means that no chunk ever finishes loading.
+    if(current_task && !isNear(*current_task, row_begin, row_end))
+        nosync_cancelCurrentTask();
+
+    auto it = std::remove_if(prefetch_tasks.begin(), prefetch_tasks.end(), [row_begin, row_end](const std::unique_ptr<Task>& t) {
+        return !isNear(*t, row_begin, row_end);
+    });
+    prefetch_tasks.erase(it, prefetch_tasks.end());
 
     nosync_ensureDbAccess();
 
+    // Counting the rows starts along with reading the first chunk of a query. Reserve separate connections for this here in
+    // the main thread, so reading rows doesn't have to wait for the count.
+    if(!first_chunk_loaded && count_dbs.empty())
+    {
+        const size_t wanted = rangeCountQuery.isEmpty() ? 1 : max_count_connections;
+        while(count_dbs.size() < wanted)
+        {
+            auto db = reader_getter();
+            if(!db)
+                break;
+            count_dbs.push_back(db);
+        }
+    }
+
     // (forget a possibly already existing "next task")
     next_task.reset(new Task{ *this, token, row_begin, row_end });
 
@@ -138,10 +583,63 @@ void RowLoader::triggerFetch (int token, size_t row_begin, size_t row_end)
     cv.notify_all();
 }
 
+void RowLoader::triggerPrefetch (int token, size_t row_begin, size_t row_end)
+{
+    std::unique_lock<std::mutex> lk(m);
+
+    // Don't queue anything which is already going to be read
+    auto covers = [token, row_begin, row_end](const std::unique_ptr<Task>& t) {
+        return t && !t->formats_only && t->token == token && t->row_begin <= row_begin && row_end <= t->row_end;
+    };
+    if(covers(current_task) || covers(next_task) || std::any_of(prefetch_tasks.begin(), prefetch_tasks.end(), covers))
+        return;
+
+    // Newer predictions are more accurate than older ones
+    if(prefetch_tasks.size() >= max_prefetch_tasks)
+        prefetch_tasks.pop_front();
+
+    nosync_ensureDbAccess();
+    prefetch_tasks.emplace_back(new Task{ *this, token, row_begin, row_end, true });
+
+    lk.unlock();
+    cv.notify_all();
+}
+
+void RowLoader::cancelPrefetch ()
+{
+    std::unique_lock<std::mutex> lk(m);
+
+    prefetch_tasks.clear();
+    if(current_task && current_task->speculative)
+        nosync_cancelCurrentTask();
+
+    cv.wait(lk, [this](){ return !current_task || !current_task->speculative; });
+}
+
+bool RowLoader::isNear (const Task & t, size_t row_begin, size_t row_end)
+{
+    // Near means that there is a gap of at most the size of the requested range between the two ranges
+    const size_t distance = row_end - row_begin;
+    return t.row_begin <= row_end + distance && row_begin <= t.row_end + distance;
+}
+
+void RowLoader::nosync_cancelCurrentTask()
+{
+    if(pDb) {
+        if(!count_dbs.empty() || !row_counter.valid() || row_counter.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+            // only if row count is complete or uses other connections, we can safely interrupt SQLite to speed up cancellation
+            sqlite3_interrupt(pDb.get());
+        }
+    }
+
+    current_task->cancel = true;
+}
+
 void RowLoader::nosync_taskDone()
 {
     if(--num_tasks == 0) {
         pDb = nullptr;
+        count_dbs.clear();
     }
 }
 
@@ -151,11 +649,15 @@ void RowLoader::cancel ()
 
     if(pDb)
         sqlite3_interrupt(pDb.get());
+    for(const auto& db : count_dbs)
+        sqlite3_interrupt(db.get());
 
     if(current_task)
         current_task->cancel = true;
 
     next_task = nullptr;
+    prefetch_tasks.clear();
+    format_task = nullptr;
     cv.notify_all();
 }
 
@@ -178,7 +680,7 @@ void RowLoader::waitUntilIdle () const
     if(row_counter.valid())
         row_counter.wait();
     std::unique_lock<std::mutex> lk(m);
-    cv.wait(lk, [this](){ return stop_requested || (!current_task && !next_task); });
+    cv.wait(lk, [this](){ return stop_requested || (!current_task && !next_task && !format_task && prefetch_tasks.empty()); });
 }
 
 void RowLoader::run ()
@@ -189,22 +691,104 @@ void RowLoader::run ()
         current_task = nullptr;
         cv.notify_all();
 
-        cv.wait(lk, [this](){ return stop_requested || next_task; });
+        cv.wait(lk, [this](){ return stop_requested || next_task || format_task || !prefetch_tasks.empty(); });
 
         if(stop_requested)
             return;
 
-        current_task = std::move(next_task);
+        // Requested rows always take precedence over updating the formats of rows which are already there, which in turn
+        // takes precedence over speculatively prefetched rows
+        if(next_task)
+        {
+            current_task = std::move(next_task);
+        } else if(format_task) {
+            current_task = std::move(format_task);
+        } else {
+            current_task = std::move(prefetch_tasks.front());
+            prefetch_tasks.pop_front();
+        }
         lk.unlock();
 
-        process(*current_task);
+        if(current_task->formats_only)
+            processFormats(*current_task);
+        else
+            process(*current_task);
     }
 }
 
+void RowLoader::processFormats (Task & t)
+{
+    FormatConditions conditions;
+    {
+        std::lock_guard<std::mutex> lk(m);
+        conditions = formatConditions;
+    }
+
+    FormatEvaluator evaluator(pDb.get(), conditions);
+
+    std::vector<QByteArray> values;
+    Cache::CellRow rowdata;
+    for(size_t row=t.row_begin;row<t.row_end && !t.cancel;row++)
+    {
+        // Copy the values because the cache must not be locked while evaluating
+        {
+            std::lock_guard<std::mutex> cache_lock(cache_mutex);
+            if(!cache_data.count(row))
+                continue;
+            const auto cached_row = cache_data.at(row);
+            values.resize(cached_row.size());
+            for(size_t i=0;i<cached_row.size();i++)
+                values[i] = cached_row.at(i);
+        }
+
+        rowdata.resize(values.size());
+        for(size_t i=0;i<values.size();i++)
+            rowdata[i] = Cache::Cell::fromByteArray(values[i]);
+        const auto formats = evaluator.evaluate(rowdata);
+
+        std::lock_guard<std::mutex> cache_lock(cache_mutex);
+        cache_data.setFormats(row, formats);
+    }
+
+    emit formatsEvaluated(t.token, t.row_begin, t.row_end);
+}
+
 void RowLoader::process (Task & t)
 {
+    // Copy the queries and formats because the main thread may replace them while we are reading
+    QString rows_query;
+    QString anchored_query;
+    QString anchor_query;
+    QString anchored_anchor_query;
+    size_t key_column;
+    FormatConditions conditions;
+    {
+        std::lock_guard<std::mutex> lk(m);
+        rows_query = keysetQuery;
+        anchored_query = keysetAnchoredQuery;
+        anchor_query = keysetAnchorQuery;
+        anchored_anchor_query = keysetAnchoredAnchorQuery;
+        key_column = keysetColumn;
+        conditions = formatConditions;
+    }
+
     QString sLimitQuery;
-    if(query.startsWith("PRAGMA", Qt::CaseInsensitive) || query.startsWith("EXPLAIN", Qt::CaseInsensitive) ||
+    size_t anchor_row = 0;
+    Anchor anchor;
+    bool anchored = false;
+    const bool keyset = !rows_query.isEmpty();
+    if(keyset)
+    {
+        // Keyset pagination: start reading at the closest known key value before the first requested row and only skip the few
+        // rows in between. When that key value is far away, walk through the key values up to the requested row first, which is
+        // cheaper than skipping whole rows and leaves anchors behind for jumping there again. If we do not know the key values
+        // (because the anchor query fails or the task is cancelled), we have to skip rows from the start of the result set, just
+        // like in offset mode.
+        if(!anchor_query.isEmpty())
+            collectAnchors(t, anchor_query, anchored_anchor_query);
+        anchored = findAnchor(t.row_begin, anchor_row, anchor);
+        sLimitQuery = (anchored ? anchored_query : rows_query) + QString(" LIMIT %1 OFFSET %2;").arg(t.row_end-t.row_begin).arg(t.row_begin-anchor_row);
+    } else if(query.startsWith("PRAGMA", Qt::CaseInsensitive) || query.startsWith("EXPLAIN", Qt::CaseInsensitive) ||
         // With RETURNING keyword DELETE,INSERT,UPDATE can return rows
         // https://www.sqlite.org/lang_returning.html
         query.startsWith("DELETE", Qt::CaseInsensitive) || query.startsWith("INSERT", Qt::CaseInsensitive) ||
@@ -228,33 +812,72 @@ void RowLoader::process (Task & t)
         else
             sLimitQuery = queryTemp + QString(" LIMIT %1 OFFSET %2;").arg(t.row_end-t.row_begin).arg(t.row_begin);
     }
+    last_fetch_mode = anchored ? FetchMode::Keyset : FetchMode::Offset;
     statement_logger(sLimitQuery);
 
+    // Evaluate the conditional formats right away while reading the rows, so showing them doesn't need any database access
+    const FormatEvaluator evaluator(pDb.get(), conditions);
+
     QByteArray utf8Query = sLimitQuery.toUtf8();
     sqlite3_stmt *stmt;
     auto row = t.row_begin;
     if(sqlite3_prepare_v2(pDb.get(), utf8Query, utf8Query.size(), &stmt, nullptr) == SQLITE_OK)
     {
+        if(anchored)
+            bindAnchor(stmt, anchor);
+
+        // The cells only point to the values inside the statement, they are copied into the cache's arenas. So the same row object
+        // can be reused for all rows without allocating any memory per cell.
+        Cache::CellRow rowdata;
         while(!t.cancel && sqlite3_step(stmt) == SQLITE_ROW)
         {
             size_t num_columns = static_cast<size_t>(sqlite3_data_count(stmt));
 
-            // Construct a new row object with the right number of columns
-            Cache::value_type rowdata(num_columns);
+            if(keyset && row % keyset_anchor_stride == 0 && key_column < num_columns)
+                recordAnchor(row, stmt, static_cast<int>(key_column));
+
+            rowdata.resize(num_columns);
             for(size_t i=0;i<num_columns;++i)
             {
-                // No need to do anything for NULL values because we can just use the already default constructed value
-                if(sqlite3_column_type(stmt, static_cast<int>(i)) != SQLITE_NULL)
+                switch(sqlite3_column_type(stmt, static_cast<int>(i)))
                 {
-                    int bytes = sqlite3_column_bytes(stmt, static_cast<int>(i));
-                    if(bytes)
-                        rowdata[i] = QByteArray(static_cast<const char*>(sqlite3_column_blob(stmt, static_cast<int>(i))), bytes);
+                case SQLITE_NULL:
+                    rowdata[i] = Cache::Cell::null();
+                    break;
+                case SQLITE_INTEGER:
+                    rowdata[i] = Cache::Cell::fromInteger(sqlite3_column_int64(stmt, static_cast<int>(i)));
+                    break;
+                case SQLITE_FLOAT:
+                {
+                    // Keep the text SQLite produces for REAL values unless we would show them in the same way anyway
+                    const double real = sqlite3_column_double(stmt, static_cast<int>(i));
+                    const char* text = reinterpret_cast<const char*>(sqlite3_column_text(stmt, static_cast<int>(i)));
+                    const int bytes = sqlite3_column_bytes(stmt, static_cast<int>(i));
+                    if(Cache::Cell::formatReal(real) == QByteArray::fromRawData(text, bytes))
+                        rowdata[i] = Cache::Cell::fromReal(real);
                     else
-                        rowdata[i] = "";
+                        rowdata[i] = Cache::Cell::fromBytes(text, static_cast<size_t>(bytes));
+                    break;
+                }
+                default:
+                {
+                    // Text and BLOB values
+                    const char* data = static_cast<const char*>(sqlite3_column_blob(stmt, static_cast<int>(i)));
+                    int bytes = sqlite3_column_bytes(stmt, static_cast<int>(i));
+                    rowdata[i] = Cache::Cell::fromBytes(data, static_cast<size_t>(bytes));
+                    break;
+                }
                 }
             }
-            std::lock_guard<std::mutex> lk(cache_mutex);
-            cache_data.set(row++, std::move(rowdata));
+            std::vector<int> formats;
+            if(!conditions.empty())
+                formats = evaluator.evaluate(rowdata);
+
+            std::lock_guard<std::mutex> cache_lock(cache_mutex);
+            cache_data.set(row, rowdata);
+            if(!conditions.empty())
+                cache_data.setFormats(row, formats);
+            row++;
         }
 
         sqlite3_finalize(stmt);
@@ -267,9 +890,14 @@ void RowLoader::process (Task & t)
         {
             first_chunk_loaded = true;
             if(row == t.row_end)
+            {
                 triggerRowCountDetermination(t.token);
-            else
+            } else {
                 emit rowCountComplete(t.token, static_cast<int>(row-t.row_begin));
+
+                std::lock_guard<std::mutex> lk(m);
+                count_dbs.clear();
+            }
         }
     }
 
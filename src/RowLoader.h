@@ -2,19 +2,23 @@
 #define ROW_LOADER_H
 
 #include <condition_variable>
+#include <deque>
 #include <mutex>
 #include <atomic>
 #include <memory>
 #include <future>
 #include <functional>
+#include <map>
 #include <vector>
 
 #include <QThread>
 #include <QString>
+#include <QStringList>
 
-#include "RowCache.h"
+#include "ColumnarRowCache.h"
 
 struct sqlite3;
+struct sqlite3_stmt;
 
 class RowLoader : public QThread
 {
@@ -23,11 +27,54 @@ class RowLoader : public QThread
     void run() override;
 
 public:
-    using Cache = RowCache<std::vector<QByteArray>>;
+    using Cache = ColumnarRowCache;
 
-    /// set up worker thread to handle row loading
+    /// condition of a conditional format, as produced by
+    /// CondFormat::sqlCondition()
+    struct FormatCondition
+    {
+        std::string sql_condition;  //< empty for formats applying to any value
+        bool on_rowid;              //< test the value of the rowid column instead of the formatted column's
+    };
+
+    /// maps column numbers to the conditions of their formats, in the
+    /// order in which they take precedence
+    using FormatConditions = std::map<size_t, std::vector<FormatCondition>>;
+
+    /// evaluates the format conditions for rows, using statements which
+    /// are prepared only once on the specified database
+    class FormatEvaluator
+    {
+    public:
+        FormatEvaluator (sqlite3* db, const FormatConditions& conditions);
+        ~FormatEvaluator ();
+
+        FormatEvaluator (const FormatEvaluator&) = delete;
+        FormatEvaluator& operator= (const FormatEvaluator&) = delete;
+
+        /// \returns index of the first matching condition for each
+        /// column of the row, -1 if none matches
+        std::vector<int> evaluate (const Cache::CellRow& row) const;
+
+    private:
+        struct Condition
+        {
+            sqlite3_stmt* stmt;     //< nullptr if applying to any value or if the condition is invalid
+            bool any_value;
+            bool on_rowid;
+            bool quoted;            //< condition contains string literals, so values are never compared as numbers
+        };
+
+        std::map<size_t, std::vector<Condition>> columns;
+    };
+
+    /// set up worker thread to handle row loading. \param
+    /// reader_getter returns an additional read-only connection, or
+    /// nullptr if there is none available; these are used for counting
+    /// rows without blocking the reading of rows.
     explicit RowLoader (
         std::function<std::shared_ptr<sqlite3>(void)> db_getter,
+        std::function<std::shared_ptr<sqlite3>(void)> reader_getter,
         std::function<void(QString)> statement_logger,
         std::vector<std::string> & headers,
         std::mutex & cache_mutex,
@@ -36,6 +83,50 @@ public:
 
     void setQuery (const QString& new_query, const QString& newCountQuery = QString());
 
+    /// switch the current query to keyset pagination. \param rows_query
+    /// and \param anchored_query are the results of
+    /// sqlb::Query::buildKeysetQuery() without and with anchoring,
+    /// \param anchor_query and \param anchored_anchor_query those of
+    /// sqlb::Query::buildKeysetAnchorQuery(), and \param key_column is
+    /// the index of the key column in the rows returned by the first
+    /// two queries. must be called after setQuery(), which resets to
+    /// offset pagination.
+    void setKeysetQuery (const QString& rows_query, const QString& anchored_query,
+                         const QString& anchor_query, const QString& anchored_anchor_query, size_t key_column);
+
+    /// help determining the row count of the current query.
+    /// \param estimate_queries each return an approximate row count
+    /// and are tried in order until one yields a result. \param
+    /// key_range_query and \param range_count_query are the results of
+    /// sqlb::Query::buildKeyRangeQuery() and buildRangeCountQuery()
+    /// which allow counting the rows in parallel. must be called after
+    /// setQuery(), which resets these.
+    void setRowCountQueries (const QStringList& estimate_queries, const QString& key_range_query, const QString& range_count_query);
+
+    /// set the conditional formats which are evaluated for every row
+    /// being read. the indices of the matching formats are stored in
+    /// the cache.
+    void setFormatConditions (const FormatConditions& conditions);
+
+    /// trigger asynchronous evaluation of the conditional formats for
+    /// the rows of the specified range which are in the cache, e.g.
+    /// after the formats have changed. \param token is returned through
+    /// the 'formatsEvaluated' signal.
+    void triggerFormatEvaluation (int token, size_t row_begin, size_t row_end);
+
+    /// forget all known row number to key value mappings. to be
+    /// called when rows are inserted, deleted or their key changed.
+    void resetKeysetAnchors ();
+
+    enum class FetchMode
+    {
+        Offset,   //< chunk was read using LIMIT/OFFSET from the start of the result set
+        Keyset    //< chunk was read starting from a known key value
+    };
+
+    /// how was the most recently fetched chunk read?
+    FetchMode lastFetchMode () const;
+
     void triggerRowCountDetermination (int token);
 
     /// trigger asynchronous reading of specified row range,
@@ -46,6 +137,16 @@ public:
     /// 'fetched' signal may be for a narrower row range.
     void triggerFetch (int token, size_t row_begin, size_t row_end);
 
+    /// queue speculative reading of specified row range at low
+    /// priority, i.e. it is only read while no rows are requested
+    /// through triggerFetch(). speculative tasks are dropped again
+    /// when rows far away from them are requested.
+    void triggerPrefetch (int token, size_t row_begin, size_t row_end);
+
+    /// drop all speculative tasks and wait until a speculative task
+    /// which is already running has stopped
+    void cancelPrefetch ();
+
     /// cancel everything
     void cancel ();
 
@@ -64,10 +165,13 @@ public:
 
 signals:
     void fetched(int token, size_t row_begin, size_t row_end);
+    void rowCountEstimated(int token, int num_rows);
     void rowCountComplete(int token, int num_rows);
+    void formatsEvaluated(int token, size_t row_begin, size_t row_end);
 
 private:
     const std::function<std::shared_ptr<sqlite3>()> db_getter;
+    const std::function<std::shared_ptr<sqlite3>()> reader_getter;
     const std::function<void(QString)> statement_logger;
     std::vector<std::string> & headers;
     std::mutex & cache_mutex;
@@ -78,13 +182,48 @@ private:
 
     QString query;
     QString countQuery;
+    FormatConditions formatConditions;
+    QStringList estimateQueries;
+    QString keyRangeQuery;
+    QString rangeCountQuery;
+
+    /// keyset pagination: enabled if keysetQuery is not empty. the
+    /// anchors map row numbers to the key values in these rows. they
+    /// are collected every keyset_anchor_stride rows while reading
+    /// chunks and, before reading a chunk far away from any known
+    /// anchor, while walking the key values up to that chunk. so
+    /// any row can be reached by skipping less than that number of
+    /// rows from some anchor.
+    struct Anchor
+    {
+        int type;
+        qint64 int_value;
+        double float_value;
+        QByteArray value;
+    };
+
+    static constexpr size_t keyset_anchor_stride = 256;
+
+    QString keysetQuery;
+    QString keysetAnchoredQuery;
+    QString keysetAnchorQuery;
+    QString keysetAnchoredAnchorQuery;
+    size_t keysetColumn;
+    mutable std::mutex anchors_mutex;
+    std::map<size_t, Anchor> anchors;
+    std::atomic<FetchMode> last_fetch_mode;
 
     mutable std::future<void> row_counter;
 
     bool first_chunk_loaded;
 
     size_t num_tasks;
-    std::shared_ptr<sqlite3> pDb; //< exclusive access while held...
+    std::shared_ptr<sqlite3> pDb; //< database access while held; a read-only connection may be shared with other readers
+
+    /// connections reserved for counting rows, taken along with pDb
+    /// when the first chunk of a query is requested
+    std::vector<std::shared_ptr<sqlite3>> count_dbs;
+    static constexpr size_t max_count_connections = 4;
 
     bool stop_requested;
 
@@ -94,10 +233,12 @@ private:
         int token;
         size_t row_begin;
         size_t row_end; //< exclusive
+        bool speculative;
+        bool formats_only;  //< only evaluate the conditional formats of cached rows
         std::atomic<bool> cancel;
 
-        Task(RowLoader & row_loader_, int t, size_t a, size_t b)
-            : row_loader(row_loader_), token(t), row_begin(a), row_end(b), cancel(false)
+        Task(RowLoader & row_loader_, int t, size_t a, size_t b, bool s = false, bool f = false)
+            : row_loader(row_loader_), token(t), row_begin(a), row_end(b), speculative(s), formats_only(f), cancel(false)
         {
             row_loader.num_tasks++;
         }
@@ -111,13 +252,44 @@ private:
 
     std::unique_ptr<Task> current_task;
     std::unique_ptr<Task> next_task;
+    std::deque<std::unique_ptr<Task>> prefetch_tasks;
+    std::unique_ptr<Task> format_task;
+
+    static constexpr size_t max_prefetch_tasks = 2;
+
+    /// is the task reading rows close enough to the specified range
+    /// to be still useful when the user looks at that range?
+    static bool isNear (const Task & t, size_t row_begin, size_t row_end);
+
+    /// \returns approximate row count or -1 if there is no estimate
+    int estimateRows (sqlite3* db);
+
+    /// \returns the row count or -1 on error or when interrupted
+    int countRows (const std::vector<std::shared_ptr<sqlite3>>& dbs);
+    int countRows (sqlite3* db);
+
+    /// count the rows in ranges of key values, one per connection, at
+    /// the same time. \returns false if the keys can't be split into
+    /// ranges.
+    bool countRowsInRanges (const std::vector<std::shared_ptr<sqlite3>>& dbs, int& count);
+
+    /// walk through the key values from the closest known anchor
+    /// before the first row of the task up to that row and record
+    /// anchors for them, so that reading the rows of the task only
+    /// skips a few rows. only reads the key column and stops when
+    /// the task is cancelled.
+    void collectAnchors (Task& t, const QString& anchor_query, const QString& anchored_anchor_query);
 
-    int countRows () const;
+    void recordAnchor (size_t row, sqlite3_stmt* stmt, int column);
+    bool findAnchor (size_t row, size_t& anchor_row, Anchor& anchor) const;
+    static void bindAnchor (sqlite3_stmt* stmt, const Anchor& anchor);
 
     void process (Task &);
+    void processFormats (Task &);
 
     void nosync_ensureDbAccess ();
     void nosync_taskDone ();
+    void nosync_cancelCurrentTask ();
 
 };
 
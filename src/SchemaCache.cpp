@@ -0,0 +1,121 @@
+#include "SchemaCache.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+namespace {
+// Every cache file starts with these two numbers. The version needs to be increased whenever the layout of the file changes.
+constexpr quint32 cacheFileMagic = 0x44425343;
+constexpr quint32 cacheFileVersion = 1;
+
+// The number of cache files to keep
+constexpr int maxCacheFiles = 20;
+}
+
+SchemaCache::SchemaCache(const QString& directory)
+    : m_directory(directory)
+{
+}
+
+QString SchemaCache::defaultDirectory()
+{
+    return QStandardPaths::writableLocation(
+#if QT_VERSION >= QT_VERSION_CHECK(5, 4, 0)
+                QStandardPaths::AppDataLocation
+#else
+                QStandardPaths::GenericDataLocation
+#endif
+                ) + "/schemacache";
+}
+
+QString SchemaCache::cacheFileName(const QString& database_file) const
+{
+    // The same file can be reached through different paths, so use the canonical one. Files which don't exist can't have a cache.
+    const QString path = QFileInfo(database_file).canonicalFilePath();
+    if(path.isEmpty() || m_directory.isEmpty())
+        return QString();
+
+    return m_directory + "/" + QCryptographicHash::hash(path.toUtf8(), QCryptographicHash::Sha1).toHex() + ".schema";
+}
+
+bool SchemaCache::load(const QString& database_file, int schema_version, const QByteArray& schema_digest, std::vector<sqlb::ObjectPtr>& objects) const
+{
+    const QString filename = cacheFileName(database_file);
+    if(filename.isEmpty())
+        return false;
+
+    QFile file(filename);
+    if(!file.open(QIODevice::ReadOnly))
+        return false;
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_0);
+
+    quint32 magic, version;
+    stream >> magic >> version;
+    if(stream.status() != QDataStream::Ok || magic != cacheFileMagic || version != cacheFileVersion)
+        return false;
+
+    // Check that the cache belongs to this file and that the schema hasn't changed since it was written. The path is compared
+    // in case two paths have the same hash.
+    QString path;
+    qint32 cached_version;
+    QByteArray cached_digest;
+    stream >> path >> cached_version >> cached_digest;
+    if(stream.status() != QDataStream::Ok || path != QFileInfo(database_file).canonicalFilePath() ||
+            cached_version != schema_version || cached_digest != schema_digest)
+        return false;
+
+    QByteArray data;
+    stream >> data;
+    if(stream.status() != QDataStream::Ok)
+        return false;
+
+    if(!sqlb::deserialiseSchema(data.toStdString(), objects))
+        return false;
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 10, 0)
+    // Mark the file as recently used, so it isn't among the first ones to be removed
+    file.setFileTime(QDateTime::currentDateTimeUtc(), QFileDevice::FileModificationTime);
+#endif
+
+    return true;
+}
+
+bool SchemaCache::store(const QString& database_file, int schema_version, const QByteArray& schema_digest, const std::vector<sqlb::ObjectPtr>& objects) const
+{
+    const QString filename = cacheFileName(database_file);
+    if(filename.isEmpty() || !QDir().mkpath(m_directory))
+        return false;
+
+    const std::string data = sqlb::serialiseSchema(objects);
+
+    // Write to a temporary file first, so other instances of the application never read a partly written cache file
+    QSaveFile file(filename);
+    if(!file.open(QIODevice::WriteOnly))
+        return false;
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_0);
+    stream << cacheFileMagic << cacheFileVersion;
+    stream << QFileInfo(database_file).canonicalFilePath() << qint32(schema_version) << schema_digest;
+    stream << QByteArray::fromRawData(data.data(), static_cast<int>(data.size()));
+    if(stream.status() != QDataStream::Ok || !file.commit())
+        return false;
+
+    removeOldFiles();
+    return true;
+}
+
+void SchemaCache::removeOldFiles() const
+{
+    const QFileInfoList files = QDir(m_directory).entryInfoList({"*.schema"}, QDir::Files, QDir::Time);
+    for(int i=maxCacheFiles;i<files.size();i++)
+        QFile::remove(files.at(i).filePath());
+}
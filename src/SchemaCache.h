@@ -0,0 +1,39 @@
+#ifndef SCHEMACACHE_H
+#define SCHEMACACHE_H
+
+#include "sql/sqlitetypes.h"
+
+#include <QByteArray>
+#include <QString>
+
+#include <vector>
+
+/*
+ * This class keeps the parsed schema of database files on disk, so opening a database again doesn't require parsing its schema when it
+ * hasn't changed since. There is one cache file per database file. Besides the objects it contains the path of the database file, its
+ * schema version, and a digest of its schema table. The cached objects are only used if all of them match the database as it is now.
+ * Only the cache files of the most recently used databases are kept.
+ */
+class SchemaCache
+{
+public:
+    explicit SchemaCache(const QString& directory = defaultDirectory());
+
+    // The directory in the application data directory which is used by default
+    static QString defaultDirectory();
+
+    // Load the objects stored for a database file. This fails if there are none or if they were stored for a different
+    // schema version or schema digest.
+    bool load(const QString& database_file, int schema_version, const QByteArray& schema_digest, std::vector<sqlb::ObjectPtr>& objects) const;
+
+    // Store the objects of a database file, replacing the ones stored for it before
+    bool store(const QString& database_file, int schema_version, const QByteArray& schema_digest, const std::vector<sqlb::ObjectPtr>& objects) const;
+
+private:
+    QString m_directory;
+
+    QString cacheFileName(const QString& database_file) const;
+    void removeOldFiles() const;
+};
+
+#endif
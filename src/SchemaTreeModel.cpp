@@ -0,0 +1,660 @@
+#include "SchemaTreeModel.h"
+#include "IconCache.h"
+
+#include <QCoreApplication>
+
+#include <algorithm>
+#include <set>
+#include <tuple>
+
+namespace {
+// These are the object types of the group nodes below each schema node in the order in which the groups are shown
+const std::string groupTypes[] = {"table", "index", "view", "trigger"};
+
+size_t objectCount(const objectMap& objmap, const std::string& type)
+{
+    if(type == "table" || type == "view")
+    {
+        const bool views = type == "view";
+        return static_cast<size_t>(std::count_if(objmap.tables.begin(), objmap.tables.end(), [views](const auto& t) { return t.second->isView() == views; }));
+    } else if(type == "index") {
+        return objmap.indices.size();
+    } else if(type == "trigger") {
+        return objmap.triggers.size();
+    }
+    return 0;
+}
+
+size_t fieldCount(const std::string& type, const sqlb::ObjectPtr& object)
+{
+    if(type == "table" || type == "view")
+        return std::static_pointer_cast<sqlb::Table>(object)->fields.size();
+    else if(type == "index")
+        return std::static_pointer_cast<sqlb::Index>(object)->fields.size();
+    return 0;
+}
+
+// Objects are sorted by name. In the browsable section the objects of the main schema come first, then those of the temp schema and
+// then those of all other schemata.
+bool objectLessThan(const std::string& schema_a, const std::string& name_a, const std::string& schema_b, const std::string& name_b)
+{
+    auto rank = [](const std::string& schema) { return schema == "main" ? 0 : (schema == "temp" ? 1 : 2); };
+    const int rank_a = rank(schema_a);
+    const int rank_b = rank(schema_b);
+    return std::tie(rank_a, schema_a, name_a) < std::tie(rank_b, schema_b, name_b);
+}
+}
+
+struct SchemaTreeModel::Node
+{
+    Node(NodeType node_type, const std::string& node_schema, const std::string& node_name, const std::string& object_type, const std::string& icon_name)
+        : nodeType(node_type),
+          parent(nullptr),
+          row(0),
+          populated(node_type != NodeType::Group && node_type != NodeType::Object),
+          schema(node_schema),
+          name(node_name),
+          type(object_type),
+          count(0),
+          icon(icon_name.empty() ? nullptr : &IconCache::get(icon_name))
+    {
+    }
+
+    NodeType nodeType;
+    Node* parent;
+    int row;                                            // Position of this node in the children of its parent
+    std::vector<std::unique_ptr<Node>> children;
+    bool populated;                                     // False as long as the children of a lazily populated node haven't been created
+
+    std::string schema;
+    std::string name;
+    std::string type;                                   // Object type of objects and fields. For groups it's the type of the objects in them.
+    std::string dataType;                               // Only used for fields
+    std::string sql;                                    // Only used for fields. For objects the SQL is taken from the object itself.
+    sqlb::ObjectPtr object;                             // Only used for objects
+    size_t count;                                       // Only used for groups. This is the number of objects in the group.
+    const QIcon* icon;
+};
+
+SchemaTreeModel::SchemaTreeModel(const schemaMap& schemata, QObject* parent)
+    : QAbstractItemModel(parent),
+      m_schemata(schemata),
+      rootItem(std::make_unique<Node>(NodeType::Root, std::string(), std::string(), std::string(), std::string())),
+      browsablesRootItem(nullptr)
+{
+}
+
+SchemaTreeModel::~SchemaTreeModel() = default;
+
+int SchemaTreeModel::columnCount(const QModelIndex&) const
+{
+    return ColumnSchema + 1;
+}
+
+QString SchemaTreeModel::text(const Node* node, int column) const
+{
+    switch(column)
+    {
+    case ColumnName:
+        // The texts are translated in the context of DbStructureModel which is where they have been defined originally
+        if(node->nodeType == NodeType::Group)
+        {
+            if(node->type == "table")
+                return QCoreApplication::translate("DbStructureModel", "Tables (%1)").arg(node->count);
+            else if(node->type == "index")
+                return QCoreApplication::translate("DbStructureModel", "Indices (%1)").arg(node->count);
+            else if(node->type == "view")
+                return QCoreApplication::translate("DbStructureModel", "Views (%1)").arg(node->count);
+            else
+                return QCoreApplication::translate("DbStructureModel", "Triggers (%1)").arg(node->count);
+        }
+        return QString::fromStdString(node->name);
+    case ColumnObjectType:
+        return node->nodeType == NodeType::Group ? QString() : QString::fromStdString(node->type);
+    case ColumnDataType:
+        return QString::fromStdString(node->dataType);
+    case ColumnSQL:
+        return QString::fromStdString(node->object ? node->object->originalSql() : node->sql);
+    case ColumnSchema:
+        return node->nodeType == NodeType::Group ? QString() : QString::fromStdString(node->schema);
+    default:
+        return QString();
+    }
+}
+
+QVariant SchemaTreeModel::data(const QModelIndex& index, int role) const
+{
+    if(!index.isValid())
+        return QVariant();
+
+    // Get the node the index points at
+    const Node* node = static_cast<const Node*>(index.internalPointer());
+
+    // Depending on the role either return the text or the icon
+    switch(role)
+    {
+    case Qt::DisplayRole:
+        // For the display role and the browsable branch of the tree we want to show the column name including the schema name if necessary (i.e.
+        // for schemata != "main"). For the normal structure branch of the tree we don't want to add the schema name because it's already obvious from
+        // the position of the item in the tree.
+        if(index.column() == ColumnName && node->parent == browsablesRootItem)
+            return QString::fromStdString(sqlb::ObjectIdentifier(node->schema, node->name).toDisplayString());
+        else
+            return text(node, index.column());
+    case Qt::EditRole:
+        return text(node, index.column());
+    case Qt::ToolTipRole: {
+        // Show the original text but limited, when it's supposed to be shown in a tooltip
+        QString tooltip = text(node, index.column());
+        if (tooltip.length() > 512) {
+            tooltip.truncate(509);
+            tooltip.append("...");
+        }
+        return tooltip;
+    }
+    case Qt::DecorationRole:
+        if(index.column() == ColumnName && node->icon)
+            return *node->icon;
+        return QVariant();
+    default:
+        return QVariant();
+    }
+}
+
+QVariant SchemaTreeModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if(orientation != Qt::Horizontal || role != Qt::DisplayRole)
+        return QVariant();
+
+    switch(section)
+    {
+    case ColumnName: return QCoreApplication::translate("DbStructureModel", "Name");
+    case ColumnObjectType: return QCoreApplication::translate("DbStructureModel", "Object");
+    case ColumnDataType: return QCoreApplication::translate("DbStructureModel", "Type");
+    case ColumnSQL: return QCoreApplication::translate("DbStructureModel", "Schema");
+    case ColumnSchema: return QCoreApplication::translate("DbStructureModel", "Database");
+    default: return QVariant();
+    }
+}
+
+QModelIndex SchemaTreeModel::index(int row, int column, const QModelIndex& parent) const
+{
+    if(!hasIndex(row, column, parent))
+        return QModelIndex();
+
+    const Node* parentItem = parent.isValid() ? static_cast<const Node*>(parent.internalPointer()) : rootItem.get();
+    return createIndex(row, column, parentItem->children.at(static_cast<size_t>(row)).get());
+}
+
+QModelIndex SchemaTreeModel::parent(const QModelIndex& index) const
+{
+    if(!index.isValid())
+        return QModelIndex();
+
+    const Node* childItem = static_cast<const Node*>(index.internalPointer());
+    return indexForNode(childItem->parent);
+}
+
+QModelIndex SchemaTreeModel::indexForNode(Node* node) const
+{
+    if(node == nullptr || node == rootItem.get())
+        return QModelIndex();
+    else
+        return createIndex(node->row, 0, node);
+}
+
+int SchemaTreeModel::rowCount(const QModelIndex& parent) const
+{
+    if(parent.column() > 0)
+        return 0;
+
+    if(!parent.isValid())
+        return static_cast<int>(rootItem->children.size());
+    else
+        return static_cast<int>(static_cast<const Node*>(parent.internalPointer())->children.size());
+}
+
+bool SchemaTreeModel::hasChildren(const QModelIndex& parent) const
+{
+    if(parent.column() > 0)
+        return false;
+
+    const Node* node = parent.isValid() ? static_cast<const Node*>(parent.internalPointer()) : rootItem.get();
+    if(node->populated)
+        return !node->children.empty();
+
+    // Nodes which haven't been populated yet know how many children they are going to have
+    if(node->nodeType == NodeType::Group)
+        return node->count > 0;
+    else
+        return fieldCount(node->type, node->object) > 0;
+}
+
+bool SchemaTreeModel::canFetchMore(const QModelIndex& parent) const
+{
+    if(!parent.isValid() || parent.column() > 0)
+        return false;
+
+    return !static_cast<const Node*>(parent.internalPointer())->populated;
+}
+
+void SchemaTreeModel::fetchMore(const QModelIndex& parent)
+{
+    if(!parent.isValid() || parent.column() > 0)
+        return;
+
+    Node* node = static_cast<Node*>(parent.internalPointer());
+    if(node->populated)
+        return;
+
+    auto children = createChildren(node);
+    node->populated = true;
+    if(children.empty())
+        return;
+
+    beginInsertRows(parent, 0, static_cast<int>(children.size()) - 1);
+    node->children = std::move(children);
+    endInsertRows();
+}
+
+void SchemaTreeModel::reloadData()
+{
+    beginResetModel();
+
+    // Remove all data except for the root item
+    rootItem->children.clear();
+    browsablesRootItem = nullptr;
+
+    // Return here if no DB is opened. There is always a main schema for an opened database.
+    if(m_schemata.find("main") == m_schemata.end())
+    {
+        endResetModel();
+        return;
+    }
+
+    // Create the nodes for browsables and for tables, indices, views and triggers. The idea here is to basically have two trees in one model:
+    // In the root node there are two nodes: 'browsables' and 'all'. The first node contains a list of all browsable objects, i.e. views and tables.
+    // The second node contains four sub-nodes (tables, indices, views and triggers), each containing a list of objects of that type.
+    // This way we only have to have and only have to update one model and can use it in all sorts of places, just by setting a different root node.
+    const std::string browsables = QCoreApplication::translate("DbStructureModel", "Browsables").toStdString();
+    browsablesRootItem = appendNode(rootItem.get(), std::make_unique<Node>(NodeType::Browsables, std::string(), browsables, std::string(), "view"));
+
+    // Make sure to always load the main schema first
+    const std::string all = QCoreApplication::translate("DbStructureModel", "All").toStdString();
+    Node* itemAll = appendNode(rootItem.get(), std::make_unique<Node>(NodeType::Schema, "main", all, "database", "database"));
+    buildTree(itemAll, "main");
+
+    // Add the temporary database as a node if it isn't empty. Make sure it's always second if it exists.
+    auto temp = m_schemata.find("temp");
+    if(temp != m_schemata.end() && !temp->second.empty())
+    {
+        const std::string temporary = QCoreApplication::translate("DbStructureModel", "Temporary").toStdString();
+        Node* itemTemp = appendNode(itemAll, std::make_unique<Node>(NodeType::Schema, "temp", temporary, "database", "database"));
+        buildTree(itemTemp, "temp");
+    }
+
+    // Now load all the other schemata last
+    for(const auto& it : m_schemata)
+    {
+        // Don't load the main and temp schema again
+        if(it.first != "main" && it.first != "temp")
+        {
+            Node* itemSchema = appendNode(itemAll, std::make_unique<Node>(NodeType::Schema, it.first, it.first, "database", "database"));
+            buildTree(itemSchema, it.first);
+        }
+    }
+
+    // Refresh the view
+    endResetModel();
+}
+
+void SchemaTreeModel::buildTree(Node* parent, const std::string& schema)
+{
+    // Get object map for the given schema
+    const objectMap& objmap = m_schemata.at(schema);
+
+    // Prepare tree. The objects in the groups are only added when the group is expanded.
+    for(const auto& type : groupTypes)
+    {
+        Node* group = appendNode(parent, std::make_unique<Node>(NodeType::Group, schema, std::string(), type, type));
+        group->count = objectCount(objmap, type);
+    }
+
+    // Add tables and views to the browsable section. These are always needed for the list of tables in the Browse Data tab.
+    for(const auto& obj : objmap.tables)
+        appendNode(browsablesRootItem, createObjectNode(schema, obj.first, obj.second->isView() ? "view" : "table", obj.second, true));
+}
+
+SchemaTreeModel::Node* SchemaTreeModel::appendNode(Node* parent, std::unique_ptr<Node> node)
+{
+    node->parent = parent;
+    node->row = static_cast<int>(parent->children.size());
+    parent->children.push_back(std::move(node));
+    return parent->children.back().get();
+}
+
+std::unique_ptr<SchemaTreeModel::Node> SchemaTreeModel::createObjectNode(const std::string& schema, const std::string& name, const std::string& type,
+                                                                       const sqlb::ObjectPtr& object, bool browsable) const
+{
+    auto node = std::make_unique<Node>(NodeType::Object, schema, name, type, type);
+    node->object = object;
+
+    // The objects in the browsable section don't list their fields and triggers don't have any
+    node->populated = browsable || fieldCount(type, object) == 0;
+    return node;
+}
+
+std::vector<std::unique_ptr<SchemaTreeModel::Node>> SchemaTreeModel::createChildren(Node* node) const
+{
+    std::vector<std::unique_ptr<Node>> children;
+
+    if(node->nodeType == NodeType::Group)
+    {
+        auto it = m_schemata.find(node->schema);
+        if(it == m_schemata.end())
+            return children;
+        const objectMap& objmap = it->second;
+
+        if(node->type == "table" || node->type == "view")
+        {
+            const bool views = node->type == "view";
+            for(const auto& obj : objmap.tables)
+            {
+                if(obj.second->isView() == views)
+                    children.push_back(createObjectNode(node->schema, obj.first, node->type, obj.second, false));
+            }
+        } else if(node->type == "index") {
+            for(const auto& obj : objmap.indices)
+                children.push_back(createObjectNode(node->schema, obj.first, node->type, obj.second, false));
+        } else if(node->type == "trigger") {
+            for(const auto& obj : objmap.triggers)
+                children.push_back(createObjectNode(node->schema, obj.first, node->type, obj.second, false));
+        }
+    } else if(node->nodeType == NodeType::Object && node->parent != browsablesRootItem) {
+        auto addField = [&children, node](const std::string& name, const std::string& sql, const std::string& data_type, const std::string& icon_suffix) {
+            auto field = std::make_unique<Node>(NodeType::Field, node->schema, name, "field", "field" + icon_suffix);
+            field->sql = sql;
+            field->dataType = data_type;
+            children.push_back(std::move(field));
+        };
+
+        if(node->type == "table" || node->type == "view")
+        {
+            const auto table = std::static_pointer_cast<sqlb::Table>(node->object);
+
+            sqlb::IndexedColumnVector pk_columns;
+            if(!table->isView())
+            {
+                const auto pk = table->primaryKey();
+                if(pk)
+                    pk_columns = table->primaryKeyColumns();
+            }
+
+            for(const auto& field : table->fields)
+            {
+                bool isPK = contains(pk_columns, field.name());
+                bool isFK = table->foreignKey({field.name()}) != nullptr;
+
+                addField(field.name(), field.toString("  ", " "), field.type(), isPK ? "_key" : (isFK ? "_fk" : std::string{}));
+            }
+        } else if(node->type == "index") {
+            const auto index = std::static_pointer_cast<sqlb::Index>(node->object);
+            for(const auto& field : index->fields)
+                addField(field.name(), field.toString("  ", " "), field.order(), std::string{});
+        }
+    }
+
+    for(size_t i=0;i<children.size();i++)
+    {
+        children[i]->parent = node;
+        children[i]->row = static_cast<int>(i);
+    }
+    return children;
+}
+
+SchemaTreeModel::Node* SchemaTreeModel::schemaNode(const std::string& schema) const
+{
+    if(rootItem->children.size() < 2)
+        return nullptr;
+
+    // The 'All' node is the node of the main schema. The nodes of the other schemata follow its group nodes.
+    Node* itemAll = rootItem->children.at(1).get();
+    if(itemAll->schema == schema)
+        return itemAll;
+    for(const auto& child : itemAll->children)
+    {
+        if(child->nodeType == NodeType::Schema && child->schema == schema)
+            return child.get();
+    }
+    return nullptr;
+}
+
+SchemaTreeModel::Node* SchemaTreeModel::groupNode(const std::string& schema, const std::string& type) const
+{
+    Node* node = schemaNode(schema);
+    if(node == nullptr)
+        return nullptr;
+
+    for(const auto& child : node->children)
+    {
+        if(child->nodeType == NodeType::Group && child->type == type)
+            return child.get();
+    }
+    return nullptr;
+}
+
+bool SchemaTreeModel::hasSchemaNodes() const
+{
+    if(rootItem->children.size() < 2 || m_schemata.find("main") == m_schemata.end())
+        return false;
+
+    // Collect the schemata which are shown in the tree and those which should be shown in the same order as reloadData() adds them
+    std::vector<std::string> shown;
+    const Node* itemAll = rootItem->children.at(1).get();
+    shown.push_back(itemAll->schema);
+    for(const auto& child : itemAll->children)
+    {
+        if(child->nodeType == NodeType::Schema)
+            shown.push_back(child->schema);
+    }
+
+    std::vector<std::string> expected = {"main"};
+    auto temp = m_schemata.find("temp");
+    if(temp != m_schemata.end() && !temp->second.empty())
+        expected.push_back("temp");
+    for(const auto& it : m_schemata)
+    {
+        if(it.first != "main" && it.first != "temp")
+            expected.push_back(it.first);
+    }
+
+    return shown == expected;
+}
+
+sqlb::ObjectPtr SchemaTreeModel::findObject(const std::string& type, const sqlb::ObjectIdentifier& name) const
+{
+    auto schema = m_schemata.find(name.schema());
+    if(schema == m_schemata.end())
+        return nullptr;
+
+    auto find = [&name](const auto& objects) -> sqlb::ObjectPtr {
+        auto it = objects.find(name.name());
+        if(it == objects.end())
+            return nullptr;
+        return it->second;
+    };
+    if(type == "table" || type == "view")
+        return find(schema->second.tables);
+    else if(type == "index")
+        return find(schema->second.indices);
+    else if(type == "trigger")
+        return find(schema->second.triggers);
+    return nullptr;
+}
+
+SchemaTreeModel::Node* SchemaTreeModel::findNode(Node* parent, const std::string& schema, const std::string& name) const
+{
+    // The objects are kept sorted, so they can be found by a binary search
+    auto it = std::lower_bound(parent->children.begin(), parent->children.end(), std::tie(schema, name), [](const auto& a, const auto& b) {
+        return objectLessThan(a->schema, a->name, std::get<0>(b), std::get<1>(b));
+    });
+    if(it == parent->children.end() || (*it)->schema != schema || (*it)->name != name)
+        return nullptr;
+    return it->get();
+}
+
+void SchemaTreeModel::insertNode(Node* parent, std::unique_ptr<Node> node)
+{
+    auto it = std::lower_bound(parent->children.begin(), parent->children.end(), node, [](const auto& a, const auto& b) {
+        return objectLessThan(a->schema, a->name, b->schema, b->name);
+    });
+    const int row = static_cast<int>(it - parent->children.begin());
+
+    beginInsertRows(indexForNode(parent), row, row);
+    node->parent = parent;
+    parent->children.insert(it, std::move(node));
+    for(size_t i=static_cast<size_t>(row);i<parent->children.size();i++)
+        parent->children[i]->row = static_cast<int>(i);
+    endInsertRows();
+}
+
+void SchemaTreeModel::removeNode(Node* parent, const std::string& schema, const std::string& name)
+{
+    Node* node = findNode(parent, schema, name);
+    if(node == nullptr)
+        return;
+    const int row = node->row;
+
+    beginRemoveRows(indexForNode(parent), row, row);
+    parent->children.erase(parent->children.begin() + row);
+    for(size_t i=static_cast<size_t>(row);i<parent->children.size();i++)
+        parent->children[i]->row = static_cast<int>(i);
+    endRemoveRows();
+}
+
+void SchemaTreeModel::refreshNode(Node* node, const sqlb::ObjectPtr& object)
+{
+    node->object = object;
+    const QModelIndex index = indexForNode(node);
+    emit dataChanged(index, index.sibling(index.row(), ColumnSchema));
+
+    // Fields which have been shown already are replaced by the new ones. Otherwise they are created when the node is expanded.
+    if(node->nodeType != NodeType::Object || node->parent == browsablesRootItem)
+        return;
+    if(!node->populated)
+        return;
+
+    if(!node->children.empty())
+    {
+        beginRemoveRows(index, 0, static_cast<int>(node->children.size()) - 1);
+        node->children.clear();
+        endRemoveRows();
+    }
+
+    auto children = createChildren(node);
+    if(!children.empty())
+    {
+        beginInsertRows(index, 0, static_cast<int>(children.size()) - 1);
+        node->children = std::move(children);
+        endInsertRows();
+    }
+}
+
+void SchemaTreeModel::updateGroupCounts(const std::string& schema)
+{
+    Node* node = schemaNode(schema);
+    if(node == nullptr)
+        return;
+
+    auto objmap = m_schemata.find(schema);
+    for(const auto& child : node->children)
+    {
+        if(child->nodeType != NodeType::Group)
+            continue;
+
+        const size_t count = objmap == m_schemata.end() ? 0 : objectCount(objmap->second, child->type);
+        if(count != child->count)
+        {
+            child->count = count;
+            const QModelIndex index = indexForNode(child.get());
+            emit dataChanged(index, index);
+        }
+    }
+}
+
+void SchemaTreeModel::addObject(const std::string& type, const sqlb::ObjectIdentifier& name)
+{
+    const sqlb::ObjectPtr object = findObject(type, name);
+    Node* group = groupNode(name.schema(), type);
+    if(!object || group == nullptr)
+        return;
+
+    // Objects which are already in the tree, e.g. because the group has been populated after the schema has changed, are only updated
+    auto add = [this, &type, &name, &object](Node* parent, bool browsable) {
+        Node* node = findNode(parent, name.schema(), name.name());
+        if(node)
+            refreshNode(node, object);
+        else
+            insertNode(parent, createObjectNode(name.schema(), name.name(), type, object, browsable));
+    };
+
+    // Groups which haven't been populated yet get the new object when they are expanded
+    if(group->populated)
+        add(group, false);
+    if(type == "table" || type == "view")
+        add(browsablesRootItem, true);
+}
+
+void SchemaTreeModel::removeObject(const std::string& type, const sqlb::ObjectIdentifier& name)
+{
+    Node* group = groupNode(name.schema(), type);
+    if(group && group->populated)
+        removeNode(group, name.schema(), name.name());
+    if(type == "table" || type == "view")
+        removeNode(browsablesRootItem, name.schema(), name.name());
+}
+
+void SchemaTreeModel::updateData(const SchemaChanges& changes)
+{
+    if(changes.empty())
+        return;
+
+    // Reload everything if another database has been opened or if schema nodes need to be added or removed
+    if(changes.reset || !hasSchemaNodes())
+    {
+        reloadData();
+        return;
+    }
+
+    std::set<std::string> schemata;
+    for(const auto& obj : changes.removed)
+    {
+        removeObject(obj.type, obj.name);
+        schemata.insert(obj.name.schema());
+    }
+    for(const auto& obj : changes.changed)
+    {
+        // A table which has been replaced by a view of the same name or the other way round moves to another group
+        if(obj.type == "table" || obj.type == "view")
+        {
+            const Node* browsable = findNode(browsablesRootItem, obj.name.schema(), obj.name.name());
+            if(browsable && browsable->type != obj.type)
+            {
+                const std::string old_type = browsable->type;
+                removeObject(old_type, obj.name);
+            }
+        }
+
+        addObject(obj.type, obj.name);
+        schemata.insert(obj.name.schema());
+    }
+    for(const auto& obj : changes.added)
+    {
+        addObject(obj.type, obj.name);
+        schemata.insert(obj.name.schema());
+    }
+
+    // Update the number of objects in the group nodes
+    for(const auto& schema : schemata)
+        updateGroupCounts(schema);
+}
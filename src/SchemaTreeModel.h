@@ -0,0 +1,94 @@
+#ifndef SCHEMATREEMODEL_H
+#define SCHEMATREEMODEL_H
+
+#include "sqlitedb.h"
+
+#include <QAbstractItemModel>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+/*
+ * This model shows the objects of all schemata as a tree. It has two nodes at the top level: 'Browsables' which contains a list of all
+ * tables and views, and 'All' which contains one node per object type with the objects of that type in them and one node for each
+ * further schema. The objects in the type nodes and the fields of the objects are only created when a view asks for them, i.e. when
+ * the node is expanded. Updates of the schema are applied to the existing tree where possible, so only the changed objects are touched.
+ */
+class SchemaTreeModel : public QAbstractItemModel
+{
+    Q_OBJECT
+
+public:
+    explicit SchemaTreeModel(const schemaMap& schemata, QObject* parent = nullptr);
+    ~SchemaTreeModel() override;
+
+    QVariant data(const QModelIndex& index, int role) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+    QModelIndex index(int row, int column, const QModelIndex& parent = QModelIndex()) const override;
+    QModelIndex parent(const QModelIndex& index) const override;
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex& = QModelIndex()) const override;
+    bool hasChildren(const QModelIndex& parent = QModelIndex()) const override;
+    bool canFetchMore(const QModelIndex& parent) const override;
+    void fetchMore(const QModelIndex& parent) override;
+
+    enum Columns
+    {
+        ColumnName,
+        ColumnObjectType,
+        ColumnDataType,
+        ColumnSQL,
+        ColumnSchema,
+    };
+
+public slots:
+    // Build the tree from scratch
+    void reloadData();
+
+    // Apply the changes found by DBBrowserDB::updateSchema() to the tree. This falls back to reloading if the changes need a reset.
+    void updateData(const SchemaChanges& changes);
+
+protected:
+    const schemaMap& m_schemata;
+
+private:
+    enum class NodeType
+    {
+        Root,
+        Browsables,
+        Schema,
+        Group,
+        Object,
+        Field,
+    };
+    struct Node;
+
+    std::unique_ptr<Node> rootItem;
+    Node* browsablesRootItem;
+
+    QModelIndex indexForNode(Node* node) const;
+    QString text(const Node* node, int column) const;
+
+    static Node* appendNode(Node* parent, std::unique_ptr<Node> node);
+    std::unique_ptr<Node> createObjectNode(const std::string& schema, const std::string& name, const std::string& type, const sqlb::ObjectPtr& object,
+                                           bool browsable) const;
+    std::vector<std::unique_ptr<Node>> createChildren(Node* node) const;
+    void buildTree(Node* parent, const std::string& schema);
+
+    Node* schemaNode(const std::string& schema) const;
+    Node* groupNode(const std::string& schema, const std::string& type) const;
+    bool hasSchemaNodes() const;
+    sqlb::ObjectPtr findObject(const std::string& type, const sqlb::ObjectIdentifier& name) const;
+    Node* findNode(Node* parent, const std::string& schema, const std::string& name) const;
+
+    void insertNode(Node* parent, std::unique_ptr<Node> node);
+    void removeNode(Node* parent, const std::string& schema, const std::string& name);
+    void refreshNode(Node* node, const sqlb::ObjectPtr& object);
+    void updateGroupCounts(const std::string& schema);
+
+    void addObject(const std::string& type, const sqlb::ObjectIdentifier& name);
+    void removeObject(const std::string& type, const sqlb::ObjectIdentifier& name);
+};
+
+#endif
@@ -121,6 +121,26 @@ void Settings::setValue(const std::string& group, const std::string& name, const
     m_hCache[group + name] = value;
 }
 
+bool Settings::setValueFromArgument(const QString& argument, bool save_to_disk)
+{
+    QStringList option = argument.split("=");
+    if(option.size() != 2)
+        return false;
+
+    QStringList setting = option.at(0).split("/");
+    if(setting.size() != 2)
+        return false;
+
+    QVariant value;
+    // Split string lists. This assumes they are always named "*list"
+    if(setting.at(1).endsWith("list", Qt::CaseInsensitive))
+        value = option.at(1).split(",");
+    else
+        value = option.at(1);
+    setValue(setting.at(0).toStdString(), setting.at(1).toStdString(), value, save_to_disk);
+    return true;
+}
+
 QVariant Settings::getDefaultValue(const std::string& group, const std::string& name)
 {
     // db/defaultencoding?
@@ -151,6 +171,14 @@ QVariant Settings::getDefaultValue(const std::string& group, const std::string&
     if(group == "db" && name == "prefetchsize")
         return 50000U;
 
+    // db/cachememorylimit?
+    if(group == "db" && name == "cachememorylimit")
+        return 1024U;
+
+    // db/bulkloadsqlimport?
+    if(group == "db" && name == "bulkloadsqlimport")
+        return false;
+
     // db/defaultsqltext?
     if(group == "db" && name == "defaultsqltext")
         return QString();
@@ -188,6 +216,8 @@ QVariant Settings::getDefaultValue(const std::string& group, const std::string&
             return "UTF-8";
         if(name == "localconventions")
             return false;
+        if(name == "bulkload")
+            return false;
     }
 
     // exportsql group?
@@ -197,6 +227,17 @@ QVariant Settings::getDefaultValue(const std::string& group, const std::string&
             return false;
         if(name == "oldschema")
             return 0;
+        if(name == "maxrowsperinsert")
+            return 1000;
+        if(name == "compression" || name == "splitsize")
+            return 0;
+    }
+
+    // exportdata group?
+    if(group == "exportdata")
+    {
+        if(name == "compression" || name == "splitsize")
+            return 0;
     }
 
     // newline character
@@ -211,6 +252,10 @@ QVariant Settings::getDefaultValue(const std::string& group, const std::string&
     if(group == "exportjson" && name == "prettyprint")
         return true;
 
+    // exportjson/ndjson?
+    if(group == "exportjson" && name == "ndjson")
+        return false;
+
     // MainWindow/geometry?
     if(group == "MainWindow" && name == "geometry")
         return QString();
@@ -19,6 +19,8 @@ public:
     static void setUserSettingsFile(const QString& userSettingsFileArg);
     static QVariant getValue(const std::string& group, const std::string& name);
     static void setValue(const std::string& group, const std::string& name, const QVariant& value, bool save_to_disk = true);
+    // Set a value from a command line argument in the form group/setting=value. Returns false if the argument isn't in that form.
+    static bool setValueFromArgument(const QString& argument, bool save_to_disk);
     static void clearValue(const std::string& group, const std::string& name);
     static void restoreDefaults();
 
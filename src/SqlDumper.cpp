@@ -0,0 +1,322 @@
+#include "SqlDumper.h"
+#include "Data.h"
+#include "sqlite.h"
+
+#include <QElapsedTimer>
+#include <QIODevice>
+#include <QLocale>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+// A chunk is handed to the writer once it is at least this big
+constexpr int chunkBytes = 1024 * 1024;
+
+// Number of chunks per table which may be waiting for the writer
+constexpr size_t maxQueuedChunks = 4;
+
+// The shared row counter for the progress is only updated after this many rows
+constexpr size_t progressRows = 1024;
+
+// Minimum time in milliseconds between two progress signals
+constexpr qint64 progressInterval = 50;
+
+void appendInteger(QByteArray& out, sqlite3_int64 value)
+{
+    // Write the digits backwards from the end of the buffer. The magnitude is calculated unsigned to cope with the smallest value.
+    char buffer[24];
+    char* end = buffer + sizeof(buffer);
+    char* p = end;
+    quint64 magnitude = value < 0 ? 0 - static_cast<quint64>(value) : static_cast<quint64>(value);
+    do
+    {
+        *--p = static_cast<char>('0' + magnitude % 10);
+        magnitude /= 10;
+    } while(magnitude);
+    if(value < 0)
+        *--p = '-';
+
+    out.append(p, static_cast<int>(end - p));
+}
+
+void appendReal(QByteArray& out, double value)
+{
+    // SQL has no literal for infinite values, so these are exported as text like they are returned by SQLite. Not-a-number values are
+    // stored as NULL by SQLite, so they don't need to be taken care of here.
+    if(std::isinf(value))
+    {
+        out.append(value < 0 ? "'-Inf'" : "'Inf'");
+        return;
+    }
+
+    // Use the shortest representation which reads back as the same value. This does not depend on the locale.
+    const QByteArray number = QByteArray::number(value, 'g', QLocale::FloatingPointShortest);
+    out.append(number);
+
+    // Make sure the value is read back as a real value and not as an integer
+    if(!number.contains('.') && !number.contains('e'))
+        out.append(".0");
+}
+
+void appendHex(QByteArray& out, const char* data, int size)
+{
+    static const char digits[] = "0123456789abcdef";
+
+    out.append("X'");
+    const int start = out.size();
+    out.resize(start + 2 * size);
+    char* p = out.data() + start;
+    for(int i=0;i<size;i++)
+    {
+        const unsigned char c = static_cast<unsigned char>(data[i]);
+        *p++ = digits[c >> 4];
+        *p++ = digits[c & 0xf];
+    }
+    out.append('\'');
+}
+
+void appendString(QByteArray& out, const char* data, int size)
+{
+    // Double all single quotes
+    out.append('\'');
+    const char* end = data + size;
+    while(data < end)
+    {
+        const char* quote = static_cast<const char*>(std::memchr(data, '\'', static_cast<size_t>(end - data)));
+        if(!quote)
+        {
+            out.append(data, static_cast<int>(end - data));
+            break;
+        }
+
+        out.append(data, static_cast<int>(quote - data + 1));
+        out.append('\'');
+        data = quote + 1;
+    }
+    out.append('\'');
+}
+
+// Printable ASCII characters and white space are certainly text. This is the case for most values and much quicker to check than
+// what isTextOnly() does.
+bool isPlainText(const char* data, int size)
+{
+    for(int i=0;i<size;i++)
+    {
+        const unsigned char c = static_cast<unsigned char>(data[i]);
+        if((c < 0x20 && (c < '\t' || c > '\r')) || c >= 0x7f)
+            return false;
+    }
+    return true;
+}
+}
+
+SqlDumper::SqlDumper(QIODevice& device, std::vector<Table> tables, size_t maxRowsPerInsert, QObject* parent)
+    : QObject(parent),
+      m_device(device),
+      m_tables(std::move(tables)),
+      m_maxRowsPerInsert(maxRowsPerInsert),
+      m_nextTable(0),
+      m_runningThreads(0),
+      m_stopped(false),
+      m_rowsDone(0)
+{
+    for(size_t i=0;i<m_tables.size();i++)
+        m_chunks.push_back(std::make_unique<BoundedQueue<QByteArray>>(maxQueuedChunks));
+}
+
+SqlDumper::~SqlDumper()
+{
+    if(m_runningThreads)
+        cancel();
+
+    for(auto& t : m_workerThreads)
+    {
+        if(t.joinable())
+            t.join();
+    }
+    if(m_writerThread.joinable())
+        m_writerThread.join();
+}
+
+void SqlDumper::start(const std::vector<sqlite3*>& connections)
+{
+    m_runningThreads = static_cast<int>(connections.size()) + 1;
+    m_writerThread = std::thread(&SqlDumper::write, this);
+    for(sqlite3* db : connections)
+        m_workerThreads.emplace_back(&SqlDumper::work, this, db);
+}
+
+void SqlDumper::cancel()
+{
+    fail(QString());
+}
+
+void SqlDumper::fail(const QString& message)
+{
+    {
+        std::lock_guard<std::mutex> lk(m_mutexError);
+        if(!m_stopped)
+            m_errorMessage = message;
+        m_stopped = true;
+    }
+
+    for(auto& queue : m_chunks)
+        queue->abort();
+}
+
+void SqlDumper::threadFinished()
+{
+    if(--m_runningThreads == 0)
+        emit finished();
+}
+
+void SqlDumper::work(sqlite3* db)
+{
+    // The tables are picked up in order, so the table the writer is waiting for is always being worked on
+    for(size_t index=m_nextTable++;index<m_tables.size() && !m_stopped;index=m_nextTable++)
+        dumpTable(db, index);
+
+    threadFinished();
+}
+
+void SqlDumper::dumpTable(sqlite3* db, size_t index)
+{
+    const Table& table = m_tables.at(index);
+    BoundedQueue<QByteArray>& queue = *m_chunks.at(index);
+
+    sqlite3_stmt* stmt;
+    if(sqlite3_prepare_v2(db, table.query.c_str(), static_cast<int>(table.query.size()), &stmt, nullptr) != SQLITE_OK)
+    {
+        fail(QString::fromUtf8(sqlite3_errmsg(db)));
+        return;
+    }
+
+    const int columns = sqlite3_column_count(stmt);
+    QByteArray chunk;
+    chunk.reserve(chunkBytes);
+    size_t rows = 0;
+    size_t rowsCounted = 0;
+    size_t rowsInStatement = 0;
+    int status;
+    while((status = sqlite3_step(stmt)) == SQLITE_ROW)
+    {
+        // The end of the previous row depends on whether this row is appended to its INSERT statement
+        if(rowsInStatement == m_maxRowsPerInsert && rowsInStatement)
+        {
+            chunk.append(");\n");
+            rowsInStatement = 0;
+        } else if(rowsInStatement) {
+            chunk.append("),\n (");
+        }
+        if(rowsInStatement == 0)
+        {
+            chunk.append(table.insert);
+            chunk.append(" (");
+        }
+        rowsInStatement++;
+
+        for(int i=0;i<columns;i++)
+        {
+            if(i)
+                chunk.append(',');
+            appendValue(chunk, stmt, i);
+        }
+
+        // Only count the estimated number of rows for the progress
+        if(++rows % progressRows == 0 && rowsCounted < table.estimatedRows)
+        {
+            const size_t counted = std::min(rows, table.estimatedRows);
+            m_rowsDone += counted - rowsCounted;
+            rowsCounted = counted;
+        }
+
+        if(chunk.size() >= chunkBytes)
+        {
+            if(m_stopped || !queue.push(std::move(chunk)))
+                break;
+            chunk = QByteArray();
+            chunk.reserve(chunkBytes);
+        }
+    }
+
+    if(status != SQLITE_ROW && status != SQLITE_DONE)
+        fail(QString::fromUtf8(sqlite3_errmsg(db)));
+    sqlite3_finalize(stmt);
+    if(m_stopped)
+        return;
+
+    // Count the rest of the estimate before the writer can get to the end of the table
+    m_rowsDone += table.estimatedRows - rowsCounted;
+
+    if(rowsInStatement)
+        chunk.append(");\n");
+    if(!chunk.isEmpty())
+        queue.push(std::move(chunk));
+    queue.close();
+}
+
+void SqlDumper::write()
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    for(auto& queue : m_chunks)
+    {
+        QByteArray chunk;
+        while(queue->pop(chunk))
+        {
+            if(m_device.write(chunk) != chunk.size())
+            {
+                fail(m_device.errorString());
+                break;
+            }
+
+            if(timer.elapsed() >= progressInterval)
+            {
+                emit progress(m_rowsDone);
+                timer.restart();
+            }
+        }
+
+        if(m_stopped)
+            break;
+    }
+
+    emit progress(m_rowsDone);
+    threadFinished();
+}
+
+void SqlDumper::appendValue(QByteArray& out, sqlite3_stmt* stmt, int column)
+{
+    switch(sqlite3_column_type(stmt, column))
+    {
+    case SQLITE_INTEGER:
+        appendInteger(out, sqlite3_column_int64(stmt, column));
+        break;
+    case SQLITE_FLOAT:
+        appendReal(out, sqlite3_column_double(stmt, column));
+        break;
+    case SQLITE_TEXT:
+    {
+        const char* data = reinterpret_cast<const char*>(sqlite3_column_text(stmt, column));
+        const int size = sqlite3_column_bytes(stmt, column);
+
+        // Text which contains binary data is exported as a blob, just like sqlb::escapeByteArray() does
+        if(isPlainText(data, size) || isTextOnly(QByteArray::fromRawData(data, size)))
+            appendString(out, data, size);
+        else
+            appendHex(out, data, size);
+        break;
+    }
+    case SQLITE_BLOB:
+    {
+        const char* data = static_cast<const char*>(sqlite3_column_blob(stmt, column));
+        appendHex(out, data, sqlite3_column_bytes(stmt, column));
+        break;
+    }
+    default:
+        out.append("NULL");
+    }
+}
@@ -0,0 +1,92 @@
+#ifndef SQLDUMPER_H
+#define SQLDUMPER_H
+
+#include "BoundedQueue.h"
+
+#include <QByteArray>
+#include <QObject>
+#include <QString>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class QIODevice;
+struct sqlite3;
+struct sqlite3_stmt;
+
+/*
+ * This class writes the contents of some tables as INSERT statements to a device. Each table is formatted on one of several worker
+ * threads, each of them using its own database connection, while a writer thread appends the formatted data to the device in the
+ * order of the tables. The workers hand the data to the writer in chunks through bounded queues, so at most a few chunks per table
+ * which is being worked on are held in memory at any time.
+ */
+class SqlDumper : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Table
+    {
+        std::string query;                      // SELECT statement which returns the rows to export
+        QByteArray insert;                      // Start of each INSERT statement up to and including the VALUES keyword
+        size_t estimatedRows;                   // Only used for the progress
+    };
+
+    // The tables are written in the order they are specified in. A maximum of one row per INSERT statement writes a separate statement
+    // for each row and a maximum of 0 writes all rows of a table in a single statement.
+    SqlDumper(QIODevice& device, std::vector<Table> tables, size_t maxRowsPerInsert, QObject* parent = nullptr);
+    ~SqlDumper() override;
+
+    // Start exporting using one worker thread for each of the connections. The device and the connections must not be used otherwise
+    // until finished() has been emitted.
+    void start(const std::vector<sqlite3*>& connections);
+
+    // Stop exporting as soon as possible
+    void cancel();
+
+    // These may only be called after finished() has been emitted
+    bool success() const { return !m_stopped; }
+    QString errorMessage() const { return m_errorMessage; }
+
+    // Append the value of a column in the current row of a statement as an SQL literal
+    static void appendValue(QByteArray& out, sqlite3_stmt* stmt, int column);
+
+signals:
+    // Number of rows written so far, measured in the estimated numbers of rows of the tables. Tables which turned out to have more rows
+    // than estimated are counted with their estimate.
+    void progress(quint64 rows);
+
+    // All threads have stopped
+    void finished();
+
+private:
+    QIODevice& m_device;
+    std::vector<Table> m_tables;
+    size_t m_maxRowsPerInsert;
+
+    std::vector<std::unique_ptr<BoundedQueue<QByteArray>>> m_chunks;   // Formatted data per table
+    std::vector<std::thread> m_workerThreads;
+    std::thread m_writerThread;
+    std::atomic<size_t> m_nextTable;            // Index of the next table a worker is going to pick up
+    std::atomic<int> m_runningThreads;
+    std::atomic<bool> m_stopped;                // The export was cancelled or has failed
+    std::atomic<quint64> m_rowsDone;
+
+    std::mutex m_mutexError;
+    QString m_errorMessage;
+
+    void work(sqlite3* db);
+    void dumpTable(sqlite3* db, size_t index);
+    void write();
+
+    // Stop all threads. Only the first error message is kept.
+    void fail(const QString& message);
+
+    void threadFinished();
+};
+
+#endif
@@ -0,0 +1,197 @@
+#include "SqlStatementReader.h"
+
+#include <QIODevice>
+
+namespace {
+// Token classes and states for finding the end of a statement. These follow sqlite3_complete(), which can't be used here because it
+// always starts at the beginning of the statement and would thus scan long statements over and over again.
+enum Token
+{
+    TokenSemicolon,
+    TokenWhitespace,
+    TokenOther,
+    TokenExplain,
+    TokenCreate,
+    TokenTemp,
+    TokenTrigger,
+    TokenEnd
+};
+
+enum State
+{
+    StateInvalid,       // Nothing but whitespace and comments so far
+    StateStart,         // At the end of a complete statement
+    StateNormal,
+    StateExplain,
+    StateCreate,
+    StateTrigger,       // Inside the body of a CREATE TRIGGER statement
+    StateSemicolon,
+    StateEnd
+};
+
+const State transitions[8][8] = {
+    //                 Semicolon       Whitespace      Other         Explain       Create        Temp          Trigger       End
+    /* Invalid */    { StateStart,     StateInvalid,   StateNormal,  StateExplain, StateCreate,  StateNormal,  StateNormal,  StateNormal },
+    /* Start */      { StateStart,     StateStart,     StateNormal,  StateExplain, StateCreate,  StateNormal,  StateNormal,  StateNormal },
+    /* Normal */     { StateStart,     StateNormal,    StateNormal,  StateNormal,  StateNormal,  StateNormal,  StateNormal,  StateNormal },
+    /* Explain */    { StateStart,     StateExplain,   StateExplain, StateNormal,  StateCreate,  StateNormal,  StateNormal,  StateNormal },
+    /* Create */     { StateStart,     StateCreate,    StateNormal,  StateNormal,  StateNormal,  StateCreate,  StateTrigger, StateNormal },
+    /* Trigger */    { StateSemicolon, StateTrigger,   StateTrigger, StateTrigger, StateTrigger, StateTrigger, StateTrigger, StateTrigger },
+    /* Semicolon */  { StateSemicolon, StateSemicolon, StateTrigger, StateTrigger, StateTrigger, StateTrigger, StateTrigger, StateEnd },
+    /* End */        { StateStart,     StateEnd,       StateTrigger, StateTrigger, StateTrigger, StateTrigger, StateTrigger, StateTrigger },
+};
+
+bool isIdChar(char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || c == '$' ||
+            static_cast<unsigned char>(c) >= 0x80;
+}
+
+Token keywordToken(const char* word, int length)
+{
+    const auto is = [word, length](const char* keyword) {
+        return static_cast<int>(qstrlen(keyword)) == length && qstrnicmp(word, keyword, static_cast<uint>(length)) == 0;
+    };
+
+    if(is("create"))
+        return TokenCreate;
+    else if(is("temp") || is("temporary"))
+        return TokenTemp;
+    else if(is("trigger"))
+        return TokenTrigger;
+    else if(is("explain"))
+        return TokenExplain;
+    else if(is("end"))
+        return TokenEnd;
+    return TokenOther;
+}
+}
+
+SqlStatementReader::SqlStatementReader(QIODevice& device, int chunkSize)
+    : m_device(device),
+      m_chunkSize(chunkSize > 0 ? chunkSize : 1),
+      m_start(0),
+      m_scanned(0),
+      m_tokenScanned(0),
+      m_state(StateInvalid),
+      m_position(0),
+      m_atEnd(false),
+      m_error(false),
+      m_firstChunk(true)
+{
+}
+
+bool SqlStatementReader::next(QByteArray& statement)
+{
+    while(true)
+    {
+        // Go through the tokens of the buffer until a semicolon ends the statement. A token which might continue in the next chunk is
+        // left for after reading it, but the search for its end is resumed where it stopped.
+        const char* data = m_buffer.constData();
+        const int size = m_buffer.size();
+        while(m_scanned < size)
+        {
+            const char c = data[m_scanned];
+            const int resume = m_tokenScanned;
+            int end = -1;
+            Token token = TokenOther;
+            if(c == ';')
+            {
+                token = TokenSemicolon;
+                end = m_scanned + 1;
+            } else if(c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f') {
+                token = TokenWhitespace;
+                end = m_scanned + 1;
+            } else if((c == '/' || c == '-') && m_scanned + 1 == size) {
+                // Wait for the next character to tell if this starts a comment
+            } else if(c == '/' && data[m_scanned + 1] == '*') {
+                token = TokenWhitespace;
+                end = m_buffer.indexOf("*/", qMax(m_scanned + 2, resume - 1));
+                if(end != -1)
+                    end += 2;
+            } else if(c == '-' && data[m_scanned + 1] == '-') {
+                token = TokenWhitespace;
+                end = m_buffer.indexOf('\n', qMax(m_scanned + 2, resume));
+                if(end != -1)
+                    end++;
+            } else if(c == '\'' || c == '"' || c == '`' || c == '[') {
+                end = m_buffer.indexOf(c == '[' ? ']' : c, qMax(m_scanned + 1, resume));
+                if(end != -1)
+                    end++;
+            } else if(isIdChar(c)) {
+                end = qMax(m_scanned + 1, resume);
+                while(end < size && isIdChar(data[end]))
+                    end++;
+                if(end == size)
+                    end = -1;
+                else
+                    token = keywordToken(data + m_scanned, end - m_scanned);
+            } else {
+                end = m_scanned + 1;
+            }
+
+            if(end == -1)
+            {
+                m_tokenScanned = size;
+                break;
+            }
+
+            m_scanned = m_tokenScanned = end;
+            m_state = transitions[m_state][token];
+            if(token == TokenSemicolon && m_state == StateStart)
+            {
+                statement = m_buffer.mid(m_start, end - m_start);
+                m_position += statement.size();
+                m_start = end;
+                m_state = StateInvalid;
+                return true;
+            }
+        }
+
+        if(!readChunk())
+            break;
+    }
+
+    // Return the remaining text if there is any
+    statement = m_buffer.mid(m_start);
+    m_position += statement.size();
+    m_start = m_scanned = m_tokenScanned = m_buffer.size();
+    m_state = StateInvalid;
+    return !m_error && !statement.trimmed().isEmpty();
+}
+
+bool SqlStatementReader::readChunk()
+{
+    if(m_atEnd)
+        return false;
+
+    // Drop the text of the returned statements before reading more
+    m_buffer.remove(0, m_start);
+    m_scanned -= m_start;
+    m_tokenScanned -= m_start;
+    m_start = 0;
+
+    const QByteArray chunk = m_device.read(m_chunkSize);
+    if(chunk.isEmpty())
+    {
+        m_atEnd = true;
+        m_error = !m_device.atEnd();
+        return false;
+    }
+    m_buffer.append(chunk);
+
+    // Skip a UTF-8 byte order mark at the start of the input. Wait for enough bytes to tell whether there is one.
+    if(m_firstChunk && (m_buffer.size() >= 3 || m_device.atEnd()))
+    {
+        m_firstChunk = false;
+        if(m_buffer.startsWith("\xEF\xBB\xBF"))
+        {
+            m_buffer.remove(0, 3);
+            m_position += 3;
+            m_scanned = m_tokenScanned = 0;
+            m_state = StateInvalid;
+        }
+    }
+
+    return true;
+}
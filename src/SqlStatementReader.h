@@ -0,0 +1,48 @@
+#ifndef SQLSTATEMENTREADER_H
+#define SQLSTATEMENTREADER_H
+
+#include <QByteArray>
+
+class QIODevice;
+
+/*
+ * This class splits the SQL text read from a device into single statements. The text is read in chunks and only the chunk and the
+ * current statement are kept in memory, so the memory usage does not depend on the size of the input, only on the size of its
+ * largest statement. Statement boundaries are found the same way sqlite3_complete() finds them, so semicolons in string literals, comments
+ * and trigger bodies are handled correctly. Unlike sqlite3_complete(), each byte is only scanned once however long the statement is.
+ */
+class SqlStatementReader
+{
+public:
+    explicit SqlStatementReader(QIODevice& device, int chunkSize = 1024 * 1024);
+
+    // Reads the next statement including its terminating semicolon and any whitespace or comments before it. Text at the end of the
+    // input which is not terminated by a semicolon is returned as the last statement unless it consists of whitespace only. Returns
+    // false when there are no more statements or reading from the device failed.
+    bool next(QByteArray& statement);
+
+    // Number of bytes read from the device which belong to statements returned so far
+    qint64 position() const { return m_position; }
+
+    // Whether reading from the device failed
+    bool hasError() const { return m_error; }
+
+private:
+    QIODevice& m_device;
+    int m_chunkSize;
+
+    QByteArray m_buffer;        // Text read from the device but not returned yet, starting at m_start
+    int m_start;
+    int m_scanned;              // Position in the buffer of the next token to scan
+    int m_tokenScanned;         // Position in the buffer up to which the end of the token at m_scanned has been looked for
+    int m_state;                // State of the statement end detection after the tokens up to m_scanned
+    qint64 m_position;
+    bool m_atEnd;
+    bool m_error;
+    bool m_firstChunk;
+
+    // Appends the next chunk of the device to the buffer. Returns false at the end of the input.
+    bool readChunk();
+};
+
+#endif
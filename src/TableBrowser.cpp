@@ -393,6 +393,7 @@ TableBrowser::TableBrowser(DBBrowserDB* _db, QWidget* parent) :
 
     // Connect slots
     connect(m_model, &SqliteTableModel::finishedFetch, this, &TableBrowser::fetchedData);
+    connect(m_model, &SqliteTableModel::rowCountEstimated, this, &TableBrowser::updateRecordsetLabel);
 
     // Load initial settings
     reloadSettings();
@@ -759,15 +760,23 @@ void TableBrowser::updateRecordsetLabel()
     if(m_model->query().empty())
         row_count_available = SqliteTableModel::RowCount::Complete;
 
-    // Update the label showing the current position
+    // Update the label showing the current position. While the exact row count is still being determined, show an estimate if
+    // there is one.
+    const int estimate = m_model->estimatedRowCount();
     QString txt;
     switch(row_count_available)
     {
     case SqliteTableModel::RowCount::Unknown:
-        txt = tr("determining row count...");
+        if(estimate >= 0)
+            txt = tr("%L1 - %L2 of ~%L3").arg(from).arg(to).arg(estimate);
+        else
+            txt = tr("determining row count...");
         break;
     case SqliteTableModel::RowCount::Partial:
-        txt = tr("%L1 - %L2 of >= %L3").arg(from).arg(to).arg(total);
+        if(estimate >= total)
+            txt = tr("%L1 - %L2 of ~%L3").arg(from).arg(to).arg(estimate);
+        else
+            txt = tr("%L1 - %L2 of >= %L3").arg(from).arg(to).arg(total);
         break;
     case SqliteTableModel::RowCount::Complete:
         txt = tr("%L1 - %L2 of %L3").arg(from).arg(to).arg(real_total);
@@ -1588,17 +1597,7 @@ static QString replaceInValue(QString value, const QString& find, const QString&
 #endif
     if(flags.testFlag(match_flag))
     {
-        QRegularExpression reg_exp(find, (flags.testFlag(Qt::MatchCaseSensitive) ? QRegularExpression::NoPatternOption : QRegularExpression::CaseInsensitiveOption));
-        if(!flags.testFlag(Qt::MatchContains))
-        {
-#if QT_VERSION < QT_VERSION_CHECK(5, 12, 0)
-            reg_exp.setPattern("\\A(" + reg_exp.pattern() + ")\\Z");
-#else
-            reg_exp.setPattern(QRegularExpression::anchoredPattern(reg_exp.pattern()));
-#endif
-        }
-
-        return value.replace(reg_exp, replace);
+        return value.replace(findRegularExpression(find, !flags.testFlag(Qt::MatchContains), flags.testFlag(Qt::MatchCaseSensitive)), replace);
     } else {
         return value.replace(find, replace, flags.testFlag(Qt::MatchCaseSensitive) ? Qt::CaseSensitive : Qt::CaseInsensitive);
     }
@@ -1683,31 +1682,37 @@ void TableBrowser::find(const QString& expr, bool forward, bool include_first, R
             ui->editFindExpression->setStyleSheet("QLineEdit {color: white; background-color: rgb(255, 102, 102)}");
     } break;
     case ReplaceMode::ReplaceAll: {
-        // Find all matches
-        std::set<QModelIndex> all_matches;
-        while(true)
+        // Replace all matches at once if possible
+        int num_replacements = m_model->replaceAll(column_list, expr, ui->editReplaceExpression->text(), flags);
+        if(num_replacements < 0)
         {
-            // Find the next match
-            const auto match = m_model->nextMatch(start, column_list, expr, flags, !forward, include_first);
-
-            // If there was a match, perform the replacement and continue from that position. If there was no match, stop looking for other matches.
-            // Additionally, keep track of all the matches so far in order to avoid running over them again indefinitely, e.g. when replacing "1" by "10".
-            if(match.isValid() && all_matches.find(match) == all_matches.end())
+            // Otherwise find all matches and replace them one by one
+            std::set<QModelIndex> all_matches;
+            while(true)
             {
-                all_matches.insert(match);
-                m_model->setData(match, replaceInValue(match.data(Qt::EditRole).toString(), expr, ui->editReplaceExpression->text(), flags));
-
-                // Start searching from the last match onwards in order to not search through the same cells over and over again.
-                start = match;
-                include_first = false;
-            } else {
-                break;
+                // Find the next match
+                const auto match = m_model->nextMatch(start, column_list, expr, flags, !forward, include_first);
+
+                // If there was a match, perform the replacement and continue from that position. If there was no match, stop looking for other matches.
+                // Additionally, keep track of all the matches so far in order to avoid running over them again indefinitely, e.g. when replacing "1" by "10".
+                if(match.isValid() && all_matches.find(match) == all_matches.end())
+                {
+                    all_matches.insert(match);
+                    m_model->setData(match, replaceInValue(match.data(Qt::EditRole).toString(), expr, ui->editReplaceExpression->text(), flags));
+
+                    // Start searching from the last match onwards in order to not search through the same cells over and over again.
+                    start = match;
+                    include_first = false;
+                } else {
+                    break;
+                }
             }
+            num_replacements = static_cast<int>(all_matches.size());
         }
 
         // Make the expression control red if no results were found
-        if(!all_matches.empty())
-            QMessageBox::information(this, qApp->applicationName(), tr("%1 replacement(s) made.").arg(all_matches.size()));
+        if(num_replacements > 0)
+            QMessageBox::information(this, qApp->applicationName(), tr("%1 replacement(s) made.").arg(num_replacements));
         else
             ui->editFindExpression->setStyleSheet("QLineEdit {color: white; background-color: rgb(255, 102, 102)}");
     } break;
@@ -1,14 +1,37 @@
 #include "csvparser.h"
 
+#include <QFile>
 #include <QString>
 #include <QTextStream>
 
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <deque>
+#include <future>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CSVPARSER_SSE2
+#include <emmintrin.h>
+#if defined(__GNUC__) && !defined(__AVX2__)
+#define CSVPARSER_AVX2_DISPATCH
+#include <immintrin.h>
+#endif
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
 CSVParser::CSVParser(bool trimfields, char32_t fieldseparator, char32_t quotechar)
     : m_bTrimFields(trimfields)
     , m_iNumExtraBytesFieldSeparator(0)
     , m_iNumExtraBytesQuoteChar(0)
     , m_pCSVProgress(nullptr)
     , m_nBufferSize(4096)
+    , m_nChunkSize(1024 * 1024)
 {
     for(int i=0;i<4;i++)
     {
@@ -34,7 +57,7 @@ inline void addChar(CSVField* field, char c)
     // Increase buffer size if it is too small
     if(field->buffer_length >= field->buffer_max_length)
     {
-        field->buffer_max_length += 64;
+        field->buffer_max_length = std::max<uint64_t>(64, field->buffer_max_length * 2);
         field->buffer = static_cast<char*>(realloc(field->buffer, field->buffer_max_length));
     }
 
@@ -256,6 +279,7 @@ CSVParser::ParserResult CSVParser::parse(csvRowFunction insertFunction, QTextStr
                     // look ahead to check for linefeed
                     if(!look_ahead(stream, sBuffer, &it, &sBufferEnd, '\n'))
                     {
+                        state = StateNormal;
                         addColumn(record, field, m_bTrimFields);
 
                         if(!(field = addRow(insertFunction, record, parsedRows)))
@@ -323,3 +347,652 @@ bool CSVParser::look_ahead(QTextStream& stream, QByteArray& sBuffer, const char*
     // Check whether there actually is one more byte and it is the expected one
     return nit != *sBufferEnd && *nit == expected;
 }
+
+namespace {
+// Returns the index of the lowest set bit of a non-zero mask
+inline int lowestBit(unsigned int mask)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return static_cast<int>(index);
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+
+// Returns a pointer to the first byte in [p, end) which is equal to one of the four bytes in set or end if there is none.
+// Unused entries of set should repeat one of the others.
+inline const char* findAnyScalar(const char* p, const char* end, const char* set)
+{
+    for(;p<end;++p)
+    {
+        if(*p == set[0] || *p == set[1] || *p == set[2] || *p == set[3])
+            return p;
+    }
+    return end;
+}
+
+#ifdef CSVPARSER_SSE2
+const char* findAnySse2(const char* p, const char* end, const char* set)
+{
+    const __m128i s0 = _mm_set1_epi8(set[0]);
+    const __m128i s1 = _mm_set1_epi8(set[1]);
+    const __m128i s2 = _mm_set1_epi8(set[2]);
+    const __m128i s3 = _mm_set1_epi8(set[3]);
+
+    for(;end-p>=16;p+=16)
+    {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        const __m128i m = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, s0), _mm_cmpeq_epi8(v, s1)),
+                                       _mm_or_si128(_mm_cmpeq_epi8(v, s2), _mm_cmpeq_epi8(v, s3)));
+        const unsigned int mask = static_cast<unsigned int>(_mm_movemask_epi8(m));
+        if(mask)
+            return p + lowestBit(mask);
+    }
+    return findAnyScalar(p, end, set);
+}
+
+// Counts the bytes in [p, end) which are equal to c
+size_t countByteSse2(const char* p, const char* end, char c)
+{
+    const __m128i s = _mm_set1_epi8(c);
+    size_t count = 0;
+
+    while(end-p >= 16)
+    {
+        // Each byte lane of the accumulator counts up to 255 matches before it is summed up
+        __m128i acc = _mm_setzero_si128();
+        for(int i=0;i<255 && end-p>=16;i++,p+=16)
+            acc = _mm_sub_epi8(acc, _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)), s));
+        const __m128i sums = _mm_sad_epu8(acc, _mm_setzero_si128());
+        count += static_cast<size_t>(_mm_cvtsi128_si32(sums)) + static_cast<size_t>(_mm_cvtsi128_si32(_mm_srli_si128(sums, 8)));
+    }
+    return count + static_cast<size_t>(std::count(p, end, c));
+}
+#endif
+
+#ifdef CSVPARSER_AVX2_DISPATCH
+__attribute__((target("avx2"))) const char* findAnyAvx2(const char* p, const char* end, const char* set)
+{
+    const __m256i s0 = _mm256_set1_epi8(set[0]);
+    const __m256i s1 = _mm256_set1_epi8(set[1]);
+    const __m256i s2 = _mm256_set1_epi8(set[2]);
+    const __m256i s3 = _mm256_set1_epi8(set[3]);
+
+    for(;end-p>=32;p+=32)
+    {
+        const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        const __m256i m = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, s0), _mm256_cmpeq_epi8(v, s1)),
+                                          _mm256_or_si256(_mm256_cmpeq_epi8(v, s2), _mm256_cmpeq_epi8(v, s3)));
+        const unsigned int mask = static_cast<unsigned int>(_mm256_movemask_epi8(m));
+        if(mask)
+            return p + lowestBit(mask);
+    }
+    return findAnySse2(p, end, set);
+}
+
+const bool cpuHasAvx2 = __builtin_cpu_supports("avx2");
+#endif
+
+inline const char* findAny(const char* p, const char* end, const char* set)
+{
+#if defined(CSVPARSER_AVX2_DISPATCH)
+    return cpuHasAvx2 ? findAnyAvx2(p, end, set) : findAnySse2(p, end, set);
+#elif defined(CSVPARSER_SSE2)
+    return findAnySse2(p, end, set);
+#else
+    return findAnyScalar(p, end, set);
+#endif
+}
+
+inline size_t countByte(const char* p, const char* end, char c)
+{
+#ifdef CSVPARSER_SSE2
+    return countByteSse2(p, end, c);
+#else
+    return static_cast<size_t>(std::count(p, end, c));
+#endif
+}
+
+// A parsed field of a mapped file. Fields which are stored contiguously in the file are referenced directly, only the contents of
+// fields which are not, like those containing escaped quotes, are copied.
+struct MappedField
+{
+    uint64_t offset;                // Offset of the contents in the file or in the buffer of copied contents
+    uint64_t length;                // Length of the contents
+    bool copied;                    // Whether the contents have been copied
+};
+
+// This class parses a range of a memory-mapped file which starts at a record boundary. It implements the same state machine as
+// CSVParser::parse() for single-byte field separators and quote characters but skips over all bytes without special meaning at once.
+class MappedRangeParser
+{
+public:
+    enum States
+    {
+        StateNormal,
+        StateInQuote,
+        StateEndQuote
+    };
+
+    MappedRangeParser(const char* data, size_t size, char separator, char quote, bool trim)
+        : m_data(data), m_size(size), m_separator(separator), m_quote(quote), m_trim(trim)
+        , m_specials{separator, quote, '\r', '\n'}
+    {
+        startField();
+    }
+
+    std::vector<char> copied;           // Contents of the copied fields
+    std::vector<MappedField> fields;    // Fields of all parsed rows
+    std::vector<size_t> row_ends;       // Index of the first field after each parsed row
+
+    const char* fieldData(const MappedField& f) const { return (f.copied ? copied.data() : m_data) + f.offset; }
+
+    // Parses the bytes in [begin, end). If end is the end of the file, a pending last row is completed as well. rowComplete is called
+    // with the position after the row whenever a row has been parsed. If it returns false, parsing stops and false is returned.
+    template<typename F>
+    bool parse(size_t begin, size_t end, F rowComplete);
+
+    States state() const { return m_state; }
+
+private:
+    const char* m_data;
+    size_t m_size;
+    char m_separator;
+    char m_quote;
+    bool m_trim;
+    const char m_specials[4];
+
+    States m_state = StateNormal;
+    MappedField m_field;
+
+    void startField()
+    {
+        m_field = {0, 0, false};
+    }
+
+    void append(const char* p, size_t n)
+    {
+        if(n == 0)
+            return;
+
+        if(!m_field.copied)
+        {
+            // Extend the referenced contents as long as the new bytes directly follow them
+            if(m_field.length == 0)
+            {
+                m_field.offset = static_cast<uint64_t>(p - m_data);
+                m_field.length = n;
+                return;
+            } else if(m_data + m_field.offset + m_field.length == p) {
+                m_field.length += n;
+                return;
+            }
+
+            const char* contents = m_data + m_field.offset;
+            m_field.offset = copied.size();
+            m_field.copied = true;
+            copied.insert(copied.end(), contents, contents + m_field.length);
+        }
+
+        copied.insert(copied.end(), p, p + n);
+        m_field.length += n;
+    }
+
+    void finishField()
+    {
+        // Trim the field in the same way as addColumn() does
+        if(m_trim)
+        {
+            const char* contents = fieldData(m_field);
+            while(m_field.length && isspace(static_cast<unsigned char>(*contents)))
+            {
+                contents++;
+                m_field.offset++;
+                m_field.length--;
+            }
+            while(m_field.length && isspace(static_cast<unsigned char>(contents[m_field.length-1])))
+                m_field.length--;
+        }
+
+        fields.push_back(m_field);
+        startField();
+    }
+
+    // A carriage return only ends a row if it is not followed by a line feed
+    bool isLoneCarriageReturn(const char* p) const
+    {
+        return p + 1 == m_data + m_size || p[1] != '\n';
+    }
+};
+
+template<typename F>
+bool MappedRangeParser::parse(size_t begin, size_t end, F rowComplete)
+{
+    const char* p = m_data + begin;
+    const char* e = m_data + end;
+
+    auto finishRow = [&](const char* next) {
+        finishField();
+        row_ends.push_back(fields.size());
+        return rowComplete(static_cast<size_t>(next - m_data));
+    };
+
+    while(p < e)
+    {
+        switch(m_state)
+        {
+        case StateNormal:
+        {
+            const char* q = findAny(p, e, m_specials);
+            append(p, static_cast<size_t>(q - p));
+            if(q == e)
+            {
+                p = e;
+                break;
+            }
+
+            const char c = *q;
+            p = q + 1;
+            if(c == m_separator)
+            {
+                finishField();
+            } else if(c == m_quote) {
+                m_state = StateInQuote;
+            } else if(c == '\r') {
+                if(isLoneCarriageReturn(q) && !finishRow(p))
+                    return false;
+            } else {
+                if(!finishRow(p))
+                    return false;
+            }
+        }
+        break;
+        case StateInQuote:
+        {
+            const char* q = static_cast<const char*>(std::memchr(p, m_quote, static_cast<size_t>(e - p)));
+            if(!q)
+                q = e;
+            append(p, static_cast<size_t>(q - p));
+            if(q == e)
+            {
+                p = e;
+                break;
+            }
+
+            p = q + 1;
+            m_state = StateEndQuote;
+        }
+        break;
+        case StateEndQuote:
+        {
+            const char* q = p++;
+            const char c = *q;
+            if(c == m_quote)
+            {
+                m_state = StateInQuote;
+                append(q, 1);
+            } else if(c == m_separator) {
+                m_state = StateNormal;
+                finishField();
+            } else if(c == '\n') {
+                m_state = StateNormal;
+                if(!finishRow(p))
+                    return false;
+            } else if(c == '\r') {
+                if(isLoneCarriageReturn(q))
+                {
+                    m_state = StateNormal;
+                    if(!finishRow(p))
+                        return false;
+                }
+            } else {
+                m_state = StateNormal;
+                append(q, 1);
+            }
+        }
+        break;
+        }
+    }
+
+    // Complete the last row if the file does not end with a line break
+    const size_t rowStart = row_ends.empty() ? 0 : row_ends.back();
+    if(end == m_size && (fields.size() > rowStart || m_field.length))
+        return finishRow(e);
+
+    return true;
+}
+
+// Copies the fields of a parsed row into a row structure as handed to the insert function
+void fillRow(const MappedRangeParser& parser, size_t first, size_t last, std::vector<CSVField>& fieldBuffer, CSVRow& row)
+{
+    if(fieldBuffer.size() < last - first)
+        fieldBuffer.resize(last - first);
+
+    for(size_t i=first;i<last;i++)
+    {
+        const MappedField& f = parser.fields[i];
+        CSVField& field = fieldBuffer[i - first];
+        field.data = const_cast<char*>(parser.fieldData(f));
+        field.data_length = f.length;
+        field.buffer = field.data;
+        field.buffer_length = f.length;
+        field.buffer_max_length = 0;
+    }
+
+    row.fields = fieldBuffer.data();
+    row.num_fields = last - first;
+    row.max_num_fields = fieldBuffer.size();
+}
+
+// This class maps a file for parsing it directly from memory and unmaps it again when destroyed. Files starting with a UTF-16 or UTF-32
+// byte order mark are not mapped because they need to be decoded first.
+class MappedFile
+{
+public:
+    MappedFile(QFile& file, bool map)
+        : m_file(file), m_map(nullptr), m_begin(0), m_size(static_cast<size_t>(file.size()))
+    {
+        if(m_size && map)
+            m_map = file.map(0, file.size());
+
+        // Files with a UTF-16 or UTF-32 byte order mark need to be decoded, so don't map them. Skip a UTF-8 byte order mark.
+        if(m_map && m_size >= 2 && ((m_map[0] == 0xFF && m_map[1] == 0xFE) || (m_map[0] == 0xFE && m_map[1] == 0xFF)))
+        {
+            file.unmap(m_map);
+            m_map = nullptr;
+        } else if(m_map && m_size >= 3 && m_map[0] == 0xEF && m_map[1] == 0xBB && m_map[2] == 0xBF) {
+            m_begin = 3;
+        }
+    }
+
+    ~MappedFile()
+    {
+        if(m_map)
+            m_file.unmap(m_map);
+    }
+
+    const char* data() const { return reinterpret_cast<const char*>(m_map); }
+    size_t begin() const { return m_begin; }
+    size_t size() const { return m_size; }
+
+private:
+    QFile& m_file;
+    uchar* m_map;
+    size_t m_begin;     // Position of the first byte after the byte order mark
+    size_t m_size;
+};
+}
+
+CSVParser::ParserResult CSVParser::parse(csvRowFunction insertFunction, QFile& file, size_t nMaxRecords)
+{
+    const char separator = m_cFieldSeparator[0];
+    const char quote = m_cQuoteChar[0];
+
+    // Map the file if possible. For files in other Unicode encodings use the text stream which detects and decodes them.
+    MappedFile mapped(file, !m_iNumExtraBytesFieldSeparator && !m_iNumExtraBytesQuoteChar);
+    if(!mapped.data())
+    {
+        file.seek(0);
+        QTextStream stream(&file);
+#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+        stream.setCodec("UTF-8");
+#endif
+        return parse(insertFunction, stream, nMaxRecords);
+    }
+
+    const char* data = mapped.data();
+    const size_t begin = mapped.begin();
+    const size_t size = mapped.size();
+
+    if(m_pCSVProgress)
+        m_pCSVProgress->start();
+
+    size_t parsedRows = 0;
+    std::vector<CSVField> fieldBuffer(5);
+    CSVRow record;
+
+    // The file can only be split up if we know for sure which line breaks end a record. Each quote char toggles between being inside and
+    // outside of a quoted field, so this is only a matter of counting quote chars as long as they are not confused with any other char.
+    const size_t chunkSize = static_cast<size_t>(m_nChunkSize);
+    const size_t numChunks = (size - begin + chunkSize - 1) / chunkSize;
+    const bool canSplit = separator != quote && separator != '\r' && separator != '\n' && quote != '\r' && quote != '\n';
+
+    if(nMaxRecords > 0 || numChunks < 2 || !canSplit)
+    {
+        // Parse the file sequentially on this thread and hand each row to the caller right after parsing it
+        MappedRangeParser parser(data, size, separator, quote, m_bTrimFields);
+        ParserResult result = ParserResultSuccess;
+        size_t lastProgress = begin;
+
+        const bool finished = parser.parse(begin, size, [&](size_t pos) {
+            fillRow(parser, 0, parser.row_ends.back(), fieldBuffer, record);
+            if(!insertFunction(parsedRows, record))
+            {
+                result = ParserResultError;
+                return false;
+            }
+            parsedRows++;
+
+            // Start over with empty buffers for the next row
+            parser.fields.clear();
+            parser.row_ends.clear();
+            parser.copied.clear();
+
+            if(nMaxRecords > 0 && parsedRows >= nMaxRecords)
+                return false;
+
+            if(m_pCSVProgress && pos - lastProgress >= chunkSize)
+            {
+                lastProgress = pos;
+                if(!m_pCSVProgress->update(static_cast<int64_t>(pos)))
+                {
+                    result = ParserResultCancelled;
+                    return false;
+                }
+            }
+
+            return true;
+        });
+        if(!finished)
+            return result;
+
+        if(m_pCSVProgress)
+            m_pCSVProgress->end();
+
+        return parser.state() == MappedRangeParser::StateInQuote ? ParserResultUnexpectedEOF : ParserResultSuccess;
+    }
+
+    const size_t numThreads = std::max<size_t>(2, std::thread::hardware_concurrency());
+    auto chunkStart = [begin, chunkSize, size](size_t chunk) { return std::min(begin + chunk * chunkSize, size); };
+
+    // First pass: count the quote chars in each chunk in parallel and determine whether each chunk starts inside a quoted field
+    std::vector<char> startsInQuote(numChunks + 1, false);
+    {
+        std::vector<std::future<void>> counters;
+        std::vector<size_t> quoteCounts(numChunks);
+        for(size_t t=0;t<numThreads;t++)
+        {
+            counters.push_back(std::async(std::launch::async, [&, t]() {
+                for(size_t i=numChunks*t/numThreads;i<numChunks*(t+1)/numThreads;i++)
+                    quoteCounts[i] = countByte(data + chunkStart(i), data + chunkStart(i+1), quote);
+            }));
+        }
+        for(auto& c : counters)
+            c.get();
+
+        for(size_t i=0;i<numChunks;i++)
+            startsInQuote[i+1] = startsInQuote[i] ^ (quoteCounts[i] & 1);
+    }
+
+    // Returns the first record boundary at or after the start of the specified chunk
+    auto recordStart = [&](size_t chunk) -> size_t {
+        if(chunk == 0)
+            return begin;
+        if(chunk >= numChunks)
+            return size;
+
+        size_t pos = chunkStart(chunk);
+        bool inQuote = startsInQuote[chunk];
+        if(!inQuote && (data[pos-1] == '\n' || (data[pos-1] == '\r' && data[pos] != '\n')))
+            return pos;
+
+        const char specials[4] = {quote, '\r', '\n', '\n'};
+        const char* end = data + size;
+        for(const char* p=data+pos;;p++)
+        {
+            p = findAny(p, end, specials);
+            if(p == end)
+                return size;
+            else if(*p == quote)
+                inQuote = !inQuote;
+            else if(!inQuote && (*p == '\n' || p + 1 == end || p[1] != '\n'))
+                return static_cast<size_t>(p - data) + 1;
+        }
+    };
+
+    struct ParsedChunk
+    {
+        std::unique_ptr<MappedRangeParser> parser;
+        size_t begin;
+        size_t end;
+    };
+
+    // Second pass: parse the chunks in parallel while handing their rows to the caller in order. Only a limited number of chunks is
+    // parsed ahead in order to bound the memory usage.
+    std::deque<std::future<ParsedChunk>> pending;
+    size_t nextChunk = 0;
+    auto startChunk = [&]() {
+        const size_t chunk = nextChunk++;
+        pending.push_back(std::async(std::launch::async, [&, chunk]() {
+            ParsedChunk result;
+            result.parser.reset(new MappedRangeParser(data, size, separator, quote, m_bTrimFields));
+            result.begin = recordStart(chunk);
+            result.end = recordStart(chunk + 1);
+            result.parser->parse(result.begin, result.end, [](size_t) { return true; });
+            return result;
+        }));
+    };
+
+    MappedRangeParser::States state = MappedRangeParser::StateNormal;
+    while(nextChunk < numChunks || !pending.empty())
+    {
+        while(nextChunk < numChunks && pending.size() < 2 * numThreads)
+            startChunk();
+
+        ParsedChunk chunk = pending.front().get();
+        pending.pop_front();
+
+        size_t first = 0;
+        for(size_t last : chunk.parser->row_ends)
+        {
+            fillRow(*chunk.parser, first, last, fieldBuffer, record);
+            if(!insertFunction(parsedRows, record))
+                return ParserResultError;
+            parsedRows++;
+            first = last;
+        }
+
+        // A chunk can be empty if a record spans several chunks. Only the state of the chunk which actually ends the file matters.
+        if(chunk.begin < chunk.end)
+            state = chunk.parser->state();
+
+        if(m_pCSVProgress && !m_pCSVProgress->update(static_cast<int64_t>(chunk.end)))
+            return ParserResultCancelled;
+    }
+
+    if(m_pCSVProgress)
+        m_pCSVProgress->end();
+
+    return state == MappedRangeParser::StateInQuote ? ParserResultUnexpectedEOF : ParserResultSuccess;
+}
+
+CSVParser::ParserResult CSVParser::sample(csvRowFunction insertFunction, QFile& file, size_t nHeadRecords, size_t nBlocks, int64_t blockSize)
+{
+    const char separator = m_cFieldSeparator[0];
+    const char quote = m_cQuoteChar[0];
+
+    nHeadRecords = std::max<size_t>(nHeadRecords, 1);
+
+    // Files which cannot be mapped are only read up to the end of the head
+    MappedFile mapped(file, !m_iNumExtraBytesFieldSeparator && !m_iNumExtraBytesQuoteChar);
+    if(!mapped.data())
+    {
+        file.seek(0);
+        QTextStream stream(&file);
+#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+        stream.setCodec("UTF-8");
+#endif
+        return parse(insertFunction, stream, nHeadRecords);
+    }
+
+    const char* data = mapped.data();
+    const size_t size = mapped.size();
+
+    size_t parsedRows = 0;
+    std::vector<CSVField> fieldBuffer(5);
+    CSVRow record;
+    bool failed = false;
+
+    // Parses rows starting at begin for as long as the more function returns true for the position after the last parsed row. No row
+    // is read beyond limit. The end of the last parsed row is stored in end.
+    auto parseRows = [&](MappedRangeParser& parser, size_t begin, size_t limit, size_t& end, std::function<bool(size_t)> more) {
+        end = begin;
+        return parser.parse(begin, limit, [&](size_t pos) {
+            fillRow(parser, 0, parser.row_ends.back(), fieldBuffer, record);
+            if(!insertFunction(parsedRows, record))
+            {
+                failed = true;
+                return false;
+            }
+            parsedRows++;
+            end = pos;
+
+            parser.fields.clear();
+            parser.row_ends.clear();
+            parser.copied.clear();
+
+            return more(pos);
+        });
+    };
+
+    // Read the head of the file
+    MappedRangeParser head(data, size, separator, quote, m_bTrimFields);
+    size_t headEnd;
+    const bool headIsFile = parseRows(head, mapped.begin(), size, headEnd, [&](size_t) { return parsedRows < nHeadRecords; });
+    if(failed)
+        return ParserResultError;
+    if(headIsFile)
+        return head.state() == MappedRangeParser::StateInQuote ? ParserResultUnexpectedEOF : ParserResultSuccess;
+
+    // Read the blocks, spread evenly across the rest of the file. Apart from the first one they start after the next line break, which
+    // might be inside a quoted field. So the rows of a block might not be aligned with the records of the file and the caller needs to
+    // be prepared for that. Because of this, each block is also limited to twice its size in case its last row does not seem to end.
+    const size_t rest = size - headEnd;
+    const size_t block = static_cast<size_t>(std::max<int64_t>(blockSize, 1));
+    size_t previousEnd = headEnd;
+    for(size_t i=0;i<nBlocks;i++)
+    {
+        size_t begin = headEnd + static_cast<size_t>(static_cast<double>(rest) * static_cast<double>(i) / static_cast<double>(nBlocks));
+        if(begin <= previousEnd)
+        {
+            begin = previousEnd;
+        } else {
+            const char* lineBreak = static_cast<const char*>(std::memchr(data + begin, '\n', size - begin));
+            if(!lineBreak)
+                break;
+            begin = static_cast<size_t>(lineBreak - data) + 1;
+        }
+        if(begin >= size)
+            break;
+
+        const size_t stop = std::min(size, begin + block);
+        MappedRangeParser parser(data, size, separator, quote, m_bTrimFields);
+        parseRows(parser, begin, std::min(size, begin + 2 * block), previousEnd, [stop](size_t pos) { return pos < stop; });
+        if(failed)
+            return ParserResultError;
+    }
+
+    return ParserResultSuccess;
+}
@@ -6,6 +6,7 @@
 #include <cstddef>
 
 class QByteArray;
+class QFile;
 class QTextStream;
 
 /*!
@@ -74,8 +75,47 @@ public:
      */
     ParserResult parse(csvRowFunction insertFunction, QTextStream& stream, size_t nMaxRecords = 0);
 
+    /*!
+     * \brief parse the given UTF-8 encoded file
+     *
+     * The file is memory-mapped and, unless only a limited number of records is read, split into chunks at record boundaries which
+     * are parsed on several threads. The rows are still passed to the insert function one after the other, in order, and from the
+     * calling thread. The data pointers of the fields may point directly into the mapped file and must not be written to.
+     * Files which cannot be mapped, which start with a UTF-16 or UTF-32 byte order mark, or which are parsed using a multi-byte field
+     * separator or quote character are read through a QTextStream instead.
+     * @param insertFunction See above.
+     * \param file Open file with the CSV data
+     * \param nMaxRecords Max records to read, 0 if unlimited
+     * \return ParserResult value that indicated whether action finished normally, was cancelled or errored.
+     */
+    ParserResult parse(csvRowFunction insertFunction, QFile& file, size_t nMaxRecords = 0);
+
+    /*!
+     * \brief parse a sample of the rows of the given UTF-8 encoded file
+     *
+     * This reads the first records of the file and then a number of blocks spread evenly across the rest of it, so the time it takes
+     * does not depend on the size of the file. The file is memory-mapped and the rows are passed to the insert function like parse()
+     * does. Apart from the first one, each block starts after a line break which might be part of a quoted field, so the rows of a
+     * block might not match the records of the file. Their row numbers are counted on from the head and are not the record numbers
+     * in the file. Files which cannot be mapped are only read up to the end of the head.
+     * @param insertFunction See above.
+     * \param file Open file with the CSV data
+     * \param nHeadRecords Number of records to read from the start of the file, at least one
+     * \param nBlocks Number of blocks to read from the rest of the file
+     * \param blockSize Approximate size of each block in bytes. Blocks are extended to the end of their last row, but never to more than
+     *                  twice this size.
+     * \return ParserResult value that indicated whether action finished normally or errored.
+     */
+    ParserResult sample(csvRowFunction insertFunction, QFile& file, size_t nHeadRecords, size_t nBlocks, int64_t blockSize);
+
     void setCSVProgress(CSVProgress* csvp) { m_pCSVProgress = csvp; }
 
+    /*!
+     * \brief set the size of the chunks a mapped file is split into for parsing it in parallel
+     * \param bytes Approximate chunk size in bytes. The actual chunks are extended up to the next record boundary.
+     */
+    void setChunkSize(int64_t bytes) { m_nChunkSize = bytes > 0 ? bytes : 1; }
+
 private:
     enum ParseStates
     {
@@ -93,6 +133,7 @@ private:
     CSVProgress* m_pCSVProgress;
 
     int64_t m_nBufferSize;        //! internal buffer read size
+    int64_t m_nChunkSize;         //! size of the chunks mapped files are split into
 
     bool look_ahead(QTextStream& stream, QByteArray& sBuffer, const char** it, const char** sBufferEnd, char expected);
 };
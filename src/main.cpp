@@ -1,5 +1,6 @@
 
 #include "Application.h"
+#include "HeadlessRunner.h"
 #include "sqlite.h"
 #include <QMessageBox>
 
@@ -29,6 +30,13 @@ void boxMessageOutput(QtMsgType, const QMessageLogContext &, const QString &msg)
 
 int main( int argc, char ** argv )
 {
+    // Exports and imports requested on the command line can run without any user interface. This doesn't need a display.
+    if(HeadlessRunner::isRequested(argc, argv))
+    {
+        QCoreApplication a(argc, argv);
+        return HeadlessRunner(a.arguments()).run();
+    }
+
 #if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
 #if QT_VERSION >= QT_VERSION_CHECK(5, 6, 0)
     QApplication::setAttribute(Qt::AA_EnableHighDpiScaling, true);
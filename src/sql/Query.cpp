@@ -71,31 +71,34 @@ std::string Query::buildWherePart() const
     return where;
 }
 
-std::string Query::buildQuery(bool withRowid) const
+std::string Query::buildRowIdSelector() const
+{
+    // We select the rowid data into a JSON array in case there are multiple rowid columns in order to have all values at hand.
+    // If there is only one rowid column, we leave it as is.
+    if(m_rowid_columns.size() == 1)
+    {
+        // As of SQLite 3.36 when selecting rowid from a view SQLite does not return NULL anymore but instead returns "rowid" and throws
+        // an error. To avoid that error (we don't actually care for the value of this column, so the value is not the issue here) we
+        // explicitly select NULL (without any quotes) here.
+        if(m_is_view && !hasCustomRowIdColumn())
+            return "NULL";
+        else
+            return sqlb::escapeIdentifier(m_rowid_columns.at(0));
+    } else {
+        std::string selector = "sqlb_make_single_value(";
+        for(size_t i=0;i<m_rowid_columns.size();i++)
+            selector += sqlb::escapeIdentifier(m_rowid_columns.at(i)) + ",";
+        selector.pop_back();    // Remove the last comma
+        return selector + ")";
+    }
+}
+
+std::string Query::buildSelectorPart(bool withRowid) const
 {
     // Selector and display formats
     std::string selector;
     if (withRowid)
-    {
-        // We select the rowid data into a JSON array in case there are multiple rowid columns in order to have all values at hand.
-        // If there is only one rowid column, we leave it as is.
-        if(m_rowid_columns.size() == 1)
-        {
-            // As of SQLite 3.36 when selecting rowid from a view SQLite does not return NULL anymore but instead returns "rowid" and throws
-            // an error. To avoid that error (we don't actually care for the value of this column, so the value is not the issue here) we
-            // explicitly select NULL (without any quotes) here.
-            if(m_is_view && !hasCustomRowIdColumn())
-                selector = "NULL,";
-            else
-                selector = sqlb::escapeIdentifier(m_rowid_columns.at(0)) + ",";
-        } else {
-            selector += "sqlb_make_single_value(";
-            for(size_t i=0;i<m_rowid_columns.size();i++)
-                selector += sqlb::escapeIdentifier(m_rowid_columns.at(i)) + ",";
-            selector.pop_back();    // Remove the last comma
-            selector += "),";
-        }
-    }
+        selector = buildRowIdSelector() + ",";
 
     if(m_selected_columns.empty())
     {
@@ -111,20 +114,41 @@ std::string Query::buildQuery(bool withRowid) const
         selector.pop_back();
     }
 
+    return selector;
+}
+
+std::string Query::buildQuery(bool withRowid) const
+{
+    // Selector and display formats
+    std::string selector = buildSelectorPart(withRowid);
+
     // Filter
     std::string where = buildWherePart();
 
-    // Sorting
+    return "SELECT " + selector + " FROM " + m_table.toString() + " " + where + " " + buildOrderByPart(buildRowIdSelector());
+}
+
+std::string Query::buildOrderByPart(const std::string& rowid) const
+{
     std::string order_by;
     for(const auto& sorted_column : m_sort)
         order_by += sorted_column.toSql() + ",";
+
+    // Sort by the rowid last. Without this the order of rows with the same values in the sorted columns, or of all rows if there is no
+    // sort order, is undefined and the rows might be numbered differently by different queries. Views without rowid can't be sorted this way.
+    const bool sorted_by_rowid = m_rowid_columns.size() == 1 && std::any_of(m_sort.begin(), m_sort.end(), [this](const OrderBy& o) {
+        return !o.is_expression && o.expr == m_rowid_columns.front();
+    });
+    if(!sorted_by_rowid && !m_rowid_columns.empty() && !(m_is_view && !hasCustomRowIdColumn()))
+        order_by += rowid + " ASC,";
+
     if(order_by.size())
     {
         order_by.pop_back();
         order_by = "ORDER BY " + order_by;
     }
 
-    return "SELECT " + selector + " FROM " + m_table.toString() + " " + where + " " + order_by;
+    return order_by;
 }
 
 std::string Query::buildCountQuery() const
@@ -133,6 +157,133 @@ std::string Query::buildCountQuery() const
     return "SELECT COUNT(*) FROM " + m_table.toString() + " " + buildWherePart();
 }
 
+std::string Query::buildKeysetWherePart(const std::string& key_column, bool anchored) const
+{
+    std::string where = buildWherePart();
+    if(!anchored)
+        return where;
+
+    // Wrap the user filters in parentheses to make sure the key condition applies to all of them
+    const std::string key_condition = sqlb::escapeIdentifier(key_column) +
+            ((m_sort.empty() || m_sort.front().direction == OrderBy::Ascending) ? " >= ?1" : " <= ?1");
+    if(where.empty())
+        return "WHERE " + key_condition;
+    return "WHERE (" + where.substr(6) + ") AND " + key_condition;
+}
+
+std::string Query::buildKeysetOrderPart(const std::string& key_column) const
+{
+    // Without any explicit sort order we sort by the key column in ascending order. This is the natural order of rowid tables
+    // and WITHOUT ROWID tables anyway but we need it to be guaranteed for the keyset conditions to work.
+    const OrderBy::SortDirection direction = m_sort.empty() ? OrderBy::Ascending : m_sort.front().direction;
+    return "ORDER BY " + OrderBy(key_column, direction).toSql();
+}
+
+std::string Query::buildKeysetQuery(const std::string& key_column, bool anchored) const
+{
+    return "SELECT " + buildSelectorPart(true) + " FROM " + m_table.toString() + " " + buildKeysetWherePart(key_column, anchored) + " " +
+            buildKeysetOrderPart(key_column);
+}
+
+std::string Query::buildKeysetAnchorQuery(const std::string& key_column, bool anchored) const
+{
+    return "SELECT " + sqlb::escapeIdentifier(key_column) + " FROM " + m_table.toString() + " " + buildKeysetWherePart(key_column, anchored) + " " +
+            buildKeysetOrderPart(key_column);
+}
+
+std::string Query::buildFindQuery(const std::vector<std::string>& columns, const std::function<std::string(const std::string&)>& condition,
+                                  const std::string& key_column, bool reverse) const
+{
+    // The rows to search in are the ones of buildQuery(). The rowid column gets the name it has in the list of column names, so it can
+    // be referred to like all other columns.
+    std::string rowid_name;
+    for(const auto& rowid : m_rowid_columns)
+        rowid_name += rowid + ",";
+    if(!rowid_name.empty())
+        rowid_name.pop_back();
+    const std::string rows = "SELECT " + buildRowIdSelector() + " AS " + sqlb::escapeIdentifier(rowid_name) + "," + buildSelectorPart(false) +
+            " FROM " + m_table.toString() + " " + buildWherePart();
+
+    // Evaluate the condition once for each column of the rows in the range only
+    std::string matches;
+    std::string any_match;
+    for(size_t i=0;i<columns.size();i++)
+    {
+        const std::string match = "(" + condition(sqlb::escapeIdentifier(columns.at(i))) + ")";
+        matches += "," + match + " AS sqlb_match" + std::to_string(i);
+        any_match += match + " OR ";
+    }
+    if(!any_match.empty())
+        any_match.erase(any_match.size() - 4);
+    else
+        any_match = "0";
+
+    // Number the rows in the same order as the query which loads them does. This is all the inner query does, so the numbering
+    // doesn't have to wait for the conditions to be evaluated for all rows.
+    const std::string order_by = key_column.empty() ? buildOrderByPart(sqlb::escapeIdentifier(rowid_name)) : buildKeysetOrderPart(key_column);
+
+    return "SELECT sqlb_row" + matches + " FROM (SELECT ROW_NUMBER() OVER (" + order_by + ") - 1 AS sqlb_row,* FROM (" + rows + ")) "
+            "WHERE sqlb_row BETWEEN ?1 AND ?2 AND (" + any_match + ") ORDER BY sqlb_row " + (reverse ? "DESC" : "ASC");
+}
+
+std::string Query::buildUpdateQuery(const std::string& column, const std::string& condition, const std::string& value) const
+{
+    // Only change the rows which pass the filters
+    std::string where = "WHERE (" + condition + ")";
+    const std::string filters = buildWherePart();
+    if(!filters.empty())
+        where += " AND " + filters.substr(6);   // Remove the 'WHERE '
+
+    return "UPDATE " + m_table.toString() + " SET " + sqlb::escapeIdentifier(column) + "=" + value + " " + where;
+}
+
+std::vector<std::string> Query::buildRowCountEstimateQueries() const
+{
+    // An estimate of the unfiltered table size is no use for a filtered query
+    if(m_is_view || !m_where.empty() || !m_global_where.empty())
+        return {};
+
+    // The first number in the statistics collected by ANALYZE is the number of rows in the table. These are probably slightly out
+    // of date but that doesn't matter for an estimate.
+    const std::string schema = m_table.schema().empty() ? "main" : m_table.schema();
+    std::vector<std::string> queries = {
+        "SELECT CAST(stat AS INTEGER) FROM " + sqlb::escapeIdentifier(schema) + ".sqlite_stat1 WHERE tbl=" + sqlb::escapeString(m_table.name()) + " LIMIT 1;"
+    };
+
+    // Otherwise, without too many deleted rows, the range of rowids is a good estimate. Both ends can be looked up in the table b-tree
+    // directly.
+    if(!hasCustomRowIdColumn())
+        queries.push_back("SELECT max(_rowid_) - min(_rowid_) + 1 FROM " + m_table.toString() + ";");
+
+    return queries;
+}
+
+std::string Query::buildKeyRangeQuery() const
+{
+    if(m_is_view || m_rowid_columns.size() != 1)
+        return std::string();
+
+    const std::string key = sqlb::escapeIdentifier(m_rowid_columns.at(0));
+    return "SELECT min(" + key + "), max(" + key + ") FROM " + m_table.toString() + ";";
+}
+
+std::string Query::buildRangeCountQuery() const
+{
+    if(m_is_view || m_rowid_columns.size() != 1)
+        return std::string();
+
+    // Wrap the user filters in parentheses to make sure the range condition applies to all of them
+    const std::string key = sqlb::escapeIdentifier(m_rowid_columns.at(0));
+    const std::string range_condition = key + " >= ?1 AND " + key + " < ?2";
+    std::string where = buildWherePart();
+    if(where.empty())
+        where = "WHERE " + range_condition;
+    else
+        where = "WHERE (" + where.substr(6) + ") AND " + range_condition;
+
+    return "SELECT COUNT(*) FROM " + m_table.toString() + " " + where + ";";
+}
+
 std::vector<SelectedColumn>::iterator Query::findSelectedColumnByName(const std::string& name)
 {
     return std::find_if(m_selected_columns.begin(), m_selected_columns.end(), [name](const SelectedColumn& c) {
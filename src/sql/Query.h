@@ -3,6 +3,7 @@
 
 #include "ObjectIdentifier.h"
 
+#include <functional>
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -69,6 +70,36 @@ public:
     std::string buildQuery(bool withRowid) const;
     std::string buildCountQuery() const;
 
+    // These build queries for keyset pagination. They require the given key column to be unique and not null and the query to be
+    // sorted by this column alone (or not at all, in which case ascending order is assumed). The keyset query returns the same
+    // columns as buildQuery(true) in key order. When anchored is set, it is further restricted to rows with a key value equal to or
+    // following the value of the first bound parameter. The anchor query returns the values of the key column only, in the same order
+    // and with the same restriction when anchored.
+    std::string buildKeysetQuery(const std::string& key_column, bool anchored) const;
+    std::string buildKeysetAnchorQuery(const std::string& key_column, bool anchored) const;
+
+    // This builds a query for searching the rows returned by buildQuery(). The rows are numbered in the same order, starting with 0,
+    // using the order of the keyset query if a key column is given. The condition function returns an expression for a column which is
+    // true if the value of the column matches. The query checks the given columns of the rows from the row number in the first bound
+    // parameter up to the one in the second bound parameter. For each row with a match, it returns the row number followed by the result
+    // of the condition for each column. The rows are returned in ascending order or, if reverse is set, in descending order. The
+    // conditions may use bound parameters starting from the third one.
+    std::string buildFindQuery(const std::vector<std::string>& columns, const std::function<std::string(const std::string&)>& condition,
+                               const std::string& key_column, bool reverse) const;
+
+    // This builds a statement which sets a column to a new value in all rows returned by buildQuery() for which the condition is true.
+    // The condition and the new value are SQL expressions which refer to the escaped column.
+    std::string buildUpdateQuery(const std::string& column, const std::string& condition, const std::string& value) const;
+
+    // These build queries for determining the number of rows quickly. The estimate queries return an approximate number of rows each,
+    // they are only available when there are no filters. The key range query returns the smallest and the largest value of the rowid
+    // column and the range count query counts the filtered rows with a rowid value from the first bound parameter up to but excluding
+    // the second one. Counting several such ranges at the same time is faster than counting all rows at once. Both are empty when the
+    // rows are not identified by a single rowid column.
+    std::vector<std::string> buildRowCountEstimateQueries() const;
+    std::string buildKeyRangeQuery() const;
+    std::string buildRangeCountQuery() const;
+
     void setColumnNames(const std::vector<std::string>& column_names) { m_column_names = column_names; }
     std::vector<std::string> columnNames() const { return m_column_names; }
 
@@ -106,7 +137,12 @@ private:
 
     std::vector<SelectedColumn>::iterator findSelectedColumnByName(const std::string& name);
     std::vector<SelectedColumn>::const_iterator findSelectedColumnByName(const std::string& name) const;
+    std::string buildRowIdSelector() const;
+    std::string buildSelectorPart(bool withRowid) const;
+    std::string buildOrderByPart(const std::string& rowid) const;
     std::string buildWherePart() const;
+    std::string buildKeysetWherePart(const std::string& key_column, bool anchored) const;
+    std::string buildKeysetOrderPart(const std::string& key_column) const;
 };
 
 }
@@ -16,6 +16,10 @@ ParserDriver::ParserDriver() :
 
 int ParserDriver::parse(const std::string& s)
 {
+    // Don't keep anything from a previous run when the driver is reused
+    result = nullptr;
+    last_table_column = nullptr;
+
     source = s;
     begin_scan();
 
@@ -2,12 +2,35 @@
 #include "ObjectIdentifier.h"
 #include "parser/ParserDriver.h"
 
+#include <atomic>
+#include <cstdint>
+#include <future>
 #include <iostream>
 #include <iterator>
 #include <numeric>
+#include <thread>
 
 namespace sqlb {
 
+namespace {
+// Run the given parser on a CREATE statement. If parsing fails, an empty object of the expected type is returned.
+template<typename T>
+std::shared_ptr<T> parseObject(parser::ParserDriver& drv, const std::string& sSQL)
+{
+    if(!drv.parse(sSQL))
+    {
+        std::shared_ptr<T> object = std::dynamic_pointer_cast<T>(drv.result);
+        object->setOriginalSql(sSQL);
+        return object;
+    } else {
+        std::cerr << "Sqlite parse error: " << sSQL << std::endl;
+        std::shared_ptr<T> object = std::make_shared<T>("");
+        object->setOriginalSql(sSQL);
+        return object;
+    }
+}
+}
+
 StringVector escapeIdentifier(StringVector ids)
 {
     std::transform(ids.begin(), ids.end(), ids.begin(), [](const std::string& id) {
@@ -343,17 +366,7 @@ StringVector Table::rowidColumns() const
 TablePtr Table::parseSQL(const std::string& sSQL)
 {
     parser::ParserDriver drv;
-    if(!drv.parse(sSQL))
-    {
-        TablePtr t = std::dynamic_pointer_cast<Table>(drv.result);
-        t->setOriginalSql(sSQL);
-        return t;
-    } else {
-        std::cerr << "Sqlite parse error: " << sSQL << std::endl;
-        TablePtr t = std::make_shared<Table>("");
-        t->setOriginalSql(sSQL);
-        return t;
-    }
+    return parseObject<Table>(drv, sSQL);
 }
 
 std::string Table::sql(const std::string& schema, bool ifNotExists) const
@@ -644,17 +657,7 @@ std::string Index::sql(const std::string& schema, bool ifNotExists) const
 IndexPtr Index::parseSQL(const std::string& sSQL)
 {
     parser::ParserDriver drv;
-    if(!drv.parse(sSQL))
-    {
-        IndexPtr i = std::dynamic_pointer_cast<Index>(drv.result);
-        i->setOriginalSql(sSQL);
-        return i;
-    } else {
-        std::cerr << "Sqlite parse error: " << sSQL << std::endl;
-        IndexPtr i = std::make_shared<Index>("");
-        i->setOriginalSql(sSQL);
-        return i;
-    }
+    return parseObject<Index>(drv, sSQL);
 }
 
 template<>
@@ -690,4 +693,446 @@ std::string getBaseTable<Trigger>(TriggerPtr object)
     return object->table();
 }
 
+std::vector<ObjectPtr> parseSchema(const std::vector<std::pair<std::string, std::string>>& statements, size_t threads)
+{
+    std::vector<ObjectPtr> objects(statements.size());
+
+    // The workers take a few statements at a time until there are none left. Each worker has its own parser because the parser keeps
+    // its state in the driver object. Every object is stored at the position of its statement, so the order doesn't depend on timing.
+    const size_t blockSize = 16;
+    std::atomic<size_t> next(0);
+    auto work = [&]() {
+        parser::ParserDriver drv;
+        size_t begin;
+        while((begin = next.fetch_add(blockSize)) < statements.size())
+        {
+            const size_t end = std::min(begin + blockSize, statements.size());
+            for(size_t i=begin;i<end;i++)
+            {
+                const std::string& type = statements[i].first;
+                const std::string& sql = statements[i].second;
+                if(type == "table")
+                    objects[i] = parseObject<Table>(drv, sql);
+                else if(type == "index")
+                    objects[i] = parseObject<Index>(drv, sql);
+                else if(type == "view")
+                    objects[i] = View::parseSQL(sql);
+                else if(type == "trigger")
+                    objects[i] = Trigger::parseSQL(sql);
+            }
+        }
+    };
+
+    // Don't start more threads than there are blocks of statements. The calling thread does its share of the work, too.
+    if(threads == 0)
+        threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+    threads = std::min(threads, (statements.size() + blockSize - 1) / blockSize);
+
+    std::vector<std::future<void>> workers;
+    for(size_t t=1;t<threads;t++)
+        workers.push_back(std::async(std::launch::async, work));
+    work();
+    for(auto& w : workers)
+        w.get();
+
+    return objects;
+}
+
+namespace {
+// Version of the format written by serialiseSchema(). This needs to be increased whenever the format or the classes it stores change.
+constexpr unsigned char serialisationVersion = 1;
+
+enum class SerialisedType : unsigned char
+{
+    None,
+    Table,
+    View,
+    Index,
+    Trigger,
+};
+
+// Numbers are stored with seven bits per byte, the highest bit indicating whether more bytes follow. Strings are stored as
+// their length followed by their bytes.
+class SchemaWriter
+{
+public:
+    explicit SchemaWriter(std::string& data) : m_data(data) {}
+
+    void writeNumber(uint64_t value)
+    {
+        while(value >= 0x80)
+        {
+            m_data.push_back(static_cast<char>((value & 0x7f) | 0x80));
+            value >>= 7;
+        }
+        m_data.push_back(static_cast<char>(value));
+    }
+
+    void writeBool(bool value) { m_data.push_back(value ? 1 : 0); }
+
+    void writeString(const std::string& value)
+    {
+        writeNumber(value.size());
+        m_data.append(value);
+    }
+
+    void writeStrings(const StringVector& values)
+    {
+        writeNumber(values.size());
+        for(const auto& value : values)
+            writeString(value);
+    }
+
+    void writeIndexedColumns(const IndexedColumnVector& columns)
+    {
+        writeNumber(columns.size());
+        for(const auto& column : columns)
+        {
+            writeString(column.name());
+            writeBool(column.expression());
+            writeString(column.order());
+        }
+    }
+
+    // Optional constraints are stored as a flag followed by their name and their own data if they exist
+    template<typename T, typename F>
+    void writeConstraint(const std::shared_ptr<T>& constraint, F writeData)
+    {
+        writeBool(constraint != nullptr);
+        if(constraint)
+        {
+            writeString(constraint->name());
+            writeData(*constraint);
+        }
+    }
+
+private:
+    std::string& m_data;
+};
+
+// Reading stops at the first error. All further reads return empty values then, so the callers only need to check the result at the end.
+class SchemaReader
+{
+public:
+    explicit SchemaReader(const std::string& data) : m_data(data), m_pos(0), m_ok(true) {}
+
+    bool ok() const { return m_ok; }
+    bool atEnd() const { return m_pos == m_data.size(); }
+
+    uint64_t readNumber()
+    {
+        uint64_t value = 0;
+        for(unsigned int shift=0;m_ok;shift+=7)
+        {
+            if(m_pos >= m_data.size() || shift > 63)
+            {
+                m_ok = false;
+                break;
+            }
+
+            const unsigned char byte = static_cast<unsigned char>(m_data[m_pos++]);
+            value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if(!(byte & 0x80))
+                return value;
+        }
+        return 0;
+    }
+
+    bool readBool() { return readNumber() != 0; }
+
+    // Reads the number of items of a list. Every item takes at least one byte, so the count can be checked against the remaining data
+    // before allocating anything.
+    size_t readCount()
+    {
+        const uint64_t count = readNumber();
+        if(count > m_data.size() - m_pos)
+        {
+            m_ok = false;
+            return 0;
+        }
+        return static_cast<size_t>(count);
+    }
+
+    std::string readString()
+    {
+        const size_t size = readCount();
+        std::string value = m_data.substr(m_pos, size);
+        m_pos += size;
+        return value;
+    }
+
+    StringVector readStrings()
+    {
+        StringVector values(readCount());
+        for(auto& value : values)
+            value = readString();
+        return values;
+    }
+
+    IndexedColumnVector readIndexedColumns()
+    {
+        IndexedColumnVector columns(readCount());
+        for(auto& column : columns)
+        {
+            column.setName(readString());
+            column.setExpression(readBool());
+            column.setOrder(readString());
+        }
+        return columns;
+    }
+
+    template<typename T, typename F>
+    std::shared_ptr<T> readConstraint(F readData)
+    {
+        if(!readBool() || !m_ok)
+            return nullptr;
+
+        const std::string name = readString();
+        std::shared_ptr<T> constraint = readData();
+        constraint->setName(name);
+        return constraint;
+    }
+
+private:
+    const std::string& m_data;
+    size_t m_pos;
+    bool m_ok;
+};
+
+void writeField(SchemaWriter& writer, const Field& field)
+{
+    writer.writeString(field.name());
+    writer.writeString(field.type());
+    writer.writeConstraint(field.notNullConstraint(), [&writer](const NotNullConstraint& c) { writer.writeString(c.conflictAction()); });
+    writer.writeConstraint(field.checkConstraint(), [&writer](const CheckConstraint& c) { writer.writeString(c.expression()); });
+    writer.writeConstraint(field.defaultConstraint(), [&writer](const DefaultConstraint& c) { writer.writeString(c.value()); });
+    writer.writeConstraint(field.uniqueConstraint(), [&writer](const UniqueConstraint& c) { writer.writeString(c.conflictAction()); });
+    writer.writeConstraint(field.collateConstraint(), [&writer](const CollateConstraint& c) { writer.writeString(c.collation()); });
+    writer.writeConstraint(field.generated(), [&writer](const GeneratedColumnConstraint& c) {
+        writer.writeString(c.expression());
+        writer.writeString(c.storage());
+    });
+}
+
+Field readField(SchemaReader& reader)
+{
+    Field field;
+    field.setName(reader.readString());
+    field.setType(reader.readString());
+    field.setNotNull(reader.readConstraint<NotNullConstraint>([&reader]() {
+        auto c = std::make_shared<NotNullConstraint>();
+        c->setConflictAction(reader.readString());
+        return c;
+    }));
+    field.setCheck(reader.readConstraint<CheckConstraint>([&reader]() { return std::make_shared<CheckConstraint>(reader.readString()); }));
+    field.setDefaultValue(reader.readConstraint<DefaultConstraint>([&reader]() { return std::make_shared<DefaultConstraint>(reader.readString()); }));
+    field.setUnique(reader.readConstraint<UniqueConstraint>([&reader]() {
+        auto c = std::make_shared<UniqueConstraint>();
+        c->setConflictAction(reader.readString());
+        return c;
+    }));
+    field.setCollation(reader.readConstraint<CollateConstraint>([&reader]() { return std::make_shared<CollateConstraint>(reader.readString()); }));
+    field.setGenerated(reader.readConstraint<GeneratedColumnConstraint>([&reader]() {
+        const std::string expression = reader.readString();
+        return std::make_shared<GeneratedColumnConstraint>(expression, reader.readString());
+    }));
+    return field;
+}
+
+void writeTable(SchemaWriter& writer, const Table& table)
+{
+    writer.writeBool(table.withoutRowidTable());
+    writer.writeBool(table.isStrict());
+    writer.writeString(table.virtualUsing());
+
+    writer.writeNumber(table.fields.size());
+    for(const auto& field : table.fields)
+        writeField(writer, field);
+
+    const auto index_constraints = table.indexConstraints();
+    writer.writeNumber(index_constraints.size());
+    for(const auto& it : index_constraints)
+    {
+        writer.writeIndexedColumns(it.first);
+        writer.writeBool(it.second->isPrimaryKey());
+        writer.writeString(it.second->name());
+        writer.writeString(it.second->conflictAction());
+        if(it.second->isPrimaryKey())
+            writer.writeBool(std::static_pointer_cast<PrimaryKeyConstraint>(it.second)->autoIncrement());
+    }
+
+    const auto foreign_keys = table.foreignKeys();
+    writer.writeNumber(foreign_keys.size());
+    for(const auto& it : foreign_keys)
+    {
+        writer.writeStrings(it.first);
+        writer.writeString(it.second->name());
+        writer.writeString(it.second->table());
+        writer.writeStrings(it.second->columns());
+        writer.writeString(it.second->constraint());
+    }
+
+    const auto checks = table.checkConstraints();
+    writer.writeNumber(checks.size());
+    for(const auto& check : checks)
+    {
+        writer.writeString(check->name());
+        writer.writeString(check->expression());
+    }
+}
+
+void readTable(SchemaReader& reader, Table& table)
+{
+    table.setWithoutRowidTable(reader.readBool());
+    table.setStrict(reader.readBool());
+    table.setVirtualUsing(reader.readString());
+
+    const size_t num_fields = reader.readCount();
+    for(size_t i=0;i<num_fields && reader.ok();i++)
+        table.fields.push_back(readField(reader));
+
+    const size_t num_index_constraints = reader.readCount();
+    for(size_t i=0;i<num_index_constraints && reader.ok();i++)
+    {
+        const IndexedColumnVector columns = reader.readIndexedColumns();
+        if(reader.readBool())
+        {
+            auto pk = std::make_shared<PrimaryKeyConstraint>();
+            pk->setName(reader.readString());
+            pk->setConflictAction(reader.readString());
+            pk->setAutoIncrement(reader.readBool());
+            table.addConstraint(columns, pk);
+        } else {
+            auto unique = std::make_shared<UniqueConstraint>();
+            unique->setName(reader.readString());
+            unique->setConflictAction(reader.readString());
+            table.addConstraint(columns, unique);
+        }
+    }
+
+    const size_t num_foreign_keys = reader.readCount();
+    for(size_t i=0;i<num_foreign_keys && reader.ok();i++)
+    {
+        const StringVector columns = reader.readStrings();
+        auto fk = std::make_shared<ForeignKeyClause>();
+        fk->setName(reader.readString());
+        fk->setTable(reader.readString());
+        fk->setColumns(reader.readStrings());
+        fk->setConstraint(reader.readString());
+        table.addConstraint(columns, fk);
+    }
+
+    const size_t num_checks = reader.readCount();
+    for(size_t i=0;i<num_checks && reader.ok();i++)
+    {
+        auto check = std::make_shared<CheckConstraint>();
+        check->setName(reader.readString());
+        check->setExpression(reader.readString());
+        table.addConstraint(check);
+    }
+}
+}
+
+std::string serialiseSchema(const std::vector<ObjectPtr>& objects)
+{
+    std::string data;
+    SchemaWriter writer(data);
+    writer.writeNumber(serialisationVersion);
+    writer.writeNumber(objects.size());
+
+    for(const auto& object : objects)
+    {
+        SerialisedType type = SerialisedType::None;
+        if(std::dynamic_pointer_cast<View>(object))
+            type = SerialisedType::View;
+        else if(std::dynamic_pointer_cast<Table>(object))
+            type = SerialisedType::Table;
+        else if(std::dynamic_pointer_cast<Index>(object))
+            type = SerialisedType::Index;
+        else if(std::dynamic_pointer_cast<Trigger>(object))
+            type = SerialisedType::Trigger;
+
+        writer.writeNumber(static_cast<unsigned char>(type));
+        if(type == SerialisedType::None)
+            continue;
+
+        writer.writeString(object->name());
+        writer.writeString(object->originalSql());
+        writer.writeBool(object->fullyParsed());
+
+        if(type == SerialisedType::Table || type == SerialisedType::View)
+        {
+            writeTable(writer, *std::static_pointer_cast<Table>(object));
+        } else if(type == SerialisedType::Index) {
+            const Index& index = *std::static_pointer_cast<Index>(object);
+            writer.writeBool(index.unique());
+            writer.writeString(index.table());
+            writer.writeString(index.whereExpr());
+            writer.writeIndexedColumns(index.fields);
+        } else if(type == SerialisedType::Trigger) {
+            writer.writeString(std::static_pointer_cast<Trigger>(object)->table());
+        }
+    }
+
+    return data;
+}
+
+bool deserialiseSchema(const std::string& data, std::vector<ObjectPtr>& objects)
+{
+    objects.clear();
+
+    SchemaReader reader(data);
+    if(reader.readNumber() != serialisationVersion || !reader.ok())
+        return false;
+
+    const size_t count = reader.readCount();
+    objects.reserve(count);
+    for(size_t i=0;i<count && reader.ok();i++)
+    {
+        const SerialisedType type = static_cast<SerialisedType>(reader.readNumber());
+        if(type == SerialisedType::None)
+        {
+            objects.push_back(nullptr);
+            continue;
+        }
+
+        const std::string name = reader.readString();
+        const std::string sql = reader.readString();
+        const bool fully_parsed = reader.readBool();
+
+        ObjectPtr object;
+        if(type == SerialisedType::Table || type == SerialisedType::View)
+        {
+            TablePtr table = type == SerialisedType::View ? std::make_shared<View>(name) : std::make_shared<Table>(name);
+            readTable(reader, *table);
+            object = table;
+        } else if(type == SerialisedType::Index) {
+            IndexPtr index = std::make_shared<Index>(name);
+            index->setUnique(reader.readBool());
+            index->setTable(reader.readString());
+            index->setWhereExpr(reader.readString());
+            index->fields = reader.readIndexedColumns();
+            object = index;
+        } else if(type == SerialisedType::Trigger) {
+            TriggerPtr trigger = std::make_shared<Trigger>(name);
+            trigger->setTable(reader.readString());
+            object = trigger;
+        } else {
+            return false;
+        }
+
+        object->setOriginalSql(sql);
+        object->setFullyParsed(fully_parsed);
+        objects.push_back(object);
+    }
+
+    if(!reader.ok() || !reader.atEnd())
+    {
+        objects.clear();
+        return false;
+    }
+
+    return true;
+}
+
 } //namespace sqlb
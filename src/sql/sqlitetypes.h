@@ -328,6 +328,12 @@ public:
     bool unique() const { return m_unique ? true : false; }
     std::string collation() const { return m_collation ? m_collation->collation() : std::string{}; }
 
+    std::shared_ptr<NotNullConstraint> notNullConstraint() const { return m_notnull; }
+    std::shared_ptr<CheckConstraint> checkConstraint() const { return m_check; }
+    std::shared_ptr<DefaultConstraint> defaultConstraint() const { return m_defaultvalue; }
+    std::shared_ptr<UniqueConstraint> uniqueConstraint() const { return m_unique; }
+    std::shared_ptr<CollateConstraint> collateConstraint() const { return m_collation; }
+
     const std::shared_ptr<GeneratedColumnConstraint> generated() const { return m_generated; }
     std::shared_ptr<GeneratedColumnConstraint> generated() { return m_generated; }
     void setGenerated(std::shared_ptr<GeneratedColumnConstraint> gen) { m_generated = gen; }
@@ -612,6 +618,31 @@ bool removeField(T& object, const std::string& name)
     return removeField(&object, name);
 }
 
+/**
+ * @brief parseSchema Parses the CREATE statements of many objects at once, spreading the work across multiple threads.
+ * The result is the same as when calling the parseSQL() function of the respective class for each statement.
+ * @param statements Pairs of the object type ("table", "index", "view" or "trigger") and the CREATE statement of each object.
+ * @param threads The maximum number of threads to use. 0 uses one thread per processor core.
+ * @return The parsed objects in the order of the statements. The objects for statements of other types are nullptr.
+ */
+std::vector<ObjectPtr> parseSchema(const std::vector<std::pair<std::string, std::string>>& statements, size_t threads = 0);
+
+/**
+ * @brief serialiseSchema Stores objects in a compact binary format, e.g. for caching them on disk. All information about the objects is
+ * kept, including the column lists of views and virtual tables which cannot be recreated by parsing their SQL.
+ * @param objects The objects to store. The vector may contain nullptr items.
+ * @return The binary data.
+ */
+std::string serialiseSchema(const std::vector<ObjectPtr>& objects);
+
+/**
+ * @brief deserialiseSchema Restores the objects stored by serialiseSchema().
+ * @param data The binary data.
+ * @param objects The restored objects in the order in which they were stored.
+ * @return true if the data could be read. false if it is damaged or was written by a version using a different format.
+ */
+bool deserialiseSchema(const std::string& data, std::vector<ObjectPtr>& objects);
+
 /**
  * @brief getFieldNumber returns the number of the field with the given name in an object. This is supposed to be a temporary helper function only.
  * @param object
@@ -1,11 +1,17 @@
 #include "sqlitedb.h"
 #include "sqlite.h"
 #include "sqlitetablemodel.h"
+#include "sql/Query.h"
+#include "SqlStatementReader.h"
+#include "CompressedFile.h"
+#include "SqlDumper.h"
 #include "CipherDialog.h"
 #include "CipherSettings.h"
 #include "Settings.h"
 #include "Data.h"
 
+#include <QBuffer>
+#include <QCryptographicHash>
 #include <QFile>
 #include <QMessageBox>
 #include <QProgressDialog>
@@ -14,6 +20,7 @@
 #include <QFileInfo>
 #include <QDir>
 #include <QDebug>
+#include <QEventLoop>
 #include <QThread>
 #include <QRegularExpression>
 
@@ -61,6 +68,71 @@ QString escapeByteArray(const QByteArray& literal)
         return QString("X'%1'").arg(QString(literal.toHex()));
 }}
 
+// Without a QApplication object, like in the headless mode, there is nobody to show any dialogs to
+static bool canShowDialogs()
+{
+    return qobject_cast<QApplication*>(QCoreApplication::instance()) != nullptr;
+}
+
+// Bind the values to the parameters of a statement, see DBBrowserDB::BindValues
+static bool bindValues(sqlite3_stmt* stmt, const DBBrowserDB::BindValues& values)
+{
+    for(size_t i=0;i<values.size();i++)
+    {
+        const QVariant& value = values[i];
+        const int index = static_cast<int>(i) + 1;
+        int result;
+        switch(value.userType())
+        {
+        case QMetaType::Bool:
+        case QMetaType::Int:
+        case QMetaType::UInt:
+        case QMetaType::LongLong:
+        case QMetaType::ULongLong:
+            result = sqlite3_bind_int64(stmt, index, value.toLongLong());
+            break;
+        case QMetaType::Float:
+        case QMetaType::Double:
+            result = sqlite3_bind_double(stmt, index, value.toDouble());
+            break;
+        case QMetaType::QByteArray:
+        {
+            const QByteArray bytes = value.toByteArray();
+            if(bytes.isNull())
+                result = sqlite3_bind_null(stmt, index);
+            else if(isTextOnly(bytes))
+                result = sqlite3_bind_text(stmt, index, bytes.constData(), bytes.size(), SQLITE_TRANSIENT);
+            else
+                result = sqlite3_bind_blob(stmt, index, bytes.constData(), bytes.size(), SQLITE_TRANSIENT);
+            break;
+        }
+        default:
+            if(value.isNull())
+            {
+                result = sqlite3_bind_null(stmt, index);
+            } else {
+                const QByteArray text = value.toString().toUtf8();
+                result = sqlite3_bind_text(stmt, index, text.constData(), text.size(), SQLITE_TRANSIENT);
+            }
+            break;
+        }
+
+        if(result != SQLITE_OK)
+            return false;
+    }
+
+    return true;
+}
+
+// Return the SQL text of a statement with the bound parameter values filled in, for logging
+static QString expandedSql(sqlite3_stmt* stmt)
+{
+    char* sql = sqlite3_expanded_sql(stmt);
+    const QString result = QString::fromUtf8(sql);
+    sqlite3_free(sql);
+    return result;
+}
+
 // collation callbacks
 int collCompare(void* /*pArg*/, int sizeA, const void* sA, int sizeB, const void* sB)
 {
@@ -100,11 +172,96 @@ static void sqlite_make_single_value(sqlite3_context* ctx, int num_arguments, sq
     });
 }
 
+// Returns the text of an argument of one of the functions below. NULL values are treated like the table browser shows them when editing.
+static QString findArgumentText(sqlite3_value* argument)
+{
+    if(sqlite3_value_type(argument) == SQLITE_NULL)
+        return QString();
+    return QString::fromUtf8(reinterpret_cast<const char*>(sqlite3_value_text(argument)), sqlite3_value_bytes(argument));
+}
+
+// Returns the regular expression in the second argument of one of the functions below. The search expression is the same for all rows,
+// so SQLite keeps the compiled expression for us. Sets an error and returns false if the expression is invalid.
+static bool findArgumentRegularExpression(sqlite3_context* ctx, sqlite3_value* arguments[], bool whole_cell, bool case_sensitive, QRegularExpression& reg_exp)
+{
+    const QRegularExpression* cached = static_cast<QRegularExpression*>(sqlite3_get_auxdata(ctx, 1));
+    if(cached)
+    {
+        reg_exp = *cached;
+        return true;
+    }
+
+    reg_exp = findRegularExpression(findArgumentText(arguments[1]), whole_cell, case_sensitive);
+    if(!reg_exp.isValid())
+    {
+        sqlite3_result_error(ctx, "invalid regular expression", -1);
+        return false;
+    }
+
+    sqlite3_set_auxdata(ctx, 1, new QRegularExpression(reg_exp), [](void* ptr) {
+        delete static_cast<QRegularExpression*>(ptr);
+    });
+    return true;
+}
+
+// Internal helper function for the Find function of the table browser. It checks whether the value in the first argument matches the
+// search expression in the second argument in the same way as SqliteTableModel::nextMatch() compares the cells it has loaded. The
+// remaining arguments tell whether the whole value needs to match, whether the comparison is case sensitive, and whether the search
+// expression is a regular expression.
+static void sqlite_find_match(sqlite3_context* ctx, int /*num_arguments*/, sqlite3_value* arguments[])
+{
+    const bool whole_cell = sqlite3_value_int(arguments[2]);
+    const bool case_sensitive = sqlite3_value_int(arguments[3]);
+    const bool regex = sqlite3_value_int(arguments[4]);
+
+    const QString data = findArgumentText(arguments[0]);
+    if(regex)
+    {
+        QRegularExpression reg_exp;
+        if(findArgumentRegularExpression(ctx, arguments, whole_cell, case_sensitive, reg_exp))
+            sqlite3_result_int(ctx, reg_exp.match(data).hasMatch());
+    } else {
+        const QString value = findArgumentText(arguments[1]);
+        const Qt::CaseSensitivity cs = case_sensitive ? Qt::CaseSensitive : Qt::CaseInsensitive;
+        sqlite3_result_int(ctx, whole_cell ? data.compare(value, cs) == 0 : data.contains(value, cs));
+    }
+}
+
+// Internal helper function for the Replace All function of the table browser. It takes the same arguments as sqlb_find_match() with the
+// replacement text inserted as the third argument and returns the value with all matches of the search expression replaced.
+static void sqlite_find_replace(sqlite3_context* ctx, int /*num_arguments*/, sqlite3_value* arguments[])
+{
+    const bool whole_cell = sqlite3_value_int(arguments[3]);
+    const bool case_sensitive = sqlite3_value_int(arguments[4]);
+    const bool regex = sqlite3_value_int(arguments[5]);
+
+    QString data = findArgumentText(arguments[0]);
+    const QString replacement = findArgumentText(arguments[2]);
+    if(regex)
+    {
+        QRegularExpression reg_exp;
+        if(!findArgumentRegularExpression(ctx, arguments, whole_cell, case_sensitive, reg_exp))
+            return;
+        data.replace(reg_exp, replacement);
+    } else {
+        data.replace(findArgumentText(arguments[1]), replacement, case_sensitive ? Qt::CaseSensitive : Qt::CaseInsensitive);
+    }
+
+    const QByteArray result = data.toUtf8();
+    sqlite3_result_text(ctx, result.constData(), result.size(), SQLITE_TRANSIENT);
+}
+
 DBBrowserDB::DBBrowserDB() :
     _db(nullptr),
     db_used(false),
     isEncrypted(false),
     isReadOnly(false),
+    isWal(false),
+    caseSensitiveLike(false),
+    readers_generation(0),
+    cached_statements_generation(0),
+    statement_cache_statistics{0, 0, 0},
+    bulk_load_timings{0, 0, 0},
     disableStructureUpdateChecks(false)
 {
     // Register error log callback. This needs to be done before SQLite is first used
@@ -174,6 +331,72 @@ static void regexp(sqlite3_context* ctx, int /*argc*/, sqlite3_value* argv[])
     sqlite3_result_int(ctx, regex.match(arg2).hasMatch());
 }
 
+// Registers the collations and functions which are available on every connection we open
+static void registerCustomFunctions(sqlite3* db)
+{
+    // add UTF16 collation (comparison is performed by QString functions)
+    sqlite3_create_collation(db, "UTF16", SQLITE_UTF16, nullptr, sqlite_compare_utf16);
+    // add UTF16CI (case insensitive) collation (comparison is performed by QString functions)
+    sqlite3_create_collation(db, "UTF16CI", SQLITE_UTF16, nullptr, sqlite_compare_utf16ci);
+
+    // Register REGEXP function
+    if(Settings::getValue("extensions", "disableregex").toBool() == false)
+        sqlite3_create_function(db, "REGEXP", 2, SQLITE_UTF8, nullptr, regexp, nullptr, nullptr);
+
+    // Register our internal helper function for putting multiple values into a single column
+    sqlite3_create_function_v2(
+        db,
+        "sqlb_make_single_value",
+        -1,
+        SQLITE_UTF8 | SQLITE_DETERMINISTIC,
+        nullptr,
+        sqlite_make_single_value,
+        nullptr,
+        nullptr,
+        nullptr
+    );
+
+    // Register our internal helper function for finding cells in the table browser
+    sqlite3_create_function_v2(
+        db,
+        "sqlb_find_match",
+        5,
+        SQLITE_UTF8 | SQLITE_DETERMINISTIC,
+        nullptr,
+        sqlite_find_match,
+        nullptr,
+        nullptr,
+        nullptr
+    );
+
+    // Register our internal helper function for replacing text in the table browser
+    sqlite3_create_function_v2(
+        db,
+        "sqlb_find_replace",
+        6,
+        SQLITE_UTF8 | SQLITE_DETERMINISTIC,
+        nullptr,
+        sqlite_find_replace,
+        nullptr,
+        nullptr,
+        nullptr
+    );
+}
+
+// Collation callback for the read-only connections. These are used from background threads, so we can't ask the user
+// what to do about unknown collations like for the main connection. Instead the default comparison is used silently. As
+// nothing is written through these connections, this can't harm any indices.
+static void readerCollationNeeded(void* /*pData*/, sqlite3* db, int eTextRep, const char* sCollationName)
+{
+    QString name(sCollationName);
+    if(name.compare("BINARY", Qt::CaseInsensitive) &&
+            name.compare("NOCASE", Qt::CaseInsensitive) &&
+            name.compare("RTRIM", Qt::CaseInsensitive))
+    {
+        sqlite3_create_collation(db, sCollationName, eTextRep, nullptr, collCompare);
+    }
+}
+
 bool DBBrowserDB::isOpen ( ) const
 {
     return _db != nullptr;
@@ -218,10 +441,8 @@ bool DBBrowserDB::open(const QString& db, bool readOnly)
 
     if (_db)
     {
-        // add UTF16 collation (comparison is performed by QString functions)
-        sqlite3_create_collation(_db, "UTF16", SQLITE_UTF16, nullptr, sqlite_compare_utf16);
-        // add UTF16CI (case insensitive) collation (comparison is performed by QString functions)
-        sqlite3_create_collation(_db, "UTF16CI", SQLITE_UTF16, nullptr, sqlite_compare_utf16ci);
+        // add our collations and functions
+        registerCustomFunctions(_db);
 
         // register collation callback
         Callback<void(void*, sqlite3*, int, const char*)>::func = std::bind(&DBBrowserDB::collationNeeded, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, std::placeholders::_4);
@@ -232,23 +453,6 @@ bool DBBrowserDB::open(const QString& db, bool readOnly)
         bool foreignkeys = Settings::getValue("db", "foreignkeys").toBool();
         setPragma("foreign_keys", foreignkeys ? "1" : "0");
 
-        // Register REGEXP function
-        if(Settings::getValue("extensions", "disableregex").toBool() == false)
-            sqlite3_create_function(_db, "REGEXP", 2, SQLITE_UTF8, nullptr, regexp, nullptr, nullptr);
-
-        // Register our internal helper function for putting multiple values into a single column
-        sqlite3_create_function_v2(
-            _db,
-            "sqlb_make_single_value",
-            -1,
-            SQLITE_UTF8 | SQLITE_DETERMINISTIC,
-            nullptr,
-            sqlite_make_single_value,
-            nullptr,
-            nullptr,
-            nullptr
-        );
-
         // Check if file is read only. In-memory databases are never read only
         if(db == ":memory:")
         {
@@ -272,6 +476,10 @@ bool DBBrowserDB::open(const QString& db, bool readOnly)
 
         curDBFilename = db;
 
+        // In WAL mode readers don't keep us from committing changes
+        isWal = getPragma("journal_mode").compare("wal", Qt::CaseInsensitive) == 0;
+        caseSensitiveLike = false;
+
         updateSchema();
 
         return true;
@@ -492,6 +700,11 @@ bool DBBrowserDB::tryEncryptionSettings(const QString& filePath, bool* encrypted
             if(foundDotenvPassword)
             {
                 // Skip the CipherDialog prompt for now to test if the dotenv settings are correct
+            } else if(!canShowDialogs()) {
+                lastErrorMessage = tr("The database is encrypted and there is no password for it in the .env file next to it.");
+                sqlite3_close_v2(dbHandle);
+                *encrypted = false;
+                return false;
             } else {
 	            CipherDialog *cipherDialog = new CipherDialog(nullptr, false);
 	            if(cipherDialog->exec())
@@ -592,6 +805,11 @@ bool DBBrowserDB::releaseSavepoint(const std::string& pointname)
         // the operation should be successfull
         return true;
 
+    // Releasing the outermost savepoint commits the transaction. Without WAL this needs all readers to be finished, so
+    // interrupt them if they take too long.
+    if(pointname == savepointList.front() && !isWal)
+        waitForReadersRelease(false);
+
     if(!executeSQL("RELEASE " + sqlb::escapeIdentifier(pointname) + ";", false, true))
         return false;
     // SQLite releases all savepoints that were created between
@@ -636,7 +854,11 @@ bool DBBrowserDB::releaseAllSavepoints()
 
     // When still in a transaction, commit that too
     if(sqlite3_get_autocommit(_db) == 0)
+    {
+        if(!isWal)
+            waitForReadersRelease(false);
         executeSQL("COMMIT;", false, true);
+    }
 
     return true;
 }
@@ -651,6 +873,112 @@ bool DBBrowserDB::revertAll()
     return true;
 }
 
+namespace {
+// Page cache size in KiB used while bulk loading
+constexpr qint64 bulkLoadCacheSize = 256 * 1024;
+
+}
+
+bool DBBrowserDB::beginBulkLoad(const std::vector<sqlb::ObjectIdentifier>& tables)
+{
+    if(!isOpen())
+        return false;
+
+    bulk_load_indices.clear();
+    bulk_load_timings = {0, 0, 0};
+
+    // Only raise the cache size. A negative value is in KiB, a positive one in pages.
+    bulk_load_cache_size = getPragma("cache_size");
+    qint64 cache_size = bulk_load_cache_size.toLongLong();
+    if(cache_size > 0)
+        cache_size = cache_size * getPragma("page_size").toLongLong() / 1024;
+    else
+        cache_size = -cache_size;
+    if(cache_size < bulkLoadCacheSize && !executeSQL("PRAGMA cache_size = -" + std::to_string(bulkLoadCacheSize) + ";", false, true))
+        return false;
+
+    // Find the indexes which can be dropped. Indexes without SQL are created for constraints and unique ones enforce a constraint
+    // themselves, so they need to stay. The SQL of an index does not contain its schema name, so only indexes in the main schema
+    // can be created again from it.
+    for(const auto& table : tables)
+    {
+        if(table.schema() != "main")
+            continue;
+
+        const std::string sql = "SELECT m.name, m.sql FROM main.sqlite_master m, pragma_index_list(" + sqlb::escapeString(table.name()) + ", 'main') l "
+                "WHERE m.type = 'index' AND m.name = l.name AND m.sql IS NOT NULL AND l.\"unique\" = 0;";
+        if(!executeSQL(sql, false, true, [this, &table](int, std::vector<QByteArray> values, std::vector<QByteArray>) -> bool {
+            bulk_load_indices.push_back({values.at(0).toStdString(), table.name(), values.at(1).toStdString()});
+            return false;
+        }))
+        {
+            bulk_load_indices.clear();
+            return false;
+        }
+    }
+
+    // The indexes are created again with the same SQL, so there is no need to update the schema in between
+    NoStructureUpdateChecks nup(*this);
+    for(const auto& index : bulk_load_indices)
+    {
+        if(!executeSQL("DROP INDEX " + sqlb::ObjectIdentifier("main", index.name).toString() + ";", false, true))
+            return false;
+    }
+
+    bulk_load_timer.start();
+    return true;
+}
+
+bool DBBrowserDB::endBulkLoad(bool rebuild)
+{
+    bulk_load_timings.load = bulk_load_timer.isValid() ? bulk_load_timer.elapsed() : 0;
+    bulk_load_timer.invalidate();
+
+    bool ok = true;
+    if(rebuild)
+    {
+        QElapsedTimer timer;
+        timer.start();
+
+        NoStructureUpdateChecks nup(*this);
+        for(const auto& index : bulk_load_indices)
+        {
+            // The loaded data might have changed the schema, e.g. when importing an SQL file
+            if(querySingleValueFromDb("SELECT EXISTS(SELECT 1 FROM main.sqlite_master WHERE type = 'table' AND name = ?1) AND "
+                                      "NOT EXISTS(SELECT 1 FROM main.sqlite_master WHERE name = ?2);",
+                                      {QString::fromStdString(index.table), QString::fromStdString(index.name)}, false) != "1")
+                continue;
+
+            if(!executeSQL(index.sql + ";", false, true))
+            {
+                ok = false;
+                break;
+            }
+            bulk_load_timings.numIndices++;
+        }
+
+        bulk_load_timings.indices = timer.elapsed();
+    }
+    bulk_load_indices.clear();
+
+    // Restore the cache size even if creating the indexes failed. Keep the error message of the failed statement in that case.
+    if(!bulk_load_cache_size.isEmpty())
+    {
+        const QString error = lastErrorMessage;
+        if(!executeSQL("PRAGMA cache_size = " + bulk_load_cache_size.toStdString() + ";", false, true))
+            ok = false;
+        else if(!ok)
+            lastErrorMessage = error;
+        bulk_load_cache_size.clear();
+    }
+
+    if(ok && rebuild)
+        logSQL(tr("-- Bulk load: loading the data took %1 ms, creating %2 indexes again took %3 ms.")
+               .arg(bulk_load_timings.load).arg(bulk_load_timings.numIndices).arg(bulk_load_timings.indices), kLogMsg_App);
+
+    return ok;
+}
+
 bool DBBrowserDB::create ( const QString & db)
 {
     if (isOpen())
@@ -701,8 +1029,11 @@ bool DBBrowserDB::close()
 
     waitForDbRelease();
 
-    if (getDirty())
+    if(getDirty() && !canShowDialogs())
     {
+        // Without anybody to ask, only changes which have been saved explicitly are kept
+        revertAll();
+    } else if(getDirty()) {
         // In-memory databases can't be saved to disk. So the need another text than regular databases.
         // Note that the QMessageBox::Yes option in the :memory: case and the QMessageBox::No option in the regular case are
         // doing the same job: proceeding but not saving anything.
@@ -731,16 +1062,23 @@ bool DBBrowserDB::close()
             revertAll(); //not really necessary, I think... but will not hurt.
     }
 
+    // Abort everything still reading through the pooled connections and close them
+    waitForReadersRelease(true);
+    invalidateReaders();
+    loadedExtensions.clear();
+    clearStatementCache();
+
     if(sqlite3_close_v2(_db) != SQLITE_OK)
         qWarning() << tr("Database didn't close correctly, probably still busy");
 
     _db = nullptr;
     curDBFilename.clear();
     schemata.clear();
+    schema_versions.clear();
     savepointList.clear();
 
     emit dbChanged(getDirty());
-    emit structureUpdated();
+    emit structureUpdated(SchemaChanges());
 
     // Return true to tell the calling function that the closing wasn't cancelled by the user
     return true;
@@ -786,6 +1124,9 @@ bool DBBrowserDB::saveAs(const std::string& filename) {
 
     if(rc == SQLITE_OK) {
         // Close current database and set backup as current
+        waitForReadersRelease(true);
+        invalidateReaders();
+        clearStatementCache();
         sqlite3_close_v2(_db);
         _db = pTo;
         curDBFilename = QString::fromStdString(filename);
@@ -813,6 +1154,131 @@ DBBrowserDB::db_pointer_type DBBrowserDB::get(const QString& user, bool force_wa
     return db_pointer_type(_db, DatabaseReleaser(this));
 }
 
+DBBrowserDB::db_pointer_type DBBrowserDB::getReader(const QString& user, bool force_wait)
+{
+    // If no separate connection is available, share the main one
+    db_pointer_type reader = tryGetReader();
+    if(!reader)
+        return get(user, force_wait);
+    return reader;
+}
+
+DBBrowserDB::db_pointer_type DBBrowserDB::tryGetReader()
+{
+    if(!canUseReaders())
+        return nullptr;
+
+    std::lock_guard<std::mutex> lk(readers_mutex);
+    sqlite3* reader = nullptr;
+    if(!idle_readers.empty())
+    {
+        reader = idle_readers.back();
+        idle_readers.pop_back();
+    } else if(busy_readers.size() < max_readers) {
+        reader = openReader();
+    }
+
+    if(!reader)
+        return nullptr;
+
+    busy_readers[reader] = readers_generation;
+    return db_pointer_type(reader, DatabaseReleaser(this, true));
+}
+
+bool DBBrowserDB::canUseReaders() const
+{
+    if(!_db || isEncrypted || curDBFilename.isEmpty() || curDBFilename == ":memory:")
+        return false;
+
+    // Uncommitted changes are only visible to the main connection
+    if(!savepointList.empty() || sqlite3_get_autocommit(_db) == 0)
+        return false;
+
+    // Neither are attached databases nor temporary objects
+    for(const auto& it : schemata)
+    {
+        if(it.first == "temp")
+        {
+            if(!it.second.empty())
+                return false;
+        } else if(it.first != "main") {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+sqlite3* DBBrowserDB::openReader() const
+{
+    sqlite3* reader;
+    if(sqlite3_open_v2(curDBFilename.toUtf8(), &reader, SQLITE_OPEN_READONLY, nullptr) != SQLITE_OK)
+    {
+        qWarning() << tr("Could not open read-only connection: %1").arg(sqlite3_errmsg(reader));
+        sqlite3_close_v2(reader);
+        return nullptr;
+    }
+
+    registerCustomFunctions(reader);
+    sqlite3_collation_needed(reader, nullptr, readerCollationNeeded);
+
+    if(caseSensitiveLike)
+        sqlite3_exec(reader, "PRAGMA case_sensitive_like = 1;", nullptr, nullptr, nullptr);
+
+    // Load the same extensions as in the main connection. Errors have been reported when loading them there already.
+    sqlite3_enable_load_extension(reader, 1);
+    for(const QString& ext : loadedExtensions)
+        sqlite3_load_extension(reader, ext.toUtf8(), nullptr, nullptr);
+    sqlite3_enable_load_extension(reader, 0);
+
+    return reader;
+}
+
+void DBBrowserDB::releaseReader(sqlite3* reader)
+{
+    std::unique_lock<std::mutex> lk(readers_mutex);
+    auto it = busy_readers.find(reader);
+    if(it == busy_readers.end())
+        return;
+
+    // Readers opened before the last invalidation are not set up correctly anymore
+    if(it->second == readers_generation)
+        idle_readers.push_back(reader);
+    else
+        sqlite3_close_v2(reader);
+    busy_readers.erase(it);
+
+    lk.unlock();
+    readers_cv.notify_all();
+}
+
+void DBBrowserDB::invalidateReaders()
+{
+    std::lock_guard<std::mutex> lk(readers_mutex);
+    for(sqlite3* reader : idle_readers)
+        sqlite3_close_v2(reader);
+    idle_readers.clear();
+    readers_generation++;
+}
+
+void DBBrowserDB::waitForReadersRelease(bool interrupt)
+{
+    std::unique_lock<std::mutex> lk(readers_mutex);
+    const auto released = [this](){ return busy_readers.empty(); };
+
+    // This is mostly called from the GUI thread, e.g. when committing without WAL. So don't wait for long-running reads like
+    // counting the rows of a huge table but interrupt them after a short while. The row loaders fetch the rows again when needed.
+    if(!interrupt && readers_cv.wait_for(lk, std::chrono::milliseconds(reader_release_timeout), released))
+        return;
+
+    // A reader might start another statement after the current one was interrupted, so keep interrupting until it is released
+    do
+    {
+        for(const auto& it : busy_readers)
+            sqlite3_interrupt(it.first);
+    } while(!readers_cv.wait_for(lk, std::chrono::milliseconds(50), released));
+}
+
 void DBBrowserDB::waitForDbRelease(ChoiceOnUse choice) const
 {
     if(!_db)
@@ -820,7 +1286,7 @@ void DBBrowserDB::waitForDbRelease(ChoiceOnUse choice) const
 
     // We can't show a message box from another thread than the main thread. So instead of crashing we
     // just decide that we don't interrupt any running query in this case.
-    if(choice == Ask && QThread::currentThread() != QApplication::instance()->thread())
+    if(choice == Ask && (QThread::currentThread() != QApplication::instance()->thread() || !canShowDialogs()))
         choice = Wait;
 
     std::unique_lock<std::mutex> lk(m);
@@ -855,45 +1321,71 @@ bool DBBrowserDB::dump(const QString& filePath,
     bool keepOriginal,
     bool exportSchema,
     bool exportData,
-    bool keepOldSchema) const
+    bool keepOldSchema,
+    size_t maxRowsPerInsert,
+    Compression compression,
+    qint64 splitSize)
 {
     waitForDbRelease();
 
-    // Open file
-    QFile file(filePath);
+    // Open file. Compressing it happens on a thread of its own while the data is being formatted.
+    CompressedFileWriter file(filePath, compression, splitSize);
     if(file.open(QIODevice::WriteOnly|QIODevice::Text))
     {
-        QApplication::setOverrideCursor(Qt::WaitCursor);
+        const bool gui = canShowDialogs();
+        if(gui)
+            QApplication::setOverrideCursor(Qt::WaitCursor);
 
-        // Count the total number of all records in all tables for the progress dialog
-        size_t numRecordsTotal = 0;
+        // Get the tables to export along with an estimate of their number of records for the progress dialog. Counting them exactly
+        // would mean reading all tables twice.
         objectMap objMap = schemata.at("main");             // We only always export the main database, not the attached databases
+        const bool hasStatistics = objMap.tables.find("sqlite_stat1") != objMap.tables.end();
         std::vector<sqlb::TablePtr> tables;
+        std::vector<SqlDumper::Table> dumpTables;
+        quint64 numRecordsTotal = 0;
         for(const auto& it : objMap.tables)
         {
             // Never export the sqlite_stat1 and the sqlite_sequence tables if they exist. Also only export any tables which are selected for export.
             if(!it.second->isView() && it.first != "sqlite_stat1" && it.first != "sqlite_sequence" && contains(tablesToDump, it.first))
             {
-                // Get the number of records in this table and remember to export it
                 tables.push_back(it.second);
-                numRecordsTotal += querySingleValueFromDb("SELECT COUNT(*) FROM " + sqlb::ObjectIdentifier("main", it.first).toString()).toUInt();
+                if(!exportData)
+                    continue;
+
+                // Don't estimate the size of virtual tables because these might have to be scanned completely just for this
+                size_t estimate = 0;
+                if(!it.second->isVirtual())
+                {
+                    sqlb::Query query(sqlb::ObjectIdentifier("main", it.first));
+                    query.setRowIdColumns(it.second->rowidColumns());
+                    for(const auto& estimateQuery : query.buildRowCountEstimateQueries())
+                    {
+                        if(estimateQuery.find("sqlite_stat1") != std::string::npos && !hasStatistics)
+                            continue;
+
+                        estimate = querySingleValueFromDb(estimateQuery, false).toULongLong();
+                        if(estimate)
+                            break;
+                    }
+                }
+                numRecordsTotal += estimate;
+
+                std::string insert = "INSERT INTO " + sqlb::escapeIdentifier(it.first);
+                if(insertColNames)
+                    insert += " (" + sqlb::joinStringVector(sqlb::escapeIdentifier(it.second->fieldNames()), ",") + ")";
+                insert += " VALUES";
+                dumpTables.push_back({"SELECT * FROM " + sqlb::escapeIdentifier(it.first), QByteArray::fromStdString(insert), estimate});
             }
         }
 
-        QProgressDialog progress(tr("Exporting database to SQL file..."),
-                                 tr("Cancel"), 0, static_cast<int>(numRecordsTotal));
-        // Disable context help button on Windows
-        progress.setWindowFlags(progress.windowFlags()
-                                & ~Qt::WindowContextHelpButtonHint);
-        progress.setWindowModality(Qt::ApplicationModal);
-        progress.show();
-        qApp->processEvents();
-
-        // Open text stream to the file
-        QTextStream stream(&file);
+        // Write everything as UTF-8 like it is stored in the database
+        bool ok = true;
+        auto write = [&file, &ok](const std::string& str) {
+            ok = ok && file.write(str.data(), static_cast<qint64>(str.size())) == static_cast<qint64>(str.size());
+        };
 
         // Put the SQL commands in a transaction block
-        stream << "BEGIN TRANSACTION;\n";
+        write("BEGIN TRANSACTION;\n");
 
         // First export the schema of all selected tables. We need to export the schema of all tables before we export the first INSERT statement to
         // make sure foreign keys are working properly.
@@ -903,113 +1395,103 @@ bool DBBrowserDB::dump(const QString& filePath,
             {
                 // Write the SQL string used to create this table to the output file
                 if(!keepOldSchema)
-                    stream << QString("DROP TABLE IF EXISTS %1;\n").arg(QString::fromStdString(sqlb::escapeIdentifier(it->name())));
+                    write("DROP TABLE IF EXISTS " + sqlb::escapeIdentifier(it->name()) + ";\n");
 
                 if(it->fullyParsed() && !keepOriginal)
-                    stream << QString::fromStdString(it->sql("main", keepOldSchema)) << "\n";
+                    write(it->sql("main", keepOldSchema) + "\n");
                 else {
-                    QString statement = QString::fromStdString(it->originalSql());
+                    std::string statement = it->originalSql();
                     if(keepOldSchema) {
                         // The statement is guaranteed by SQLite to start with "CREATE TABLE"
-                        const int createTableLength = 12;
+                        const size_t createTableLength = 12;
                         statement.replace(0, createTableLength, "CREATE TABLE IF NOT EXISTS");
                     }
-                    stream << statement << ";\n";
+                    write(statement + ";\n");
                 }
             }
         }
 
-        // Now export the data as well
-        if(exportData)
+        // Now export the data as well. Each table is read on its own connection and formatted on its own thread if possible. Otherwise
+        // all tables are exported one after the other using the main connection.
+        if(exportData && ok)
         {
-            for(const auto& it : tables)
+            const size_t numWorkers = std::min(dumpTables.size(), static_cast<size_t>(std::max(QThread::idealThreadCount(), 1)));
+            std::vector<db_pointer_type> readers;
+            while(readers.size() < numWorkers)
             {
-                // get columns
-                sqlb::StringVector cols = it->fieldNames();
-
-                std::string sQuery = "SELECT * FROM " + sqlb::escapeIdentifier(it->name());
-                sqlite3_stmt *stmt;
-                QString lineSep(QString(")%1\n").arg(insertNewSyntx?',':';'));
+                db_pointer_type reader = tryGetReader();
+                if(!reader)
+                    break;
+                readers.push_back(std::move(reader));
+            }
+            db_pointer_type pDb;
+            std::vector<sqlite3*> connections;
+            if(readers.empty())
+            {
+                pDb = get(tr("exporting the database"));
+                if(pDb)
+                    connections.push_back(pDb.get());
+            } else {
+                for(const auto& reader : readers)
+                    connections.push_back(reader.get());
+            }
 
-                int status = sqlite3_prepare_v2(_db, sQuery.c_str(), static_cast<int>(sQuery.size()), &stmt, nullptr);
-                if(SQLITE_OK == status)
-                {
-                    int columns = sqlite3_column_count(stmt);
-                    size_t counter = 0;
-                    size_t numRecordsCurrent = 0;
-                    qApp->processEvents();
-                    while(sqlite3_step(stmt) == SQLITE_ROW)
-                    {
-                        if (counter) stream << lineSep;
+            if(connections.empty())
+            {
+                file.cancelWriting();
+                if(gui)
+                    QApplication::restoreOverrideCursor();
+                return false;
+            }
 
-                        if (!insertNewSyntx || !counter)
-                        {
-                            stream << "INSERT INTO " << QString::fromStdString(sqlb::escapeIdentifier(it->name()));
-                            if (insertColNames)
-                                stream << " (" << QString::fromStdString(sqlb::joinStringVector(sqlb::escapeIdentifier(cols), ",")) << ")";
-                            stream << " VALUES (";
-                        }
-                        else
-                        {
-                            stream << " (";
-                        }
+            // A single INSERT statement per row is the same as a maximum of one row per statement
+            SqlDumper dumper(file, dumpTables, insertNewSyntx ? maxRowsPerInsert : 1);
 
-                        for (int i = 0; i < columns; ++i)
-                        {
-                            int fieldsize = sqlite3_column_bytes(stmt, i);
-                            int fieldtype = sqlite3_column_type(stmt, i);
-                            QByteArray bcontent(
-                                        reinterpret_cast<const char*>(sqlite3_column_blob(stmt, i)),
-                                        fieldsize);
+            const quint64 progressTotal = std::max<quint64>(numRecordsTotal, 1);
+            connect(&dumper, &SqlDumper::progress, this, [this, progressTotal](quint64 rows) {
+                emit dumpProgress(std::min(rows, progressTotal), progressTotal);
+            });
 
-                            switch(fieldtype)
-                            {
-                            case SQLITE_BLOB:
-                                stream << QString("X'%1'").arg(QString(bcontent.toHex()));
-                                break;
-                            case SQLITE_TEXT:
-                                stream << sqlb::escapeByteArray(bcontent);
-                                break;
-                            case SQLITE_NULL:
-                                stream << "NULL";
-                                break;
-                            case SQLITE_FLOAT:
-                                if(bcontent.indexOf("Inf") != -1)
-                                    stream << "'" << bcontent << "'";
-                                else
-                                    stream << bcontent;
-                                break;
-                            default:
-                                stream << bcontent;
-                            }
-                            if(i != columns - 1)
-                                stream << ',';
-                        }
+            // The progress dialog is only shown if there is a user interface
+            std::unique_ptr<QProgressDialog> progress;
+            if(gui)
+            {
+                progress = std::make_unique<QProgressDialog>(tr("Exporting database to SQL file..."), tr("Cancel"), 0, 10000);
+                // Disable context help button on Windows
+                progress->setWindowFlags(progress->windowFlags()
+                                         & ~Qt::WindowContextHelpButtonHint);
+                progress->setWindowModality(Qt::ApplicationModal);
+
+                QProgressDialog* dialog = progress.get();
+                connect(&dumper, &SqlDumper::progress, dialog, [dialog, progressTotal](quint64 rows) {
+                    dialog->setValue(static_cast<int>(static_cast<double>(std::min(rows, progressTotal)) / static_cast<double>(progressTotal) * 10000.0));
+                });
+                connect(dialog, &QProgressDialog::canceled, &dumper, &SqlDumper::cancel);
+                progress->show();
+            }
 
-                        progress.setValue(static_cast<int>(++numRecordsCurrent));
-                        if(counter % 5000 == 0)
-                            qApp->processEvents();
-                        counter++;
+            QEventLoop loop;
+            connect(&dumper, &SqlDumper::finished, &loop, &QEventLoop::quit, Qt::QueuedConnection);
+            dumper.start(connections);
+            loop.exec();
+            if(progress)
+                progress->hide();
 
-                        if(progress.wasCanceled())
-                        {
-                            sqlite3_finalize(stmt);
-                            file.close();
-                            file.remove();
-                            QApplication::restoreOverrideCursor();
-                            return false;
-                        }
-                    }
-                    if (counter > 0) stream << ");\n";
-                }
-                sqlite3_finalize(stmt);
+            if(!dumper.success())
+            {
+                if(!dumper.errorMessage().isEmpty())
+                    lastErrorMessage = dumper.errorMessage();
+                file.cancelWriting();
+                if(gui)
+                    QApplication::restoreOverrideCursor();
+                return false;
             }
         }
 
         // Finally export all objects other than tables
         if(exportSchema)
         {
-            auto writeSchema = [&stream, &tablesToDump, keepOldSchema, keepOriginal](const QString& type, auto objects) {
+            auto writeSchema = [&write, &tablesToDump, keepOldSchema, keepOriginal](const std::string& type, auto objects) {
                 for(const auto& obj : objects)
                 {
                     const auto& it = obj.second;
@@ -1023,33 +1505,40 @@ bool DBBrowserDB::dump(const QString& filePath,
                     if(!it->originalSql().empty())
                     {
                         if(!keepOldSchema)
-                            stream << QString("DROP %1 IF EXISTS %2;\n").arg(
-                                      type.toUpper(),
-                                      QString::fromStdString(sqlb::escapeIdentifier(it->name())));
+                            write("DROP " + type + " IF EXISTS " + sqlb::escapeIdentifier(it->name()) + ";\n");
 
                         if(it->fullyParsed() && !keepOriginal)
-                            stream << QString::fromStdString(it->sql("main", keepOldSchema)) << "\n";
+                            write(it->sql("main", keepOldSchema) + "\n");
                         else
-                            stream << QString::fromStdString(it->originalSql()) << ";\n";
+                            write(it->originalSql() + ";\n");
                     }
                 }
             };
 
             std::map<std::string, sqlb::TablePtr> views;
             std::copy_if(objMap.tables.begin(), objMap.tables.end(), std::inserter(views, views.end()), [](const auto& t) { return t.second->isView(); });
-            writeSchema("view", views);
-            writeSchema("index", objMap.indices);
-            writeSchema("trigger", objMap.triggers);
+            writeSchema("VIEW", views);
+            writeSchema("INDEX", objMap.indices);
+            writeSchema("TRIGGER", objMap.triggers);
         }
 
         // Done
-        stream << "COMMIT;\n";
-        file.close();
+        write("COMMIT;\n");
+        if(ok)
+            ok = file.commit();
+        else
+            file.cancelWriting();
+        if(!ok)
+            lastErrorMessage = file.errorString();
 
-        QApplication::restoreOverrideCursor();
-        qApp->processEvents();
-        return stream.status() == QTextStream::Ok && file.error() == QFileDevice::NoError;
+        if(gui)
+        {
+            QApplication::restoreOverrideCursor();
+            qApp->processEvents();
+        }
+        return ok;
     }
+    lastErrorMessage = file.errorString();
     return false;
 }
 
@@ -1084,6 +1573,9 @@ bool DBBrowserDB::executeSQL(const std::string& statement, bool dirtyDB, bool lo
     char* errmsg;
     if (SQLITE_OK == sqlite3_exec(_db, statement.c_str(), callback ? callbackWrapper : nullptr, &callback, &errmsg))
     {
+        if(starts_with_ci(statement, "ROLLBACK"))
+            invalidateSchemaVersions();
+
         // Update DB structure after executing an SQL statement. But try to avoid doing unnecessary updates.
         if(!disableStructureUpdateChecks && (starts_with_ci(statement, "ALTER") ||
                 starts_with_ci(statement, "CREATE") ||
@@ -1101,7 +1593,7 @@ bool DBBrowserDB::executeSQL(const std::string& statement, bool dirtyDB, bool lo
     }
 }
 
-bool DBBrowserDB::executeMultiSQL(QByteArray query, bool dirty, bool log)
+bool DBBrowserDB::executeSQL(const std::string& statement, const BindValues& values, bool dirtyDB, bool logsql)
 {
     waitForDbRelease();
     if(!_db)
@@ -1110,71 +1602,229 @@ bool DBBrowserDB::executeMultiSQL(QByteArray query, bool dirty, bool log)
         return false;
     }
 
+    if (dirtyDB) setSavepoint();
+
+    const CachedStatement cached = prepareCached(statement);
+    sqlite3_stmt* stmt = cached.get();
+    if(!stmt)
+    {
+        lastErrorMessage = QString("%1 (%2)").arg(QString::fromUtf8(sqlite3_errmsg(_db)), QString::fromStdString(statement));
+        qWarning() << "executeSQL: " << lastErrorMessage;
+        return false;
+    }
+
+    int result = SQLITE_ERROR;
+    if(bindValues(stmt, values))
+    {
+        if (logsql) logSQL(expandedSql(stmt), kLogMsg_App);
+
+        while((result = sqlite3_step(stmt)) == SQLITE_ROW)
+            ;
+    }
+    if(result != SQLITE_DONE)
+    {
+        lastErrorMessage = QString("%1 (%2)").arg(QString::fromUtf8(sqlite3_errmsg(_db)), QString::fromStdString(statement));
+        qWarning() << "executeSQL: " << lastErrorMessage;
+        return false;
+    }
+
+    if(starts_with_ci(statement, "ROLLBACK"))
+        invalidateSchemaVersions();
+
+    // Update DB structure after executing an SQL statement. But try to avoid doing unnecessary updates.
+    if(!disableStructureUpdateChecks && (starts_with_ci(statement, "ALTER") ||
+            starts_with_ci(statement, "CREATE") ||
+            starts_with_ci(statement, "DROP") ||
+            starts_with_ci(statement, "ROLLBACK")))
+        updateSchema();
+
+    return true;
+}
+
+int DBBrowserDB::changes() const
+{
+    return _db ? sqlite3_changes(_db) : 0;
+}
+
+DBBrowserDB::StatementCacheStatistics DBBrowserDB::statementCacheStatistics() const
+{
+    std::lock_guard<std::mutex> lk(cached_statements_mutex);
+    return statement_cache_statistics;
+}
+
+DBBrowserDB::CachedStatement::CachedStatement(const DBBrowserDB& db, const std::string& sql, sqlite3_stmt* stmt, unsigned int generation) :
+    m_db(db),
+    m_sql(sql),
+    m_stmt(stmt),
+    m_generation(generation)
+{
+}
+
+DBBrowserDB::CachedStatement::CachedStatement(CachedStatement&& other) noexcept :
+    m_db(other.m_db),
+    m_sql(std::move(other.m_sql)),
+    m_stmt(other.m_stmt),
+    m_generation(other.m_generation)
+{
+    other.m_stmt = nullptr;
+}
+
+DBBrowserDB::CachedStatement::~CachedStatement()
+{
+    if(m_stmt)
+        m_db.returnCached(m_sql, m_stmt, m_generation);
+}
+
+DBBrowserDB::CachedStatement DBBrowserDB::prepareCached(const std::string& sql) const
+{
+    unsigned int generation;
+    {
+        std::lock_guard<std::mutex> lk(cached_statements_mutex);
+        generation = cached_statements_generation;
+
+        // Take the statement out of the cache while it is being used
+        auto it = cached_statements_index.find(sql);
+        if(it != cached_statements_index.end())
+        {
+            statement_cache_statistics.hits++;
+            sqlite3_stmt* stmt = it->second->second;
+            cached_statements.erase(it->second);
+            cached_statements_index.erase(it);
+            return CachedStatement(*this, sql, stmt, generation);
+        }
+
+        statement_cache_statistics.misses++;
+    }
+
+    // Statements without any SQL in them, e.g. only comments, are nullptr as well. They don't need to be cached.
+    sqlite3_stmt* stmt;
+    if(sqlite3_prepare_v2(_db, sql.c_str(), static_cast<int>(sql.size()), &stmt, nullptr) != SQLITE_OK)
+        stmt = nullptr;
+    return CachedStatement(*this, sql, stmt, generation);
+}
+
+void DBBrowserDB::returnCached(const std::string& sql, sqlite3_stmt* stmt, unsigned int generation) const
+{
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+
+    std::lock_guard<std::mutex> lk(cached_statements_mutex);
+
+    // Statements prepared before the cache was cleared might refer to objects which are gone. And when the same SQL has been
+    // prepared again while this statement was in use, one of them is enough.
+    if(generation != cached_statements_generation || cached_statements_index.count(sql))
+    {
+        sqlite3_finalize(stmt);
+        return;
+    }
+
+    cached_statements.emplace_front(sql, stmt);
+    cached_statements_index[sql] = cached_statements.begin();
+
+    // Finalize the least recently used statements when there are too many. None of them is in use.
+    while(cached_statements.size() > max_cached_statements)
+    {
+        cached_statements_index.erase(cached_statements.back().first);
+        sqlite3_finalize(cached_statements.back().second);
+        cached_statements.pop_back();
+        statement_cache_statistics.evictions++;
+    }
+}
+
+void DBBrowserDB::clearStatementCache() const
+{
+    std::lock_guard<std::mutex> lk(cached_statements_mutex);
+    for(const auto& it : cached_statements)
+        sqlite3_finalize(it.second);
+    cached_statements.clear();
+    cached_statements_index.clear();
+    cached_statements_generation++;
+}
+
+bool DBBrowserDB::executeMultiSQL(QByteArray query, bool dirty, bool log)
+{
     // Log the statement if needed
-    if(log)
+    if(log && _db)
         logSQL(query, kLogMsg_App);
 
-    // Show progress dialog
-    QProgressDialog progress(tr("Executing SQL..."),
-                             tr("Cancel"), 0, 100);
-    progress.setWindowModality(Qt::ApplicationModal);
-    // Disable context help button on Windows
-    progress.setWindowFlags(progress.windowFlags()
-                            & ~Qt::WindowContextHelpButtonHint);
-    progress.show();
+    QBuffer buffer(&query);
+    buffer.open(QIODevice::ReadOnly);
+    return executeMultiSQL(buffer, dirty);
+}
 
-    // Execute the statement by looping until SQLite stops giving back a tail string
+bool DBBrowserDB::executeMultiSQL(QIODevice& device, bool dirty)
+{
+    waitForDbRelease();
+    if(!_db)
+    {
+        lastErrorMessage = tr("No database file opened");
+        return false;
+    }
+
+    // Show progress dialog. If the size of the input is unknown, only show that something is happening. Compressed files are
+    // sequential but know how much of the file on disk has been read.
+    const auto compressed = qobject_cast<const CompressedFileReader*>(&device);
+    const qint64 total_size = compressed ? compressed->fileSize() : (device.isSequential() ? 0 : device.size());
+    std::unique_ptr<QProgressDialog> progress;
+    if(canShowDialogs())
+    {
+        progress = std::make_unique<QProgressDialog>(tr("Executing SQL..."),
+                                                     tr("Cancel"), 0, total_size > 0 ? 100 : 0);
+        progress->setWindowModality(Qt::ApplicationModal);
+        // Disable context help button on Windows
+        progress->setWindowFlags(progress->windowFlags()
+                                 & ~Qt::WindowContextHelpButtonHint);
+        progress->show();
+    }
+
+    // Read and execute one statement after the other. This way only the current statement needs to be kept in memory.
+    SqlStatementReader reader(device);
+    QByteArray statement;
     sqlite3_stmt* vm;
-    const char *tail = query.constData();
-    const char * const tail_start = tail;
-    const char * const tail_end = tail + query.size() + 1;
-    size_t total_tail_length = static_cast<size_t>(tail_end - tail_start);
     unsigned int line = 0;
     bool structure_updated = false;
-    int last_progress_value = -1;
+    QElapsedTimer progress_timer;
+    progress_timer.start();
     std::string savepoint_name;
-    while(tail && *tail != 0)
+    while(reader.next(statement))
     {
         line++;
 
         // Update progress dialog, keep UI responsive. Make sure to not spend too much time updating the progress dialog in case there are many small statements.
-        int progress_value = static_cast<int>(static_cast<float>(tail - tail_start) / static_cast<float>(total_tail_length) * 100.0f);
-        if(progress_value > last_progress_value)
+        if(progress && progress_timer.elapsed() >= 100)
         {
-            progress.setValue(progress_value);
+            if(total_size > 0)
+            {
+                const qint64 position = compressed ? compressed->filePosition() : reader.position();
+                progress->setValue(static_cast<int>(static_cast<double>(position) / static_cast<double>(total_size) * 100.0));
+            }
             qApp->processEvents();
-            if(progress.wasCanceled())
+            if(progress->wasCanceled())
             {
                 lastErrorMessage = tr("Action cancelled.");
                 return false;
             }
-            last_progress_value = progress_value;
+            progress_timer.restart();
         }
 
         // Check next statement
         {
-            // Ignore all whitespace at the start of the current tail
-            const char* tail_ptr = tail;
-            while(std::isspace(*tail_ptr))
-                tail_ptr++;
-
-            // Convert the first couple of bytes of the tail to a C++ string for easier handling. We only need the first 8 bytes (in cae it's a ROLLBACK
-            // statement), so no need to convert the entire tail. If the tail is less than 8 bytes long, make sure not to read past its end.
-            size_t length = std::min(static_cast<size_t>(tail_end - tail + 1), static_cast<size_t>(8));
-            std::string next_statement(tail_ptr, length);
+            // Ignore all whitespace at the start of the statement
+            const char* statement_ptr = statement.constData();
+            while(std::isspace(*statement_ptr))
+                statement_ptr++;
+
+            // Convert the first couple of bytes of the statement to a C++ string for easier handling. We only need the first 8 bytes (in case it's
+            // a ROLLBACK statement), so no need to convert the entire statement. If it is shorter than that, make sure not to read past its end.
+            size_t length = std::min(static_cast<size_t>(statement.constData() + statement.size() - statement_ptr), static_cast<size_t>(8));
+            std::string next_statement(statement_ptr, length);
             std::transform(next_statement.begin(), next_statement.end(), next_statement.begin(), ::toupper);
 
-            // Check for transaction statements and skip until the next semicolon
+            // Skip transaction statements
             if(next_statement.compare(0, 6, "COMMIT") == 0 ||
                     next_statement.compare(0, 4, "END ") == 0 ||
                     next_statement.compare(0, 6, "BEGIN ") == 0)
             {
-                while(tail != tail_end)
-                {
-                    if(*tail++ == ';')
-                        break;
-                }
-
                 // Set DB to dirty and create a restore point if we haven't done that yet
                 if(savepoint_name.empty())
                 {
@@ -1183,10 +1833,13 @@ bool DBBrowserDB::executeMultiSQL(QByteArray query, bool dirty, bool log)
                     dirty = true;
                 }
 
-                // Don't just execute next statement. Start next statement with the same checks
+                // Don't just execute this statement. Start next statement with the same checks
                 continue;
             }
 
+            if(next_statement.compare(0, 8, "ROLLBACK") == 0)
+                invalidateSchemaVersions();
+
             // Check whether the DB structure is changed by this statement
             if(!disableStructureUpdateChecks && !structure_updated)
             {
@@ -1199,8 +1852,8 @@ bool DBBrowserDB::executeMultiSQL(QByteArray query, bool dirty, bool log)
             }
         }
 
-        // Execute next statement
-        if(sqlite3_prepare_v2(_db, tail, static_cast<int>(tail_end - tail + 1), &vm, &tail) == SQLITE_OK)
+        // Execute statement
+        if(sqlite3_prepare_v2(_db, statement.constData(), statement.size(), &vm, nullptr) == SQLITE_OK)
         {
             switch(sqlite3_step(vm))
             {
@@ -1239,6 +1892,17 @@ bool DBBrowserDB::executeMultiSQL(QByteArray query, bool dirty, bool log)
         }
     }
 
+    if(reader.hasError())
+    {
+        lastErrorMessage = tr("Error reading the SQL statements: %1.\nAborting execution%2.").arg(
+                device.errorString(),
+                dirty ? tr(" and rolling back") : "");
+        qWarning() << lastErrorMessage;
+        if(dirty)
+            revertToSavepoint(savepoint_name);
+        return false;
+    }
+
     // If the DB structure was changed by some command in this SQL script, update our schema representations
     if(structure_updated)
         updateSchema();
@@ -1248,19 +1912,25 @@ bool DBBrowserDB::executeMultiSQL(QByteArray query, bool dirty, bool log)
 }
 
 QByteArray DBBrowserDB::querySingleValueFromDb(const std::string& sql, bool log, ChoiceOnUse choice) const
+{
+    return querySingleValueFromDb(sql, BindValues(), log, choice);
+}
+
+QByteArray DBBrowserDB::querySingleValueFromDb(const std::string& sql, const BindValues& values, bool log, ChoiceOnUse choice) const
 {
     waitForDbRelease(choice);
     if(!_db)
         return QByteArray();
 
-    if(log)
-        logSQL(QString::fromStdString(sql), kLogMsg_App);
-
     QByteArray retval;
 
-    sqlite3_stmt* stmt;
-    if(sqlite3_prepare_v2(_db, sql.c_str(), static_cast<int>(sql.size()), &stmt, nullptr) == SQLITE_OK)
+    const CachedStatement cached = prepareCached(sql);
+    sqlite3_stmt* stmt = cached.get();
+    if(stmt && bindValues(stmt, values))
     {
+        if(log)
+            logSQL(values.empty() ? QString::fromStdString(sql) : expandedSql(stmt), kLogMsg_App);
+
         // Execute the statement. We distinguish three types of results:
         // SQLITE_ROW in case some data was returned from the database. This data is then used as a return value.
         // SQLITE_DONE in case the statement executed successfully but did not return any data. We do nothing in this case, leaving the return value empty.
@@ -1280,9 +1950,10 @@ QByteArray DBBrowserDB::querySingleValueFromDb(const std::string& sql, bool log,
             lastErrorMessage = tr("didn't receive any output from %1").arg(QString::fromStdString(sql));
             qWarning() << lastErrorMessage;
         }
-
-        sqlite3_finalize(stmt);
     } else {
+        if(log)
+            logSQL(QString::fromStdString(sql), kLogMsg_App);
+
         lastErrorMessage = tr("could not execute command: %1").arg(sqlite3_errmsg(_db));
         qWarning() << lastErrorMessage;
     }
@@ -1301,13 +1972,14 @@ bool DBBrowserDB::getRow(const sqlb::ObjectIdentifier& table, const QString& row
     // For a single rowid column we can use a simple WHERE condition, for multiple rowid columns we have to use sqlb_make_single_value to decode the composed rowid values.
     sqlb::StringVector pks = getTableByName(table)->rowidColumns();
     if(pks.size() == 1)
-        query += sqlb::escapeIdentifier(pks.front()) + "='" + rowid.toStdString() + "'";
+        query += sqlb::escapeIdentifier(pks.front()) + "=?1";
     else
-        query += "sqlb_make_single_value(" + sqlb::joinStringVector(sqlb::escapeIdentifier(pks), ",") + ")=" + sqlb::escapeString(rowid.toStdString());
+        query += "sqlb_make_single_value(" + sqlb::joinStringVector(sqlb::escapeIdentifier(pks), ",") + ")=?1";
 
-    sqlite3_stmt *stmt;
+    const CachedStatement cached = prepareCached(query);
+    sqlite3_stmt* stmt = cached.get();
     bool ret = false;
-    if(sqlite3_prepare_v2(_db, query.c_str(), static_cast<int>(query.size()), &stmt, nullptr) == SQLITE_OK)
+    if(stmt && sqlite3_bind_text(stmt, 1, rowid.toUtf8().constData(), -1, SQLITE_TRANSIENT) == SQLITE_OK)
     {
         // even this is a while loop, the statement should always only return 1 row
         while(sqlite3_step(stmt) == SQLITE_ROW)
@@ -1328,7 +2000,6 @@ bool DBBrowserDB::getRow(const sqlb::ObjectIdentifier& table, const QString& row
             ret = true;
         }
     }
-    sqlite3_finalize(stmt);
 
     return ret;
 }
@@ -1347,7 +2018,8 @@ unsigned long DBBrowserDB::max(const sqlb::ObjectIdentifier& tableName, const st
             // This SQL statement tries to do two things in one statement: get the current sequence number for this table from the sqlite_sequence table or, if there is no record for the table, return the highest integer value in the given column.
             // This works by querying the sqlite_sequence table and using an aggregate function (SUM in this case) to make sure to always get exactly one result row, no matter if there is a sequence record or not. We then let COALESCE decide
             // whether to return that sequence value if there is one or fall back to the SELECT MAX statement from avove if there is no sequence value.
-            query = "SELECT COALESCE(SUM(seq), (" + query + ") FROM sqlite_sequence WHERE name=" + sqlb::escapeString(tableName.name());
+            query = "SELECT COALESCE(SUM(seq), (" + query + ") FROM sqlite_sequence WHERE name=?1";
+            return querySingleValueFromDb(query, {QString::fromStdString(tableName.name())}).toULong();
          }
     }
 
@@ -1496,6 +2168,12 @@ bool DBBrowserDB::deleteRecords(const sqlb::ObjectIdentifier& table, const std::
 
 bool DBBrowserDB::updateRecord(const sqlb::ObjectIdentifier& table, const std::string& column,
                                const QByteArray& rowid, const QByteArray& value, int force_type, const sqlb::StringVector& pseudo_pk)
+{
+    return updateRecord(table, sqlb::StringVector{column}, rowid, std::vector<QByteArray>{value}, std::vector<int>{force_type}, pseudo_pk);
+}
+
+bool DBBrowserDB::updateRecord(const sqlb::ObjectIdentifier& table, const sqlb::StringVector& columns,
+                               const QByteArray& rowid, const std::vector<QByteArray>& values, const std::vector<int>& force_types, const sqlb::StringVector& pseudo_pk)
 {
     waitForDbRelease();
     if (!isOpen()) return false;
@@ -1508,47 +2186,75 @@ bool DBBrowserDB::updateRecord(const sqlb::ObjectIdentifier& table, const std::s
         return false;
     }
 
-    std::string sql = "UPDATE " + table.toString() + " SET " + sqlb::escapeIdentifier(column) + "=? WHERE ";
+    // The new values are bound to the parameters ?1 to ?n and the rowid to ?n+1. Because of this, updating the same set of columns
+    // of another row uses the same SQL text and therefore the same cached statement.
+    std::string sql = "UPDATE " + table.toString() + " SET ";
+    for(size_t i=0;i<columns.size();i++)
+    {
+        if(i)
+            sql += ",";
+        sql += sqlb::escapeIdentifier(columns[i]) + "=?" + std::to_string(i + 1);
+    }
+    const int rowid_param = static_cast<int>(columns.size()) + 1;
+    sql += " WHERE ";
 
     // For a single rowid column we can use a simple WHERE condition, for multiple rowid columns we have to use sqlb_make_single_value to decode the composed rowid values.
     if(pks.size() == 1)
-      sql += sqlb::escapeIdentifier(pks.front()) + "=" + sqlb::escapeByteArray(rowid).toStdString();
+        sql += sqlb::escapeIdentifier(pks.front()) + "=?" + std::to_string(rowid_param);
     else
-        sql += "sqlb_make_single_value(" + sqlb::joinStringVector(sqlb::escapeIdentifier(pks), ",") + ")=" + sqlb::escapeString(rowid.toStdString());
+        sql += "sqlb_make_single_value(" + sqlb::joinStringVector(sqlb::escapeIdentifier(pks), ",") + ")=?" + std::to_string(rowid_param);
 
     setSavepoint();
 
-    // If we get a NULL QByteArray we insert a NULL value, and for that
-    // we can pass NULL to sqlite3_bind_text() so that it behaves like sqlite3_bind_null()
-    const char *rawValue = value.isNull() ? nullptr : value.constData();
-
-    sqlite3_stmt* stmt;
+    // The rowid is bound the same way it used to be quoted: as text for a single rowid column unless it contains binary data, and
+    // always as text for the values composed by sqlb_make_single_value.
+    const CachedStatement cached = prepareCached(sql);
+    sqlite3_stmt* stmt = cached.get();
     int success = 1;
-    if(sqlite3_prepare_v2(_db, sql.c_str(), static_cast<int>(sql.size()), &stmt, nullptr) != SQLITE_OK)
+    if(!stmt)
         success = 0;
     if(success == 1) {
+        if(pks.size() == 1 && !isTextOnly(rowid))
+            success = sqlite3_bind_blob(stmt, rowid_param, rowid.constData(), rowid.size(), SQLITE_STATIC) == SQLITE_OK ? 1 : -1;
+        else
+            success = sqlite3_bind_text(stmt, rowid_param, rowid.constData(), rowid.size(), SQLITE_STATIC) == SQLITE_OK ? 1 : -1;
+    }
+    for(size_t i=0;i<values.size() && success == 1;i++)
+    {
+        const QByteArray& value = values[i];
+        const int force_type = i < force_types.size() ? force_types[i] : 0;
+        const int param = static_cast<int>(i) + 1;
+
+        // If we get a NULL QByteArray we insert a NULL value, and for that
+        // we can pass NULL to sqlite3_bind_text() so that it behaves like sqlite3_bind_null()
+        const char *rawValue = value.isNull() ? nullptr : value.constData();
+
         if(force_type == SQLITE_BLOB)
         {
-            if(sqlite3_bind_blob(stmt, 1, rawValue, value.length(), SQLITE_STATIC))
+            if(sqlite3_bind_blob(stmt, param, rawValue, value.length(), SQLITE_STATIC))
                 success = -1;
         } else if(force_type == SQLITE_INTEGER) {
-            if(sqlite3_bind_int64(stmt, 1, value.toLongLong()))
+            if(sqlite3_bind_int64(stmt, param, value.toLongLong()))
                 success = -1;
         } else if(force_type == SQLITE_FLOAT) {
-            if(sqlite3_bind_double(stmt, 1, value.toDouble()))
+            if(sqlite3_bind_double(stmt, param, value.toDouble()))
                 success = -1;
         } else {
-            if(sqlite3_bind_text(stmt, 1, rawValue, value.length(), SQLITE_STATIC))
+            if(sqlite3_bind_text(stmt, param, rawValue, value.length(), SQLITE_STATIC))
                 success = -1;
         }
     }
     if(success == 1) {
-        logSQL(QString::fromUtf8(sqlite3_expanded_sql(stmt)), kLogMsg_App);
+        logSQL(expandedSql(stmt), kLogMsg_App);
         if(sqlite3_step(stmt) != SQLITE_DONE)
             success = -1;
     }
-    if(success != 0 && sqlite3_finalize(stmt) != SQLITE_OK)
-        success = -1;
+    if(success != 0)
+    {
+        if(sqlite3_reset(stmt) != SQLITE_OK)
+            success = -1;
+        sqlite3_clear_bindings(stmt);
+    }
 
     if(success == 1)
     {
@@ -1982,19 +2688,79 @@ void DBBrowserDB::updateSchema()
 {
     waitForDbRelease();
 
-    schemata.clear();
-
     // Exit here is no DB is opened
     if(!isOpen())
+    {
+        clearStatementCache();
+        schemata.clear();
+        schema_versions.clear();
         return;
+    }
 
-    // Get a list of all databases. This list always includes the main and the temp database but can include more items if there are attached databases
-    if(!executeSQL("PRAGMA database_list;", false, true, [this](int, std::vector<QByteArray> db_values, std::vector<QByteArray>) -> bool {
+    // Get a list of all databases along with their schema versions. This list always includes the main and the temp database but can
+    // include more items if there are attached databases.
+    std::map<std::string, int> versions;
+    std::map<std::string, QString> files;
+    if(!executeSQL("PRAGMA database_list;", false, true, [this, &versions, &files](int, std::vector<QByteArray> db_values, std::vector<QByteArray>) -> bool {
         // Get the schema name which is in column 1 (counting starts with 0). 0 contains an ID and 2 the file path.
         const std::string schema_name = db_values.at(1).toStdString();
+        files[schema_name] = QString::fromUtf8(db_values.at(2));
+
+        int& version = versions[schema_name];
+        version = -1;
+        executeSQL("PRAGMA " + sqlb::escapeIdentifier(schema_name) + ".schema_version;", false, false,
+                   [&version](int, std::vector<QByteArray> values, std::vector<QByteArray>) -> bool {
+            version = values.at(0).toInt();
+            return false;
+        });
+
+        return false;
+    }))
+    {
+        qWarning() << tr("could not get list of databases: %1").arg(sqlite3_errmsg(_db));
+    }
+
+    // Nothing to do if no schema has changed since the last time
+    if(!versions.empty() && versions == schema_versions &&
+            std::all_of(versions.begin(), versions.end(), [](const auto& version) { return version.second >= 0; }))
+    {
+        SchemaChanges changes;
+        changes.reset = false;
+        emit structureUpdated(changes);
+        return;
+    }
+
+    // Statements prepared for the old schema might refer to objects which are gone now, so don't keep them around
+    clearStatementCache();
+
+    // The current objects are reused if their SQL hasn't changed. Only new and changed objects need to be parsed.
+    schemaMap old_schemata;
+    std::swap(old_schemata, schemata);
+    SchemaChanges changes;
+    changes.reset = old_schemata.empty() || versions.size() != schema_versions.size() ||
+            !std::equal(versions.begin(), versions.end(), schema_versions.begin(), [](const auto& a, const auto& b) { return a.first == b.first; });
+    schema_versions = versions;
+
+    // Read the objects of all schemata first, so all statements which need to be parsed can be parsed together
+    struct SchemaObject
+    {
+        std::string schema;
+        std::string type;
+        std::string name;
+        std::string sql;
+        std::string tbl_name;
+        sqlb::ObjectPtr object;
+        bool parsed;
+    };
+    std::vector<SchemaObject> objects;
+    std::map<std::string, std::pair<size_t, size_t>> schema_ranges;     // Range of the objects of each schema in the objects vector
+    for(const auto& version : versions)
+    {
+        const std::string& schema_name = version.first;
+        const size_t first_object = objects.size();
 
         // Always add the schema to the map. This makes sure it's even then added when there are no objects in the database
-        objectMap& object_map = schemata[schema_name];
+        schemata[schema_name];
 
         // Get a list of all the tables for the current database schema. We need to do this differently for normal databases and the temporary schema
         // because SQLite doesn't understand the "temp.sqlite_master" notation.
@@ -2004,70 +2770,219 @@ void DBBrowserDB::updateSchema()
         else
             statement = "SELECT type,name,sql,tbl_name FROM " + sqlb::escapeIdentifier(schema_name) + ".sqlite_master;";
 
-        if(!executeSQL(statement, false, true, [this, schema_name, &object_map](int, std::vector<QByteArray> values, std::vector<QByteArray>) -> bool {
-            const std::string val_type = values.at(0).toStdString();
-            const std::string val_name = values.at(1).toStdString();
+        if(!executeSQL(statement, false, true, [&schema_name, &objects](int, std::vector<QByteArray> values, std::vector<QByteArray>) -> bool {
             std::string val_sql = values.at(2).toStdString();
-            const std::string val_tblname = values.at(3).toStdString();
-
             if(!val_sql.empty())
             {
                 val_sql.erase(std::remove(val_sql.begin(), val_sql.end(), '\r'), val_sql.end());
+                objects.push_back({schema_name, values.at(0).toStdString(), values.at(1).toStdString(), val_sql, values.at(3).toStdString(), nullptr, false});
+            }
 
-                if(val_type == "table" || val_type == "view")
-                {
-                    sqlb::TablePtr table;
-                    if(val_type == "table")
-                        table = sqlb::Table::parseSQL(val_sql);
-                    else
-                        table = sqlb::View::parseSQL(val_sql);
+            return false;
+        }))
+        {
+            qWarning() << tr("could not get list of db objects: %1").arg(sqlite3_errmsg(_db));
+        }
 
-                    if(!table->fullyParsed())
-                        table->setName(val_name);
+        schema_ranges[schema_name] = {first_object, objects.size()};
+    }
 
-                    // For virtual tables, views, and tables we could not parse at all,
-                    // query the column list using the SQLite pragma to at least get
-                    // some information on them when our parser does not.
-                    if((!table->fullyParsed() && table->fields.empty()) || table->isVirtual())
-                    {
-                        const auto columns = queryColumnInformation(schema_name, val_name);
+    // The parsed objects of database files are cached on disk. The cache of a schema can only be used if it was written for exactly the
+    // objects which are in the database now. This is checked using a digest of the rows read from sqlite_master. The temporary schema and
+    // in-memory databases are never cached. Neither are encrypted databases because the cache would contain their schema unencrypted.
+    std::map<std::string, QByteArray> digests;
+    for(const auto& range : schema_ranges)
+    {
+        const std::string& schema_name = range.first;
+        if(schema_name == "temp" || files[schema_name].isEmpty() || isEncrypted)
+            continue;
+#ifdef ENABLE_SQLCIPHER
+        // We don't keep track of which attached databases are encrypted
+        if(schema_name != "main")
+            continue;
+#endif
 
-                        for(const auto& column : columns)
-                            table->fields.emplace_back(column.first, column.second);
-                    }
+        QCryptographicHash hash(QCryptographicHash::Sha1);
+        for(size_t i=range.second.first;i<range.second.second;i++)
+        {
+            for(const std::string* value : {&objects[i].type, &objects[i].name, &objects[i].tbl_name, &objects[i].sql})
+            {
+                hash.addData(QByteArray::number(static_cast<qulonglong>(value->size())) + ':');
+                hash.addData(QByteArray::fromRawData(value->data(), static_cast<int>(value->size())));
+            }
+        }
+        digests[schema_name] = hash.result();
 
-                    object_map.tables.insert({val_name, table});
-                } else if(val_type == "index") {
-                    sqlb::IndexPtr index = sqlb::Index::parseSQL(val_sql);
-                    if(!index->fullyParsed())
-                        index->setName(val_name);
+        // Only try the cache when the schema is read for the first time. Later on, the objects in memory are more up to date.
+        if(old_schemata.find(schema_name) != old_schemata.end())
+            continue;
 
-                    object_map.indices.insert({val_name, index});
-                } else if(val_type == "trigger") {
-                    sqlb::TriggerPtr trigger = sqlb::Trigger::parseSQL(val_sql);
-                    trigger->setName(val_name);
-                    trigger->setOriginalSql(val_sql);
+        std::vector<sqlb::ObjectPtr> cached_objects;
+        if(schema_cache.load(files[schema_name], versions[schema_name], digests[schema_name], cached_objects) &&
+                cached_objects.size() == range.second.second - range.second.first)
+        {
+            for(size_t i=range.second.first;i<range.second.second;i++)
+                objects[i].object = cached_objects[i - range.second.first];
+        }
+    }
 
-                    // For triggers set the name of the table the trigger operates on here because we don't have a parser for trigger statements yet.
-                    trigger->setTable(val_tblname);
+    // The current objects are reused if they are of the same type and their SQL hasn't changed. Views are never reused because their
+    // columns depend on the tables they select from. All other objects are parsed in parallel.
+    std::vector<std::pair<std::string, std::string>> statements;
+    for(auto& obj : objects)
+    {
+        // Skip objects loaded from the cache
+        if(obj.object)
+            continue;
+
+        const objectMap& old_object_map = old_schemata[obj.schema];
+        auto reusable = [&obj](const auto& old_objects) -> sqlb::ObjectPtr {
+            auto it = old_objects.find(obj.name);
+            if(it != old_objects.end() && it->second->originalSql() == obj.sql)
+                return it->second;
+            return nullptr;
+        };
+
+        if(obj.type == "table")
+        {
+            obj.object = reusable(old_object_map.tables);
+            if(obj.object && std::static_pointer_cast<sqlb::Table>(obj.object)->isView())
+                obj.object = nullptr;
+        } else if(obj.type == "index") {
+            obj.object = reusable(old_object_map.indices);
+        } else if(obj.type == "trigger") {
+            obj.object = reusable(old_object_map.triggers);
+        }
+
+        if(!obj.object)
+        {
+            obj.parsed = true;
+            statements.push_back({obj.type, obj.sql});
+        }
+    }
+    std::vector<sqlb::ObjectPtr> parsed_objects = sqlb::parseSchema(statements);
+
+    // Add the objects to the schemata in the order in which SQLite has returned them
+    auto parsed_object = parsed_objects.begin();
+    for(auto& obj : objects)
+    {
+        if(obj.parsed)
+            obj.object = *parsed_object++;
+
+        objectMap& object_map = schemata[obj.schema];
+        const objectMap& old_object_map = old_schemata[obj.schema];
+
+        // Remember whether this object is new or has changed
+        auto compare = [&obj, &changes](const auto& old_objects, const auto& object, auto same) {
+            auto it = old_objects.find(obj.name);
+            if(it == old_objects.end())
+                changes.added.push_back({obj.type, sqlb::ObjectIdentifier(obj.schema, obj.name)});
+            else if(!same(it->second, object))
+                changes.changed.push_back({obj.type, sqlb::ObjectIdentifier(obj.schema, obj.name)});
+        };
+        auto sameSql = [](const auto& old_object, const auto& object) { return old_object->originalSql() == object->originalSql(); };
 
-                    object_map.triggers.insert({val_name, trigger});
+        if(obj.type == "table" || obj.type == "view")
+        {
+            sqlb::TablePtr table = std::static_pointer_cast<sqlb::Table>(obj.object);
+            if(obj.parsed)
+            {
+                if(!table->fullyParsed())
+                    table->setName(obj.name);
+
+                // For virtual tables, views, and tables we could not parse at all,
+                // query the column list using the SQLite pragma to at least get
+                // some information on them when our parser does not.
+                if((!table->fullyParsed() && table->fields.empty()) || table->isVirtual())
+                {
+                    const auto columns = queryColumnInformation(obj.schema, obj.name);
+
+                    for(const auto& column : columns)
+                        table->fields.emplace_back(column.first, column.second);
                 }
             }
 
-            return false;
-        }))
+            compare(old_object_map.tables, table, [&sameSql](const sqlb::TablePtr& old_table, const sqlb::TablePtr& new_table) {
+                return old_table->isView() == new_table->isView() && sameSql(old_table, new_table) && old_table->fields == new_table->fields;
+            });
+            object_map.tables.insert({obj.name, table});
+        } else if(obj.type == "index") {
+            sqlb::IndexPtr index = std::static_pointer_cast<sqlb::Index>(obj.object);
+            if(obj.parsed && !index->fullyParsed())
+                index->setName(obj.name);
+
+            compare(old_object_map.indices, index, sameSql);
+            object_map.indices.insert({obj.name, index});
+        } else if(obj.type == "trigger") {
+            sqlb::TriggerPtr trigger = std::static_pointer_cast<sqlb::Trigger>(obj.object);
+            if(obj.parsed)
+            {
+                trigger->setName(obj.name);
+                trigger->setOriginalSql(obj.sql);
+
+                // For triggers set the name of the table the trigger operates on here because we don't have a parser for trigger statements yet.
+                trigger->setTable(obj.tbl_name);
+            }
+
+            compare(old_object_map.triggers, trigger, sameSql);
+            object_map.triggers.insert({obj.name, trigger});
+        }
+    }
+
+    // Update the cache of each schema in which anything had to be parsed. Schemata containing tables or views without any columns are
+    // not cached because their columns might become known later on, e.g. after loading the extension of a virtual table.
+    for(const auto& digest : digests)
+    {
+        const std::pair<size_t, size_t>& range = schema_ranges[digest.first];
+        bool parsed = false;
+        bool complete = true;
+        std::vector<sqlb::ObjectPtr> schema_objects;
+        for(size_t i=range.first;i<range.second;i++)
         {
-            qWarning() << tr("could not get list of db objects: %1").arg(sqlite3_errmsg(_db));
+            parsed |= objects[i].parsed;
+            if(objects[i].type == "table" || objects[i].type == "view")
+                complete &= !std::static_pointer_cast<sqlb::Table>(objects[i].object)->fields.empty();
+            schema_objects.push_back(objects[i].object);
         }
 
-        return false;
-    }))
+        if(parsed && complete)
+            schema_cache.store(files[digest.first], versions[digest.first], digest.second, schema_objects);
+    }
+
+    // Find the objects which are gone
+    for(const auto& version : versions)
     {
-        qWarning() << tr("could not get list of databases: %1").arg(sqlite3_errmsg(_db));
+        const std::string& schema_name = version.first;
+        const objectMap& object_map = schemata[schema_name];
+        const objectMap& old_object_map = old_schemata[schema_name];
+
+        auto findRemoved = [&changes, &schema_name](const auto& old_objects, const auto& objects, auto type) {
+            for(const auto& it : old_objects)
+            {
+                if(objects.find(it.first) == objects.end())
+                    changes.removed.push_back({type(it.second), sqlb::ObjectIdentifier(schema_name, it.first)});
+            }
+        };
+        findRemoved(old_object_map.tables, object_map.tables, [](const sqlb::TablePtr& table) { return std::string(table->isView() ? "view" : "table"); });
+        findRemoved(old_object_map.indices, object_map.indices, [](const sqlb::IndexPtr&) { return std::string("index"); });
+        findRemoved(old_object_map.triggers, object_map.triggers, [](const sqlb::TriggerPtr&) { return std::string("trigger"); });
+    }
+
+    // Without a previous state to compare to, the changes don't mean much
+    if(changes.reset)
+    {
+        changes.added.clear();
+        changes.changed.clear();
+        changes.removed.clear();
     }
 
-    emit structureUpdated();
+    emit structureUpdated(changes);
+}
+
+void DBBrowserDB::invalidateSchemaVersions()
+{
+    for(auto& version : schema_versions)
+        version.second = -1;
 }
 
 QString DBBrowserDB::getPragma(const std::string& pragma) const
@@ -2088,12 +3003,24 @@ bool DBBrowserDB::setPragma(const std::string& pragma, const QString& value)
     // inside transactions (see the renameColumn() function where it is set and reset at some point and where we don't want the changes
     // to be committed just because of this pragma).
     if(pragma != "defer_foreign_keys")
+    {
         releaseSavepoint();
 
+        // Some pragmas, like changing the journal mode, fail while other connections are open. So close the read-only ones.
+        waitForReadersRelease(false);
+        invalidateReaders();
+    }
+
     bool res = executeSQL(sql, false, true); // PRAGMA statements are usually not transaction bound, so we can't revert
     if( !res )
         qWarning() << tr("Error setting pragma %1 to %2: %3").arg(QString::fromStdString(pragma), value, lastErrorMessage);
 
+    // Keep track of the pragmas which affect the read-only connections as well
+    if(res && pragma == "journal_mode")
+        isWal = getPragma("journal_mode").compare("wal", Qt::CaseInsensitive) == 0;
+    if(res && pragma == "case_sensitive_like")
+        caseSensitiveLike = value == "1" || value.compare("true", Qt::CaseInsensitive) == 0 || value.compare("on", Qt::CaseInsensitive) == 0;
+
     // If this is the page_size or the auto_vacuum pragma being set, we need to execute the vacuum command right after the pragma statement or the new
     // settings won't be saved.
     if(res && (pragma == "page_size" || pragma == "auto_vacuum"))
@@ -2156,6 +3083,9 @@ bool DBBrowserDB::loadExtension(const QString& filePath)
 
     if (result == SQLITE_OK)
     {
+        // Make the extension available in the read-only connections too
+        loadedExtensions.push_back(filePath);
+        invalidateReaders();
         return true;
     } else {
         lastErrorMessage = QString::fromUtf8(error);
@@ -2176,7 +3106,12 @@ void DBBrowserDB::loadExtensionsFromSettings()
     for(const QString& ext : list)
     {
         if(loadExtension(ext) == false)
-            QMessageBox::warning(nullptr, QApplication::applicationName(), tr("Error loading extension: %1").arg(lastError()));
+        {
+            if(canShowDialogs())
+                QMessageBox::warning(nullptr, QApplication::applicationName(), tr("Error loading extension: %1").arg(lastError()));
+            else
+                qWarning() << qPrintable(tr("Error loading extension: %1").arg(lastError()));
+        }
     }
 
     const QVariantMap builtinList = Settings::getValue("extensions", "builtin").toMap();
@@ -2185,7 +3120,12 @@ void DBBrowserDB::loadExtensionsFromSettings()
         if(builtinList.value(ext).toBool())
         {
             if(loadExtension(ext) == false)
-                QMessageBox::warning(nullptr, QApplication::applicationName(), tr("Error loading built-in extension: %1").arg(lastError()));
+            {
+                if(canShowDialogs())
+                    QMessageBox::warning(nullptr, QApplication::applicationName(), tr("Error loading built-in extension: %1").arg(lastError()));
+                else
+                    qWarning() << qPrintable(tr("Error loading built-in extension: %1").arg(lastError()));
+            }
         }
     }
 }
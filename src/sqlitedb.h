@@ -3,20 +3,28 @@
 
 #include "sql/ObjectIdentifier.h"
 #include "sql/sqlitetypes.h"
+#include "CompressedFile.h"
+#include "SchemaCache.h"
 
 #include <condition_variable>
 #include <memory>
 #include <mutex>
 #include <functional>
+#include <list>
 #include <vector>
 #include <map>
+#include <unordered_map>
 
 #include <QObject>
 #include <QByteArray>
+#include <QElapsedTimer>
 #include <QStringList>
+#include <QVariant>
 
 struct sqlite3;
+struct sqlite3_stmt;
 class CipherSettings;
+class QIODevice;
 
 enum LogMessageType
 {
@@ -40,6 +48,27 @@ struct objectMap
 
 using schemaMap = std::map<std::string, objectMap>;             // Maps from the schema name (main, temp, attached schemas) to the object map for that schema
 
+// Changes of the schema found by DBBrowserDB::updateSchema(). If reset is set, anything might have changed, e.g. because another
+// database has been opened or attached, and the lists are empty.
+struct SchemaChanges
+{
+    struct Object
+    {
+        std::string type;                               // table, view, index or trigger
+        sqlb::ObjectIdentifier name;
+    };
+
+    bool reset = true;
+    std::vector<Object> added;
+    std::vector<Object> changed;
+    std::vector<Object> removed;
+
+    bool empty() const
+    {
+        return !reset && added.empty() && changed.empty() && removed.empty();
+    }
+};
+
 int collCompare(void* pArg, int sizeA, const void* sA, int sizeB, const void* sB);
 
 namespace sqlb
@@ -60,15 +89,22 @@ private:
     /// custom unique_ptr deleter releases database for further use by others
     struct DatabaseReleaser
     {
-        explicit DatabaseReleaser(DBBrowserDB * pParent_ = nullptr) : pParent(pParent_) {}
+        explicit DatabaseReleaser(DBBrowserDB * pParent_ = nullptr, bool pooled_ = false) : pParent(pParent_), pooled(pooled_) {}
 
         DBBrowserDB * pParent;
+        bool pooled;    ///< handle is a read-only connection from getReader()
 
         void operator() (const sqlite3* db) const
         {
             if(!db || !pParent)
                 return;
 
+            if(pooled)
+            {
+                pParent->releaseReader(const_cast<sqlite3*>(db));
+                return;
+            }
+
             std::unique_lock<std::mutex> lk(pParent->m);
             pParent->db_used = false;
             lk.unlock();
@@ -123,6 +159,27 @@ public:
     **/
     db_pointer_type get (const QString& user, bool force_wait = false);
 
+    /**
+       borrow a read-only connection to the currently open database,
+       until releasing the returned unique_ptr. connections are kept
+       in a small pool and, unlike the one returned by get(), can be
+       used by several readers at the same time without waiting for
+       each other.
+
+       a separate connection only sees committed data and none of the
+       state of the main connection. so this falls back to get() for
+       in-memory and encrypted databases, while there are uncommitted
+       changes, while other databases are attached or temporary
+       objects exist, and when all pooled connections are in use.
+
+       parameters and return value are the same as for get().
+    **/
+    db_pointer_type getReader (const QString& user, bool force_wait = false);
+
+    /// like getReader() but \returns nullptr instead of falling back to
+    /// the main connection
+    db_pointer_type tryGetReader ();
+
     bool setSavepoint(const std::string& pointname = "RESTOREPOINT", bool unique = true);
     bool releaseSavepoint(const std::string& pointname = "RESTOREPOINT");
     bool revertToSavepoint(const std::string& pointname = "RESTOREPOINT");
@@ -134,8 +191,48 @@ public:
     bool revertToUndoSavepoint() { return revertToSavepoint("UNDOPOINT"); };
     bool releaseUndoSavepoint() { return releaseSavepoint("UNDOPOINT"); };
 
+    /**
+       prepare loading many rows into the given tables inside the
+       current savepoint: drop their non-unique indexes and raise the
+       page cache size. endBulkLoad() creates the indexes again and
+       restores the cache size. tables outside the main schema keep
+       their indexes.
+
+       journal_mode and synchronous are left alone. reverting the
+       savepoint after an error needs the journal, and nothing is
+       synced before the changes are written anyway.
+
+       when this fails, the savepoint needs to be reverted and
+       endBulkLoad() called without rebuilding.
+    **/
+    bool beginBulkLoad(const std::vector<sqlb::ObjectIdentifier>& tables);
+
+    /**
+       finish a bulk load started by beginBulkLoad(). with rebuild set
+       the dropped indexes are created again, unless their table is gone
+       or another index with the same name exists by now. without it the
+       savepoint is expected to have been reverted, which brings them
+       back anyway, and only the cache size is restored.
+    **/
+    bool endBulkLoad(bool rebuild = true);
+
+    struct BulkLoadTimings
+    {
+        qint64 load;                //< ms between beginBulkLoad() and endBulkLoad()
+        qint64 indices;             //< ms spent creating the indexes again
+        size_t numIndices;          //< number of indexes created again
+    };
+
+    // Timings of the last finished bulk load
+    BulkLoadTimings bulkLoadTimings() const { return bulk_load_timings; }
+
+    /// write the selected tables of the main schema to an SQL file. with
+    /// insertNew set, up to maxRowsPerInsert rows (0 for no limit) are
+    /// written per INSERT statement. the file can be compressed and split
+    /// into parts of splitSize bytes, see CompressedFileWriter
     bool dump(const QString& filename, const std::vector<std::string>& tablesToDump,
-              bool insertColNames, bool insertNew, bool keepOriginal, bool exportSchema, bool exportData, bool keepOldSchema) const;
+              bool insertColNames, bool insertNew, bool keepOriginal, bool exportSchema, bool exportData, bool keepOldSchema,
+              size_t maxRowsPerInsert = 0, Compression compression = Compression::None, qint64 splitSize = 0);
 
     enum ChoiceOnUse
     {
@@ -155,10 +252,37 @@ public:
     using execCallback = std::function<bool(int, std::vector<QByteArray>, std::vector<QByteArray>)>;
     bool executeSQL(const std::string& statement, bool dirtyDB = true, bool logsql = true, execCallback callback = nullptr);
     bool executeMultiSQL(QByteArray query, bool dirty = true, bool log = false);
+    // Like above but reads the statements from a device while executing them one after the other. So the whole input is never kept in
+    // memory and the progress dialog shows how much of it has been read. Statements are not logged.
+    bool executeMultiSQL(QIODevice& device, bool dirty = true);
     QByteArray querySingleValueFromDb(const std::string& sql, bool log = true, ChoiceOnUse choice = Ask) const;
 
+    // Values for the parameters ?1, ?2, ... of a single SQL statement, in this order. Null values are bound as NULL and numbers
+    // as INTEGER or REAL. Byte arrays are bound as TEXT unless they contain binary data, in which case they are bound as BLOB,
+    // just like sqlb::escapeByteArray() would quote them. Everything else is bound as TEXT.
+    using BindValues = std::vector<QVariant>;
+
+    // These work like the functions above but execute a single statement with bound parameter values instead of literals
+    // inlined in the SQL text. The prepared statements are cached, so executing the same SQL text over and over again
+    // does not need to compile it every time.
+    bool executeSQL(const std::string& statement, const BindValues& values, bool dirtyDB = true, bool logsql = true);
+    QByteArray querySingleValueFromDb(const std::string& sql, const BindValues& values, bool log = true, ChoiceOnUse choice = Ask) const;
+
+    struct StatementCacheStatistics
+    {
+        unsigned int hits;          //< statements which were found in the cache
+        unsigned int misses;        //< statements which had to be prepared
+        unsigned int evictions;     //< statements which were finalized to make room for others
+    };
+
+    // Counters of the prepared statement cache, accumulated since construction
+    StatementCacheStatistics statementCacheStatistics() const;
+
     const QString& lastError() const { return lastErrorMessage; }
 
+    // The number of rows changed by the last INSERT, UPDATE or DELETE statement which was executed on the main connection
+    int changes() const;
+
     /**
      * @brief getRow Executes a sqlite statement to get the rowdata(columns)
      *        for the given rowid.
@@ -187,7 +311,11 @@ private:
     static int callbackWrapper (void* callback, int numberColumns, char** values, char** columnNames);
 
 public:
-    void updateSchema();    // Please don't call this from threads other than the main thread.
+    /// read the schema again. only objects whose SQL has changed are
+    /// parsed again, and nothing is read at all if the schema version
+    /// of no schema has changed. please don't call this from threads
+    /// other than the main thread.
+    void updateSchema();
 
 private:
     /**
@@ -202,6 +330,9 @@ public:
     QString addRecord(const sqlb::ObjectIdentifier& tablename);
     bool deleteRecords(const sqlb::ObjectIdentifier& table, const std::vector<QByteArray>& rowids, const sqlb::StringVector& pseudo_pk = {});
     bool updateRecord(const sqlb::ObjectIdentifier& table, const std::string& column, const QByteArray& rowid, const QByteArray& value, int force_type = 0, const sqlb::StringVector& pseudo_pk = {});
+    // Update several columns of a row at once. The values and force_types vectors correspond to the columns vector.
+    bool updateRecord(const sqlb::ObjectIdentifier& table, const sqlb::StringVector& columns, const QByteArray& rowid, const std::vector<QByteArray>& values,
+                      const std::vector<int>& force_types, const sqlb::StringVector& pseudo_pk = {});
 
     bool createTable(const sqlb::ObjectIdentifier& name, const sqlb::FieldVector& structure);
     bool renameTable(const std::string& schema, const std::string& from_table, const std::string& to_table);
@@ -298,10 +429,13 @@ public:
 signals:
     void sqlExecuted(QString sql, int msgtype) const;
     void dbChanged(bool dirty);
-    void structureUpdated();
+    void structureUpdated(const SchemaChanges& changes);
     void requestCollation(QString name, int eTextRep);
     void databaseInUseChanged(bool busy, QString user);
 
+    /// progress of dump(), measured in the estimated numbers of rows of the tables
+    void dumpProgress(quint64 rows, quint64 totalRows);
+
 private:
     /// external code needs to go through get() to obtain access to the database
     sqlite3 * _db;
@@ -317,9 +451,110 @@ private:
 
     QString curDBFilename;
     mutable QString lastErrorMessage;
+    /// PRAGMA schema_version of each schema when updateSchema() last
+    /// read it. if none has changed, the schema is not read again.
+    std::map<std::string, int> schema_versions;
+    /// parsed schemata of database files from earlier sessions
+    SchemaCache schema_cache;
+
+    /// make the next updateSchema() read the schema again, e.g. after
+    /// rolling back, which restores an earlier schema version
+    void invalidateSchemaVersions();
     std::vector<std::string> savepointList;
     bool isEncrypted;
     bool isReadOnly;
+    bool isWal;                 ///< journal_mode is WAL, so readers don't block commits
+    bool caseSensitiveLike;     ///< value of the case_sensitive_like pragma, applied to readers too
+    std::vector<QString> loadedExtensions;
+
+    /// read-only connections handed out by getReader()
+    static constexpr size_t max_readers = 8;
+    mutable std::mutex readers_mutex;
+    std::condition_variable readers_cv;
+    std::vector<sqlite3*> idle_readers;
+    std::map<sqlite3*, unsigned int> busy_readers;  ///< maps to the generation the reader was opened in
+    unsigned int readers_generation;
+
+    /// can a separate connection see the same data as the main one?
+    bool canUseReaders() const;
+    sqlite3* openReader() const;
+    void releaseReader(sqlite3* reader);
+
+    /// close idle readers and make sure readers which are in use are
+    /// closed when released, e.g. after loading an extension.
+    void invalidateReaders();
+
+    /// wait until all readers are released. with interrupt set, their
+    /// current statements are aborted first. otherwise they get
+    /// reader_release_timeout milliseconds to finish on their own
+    /// before they are aborted, so this never blocks for long.
+    static constexpr int reader_release_timeout = 500;
+    void waitForReadersRelease(bool interrupt);
+
+    /// prepared statements of the main connection keyed by their SQL
+    /// text, most recently used first. statements being used are taken
+    /// out of the cache, so they can neither be evicted nor be used
+    /// twice at the same time. the containers are guarded by
+    /// cached_statements_mutex because the database is also used from
+    /// worker threads. the generation counts how often the cache has
+    /// been cleared.
+    static constexpr size_t max_cached_statements = 64;
+    using CachedStatements = std::list<std::pair<std::string, sqlite3_stmt*>>;
+    mutable std::mutex cached_statements_mutex;
+    mutable CachedStatements cached_statements;
+    mutable std::unordered_map<std::string, CachedStatements::iterator> cached_statements_index;
+    mutable unsigned int cached_statements_generation;
+    mutable StatementCacheStatistics statement_cache_statistics;
+
+    /// a statement handed out by prepareCached(). it belongs to the
+    /// handle until the handle is destroyed, which resets the statement
+    /// and puts it back into the cache, or finalizes it if the cache
+    /// has been cleared in the meantime.
+    class CachedStatement
+    {
+    public:
+        CachedStatement(const DBBrowserDB& db, const std::string& sql, sqlite3_stmt* stmt, unsigned int generation);
+        CachedStatement(CachedStatement&& other) noexcept;
+        ~CachedStatement();
+
+        CachedStatement(const CachedStatement&) = delete;
+        CachedStatement& operator=(const CachedStatement&) = delete;
+        CachedStatement& operator=(CachedStatement&&) = delete;
+
+        /// \returns the statement or nullptr if preparing it failed
+        sqlite3_stmt* get() const { return m_stmt; }
+
+    private:
+        const DBBrowserDB& m_db;
+        std::string m_sql;
+        sqlite3_stmt* m_stmt;
+        unsigned int m_generation;
+    };
+
+    /// \returns the prepared statement for the sql, taken from the
+    /// cache if possible. the statement of the handle is nullptr on
+    /// error.
+    CachedStatement prepareCached(const std::string& sql) const;
+
+    /// put a statement which is not used anymore back into the cache
+    void returnCached(const std::string& sql, sqlite3_stmt* stmt, unsigned int generation) const;
+
+    /// finalize all cached statements, e.g. when the schema changed or
+    /// before closing the database
+    void clearStatementCache() const;
+
+    /// indexes dropped by beginBulkLoad() and the state to restore
+    /// in endBulkLoad()
+    struct BulkLoadIndex
+    {
+        std::string name;
+        std::string table;
+        std::string sql;
+    };
+    std::vector<BulkLoadIndex> bulk_load_indices;
+    QString bulk_load_cache_size;
+    QElapsedTimer bulk_load_timer;
+    BulkLoadTimings bulk_load_timings;
 
     sqlb::StringVector primaryKeyForEditing(const sqlb::ObjectIdentifier& table, const sqlb::StringVector& pseudo_pk) const;
 
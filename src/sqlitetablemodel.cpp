@@ -18,6 +18,8 @@
 #include <QPushButton>
 
 #include <cassert>
+#include <cmath>
+#include <functional>
 
 SqliteTableModel::SqliteTableModel(DBBrowserDB& db, QObject* parent, const QString& encoding, bool force_wait)
     : QAbstractTableModel(parent)
@@ -25,13 +27,18 @@ SqliteTableModel::SqliteTableModel(DBBrowserDB& db, QObject* parent, const QStri
     , m_lifeCounter(0)
     , m_currentRowCount(0)
     , m_realRowCount(0)
+    , m_estimatedRowCount(-1)
+    , m_lastViewportRow(0)
+    , m_scrollVelocity(0.0)
+    , m_prefetchStatistics{0, 0, 0}
     , m_encoding(encoding)
 {
     // Load initial settings first
     reloadSettings();
 
     worker = new RowLoader(
-        [this, force_wait](){ return m_db.get(tr("reading rows"), force_wait); },
+        [this, force_wait](){ return m_db.getReader(tr("reading rows"), force_wait); },
+        [this](){ return std::shared_ptr<sqlite3>(m_db.tryGetReader()); },
         [this](QString stmt){ return m_db.logSQL(stmt, kLogMsg_App); },
         m_headers, m_mutexDataCache, m_cache
         );
@@ -40,7 +47,9 @@ SqliteTableModel::SqliteTableModel(DBBrowserDB& db, QObject* parent, const QStri
 
     // any UI updates must be performed in the UI thread, not in the worker thread:
     connect(worker, &RowLoader::fetched, this, &SqliteTableModel::handleFinishedFetch, Qt::QueuedConnection);
+    connect(worker, &RowLoader::rowCountEstimated, this, &SqliteTableModel::handleRowCountEstimated, Qt::QueuedConnection);
     connect(worker, &RowLoader::rowCountComplete, this, &SqliteTableModel::handleRowCountComplete, Qt::QueuedConnection);
+    connect(worker, &RowLoader::formatsEvaluated, this, &SqliteTableModel::handleFormatsEvaluated, Qt::QueuedConnection);
 
     reset();
 }
@@ -90,6 +99,15 @@ void SqliteTableModel::handleFinishedFetch (int life_id, unsigned int fetched_ro
     emit finishedFetch(static_cast<int>(fetched_row_begin), static_cast<int>(fetched_row_end));
 }
 
+void SqliteTableModel::handleRowCountEstimated (int life_id, int num_rows)
+{
+    if(life_id < m_lifeCounter || m_rowCountAvailable == RowCount::Complete)
+        return;
+
+    m_estimatedRowCount = num_rows;
+    emit rowCountEstimated();
+}
+
 void SqliteTableModel::handleRowCountComplete (int life_id, int num_rows)
 {
     if(life_id < m_lifeCounter)
@@ -106,6 +124,19 @@ void SqliteTableModel::handleRowCountComplete (int life_id, int num_rows)
     emit finishedRowCount();
 }
 
+void SqliteTableModel::handleFormatsEvaluated (int life_id, size_t row_begin, size_t row_end)
+{
+    if(life_id < m_lifeCounter)
+        return;
+
+    row_end = std::min(row_end, static_cast<size_t>(m_currentRowCount));
+    if(row_begin >= row_end || m_headers.empty())
+        return;
+
+    emit dataChanged(createIndex(static_cast<int>(row_begin), 0),
+                     createIndex(static_cast<int>(row_end) - 1, static_cast<int>(m_headers.size()) - 1));
+}
+
 void SqliteTableModel::reset()
 {
     beginResetModel();
@@ -118,6 +149,7 @@ void SqliteTableModel::reset()
     m_vDataTypes.clear();
     m_mCondFormats.clear();
     m_mRowIdFormats.clear();
+    updateFormatConditions();
 
     endResetModel();
 }
@@ -270,60 +302,110 @@ QVariant SqliteTableModel::headerData(int section, Qt::Orientation orientation,
         return QString::number(section + 1);
 }
 
-QVariant SqliteTableModel::getMatchingCondFormat(const std::map<size_t, std::vector<CondFormat>>& mCondFormats, size_t column, const QString& value, int role) const
+QVariant SqliteTableModel::getMatchingCondFormat(size_t row, size_t column, int role) const
 {
-    if (!mCondFormats.count(column))
+    if(!m_cache.count(row))
         return QVariant();
 
-    bool isNumber;
-    value.toDouble(&isNumber);
-    std::string sql;
+    // The index of the matching format has been determined while loading the row. It counts the row-id formats first, because
+    // they take precedence, and the conditional formats after them.
+    int index = m_cache.at(row).format(column);
+    if(index < 0)
+        return QVariant();
 
-    // For each conditional format for this column,
-    // if the condition matches the current data, return the associated format.
-    for (const CondFormat& eachCondFormat : mCondFormats.at(column)) {
-        if (isNumber && !contains(eachCondFormat.sqlCondition(), '\''))
-            sql = "SELECT " + value.toStdString() + " " + eachCondFormat.sqlCondition();
-        else
-            sql = "SELECT " + sqlb::escapeString(value.toStdString()) + " " + eachCondFormat.sqlCondition();
+    const CondFormat* format = nullptr;
+    const auto rowid_formats = m_mRowIdFormats.find(column);
+    const size_t num_rowid_formats = rowid_formats != m_mRowIdFormats.end() ? rowid_formats->second.size() : 0;
+    if(static_cast<size_t>(index) < num_rowid_formats)
+    {
+        format = &rowid_formats->second.at(static_cast<size_t>(index));
+    } else {
+        index -= static_cast<int>(num_rowid_formats);
+        const auto cond_formats = m_mCondFormats.find(column);
+        if(cond_formats == m_mCondFormats.end() || static_cast<size_t>(index) >= cond_formats->second.size())
+            return QVariant();      // The formats have changed and the rows are still being reevaluated
+        format = &cond_formats->second.at(static_cast<size_t>(index));
+    }
 
-        // Empty filter means: apply format to any row.
-        // Query the DB for the condition, waiting in case there is a loading in progress.
-        if (eachCondFormat.filter().isEmpty() || m_db.querySingleValueFromDb(sql, false, DBBrowserDB::Wait) == "1")
-            switch (role) {
-              case Qt::ForegroundRole:
-                return eachCondFormat.foregroundColor();
-            case Qt::BackgroundRole:
-                return eachCondFormat.backgroundColor();
-            case Qt::FontRole:
-                return eachCondFormat.font();
-            case Qt::TextAlignmentRole:
-                return static_cast<int>(eachCondFormat.alignmentFlag() | Qt::AlignVCenter);
-            }
+    switch (role) {
+    case Qt::ForegroundRole:
+        return format->foregroundColor();
+    case Qt::BackgroundRole:
+        return format->backgroundColor();
+    case Qt::FontRole:
+        return format->font();
+    case Qt::TextAlignmentRole:
+        return static_cast<int>(format->alignmentFlag() | Qt::AlignVCenter);
     }
     return QVariant();
 }
 
-QVariant SqliteTableModel::getMatchingCondFormat(size_t row, size_t column, const QString& value, int role) const
+void SqliteTableModel::updateFormatConditions()
 {
-    QVariant format;
-    // Check first for a row-id format and when there is none, for a conditional format.
-    if (m_mRowIdFormats.count(column))
+    m_formatConditions.clear();
+    for(const auto& it : m_mRowIdFormats)
     {
-        std::unique_lock<std::mutex> lock(m_mutexDataCache);
-        const bool row_available = m_cache.count(row);
-        const QByteArray blank_data("");
-        const QByteArray& row_id_data = row_available ? m_cache.at(row).at(0) : blank_data;
-        lock.unlock();
-
-        format = getMatchingCondFormat(m_mRowIdFormats, column, row_id_data, role);
-        if (format.isValid())
-            return format;
+        for(const CondFormat& format : it.second)
+            m_formatConditions[it.first].push_back({format.sqlCondition(), true});
     }
-    if (m_mCondFormats.count(column))
-        return getMatchingCondFormat(m_mCondFormats, column, value, role);
-    else
-        return QVariant();
+    for(const auto& it : m_mCondFormats)
+    {
+        for(const CondFormat& format : it.second)
+            m_formatConditions[it.first].push_back({format.sqlCondition(), false});
+    }
+
+    worker->setFormatConditions(m_formatConditions);
+    if(m_currentRowCount > 0)
+        worker->triggerFormatEvaluation(m_lifeCounter, 0, m_currentRowCount);
+}
+
+void SqliteTableModel::evaluateFormats(size_t row_begin, size_t row_end)
+{
+    if(m_formatConditions.empty())
+        return;
+
+    // Copy the rows and release the cache again before getting the database. Waiting for the database while holding the cache lock
+    // could deadlock with the row loader which needs the cache lock to finish its work.
+    std::vector<std::pair<size_t, std::vector<QByteArray>>> rows;
+    {
+        std::lock_guard<std::mutex> lock(m_mutexDataCache);
+        for(size_t row=row_begin;row<row_end;row++)
+        {
+            if(!m_cache.count(row))
+                continue;
+
+            const auto cached_row = m_cache.at(row);
+            std::vector<QByteArray> values;
+            values.reserve(cached_row.size());
+            for(size_t i=0;i<cached_row.size();i++)
+                values.push_back(cached_row.at(i));
+            rows.emplace_back(row, std::move(values));
+        }
+    }
+    if(rows.empty())
+        return;
+
+    std::vector<std::vector<int>> formats;
+    formats.reserve(rows.size());
+    {
+        auto pDb = m_db.get(tr("evaluating conditional formats"), true);
+        if(!pDb)
+            return;
+
+        const RowLoader::FormatEvaluator evaluator(pDb.get(), m_formatConditions);
+        RowLoader::Cache::CellRow cells;
+        for(const auto& row : rows)
+        {
+            cells.clear();
+            for(const auto& v : row.second)
+                cells.push_back(RowLoader::Cache::Cell::fromByteArray(v));
+            formats.push_back(evaluator.evaluate(cells));
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutexDataCache);
+    for(size_t i=0;i<rows.size();i++)
+        m_cache.setFormats(rows[i].first, formats[i]);
 }
 
 QVariant SqliteTableModel::data(const QModelIndex &index, int role) const
@@ -340,19 +422,26 @@ QVariant SqliteTableModel::data(const QModelIndex &index, int role) const
     const size_t column = static_cast<size_t>(index.column());
 
     const bool row_available = m_cache.count(row);
-    const QByteArray blank_data("");
-    const QByteArray& data = row_available ? m_cache.at(row).at(column) : blank_data;
+
+    // Look at the cached value without copying it. Only the display and edit roles need a copy of it,
+    // all the other roles only check whether it is NULL or binary.
+    const RowLoader::Cache::Cell cell = row_available ? m_cache.at(row).cell(column) : RowLoader::Cache::Cell::fromBytes("", 0);
+    const bool is_null = cell.kind == RowLoader::Cache::Cell::Null;
+    const auto is_binary = [this, &cell]() {
+        return cell.kind == RowLoader::Cache::Cell::Bytes && isBinary(QByteArray::fromRawData(cell.data, static_cast<int>(cell.size)));
+    };
 
     if(role == Qt::DisplayRole)
     {
         if(!row_available)
             return tr("loading...");
-        if(data.isNull())
+        if(is_null)
         {
             return m_nullText;
-        } else if(isBinary(data)) {
+        } else if(is_binary()) {
             return m_blobText;
         } else {
+            const QByteArray data = cell.toByteArray();
             if (data.length() > m_symbolLimit) {
                 // Add "..." to the end of truncated strings
                 return decode(data.left(m_symbolLimit).append(" ..."));
@@ -361,9 +450,9 @@ QVariant SqliteTableModel::data(const QModelIndex &index, int role) const
             }
         }
     } else if(role == Qt::EditRole) {
-        if(!row_available || data.isNull())
+        if(!row_available || is_null)
             return QVariant();
-        QVariant decodedData = decode(data);
+        QVariant decodedData = decode(cell.toByteArray());
         QVariant convertedData = decodedData;
         bool converted = false;
         // For the edit role, return the data according to its column type if possible.
@@ -377,12 +466,10 @@ QVariant SqliteTableModel::data(const QModelIndex &index, int role) const
         return converted? convertedData : decodedData;
     } else if(role == Qt::FontRole) {
         QFont font = m_font;
-        if(!row_available || data.isNull() || isBinary(data))
+        if(!row_available || is_null || is_binary())
             font.setItalic(true);
         else {
-            // Unlock before querying from DB
-            lock.unlock();
-            QVariant condFormatFont = getMatchingCondFormat(row, column, data, role);
+            QVariant condFormatFont = getMatchingCondFormat(row, column, role);
             if (condFormatFont.isValid())
                 return condFormatFont;
         }
@@ -390,14 +477,12 @@ QVariant SqliteTableModel::data(const QModelIndex &index, int role) const
     } else if(role == Qt::ForegroundRole) {
         if(!row_available)
             return QColor(100, 100, 100);
-        if(data.isNull())
+        if(is_null)
             return m_nullFgColour;
-        else if (isBinary(data))
+        else if (is_binary())
             return m_binFgColour;
         else {
-            // Unlock before querying from DB
-            lock.unlock();
-            QVariant condFormatColor = getMatchingCondFormat(row, column, data, role);
+            QVariant condFormatColor = getMatchingCondFormat(row, column, role);
             if (condFormatColor.isValid())
                 return condFormatColor;
             if (hasDisplayFormat(index))
@@ -408,14 +493,12 @@ QVariant SqliteTableModel::data(const QModelIndex &index, int role) const
     } else if (role == Qt::BackgroundRole) {
         if(!row_available)
             return QColor(255, 200, 200);
-        if(data.isNull())
+        if(is_null)
             return m_nullBgColour;
-        else if (isBinary(data))
+        else if (is_binary())
             return m_binBgColour;
         else {
-            // Unlock before querying from DB
-            lock.unlock();
-            QVariant condFormatColor = getMatchingCondFormat(row, column, data, role);
+            QVariant condFormatColor = getMatchingCondFormat(row, column, role);
             if (condFormatColor.isValid())
                 return condFormatColor;
             if (hasDisplayFormat(index))
@@ -433,16 +516,17 @@ QVariant SqliteTableModel::data(const QModelIndex &index, int role) const
     } else if (role == Qt::TextAlignmentRole) {
         // Align horizontally according to conditional format or default (left for text and right for numbers)
         // Align vertically to the center, which displays better.
-        lock.unlock();
-        QVariant condFormat = getMatchingCondFormat(row, column, data, role);
+        QVariant condFormat = getMatchingCondFormat(row, column, role);
         if (condFormat.isValid())
             return condFormat;
         bool isNumber = m_vDataTypes.at(column) == SQLITE_INTEGER || m_vDataTypes.at(column) == SQLITE_FLOAT;
         return static_cast<int>((isNumber ? Qt::AlignRight : Qt::AlignLeft) | Qt::AlignVCenter);
     } else if(role == Qt::DecorationRole) {
-        if(!row_available)
+        if(!row_available || cell.kind != RowLoader::Cache::Cell::Bytes)
             return QVariant();
 
+        // The image is decoded while the cache is still locked, so there is no need to copy the data
+        const QByteArray data = QByteArray::fromRawData(cell.data, static_cast<int>(cell.size));
         if(m_imagePreviewEnabled && !isImageData(data).isNull())
         {
             QImage img;
@@ -488,8 +572,81 @@ bool SqliteTableModel::setData(const QModelIndex& index, const QVariant& value,
     return setTypedData(index, false, value, role);
 }
 
+int SqliteTableModel::prepareValueForUpdate(size_t column, bool isBlob, QByteArray& value) const
+{
+    // Special handling for integer columns: instead of setting an integer column to an empty string, set it to '0' when it is also
+    // used in a primary key. Otherwise SQLite will always output an 'datatype mismatch' error.
+    if(value == "" && !value.isNull())
+    {
+        if(m_table_of_query)
+        {
+            auto field = sqlb::findField(m_table_of_query, m_headers.at(column));
+            const auto pk = m_table_of_query->primaryKeyColumns();
+            if(contains(pk, field->name()) && field->isInteger())
+                value = "0";
+        }
+    }
+
+    // Determine type. If the BLOB flag is set, it's always BLOB. If the affinity data type of the modified column is something numeric,
+    // we check if the new value is also numeric. In that case we can safely set the data type to INTEGER or FLOAT. In all other cases we
+    // default to TEXT.
+    int type = SQLITE_TEXT;
+    if(isBlob)
+    {
+        type = SQLITE_BLOB;
+    } else if(m_vDataTypes.at(column) == SQLITE_INTEGER) {
+        bool ok;
+        value.toLongLong(&ok);
+        if(ok)
+            type = SQLITE_INTEGER;
+    } else if(m_vDataTypes.at(column) == SQLITE_FLOAT) {
+        bool ok;
+        value.toDouble(&ok);
+        if(ok)
+            type = SQLITE_FLOAT;
+    }
+
+    return type;
+}
+
+bool SqliteTableModel::setCachedCell(size_t row, size_t column, const QByteArray& value)
+{
+    m_cache.setCell(row, column, value);
+
+    // Changing the value of the key column invalidates the positions of all key values we know
+    if(keysetColumn() == static_cast<int>(column))
+        worker->resetKeysetAnchors();
+
+    // After updating the value itself in the cache, we need to check if we need to update the rowid too.
+    if(!contains(m_query.rowIdColumns(), m_headers.at(column)))
+        return false;
+
+    // When the cached rowid column needs to be updated as well, we need to distinguish between single-column and multi-column primary keys.
+    // For the former ones, we can just overwrite the existing value with the new value.
+    // For the latter ones, we need to make a new JSON object of the values of all primary key columns, not just the updated one.
+    if(m_query.rowIdColumns().size() == 1)
+    {
+        m_cache.setCell(row, 0, value);
+    } else {
+        const auto updated_row = m_cache.at(row);
+        assert(m_headers.size() == updated_row.size());
+        QByteArray output;
+        for(size_t i=0;i<m_query.rowIdColumns().size();i++)
+        {
+            auto it = std::find(m_headers.begin()+1, m_headers.end(), m_query.rowIdColumns().at(i));    // +1 in order to omit the rowid column itself
+            auto v = updated_row.at(static_cast<size_t>(std::distance(m_headers.begin(), it)));
+            output += QByteArray::number(v.size()) + ":" + v;
+        }
+        m_cache.setCell(row, 0, output);
+    }
+    return true;
+}
+
 bool SqliteTableModel::setTypedData(const QModelIndex& index, bool isBlob, const QVariant& value, int role)
 {
+    // Rows which were only prefetched in case the user scrolls there are not worth refusing the change for
+    worker->cancelPrefetch();
+
     if(readingData()) {
         // can't insert rows while reading data in background
         return false;
@@ -501,78 +658,34 @@ bool SqliteTableModel::setTypedData(const QModelIndex& index, bool isBlob, const
     {
         std::unique_lock<std::mutex> lock(m_mutexDataCache);
 
-        auto & cached_row = m_cache.at(static_cast<size_t>(index.row()));
+        const size_t row = static_cast<size_t>(index.row());
         const size_t column = static_cast<size_t>(index.column());
+        const auto cached_row = m_cache.at(row);
 
         QByteArray newValue = encode(value.toByteArray());
         QByteArray oldValue = cached_row.at(column);
-
-        // Special handling for integer columns: instead of setting an integer column to an empty string, set it to '0' when it is also
-        // used in a primary key. Otherwise SQLite will always output an 'datatype mismatch' error.
-        if(newValue == "" && !newValue.isNull())
-        {
-            if(m_table_of_query)
-            {
-                auto field = sqlb::findField(m_table_of_query, m_headers.at(column));
-                const auto pk = m_table_of_query->primaryKeyColumns();
-                if(contains(pk, field->name()) && field->isInteger())
-                    newValue = "0";
-            }
-        }
+        const int type = prepareValueForUpdate(column, isBlob, newValue);
 
         // Don't do anything if the data hasn't changed
         // To differentiate NULL and empty byte arrays, we also compare the NULL flag
         if(oldValue == newValue && oldValue.isNull() == newValue.isNull())
             return true;
 
-        // Determine type. If the BLOB flag is set, it's always BLOB. If the affinity data type of the modified column is something numeric,
-        // we check if the new value is also numeric. In that case we can safely set the data type to INTEGER or FLOAT. In all other cases we
-        // default to TEXT.
-        int type = SQLITE_TEXT;
-        if(isBlob)
-        {
-            type = SQLITE_BLOB;
-        } else if(m_vDataTypes.at(column) == SQLITE_INTEGER) {
-            bool ok;
-            newValue.toLongLong(&ok);
-            if(ok)
-                type = SQLITE_INTEGER;
-        } else if(m_vDataTypes.at(column) == SQLITE_FLOAT) {
-            bool ok;
-            newValue.toDouble(&ok);
-            if(ok)
-                type = SQLITE_FLOAT;
-        }
-
         if(m_db.updateRecord(m_query.table(), m_headers.at(column), cached_row.at(0), newValue, type, m_query.rowIdColumns()))
         {
-            cached_row[column] = newValue;
+            // This invalidates cached_row
+            const bool rowid_changed = setCachedCell(row, column, newValue);
+            lock.unlock();
+            evaluateFormats(row, row + 1);
 
-            // After updating the value itself in the cache, we need to check if we need to update the rowid too.
-            if(contains(m_query.rowIdColumns(), m_headers.at(column)))
+            if(rowid_changed)
             {
-                // When the cached rowid column needs to be updated as well, we need to distinguish between single-column and multi-column primary keys.
-                // For the former ones, we can just overwrite the existing value with the new value.
-                // For the latter ones, we need to make a new JSON object of the values of all primary key columns, not just the updated one.
-                if(m_query.rowIdColumns().size() == 1)
-                {
-                    cached_row[0] = newValue;
-                } else {
-                    assert(m_headers.size() == cached_row.size());
-                    QByteArray output;
-                    for(size_t i=0;i<m_query.rowIdColumns().size();i++)
-                    {
-                        auto it = std::find(m_headers.begin()+1, m_headers.end(), m_query.rowIdColumns().at(i));    // +1 in order to omit the rowid column itself
-                        auto v = cached_row[static_cast<size_t>(std::distance(m_headers.begin(), it))];
-                        output += QByteArray::number(v.size()) + ":" + v;
-                    }
-                    cached_row[0] = output;
-                }
                 const QModelIndex& rowidIndex = index.sibling(index.row(), 0);
-                lock.unlock();
                 emit dataChanged(rowidIndex, rowidIndex);
-            } else {
-                lock.unlock();
+
+                // Row-id formats apply to all columns of the row
+                if(m_mRowIdFormats.size())
+                    emit dataChanged(index.sibling(index.row(), 1), index.sibling(index.row(), static_cast<int>(m_headers.size()) - 1));
             }
             emit dataChanged(index, index);
             return true;
@@ -586,6 +699,147 @@ bool SqliteTableModel::setTypedData(const QModelIndex& index, bool isBlob, const
     return false;
 }
 
+bool SqliteTableModel::setTypedDataRange(const QModelIndex& topLeft, bool isBlob, const std::vector<std::vector<QByteArray>>& values)
+{
+    if(!topLeft.isValid() || values.empty() || !isEditable())
+        return false;
+
+    const size_t first_row = static_cast<size_t>(topLeft.row());
+    const size_t first_column = static_cast<size_t>(topLeft.column());
+    const size_t end_row = std::min(first_row + values.size(), static_cast<size_t>(rowCount()));
+    if(first_row >= end_row)
+        return false;
+
+    // Rows which were only prefetched in case the user scrolls there are not worth refusing the change for
+    worker->cancelPrefetch();
+
+    // All rows of the range need to be in the cache and must stay there until they are updated. The range can be larger than a
+    // chunk, so keep loading chunks starting at the first missing row until all of them are there.
+    pinCache();
+    size_t missing_row = first_row;
+    bool loaded = false;
+    while(true)
+    {
+        size_t missing_begin = missing_row;
+        size_t missing_end = end_row;
+        {
+            std::lock_guard<std::mutex> lock(m_mutexDataCache);
+            m_cache.smallestNonAvailableRange(missing_begin, missing_end);
+        }
+
+        // Stop when everything is loaded or when the last load didn't get us any further, e.g. because it was cancelled
+        const bool stuck = loaded && missing_begin == missing_row;
+        missing_row = missing_begin;
+        if(missing_row >= end_row || stuck)
+            break;
+
+        triggerCacheLoad(static_cast<int>(missing_row + m_chunkSize / 2));
+        waitUntilIdle();
+        loaded = true;
+    }
+
+    if(missing_row < end_row || readingData()) {
+        // can't change rows while reading data in background or when not all of them could be loaded
+        unpinCache();
+        return false;
+    }
+
+    m_db.setUndoSavepoint();
+
+    // Run all updates in their own savepoint, so a failing row doesn't leave the range half updated
+    const std::string savepoint = m_db.generateSavepointName("updaterange");
+    m_db.setSavepoint(savepoint);
+
+    // Group the changed cells by row. Each row is then updated by a single UPDATE statement for all of its changed columns. Because
+    // the statement only depends on the set of columns, it is prepared once and then taken from the statement cache for the other rows.
+    struct RowUpdate
+    {
+        size_t row;
+        std::vector<size_t> columns;
+        std::vector<QByteArray> values;
+    };
+    std::vector<RowUpdate> updates;
+    bool success = true;
+    {
+        std::lock_guard<std::mutex> lock(m_mutexDataCache);
+
+        sqlb::StringVector column_names;
+        std::vector<int> types;
+        for(size_t row=first_row;row<end_row && success;row++)
+        {
+            const auto cached_row = m_cache.at(row);
+
+            RowUpdate update{row, {}, {}};
+            column_names.clear();
+            types.clear();
+            const auto& source_row = values.at(row - first_row);
+            for(size_t i=0;i<source_row.size() && first_column + i < m_headers.size();i++)
+            {
+                const size_t column = first_column + i;
+                if(!isEditable(index(static_cast<int>(row), static_cast<int>(column))))
+                    continue;
+
+                QByteArray newValue = encode(source_row.at(i));
+                QByteArray oldValue = cached_row.at(column);
+                const int type = prepareValueForUpdate(column, isBlob, newValue);
+
+                // Don't do anything if the data hasn't changed
+                if(oldValue == newValue && oldValue.isNull() == newValue.isNull())
+                    continue;
+
+                column_names.push_back(m_headers.at(column));
+                types.push_back(type);
+                update.columns.push_back(column);
+                update.values.push_back(newValue);
+            }
+
+            if(update.columns.empty())
+                continue;
+
+            success = m_db.updateRecord(m_query.table(), column_names, cached_row.at(0), update.values, types, m_query.rowIdColumns());
+            updates.push_back(std::move(update));
+        }
+    }
+
+    if(!success)
+    {
+        const QString error = m_db.lastError();
+        m_db.revertToSavepoint(savepoint);
+        unpinCache();
+        QMessageBox::warning(nullptr, qApp->applicationName(), tr("Error changing data:\n%1").arg(error));
+        return false;
+    }
+    m_db.releaseSavepoint(savepoint);
+
+    // Only now that all rows were updated successfully, update the cache as well
+    size_t last_column = first_column;
+    bool rowid_changed = false;
+    {
+        std::lock_guard<std::mutex> lock(m_mutexDataCache);
+        for(const auto& update : updates)
+        {
+            for(size_t i=0;i<update.columns.size();i++)
+            {
+                rowid_changed |= setCachedCell(update.row, update.columns[i], update.values[i]);
+                last_column = std::max(last_column, update.columns[i]);
+            }
+        }
+        m_cache.unpin();
+    }
+
+    if(!updates.empty())
+    {
+        evaluateFormats(updates.front().row, updates.back().row + 1);
+
+        // A changed rowid affects the hidden rowid column and, through the row-id formats, all columns of the row
+        const int left = rowid_changed ? 0 : static_cast<int>(first_column);
+        const int right = rowid_changed && m_mRowIdFormats.size() ? static_cast<int>(m_headers.size()) - 1 : static_cast<int>(last_column);
+        emit dataChanged(index(static_cast<int>(updates.front().row), left), index(static_cast<int>(updates.back().row), right));
+    }
+
+    return true;
+}
+
 // Custom display format set?
 bool SqliteTableModel::hasDisplayFormat (const QModelIndex& index) const
 {
@@ -652,6 +906,7 @@ bool SqliteTableModel::insertRows(int row, int count, const QModelIndex& parent)
     if(!isEditable())
         return false;
 
+    worker->cancelPrefetch();
     if(readingData()) {
         // can't insert rows while reading data in background
         return false;
@@ -681,13 +936,20 @@ bool SqliteTableModel::insertRows(int row, int count, const QModelIndex& parent)
         }
     }
 
+    // Row numbers after the inserted rows are shifted now
+    worker->resetKeysetAnchors();
+
     beginInsertRows(parent, row, row + count - 1);
-    for(size_t i = 0; i < tempList.size(); ++i)
     {
-        m_cache.insert(i + static_cast<size_t>(row), std::move(tempList.at(i)));
-        m_currentRowCount++;
-        m_realRowCount++;
+        std::lock_guard<std::mutex> lock(m_mutexDataCache);
+        for(size_t i = 0; i < tempList.size(); ++i)
+        {
+            m_cache.insert(i + static_cast<size_t>(row), tempList.at(i));
+            m_currentRowCount++;
+            m_realRowCount++;
+        }
     }
+    evaluateFormats(static_cast<size_t>(row), static_cast<size_t>(row + count));
     endInsertRows();
 
     return true;
@@ -698,6 +960,7 @@ bool SqliteTableModel::removeRows(int row, int count, const QModelIndex& parent)
     if(!isEditable())
         return false;
 
+    worker->cancelPrefetch();
     if(readingData()) {
         // can't delete rows while reading data in background
         return false;
@@ -714,6 +977,9 @@ bool SqliteTableModel::removeRows(int row, int count, const QModelIndex& parent)
     bool ok = m_db.deleteRecords(m_query.table(), rowids, m_query.rowIdColumns());
 
     if (ok) {
+        // Row numbers after the removed rows are shifted now
+        worker->resetKeysetAnchors();
+
         beginRemoveRows(parent, row, row + count - 1);
 
         for(int i=count-1;i>=0;i--)
@@ -762,12 +1028,86 @@ void SqliteTableModel::updateAndRunQuery()
     QString sCountQuery = QString::fromStdString(m_query.buildCountQuery());
     worker->setQuery(m_sQuery, sCountQuery);
 
+    // Help with counting the rows of big tables
+    QStringList estimateQueries;
+    for(const auto& q : m_query.buildRowCountEstimateQueries())
+        estimateQueries.push_back(QString::fromStdString(q));
+    worker->setRowCountQueries(estimateQueries,
+                               QString::fromStdString(m_query.buildKeyRangeQuery()),
+                               QString::fromStdString(m_query.buildRangeCountQuery()));
+
+    // If possible, page through the data by seeking to known key values instead of skipping ever more rows using offsets
+    const int key_column = keysetColumn();
+    if(key_column >= 0)
+    {
+        const std::string key = m_headers.at(static_cast<size_t>(key_column));
+        worker->setKeysetQuery(QString::fromStdString(m_query.buildKeysetQuery(key, false)),
+                               QString::fromStdString(m_query.buildKeysetQuery(key, true)),
+                               QString::fromStdString(m_query.buildKeysetAnchorQuery(key, false)),
+                               QString::fromStdString(m_query.buildKeysetAnchorQuery(key, true)),
+                               static_cast<size_t>(key_column));
+    }
+
     // now fetch the first entries
     triggerCacheLoad(static_cast<int>(m_chunkSize / 2) - 1);
 
     emit layoutChanged();
 }
 
+int SqliteTableModel::keysetColumn() const
+{
+    // Keyset pagination is only supported for tables, not for views or virtual tables, and only for a single key column
+    if(!m_table_of_query || m_table_of_query->isView() || m_table_of_query->isVirtual())
+        return -1;
+    if(m_query.rowIdColumns().size() != 1 || m_query.orderBy().size() > 1)
+        return -1;
+
+    // Without explicit sort order or when sorting by the rowid column we can use the rowid column as key
+    if(m_query.orderBy().empty())
+        return 0;
+    const sqlb::OrderBy& sort = m_query.orderBy().front();
+    if(sort.is_expression)
+        return -1;
+    const auto header = std::find(m_headers.begin(), m_headers.end(), sort.expr);
+    if(header == m_headers.end())
+        return -1;
+    if(header == m_headers.begin())
+        return 0;
+
+    // Columns with a display format are sorted by their formatted value which we cannot seek to
+    const auto selected = std::find_if(m_query.selectedColumns().begin(), m_query.selectedColumns().end(), [&sort](const sqlb::SelectedColumn& c) {
+        return c.original_column == sort.expr;
+    });
+    if(selected != m_query.selectedColumns().end() && selected->selector != selected->original_column)
+        return -1;
+
+    // Check whether the sort column is unique and not null
+    const auto field = sqlb::findField(m_table_of_query, sort.expr);
+    if(field == m_table_of_query->fields.end())
+        return -1;
+
+    const auto pk = m_table_of_query->primaryKeyColumns();
+    const bool is_pk = pk.size() == 1 && pk.front() == field->name();
+    const bool is_rowid_alias = is_pk && !m_table_of_query->withoutRowidTable() && compare_ci(field->type(), "INTEGER");
+    bool is_unique = is_pk || field->unique();
+    if(!is_unique && m_db.schemata.count(m_query.table().schema()))
+    {
+        const auto& indices = m_db.schemata.at(m_query.table().schema()).indices;
+        is_unique = std::any_of(indices.begin(), indices.end(), [this, &field](const auto& it) {
+            const sqlb::IndexPtr& idx = it.second;
+            return idx->unique() && idx->whereExpr().empty() && idx->table() == m_query.table().name() &&
+                    idx->fields.size() == 1 && idx->fields.front() == field->name();
+        });
+    }
+
+    // Primary keys of WITHOUT ROWID tables and rowid aliases cannot be NULL, anything else needs a NOT NULL constraint
+    const bool is_notnull = field->notnull() || is_rowid_alias || (is_pk && m_table_of_query->withoutRowidTable());
+
+    if(is_unique && is_notnull)
+        return static_cast<int>(std::distance(m_headers.begin(), header));
+    return -1;
+}
+
 void SqliteTableModel::getColumnNames(const std::string& sQuery)
 {
     auto pDb = m_db.get(tr("retrieving list of columns"));
@@ -808,6 +1148,7 @@ void SqliteTableModel::addCondFormat(const bool isRowIdFormat, size_t column, co
         addCondFormatToMap(m_mRowIdFormats, column, condFormat);
     else
         addCondFormatToMap(m_mCondFormats, column, condFormat);
+    updateFormatConditions();
     emit layoutChanged();
 }
 
@@ -817,6 +1158,7 @@ void SqliteTableModel::setCondFormats(const bool isRowIdFormat, size_t column, c
         m_mRowIdFormats[column] = condFormats;
     else
         m_mCondFormats[column] = condFormats;
+    updateFormatConditions();
     emit layoutChanged();
 }
 
@@ -862,8 +1204,12 @@ void SqliteTableModel::clearCache()
 
     m_cache.clear();
 
+    m_scrollTimer.invalidate();
+    m_scrollVelocity = 0.0;
+
     m_currentRowCount = 0;
     m_realRowCount = 0;
+    m_estimatedRowCount = -1;
     m_rowCountAvailable = RowCount::Unknown;
 }
 
@@ -875,8 +1221,8 @@ bool SqliteTableModel::isBinary(const QModelIndex& index) const
     if(!m_cache.count(row))
         return false;
 
-    const auto & cached_row = m_cache.at(row);
-    return isBinary(cached_row.at(static_cast<size_t>(index.column())));
+    const auto cell = m_cache.at(row).cell(static_cast<size_t>(index.column()));
+    return cell.kind == RowLoader::Cache::Cell::Bytes && isBinary(QByteArray::fromRawData(cell.data, static_cast<int>(cell.size)));
 }
 
 bool SqliteTableModel::isBinary(const QByteArray& data) const
@@ -977,8 +1323,10 @@ void SqliteTableModel::triggerCacheLoad (int row) const
         // will be truncated by reader
     }
 
-    // avoid re-fetching data
+    // avoid re-fetching data. The rows around the requested one are about to be shown, so make sure they are not evicted
+    // from the cache again when loading them makes it exceed its memory limit.
     std::lock_guard<std::mutex> lk(m_mutexDataCache);
+    m_cache.setProtectedRange(row_begin, row_end);
     m_cache.smallestNonAvailableRange(row_begin, row_end);
 
     if(row_end != row_begin)
@@ -993,6 +1341,69 @@ void SqliteTableModel::triggerCacheLoad (int row_begin, int row_end) const
     triggerCacheLoad((row_begin + row_end) / 2);
 }
 
+void SqliteTableModel::triggerViewportLoad (int row_begin, int row_end)
+{
+    if(row_end <= row_begin)
+        return;
+
+    // Estimate the scrolling speed. Average it a bit so that a single jump, e.g. when clicking into the scroll bar, does not count
+    // as much as continued scrolling in one direction. After a pause, the user is likely to look around first.
+    const qint64 scroll_pause_ms = 500;
+    const qint64 elapsed = m_scrollTimer.isValid() ? m_scrollTimer.restart() : -1;
+    if(elapsed < 0)
+        m_scrollTimer.start();
+    if(elapsed > 0 && elapsed < scroll_pause_ms)
+        m_scrollVelocity = 0.5 * m_scrollVelocity + 0.5 * (row_begin - m_lastViewportRow) / static_cast<double>(elapsed);
+    else if(elapsed < 0 || elapsed >= scroll_pause_ms)
+        m_scrollVelocity = 0.0;
+    m_lastViewportRow = row_begin;
+
+    size_t missing_begin = static_cast<size_t>(row_begin);
+    size_t missing_end = static_cast<size_t>(row_end);
+    {
+        std::lock_guard<std::mutex> lk(m_mutexDataCache);
+        m_cache.smallestNonAvailableRange(missing_begin, missing_end);
+    }
+    if(missing_begin == missing_end)
+        m_prefetchStatistics.hits++;
+    else
+        m_prefetchStatistics.misses++;
+
+    triggerCacheLoad(row_begin, row_end);
+
+    if(m_scrollVelocity == 0.0)
+        return;
+
+    // Prefetch the rows following the chunk around the visible rows in scrolling direction. Look ahead as far as the user
+    // scrolls in about a second at the current speed, but at least half a chunk and at most two chunks.
+    const size_t half_chunk = m_chunkSize / 2;
+    const size_t center = static_cast<size_t>(row_begin + row_end) / 2;
+    const size_t distance = std::min(std::max(static_cast<size_t>(std::abs(m_scrollVelocity) * 1000.0), half_chunk), 2 * m_chunkSize);
+    size_t prefetch_begin, prefetch_end;
+    if(m_scrollVelocity > 0.0)
+    {
+        prefetch_begin = center + half_chunk;
+        prefetch_end = prefetch_begin + distance;
+        if(rowCountAvailable() == RowCount::Complete)
+            prefetch_end = std::min(prefetch_end, static_cast<size_t>(rowCount()));
+    } else {
+        prefetch_end = center > half_chunk ? center - half_chunk : 0;
+        prefetch_begin = prefetch_end > distance ? prefetch_end - distance : 0;
+    }
+    if(prefetch_end <= prefetch_begin)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lk(m_mutexDataCache);
+        m_cache.smallestNonAvailableRange(prefetch_begin, prefetch_end);
+    }
+    if(prefetch_end != prefetch_begin)
+    {
+        worker->triggerPrefetch(m_lifeCounter, prefetch_begin, prefetch_end);
+        m_prefetchStatistics.prefetches++;
+    }
+}
+
 bool SqliteTableModel::completeCache () const
 {
     // Show progress dialog because fetching all data might take some time but only show
@@ -1015,18 +1426,25 @@ bool SqliteTableModel::completeCache () const
 
     waitUntilIdle();
 
+    // Don't evict the blocks loaded first while loading the later ones
+    pinCache();
+
     // This loop fetches all data by loading it block by block into the cache
     for(int i = 0; i < (rowCount() + static_cast<int>( m_chunkSize / 2)); i += static_cast<int>(m_chunkSize))
     {
         progress.setValue(i);
         qApp->processEvents();
         if(progress.wasCanceled())
+        {
+            unpinCache();
             return false;
+        }
 
         triggerCacheLoad(i);
         worker->waitUntilIdle();
     }
 
+    unpinCache();
     return true;
 }
 
@@ -1038,11 +1456,28 @@ bool SqliteTableModel::isCacheComplete () const
     return m_cache.numSet() == m_currentRowCount;
 }
 
+void SqliteTableModel::pinCache() const
+{
+    std::lock_guard<std::mutex> lock(m_mutexDataCache);
+    m_cache.pin();
+}
+
+void SqliteTableModel::unpinCache() const
+{
+    std::lock_guard<std::mutex> lock(m_mutexDataCache);
+    m_cache.unpin();
+}
+
 void SqliteTableModel::waitUntilIdle () const
 {
     worker->waitUntilIdle();
 }
 
+RowLoader::FetchMode SqliteTableModel::lastFetchMode () const
+{
+    return worker->lastFetchMode();
+}
+
 QModelIndex SqliteTableModel::nextMatch(const QModelIndex& start, const std::vector<int>& column_list, const QString& value, Qt::MatchFlags flags, bool reverse, bool dont_skip_to_next_field) const
 {
     // Extract flags
@@ -1061,20 +1496,21 @@ QModelIndex SqliteTableModel::nextMatch(const QModelIndex& start, const std::vec
     QRegularExpression reg_exp;
     if(regex)
     {
-        reg_exp = QRegularExpression(value, (case_sensitive ? QRegularExpression::NoPatternOption : QRegularExpression::CaseInsensitiveOption));
+        reg_exp = findRegularExpression(value, whole_cell, case_sensitive == Qt::CaseSensitive);
         if(!reg_exp.isValid())
             return QModelIndex();
-
-        if(whole_cell)
-        {
-#if QT_VERSION < QT_VERSION_CHECK(5, 12, 0)
-        reg_exp.setPattern("\\A(" + reg_exp.pattern() + ")\\Z");
-#else
-        reg_exp.setPattern(QRegularExpression::anchoredPattern(reg_exp.pattern()));
-#endif
-        }
     }
 
+    // This is how the data of a cell is compared to the search expression
+    const auto matches = [&](const QString& data) {
+        if(regex)
+            return reg_exp.match(data).hasMatch();
+        else if(whole_cell)
+            return data.compare(value, case_sensitive) == 0;
+        else
+            return data.contains(value, case_sensitive);
+    };
+
     // Wait until the row count is there
     waitUntilIdle();
 
@@ -1090,6 +1526,23 @@ QModelIndex SqliteTableModel::nextMatch(const QModelIndex& start, const std::vec
         pos = pos.sibling(pos.row(), reverse ? column_list.back() : column_list.front());
     }
 
+    // Let the database find the next match if possible. This is a lot faster than loading all rows in between, especially when there is no
+    // match at all. The database numbers the rows in the same order as the row loader, so its result can be used as it is and only the
+    // chunk containing the match needs to be loaded. Only if the query can't be run, search cell by cell instead.
+    QModelIndex db_match;
+    if(findMatchInDatabase(pos, column_list, value, whole_cell, regex, case_sensitive == Qt::CaseSensitive, wrap, reverse, dont_skip_to_next_field, db_match))
+    {
+        if(!db_match.isValid() || db_match.row() >= rowCount())
+            return QModelIndex();
+
+        if(!m_cache.count(static_cast<size_t>(db_match.row())))
+        {
+            triggerCacheLoad(db_match.row());
+            waitUntilIdle();
+        }
+        return db_match;
+    }
+
     // Get the last cell to search in. If wrapping is enabled, we search until we hit the start cell again. If wrapping is not enabled, we start at the last
     // cell of the table.
     QModelIndex end = (wrap ? pos : index(rowCount(), column_list.back()));
@@ -1141,22 +1594,254 @@ QModelIndex SqliteTableModel::nextMatch(const QModelIndex& start, const std::vec
             triggerCacheLoad(static_cast<int>(row));
             waitUntilIdle();
         }
-        const Row* row_data = &m_cache.at(row);
+        const auto row_data = m_cache.at(row);
 
-        // Get cell data
+        // Get cell data and perform comparison
         const size_t column = static_cast<size_t>(pos.column());
-        QString data = row_data->at(column);
-
-        // Perform comparison
-        if(whole_cell && !regex && data.compare(value, case_sensitive) == 0)
-            return pos;
-        else if(!whole_cell && !regex && data.contains(value, case_sensitive))
-            return pos;
-        else if(regex && reg_exp.match(data).hasMatch())
+        if(matches(row_data.at(column)))
             return pos;
     }
 }
 
+bool SqliteTableModel::findMatchInDatabase(const QModelIndex& start, std::vector<int> columns, const QString& value, bool whole_cell, bool regex,
+                                           bool case_sensitive, bool wrap, bool reverse, bool include_start, QModelIndex& match) const
+{
+    // Numbering the rows requires window functions. The results of arbitrary queries can't be searched this way.
+    if(m_query.table().isEmpty() || sqlite3_libversion_number() < 3025000)
+        return false;
+
+    std::sort(columns.begin(), columns.end());
+    std::vector<std::string> column_names;
+    for(int column : columns)
+        column_names.push_back(m_headers.at(static_cast<size_t>(column)));
+
+    // Case sensitive searches for plain text can be done using the built-in functions. Anything else uses our own function because
+    // LIKE and REGEXP don't compare text in the same way as we do.
+    const std::string match_flags = std::string(whole_cell ? "1" : "0") + "," + (case_sensitive ? "1" : "0") + "," + (regex ? "1" : "0");
+    const auto condition = [&](const std::string& column) -> std::string {
+        if(case_sensitive && !regex)
+        {
+            if(whole_cell)
+                return "CAST(" + column + " AS TEXT) = ?3";
+            else
+                return "instr(CAST(" + column + " AS TEXT), ?3) > 0";
+        }
+        return "sqlb_find_match(" + column + ",?3," + match_flags + ")";
+    };
+
+    // Number the rows in the same way as the row loader does
+    const int key_column = keysetColumn();
+    const std::string sql = m_query.buildFindQuery(column_names, condition,
+                                                   key_column >= 0 ? m_headers.at(static_cast<size_t>(key_column)) : std::string(), reverse);
+
+    auto pDb = m_db.getReader(tr("searching"));
+    sqlite3_stmt* stmt;
+    if(sqlite3_prepare_v2(pDb.get(), sql.c_str(), static_cast<int>(sql.size()), &stmt, nullptr) != SQLITE_OK)
+        return false;
+
+    const QByteArray utf8_value = value.toUtf8();
+    sqlite3_bind_text(stmt, 3, utf8_value.constData(), utf8_value.size(), SQLITE_TRANSIENT);
+
+    // Searches the rows from first_row to last_row for a match. In the row of the start index only the columns accepted by the given
+    // function count. Forward searches take the first matching column of a row, reverse searches the last one.
+    const int start_row = start.row();
+    const int start_column = start.column();
+    bool failed = false;
+    const auto search = [&](int first_row, int last_row, const std::function<bool(int)>& accept_in_start_row) {
+        sqlite3_reset(stmt);
+        sqlite3_bind_int(stmt, 1, first_row);
+        sqlite3_bind_int(stmt, 2, last_row);
+
+        int rc;
+        while((rc = sqlite3_step(stmt)) == SQLITE_ROW)
+        {
+            const int row = sqlite3_column_int(stmt, 0);
+            for(size_t i=0;i<columns.size();i++)
+            {
+                const size_t c = reverse ? columns.size() - 1 - i : i;
+                if(sqlite3_column_int(stmt, static_cast<int>(c) + 1) && (row != start_row || accept_in_start_row(columns.at(c))))
+                {
+                    match = index(row, columns.at(c));
+                    return true;
+                }
+            }
+        }
+
+        if(rc != SQLITE_DONE)
+            failed = true;
+        return false;
+    };
+
+    // Search from the start cell to the end of the table, then from the beginning of the table back to the start cell
+    const int last_row = rowCount() - 1;
+    match = QModelIndex();
+    if(!reverse)
+    {
+        if(!search(start_row, last_row, [&](int column) { return include_start ? column >= start_column : column > start_column; }) && !failed && wrap)
+            search(0, start_row, [&](int column) { return column < start_column; });
+    } else {
+        if(!search(0, start_row, [&](int column) { return include_start ? column <= start_column : column < start_column; }) && !failed && wrap)
+            search(start_row, last_row, [&](int column) { return column > start_column; });
+    }
+
+    sqlite3_finalize(stmt);
+    return !failed;
+}
+
+int SqliteTableModel::replaceAll(const std::vector<int>& column_list, const QString& value, const QString& replacement, Qt::MatchFlags flags)
+{
+    // Extract flags
+    const bool whole_cell = !(flags & Qt::MatchContains);
+#if QT_VERSION < QT_VERSION_CHECK(5, 15, 0)
+    auto match_flag = Qt::MatchRegExp;
+#else
+    auto match_flag = Qt::MatchRegularExpression;
+#endif
+    const bool regex = flags & match_flag;
+    const bool case_sensitive = flags & Qt::MatchCaseSensitive;
+
+    // Changing all rows at once only works for tables, not for views which can only be changed through triggers, and only if the
+    // values are shown as they are stored
+    if(!isEditable() || !m_table_of_query || m_table_of_query->isView() || !m_encoding.isEmpty())
+        return -1;
+
+    QRegularExpression reg_exp;
+    if(regex)
+    {
+        reg_exp = findRegularExpression(value, whole_cell, case_sensitive);
+        if(!reg_exp.isValid())
+            return 0;
+    }
+
+    // Rows which were only prefetched in case the user scrolls there are not worth waiting for
+    worker->cancelPrefetch();
+    waitUntilIdle();
+    if(readingData())
+        return -1;
+    if(rowCount() == 0)
+        return 0;
+
+    std::vector<int> columns;
+    for(int column : column_list)
+    {
+        // A rowid which is composed of several columns can't be changed as a whole
+        if(column == 0 && m_query.rowIdColumns().size() != 1)
+            continue;
+        if(!isEditable(index(0, column)))
+            continue;
+        if(hasDisplayFormat(index(0, column)))
+            return -1;
+        columns.push_back(column);
+    }
+    if(columns.empty())
+        return 0;
+
+    m_db.setUndoSavepoint();
+
+    // Replace the values of each column using a single statement. Run all of them in their own savepoint, so a failing statement doesn't
+    // leave the table half updated.
+    const std::string savepoint = m_db.generateSavepointName("replaceall");
+    m_db.setSavepoint(savepoint);
+
+    const std::string match_flags = std::string(whole_cell ? "1" : "0") + "," + (case_sensitive ? "1" : "0") + "," + (regex ? "1" : "0");
+    int num_changes = 0;
+    for(int column : columns)
+    {
+        const std::string& column_name = m_headers.at(static_cast<size_t>(column));
+        const std::string escaped_column = sqlb::escapeIdentifier(column_name);
+
+        // Case sensitive replacements of plain text can be done using the built-in functions. Anything else uses our own functions which
+        // compare text in the same way as nextMatch().
+        std::string condition;
+        std::string new_value;
+        if(case_sensitive && !regex)
+        {
+            condition = whole_cell ? "CAST(" + escaped_column + " AS TEXT) = ?1" : "instr(CAST(" + escaped_column + " AS TEXT), ?1) > 0";
+            new_value = "replace(" + escaped_column + ", ?1, ?2)";
+        } else {
+            condition = "sqlb_find_match(" + escaped_column + ",?1," + match_flags + ")";
+            new_value = "sqlb_find_replace(" + escaped_column + ",?1,?2," + match_flags + ")";
+        }
+
+        if(!m_db.executeSQL(m_query.buildUpdateQuery(column_name, condition, new_value), {value, replacement}))
+        {
+            const QString error = m_db.lastError();
+            m_db.revertToSavepoint(savepoint);
+            QMessageBox::warning(nullptr, qApp->applicationName(), tr("Error changing data:\n%1").arg(error));
+            return 0;
+        }
+        num_changes += m_db.changes();
+    }
+    m_db.releaseSavepoint(savepoint);
+
+    if(num_changes == 0)
+        return 0;
+
+    // The positions of the keys we know are not valid anymore when the key column has changed
+    if(contains(columns, keysetColumn()))
+        worker->resetKeysetAnchors();
+
+    // SQLite might not store the new values exactly as we would compute them, e.g. because of the column affinity or triggers. So load the
+    // changed rows again instead of changing them in the cache. When the rows are filtered or sorted by a changed column, they might have
+    // moved or disappeared, so all rows need to be loaded again in this case. The same goes for the rowid column which determines the order
+    // of unsorted rows.
+    const bool rows_moved = !m_query.globalWhere().empty() || std::any_of(columns.begin(), columns.end(), [this](int column) {
+        const std::string& name = m_headers.at(static_cast<size_t>(column));
+        return column == 0 || m_query.where().count(name) || std::any_of(m_query.orderBy().begin(), m_query.orderBy().end(), [&name](const sqlb::OrderBy& o) {
+            return o.is_expression || o.expr == name;
+        });
+    });
+    if(rows_moved)
+    {
+        updateAndRunQuery();
+        return num_changes;
+    }
+
+    // Remove the rows with a match from the cache
+    const Qt::CaseSensitivity cs = case_sensitive ? Qt::CaseSensitive : Qt::CaseInsensitive;
+    const auto matches = [&](const QString& data) {
+        if(regex)
+            return reg_exp.match(data).hasMatch();
+        else if(whole_cell)
+            return data.compare(value, cs) == 0;
+        else
+            return data.contains(value, cs);
+    };
+    int first_row = -1;
+    int last_row = -1;
+    size_t visible_begin;
+    size_t visible_end;
+    {
+        std::lock_guard<std::mutex> lock(m_mutexDataCache);
+        for(size_t row=0;row<static_cast<size_t>(rowCount());row++)
+        {
+            if(!m_cache.count(row))
+                continue;
+
+            const auto row_data = m_cache.at(row);
+            if(std::none_of(columns.begin(), columns.end(), [&](int column) { return matches(row_data.at(static_cast<size_t>(column))); }))
+                continue;
+
+            m_cache.remove(row);
+            if(first_row < 0)
+                first_row = static_cast<int>(row);
+            last_row = static_cast<int>(row);
+        }
+
+        visible_begin = m_cache.protectedBegin();
+        visible_end = m_cache.protectedEnd();
+    }
+
+    if(first_row >= 0)
+    {
+        // Let the row loader read the rows which are shown right now again. All others are loaded once the user scrolls there.
+        triggerCacheLoad(static_cast<int>(visible_begin), static_cast<int>(visible_end));
+        emit dataChanged(index(first_row, 0), index(last_row, static_cast<int>(m_headers.size()) - 1));
+    }
+
+    return num_changes;
+}
+
 void SqliteTableModel::reloadSettings()
 {
     m_nullText = Settings::getValue("databrowser", "null_text").toString();
@@ -1175,4 +1860,8 @@ void SqliteTableModel::reloadSettings()
     m_rowsLimit = Settings::getValue("databrowser", "rows_limit").toInt();
     m_imagePreviewEnabled = Settings::getValue("databrowser", "image_preview").toBool();
     m_chunkSize = static_cast<std::size_t>(Settings::getValue("db", "prefetchsize").toUInt());
+    m_cacheMemoryLimit = static_cast<std::size_t>(Settings::getValue("db", "cachememorylimit").toUInt()) * 1024 * 1024;
+
+    std::lock_guard<std::mutex> lock(m_mutexDataCache);
+    m_cache.setMemoryLimit(m_cacheMemoryLimit);
 }
@@ -3,6 +3,7 @@
 
 #include <QAbstractTableModel>
 #include <QColor>
+#include <QElapsedTimer>
 #include <QFont>
 
 #include <map>
@@ -10,7 +11,7 @@
 #include <mutex>
 #include <vector>
 
-#include "RowCache.h"
+#include "RowLoader.h"
 #include "sql/Query.h"
 #include "sql/sqlitetypes.h"
 
@@ -44,6 +45,14 @@ public:
     bool setData(const QModelIndex& index, const QVariant& value, int role = Qt::EditRole) override;
     bool setTypedData(const QModelIndex& index, bool isBlob, const QVariant& value, int role = Qt::EditRole);
 
+    /// set a rectangle of cells at once, \param values holding one
+    /// vector of values per row starting at \param topLeft. values
+    /// beyond the last row or column are ignored. all rows are
+    /// updated within a single savepoint and with one UPDATE statement
+    /// each, and a single dataChanged() signal is emitted at the end.
+    /// \returns false if nothing was changed because of an error.
+    bool setTypedDataRange(const QModelIndex& topLeft, bool isBlob, const std::vector<std::vector<QByteArray>>& values);
+
     enum class RowCount
     {
         Unknown,  //< still finding out in background...
@@ -54,6 +63,11 @@ public:
     /// what kind of information is available through rowCount()?
     RowCount rowCountAvailable () const;
 
+    /// approximate total row count which is available quickly while
+    /// the exact row count is still being determined, or -1 if there
+    /// is no estimate
+    int estimatedRowCount () const { return m_estimatedRowCount; }
+
     /// trigger asynchronous loading of (at least) the specified row
     /// into cache.
     void triggerCacheLoad (int single_row) const;
@@ -62,19 +76,46 @@ public:
     /// into cache. \param row_end is exclusive.
     void triggerCacheLoad (int row_begin, int row_end) const;
 
+    /// to be called whenever the visible rows change. \param row_end
+    /// is exclusive. loads the visible rows and, depending on the
+    /// direction and speed of scrolling, speculatively prefetches the
+    /// rows ahead of them.
+    void triggerViewportLoad (int row_begin, int row_end);
+
+    struct PrefetchStatistics
+    {
+        unsigned int hits;          //< viewport changes for which all visible rows were cached already
+        unsigned int misses;        //< viewport changes which had to wait for rows being loaded
+        unsigned int prefetches;    //< speculative chunks requested
+    };
+
+    /// counters for tuning the prefetching, accumulated since construction
+    PrefetchStatistics prefetchStatistics () const { return m_prefetchStatistics; }
+
     /// wait until not reading any data (that does not mean data is
     /// complete, just that the background reader is idle)
     void waitUntilIdle () const;
 
+    /// how was the most recently fetched chunk read: by skipping rows
+    /// from the start or by seeking to a known key value?
+    RowLoader::FetchMode lastFetchMode () const;
+
     /// load all rows into cache, return when done. Returns true if all data was loaded, false if the loading was cancelled.
+    /// The cache is only pinned while loading. Callers which rely on all rows staying available afterwards need to pin the
+    /// cache themselves before calling this and unpin it once they are done with the rows.
     bool completeCache() const;
 
-    /// returns true if all rows are currently available in cache
-    /// [NOTE: potentially unsafe in case we have a limited-size
-    /// cache, where entries can vanish again -- however we can't do
-    /// this for the current implementation of the PlotDock]
+    /// returns true if all rows are currently available in cache.
+    /// the cache has a limited size, so unless it is pinned, rows can
+    /// be evicted again at any time after this returns.
     bool isCacheComplete () const;
 
+    /// disable eviction of cached rows until the matching
+    /// unpinCache() call. calls nest and pins are kept when the cache
+    /// is cleared.
+    void pinCache() const;
+    void unpinCache() const;
+
     bool insertRows(int row, int count, const QModelIndex& parent = QModelIndex()) override;
     bool removeRows(int row, int count, const QModelIndex& parent = QModelIndex()) override;
 
@@ -139,6 +180,11 @@ public:
                           bool reverse = false,
                           bool dont_skip_to_next_field = false) const;
 
+    // Replace all matches of the search expression in the given columns by the replacement text. The flags are the same as for nextMatch().
+    // Only the rows which pass the current filters are changed. Returns the number of changed cells or -1 if the cells can't be changed
+    // all at once, e.g. because a column has a display format. In that case they need to be replaced one by one using setData().
+    int replaceAll(const std::vector<int>& column_list, const QString& value, const QString& replacement, Qt::MatchFlags flags);
+
     DBBrowserDB& db() { return m_db; }
 
     void reloadSettings();
@@ -150,6 +196,7 @@ public slots:
 signals:
     void finishedFetch(int fetched_row_begin, int fetched_row_end);
     void finishedRowCount();
+    void rowCountEstimated();
 
 protected:
     Qt::DropActions supportedDropActions() const override;
@@ -164,19 +211,44 @@ private:
     void clearCache();
 
     void handleFinishedFetch(int life_id, unsigned int fetched_row_begin, unsigned int fetched_row_end);
+    void handleRowCountEstimated(int life_id, int num_rows);
     void handleRowCountComplete(int life_id, int num_rows);
+    void handleFormatsEvaluated(int life_id, size_t row_begin, size_t row_end);
 
     void updateAndRunQuery();
 
+    /// \returns the index of a column that is unique and not null and
+    /// by which the current table query is sorted, so that it can be
+    /// paged through using keyset pagination, or -1 if there is none.
+    int keysetColumn() const;
+
     void getColumnNames(const std::string& sQuery);
 
+    // Let the database search the rows for the next match of nextMatch(). Returns false if this isn't possible, otherwise the match is
+    // set to the cell which was found or to an invalid index if there is none.
+    bool findMatchInDatabase(const QModelIndex& start, std::vector<int> columns, const QString& value, bool whole_cell, bool regex,
+                             bool case_sensitive, bool wrap, bool reverse, bool include_start, QModelIndex& match) const;
+
     QByteArray encode(const QByteArray& str) const;
     QByteArray decode(const QByteArray& str) const;
 
+    // Adjust a value which is about to be written to the specified column and return the SQLite type to store it as.
+    int prepareValueForUpdate(size_t column, bool isBlob, QByteArray& value) const;
+
+    // Store the new value of a cell in the cache after it has been written to the database, updating the rowid too if necessary.
+    // Returns true if the rowid has changed. The data cache must be locked by the caller.
+    bool setCachedCell(size_t row, size_t column, const QByteArray& value);
+
     // Return matching conditional format color/font or invalid value, otherwise.
-    // Only format roles are expected in role (Qt::ItemDataRole)
-    QVariant getMatchingCondFormat(size_t row, size_t column, const QString& value, int role) const;
-    QVariant getMatchingCondFormat(const std::map<size_t, std::vector<CondFormat>>& mCondFormats, size_t column, const QString& value, int role) const;
+    // Only format roles are expected in role (Qt::ItemDataRole). The data cache must be locked by the caller.
+    QVariant getMatchingCondFormat(size_t row, size_t column, int role) const;
+
+    // Pass the conditions of all conditional formats to the row loader and have the formats of the cached rows reevaluated.
+    void updateFormatConditions();
+
+    // Evaluate the conditional formats for a range of cached rows right away, e.g. after they have been edited. The end row is
+    // exclusive. This needs the database, so the data cache must not be locked by the caller.
+    void evaluateFormats(size_t row_begin, size_t row_end);
 
     DBBrowserDB& m_db;
 
@@ -193,6 +265,7 @@ private:
     RowCount m_rowCountAvailable;
     unsigned int m_currentRowCount;
     unsigned int m_realRowCount;
+    int m_estimatedRowCount;
 
     std::vector<std::string> m_headers;
 
@@ -201,7 +274,14 @@ private:
     bool readingData() const;
 
     using Row = std::vector<QByteArray>;
-    mutable RowCache<Row> m_cache;
+    mutable RowLoader::Cache m_cache;
+
+    /// scroll tracking for triggerViewportLoad(). the velocity is in
+    /// rows per millisecond, negative when scrolling upwards.
+    QElapsedTimer m_scrollTimer;
+    int m_lastViewportRow;
+    double m_scrollVelocity;
+    PrefetchStatistics m_prefetchStatistics;
 
     Row makeDefaultCacheEntry () const;
 
@@ -211,6 +291,7 @@ private:
     std::vector<int> m_vDataTypes;
     std::map<size_t, std::vector<CondFormat>> m_mCondFormats;
     std::map<size_t, std::vector<CondFormat>> m_mRowIdFormats;
+    RowLoader::FormatConditions m_formatConditions;
 
     sqlb::Query m_query;
     std::shared_ptr<sqlb::Table> m_table_of_query;  // This holds a pointer to the table object which is queried in the m_query object
@@ -253,6 +334,12 @@ private:
      * to that row count.
      */
     size_t m_chunkSize;
+
+    /**
+     * @brief m_cacheMemoryLimit Maximum number of bytes the row cache may use before rows far away
+     * from the currently viewed ones are evicted again. 0 means no limit.
+     */
+    size_t m_cacheMemoryLimit;
 };
 
 #endif
@@ -0,0 +1,73 @@
+#include "BenchmarkExport.h"
+#include "CsvExportHelpers.h"
+
+#include <QBuffer>
+#include <QElapsedTimer>
+#include <QtTest/QTest>
+
+#include <algorithm>
+#include <string>
+
+QTEST_APPLESS_MAIN(BenchmarkExport)
+
+void BenchmarkExport::csv_data()
+{
+    QTest::addColumn<bool>("writer");
+
+    QTest::newRow("stream") << false;
+    QTest::newRow("writer") << true;
+}
+
+void BenchmarkExport::csv()
+{
+    QFETCH(bool, writer);
+
+    // A wide table with numbers, short texts, texts which need to be quoted and longer texts in turns
+    sqlite3* db;
+    QCOMPARE(sqlite3_open(":memory:", &db), SQLITE_OK);
+    const int numRows = 20000;
+    const int numColumns = 40;
+    std::string create = "CREATE TABLE wide AS WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i+1 FROM n WHERE i<" + std::to_string(numRows) + ") SELECT ";
+    for(int i=0;i<numColumns;i++)
+    {
+        if(i)
+            create += ", ";
+        switch(i % 5)
+        {
+        case 0: create += "i"; break;
+        case 1: create += "i * 0.25"; break;
+        case 2: create += "'text ' || i"; break;
+        case 3: create += "'some text, with a comma and a \"quote\"'"; break;
+        case 4: create += "'a somewhat longer text without any special characters in it'"; break;
+        }
+        create += " AS c" + std::to_string(i);
+    }
+    create += " FROM n;";
+    QCOMPARE(sqlite3_exec(db, create.c_str(), nullptr, nullptr, nullptr), SQLITE_OK);
+
+    QByteArray output;
+    qint64 elapsed = 0;
+    QBENCHMARK {
+        output.clear();
+        QBuffer buffer(&output);
+        QVERIFY(buffer.open(QIODevice::WriteOnly));
+        sqlite3_stmt* stmt;
+        QCOMPARE(sqlite3_prepare_v2(db, "SELECT * FROM wide;", -1, &stmt, nullptr), SQLITE_OK);
+
+        QElapsedTimer timer;
+        timer.start();
+        if(writer)
+            QVERIFY(writeCsv(buffer, stmt, ',', '"', "\r\n"));
+        else
+            writeCsvStream(buffer, stmt, ',', '"', "\r\n");
+        elapsed = timer.nsecsElapsed();
+
+        sqlite3_finalize(stmt);
+    }
+
+    QCOMPARE(static_cast<int>(output.count('\n')), numRows);
+    qInfo("%s: %.0f rows/s, %.1f MiB", QTest::currentDataTag(), numRows * 1e9 / static_cast<double>(std::max(elapsed, qint64(1))),
+          static_cast<double>(output.size()) / (1024.0 * 1024.0));
+
+    sqlite3_close(db);
+}
@@ -0,0 +1,15 @@
+#ifndef BENCHMARKEXPORT_H
+#define BENCHMARKEXPORT_H
+
+#include <QObject>
+
+class BenchmarkExport : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void csv_data();
+    void csv();
+};
+
+#endif
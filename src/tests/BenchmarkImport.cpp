@@ -0,0 +1,62 @@
+// force QtCore-only main application by QTEST_MAIN
+#undef QT_GUI_LIB
+#include <QTemporaryFile>
+#include <QtTest/QTest>
+#include <QCoreApplication>
+#include <QTextStream>
+#include <cstdio>
+
+#include "csvparser.h"
+#include "BenchmarkImport.h"
+
+QTEST_MAIN(BenchmarkImport)
+
+void BenchmarkImport::parse_data()
+{
+    QTest::addColumn<bool>("mapped");
+
+    QTest::newRow("stream") << false;
+    QTest::newRow("mapped") << true;
+}
+
+void BenchmarkImport::parse()
+{
+    QFETCH(bool, mapped);
+
+    // A typical file with a number, a quoted text, a real value and an unquoted text in each record
+    QTemporaryFile file;
+    QVERIFY(file.open());
+    const size_t num_rows = 500000;
+    char row[128];
+    for(size_t i=0;i<num_rows;i++)
+    {
+        const int length = std::snprintf(row, sizeof(row), "%zu,\"some text, quoted\",3.14159,plain text field\n", i);
+        file.write(row, length);
+    }
+    file.flush();
+
+    size_t num_fields = 0;
+    auto rowFunction = [&num_fields](size_t, const CSVRow& data) {
+        num_fields += data.num_fields;
+        return true;
+    };
+
+    QBENCHMARK {
+        num_fields = 0;
+        CSVParser csvparser;
+        if(mapped)
+        {
+            QCOMPARE(csvparser.parse(rowFunction, file), CSVParser::ParserResultSuccess);
+        } else {
+            file.seek(0);
+            QTextStream tstream(&file);
+#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+            tstream.setCodec("UTF-8");
+#endif
+            QCOMPARE(csvparser.parse(rowFunction, tstream), CSVParser::ParserResultSuccess);
+        }
+    }
+
+    QCOMPARE(num_fields, num_rows * 4);
+    qInfo("%s: %.1f MiB file", QTest::currentDataTag(), static_cast<double>(file.size()) / (1024.0 * 1024.0));
+}
@@ -0,0 +1,15 @@
+#ifndef BENCHMARKIMPORT_H
+#define BENCHMARKIMPORT_H
+
+#include <QObject>
+
+class BenchmarkImport : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void parse_data();
+    void parse();
+};
+
+#endif
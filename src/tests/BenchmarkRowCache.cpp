@@ -0,0 +1,98 @@
+#include <QtTest/QTest>
+
+#include "BenchmarkRowCache.h"
+#include "../ColumnarRowCache.h"
+
+#include <QByteArray>
+#include <QElapsedTimer>
+
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+QTEST_APPLESS_MAIN(BenchmarkRowCache)
+
+using CC = ColumnarRowCache;
+using Row = std::vector<QByteArray>;
+
+namespace {
+// Estimate the heap memory held by a row stored as separate byte arrays like the row cache used to do
+struct RowByteSize
+{
+    size_t operator() (const Row & row) const
+    {
+        // Approximate per-allocation overhead of a QByteArray's shared data header
+        constexpr size_t byte_array_overhead = 32;
+
+        size_t bytes = sizeof(row) + row.capacity() * sizeof(QByteArray);
+        for(const auto& v : row)
+        {
+            if(v.capacity() > 0)
+                bytes += static_cast<size_t>(v.capacity()) + byte_array_overhead;
+        }
+        return bytes;
+    }
+};
+}
+
+void BenchmarkRowCache::load_data()
+{
+    QTest::addColumn<bool>("columnar");
+
+    QTest::newRow("separate byte arrays") << false;
+    QTest::newRow("ColumnarRowCache") << true;
+}
+
+void BenchmarkRowCache::load()
+{
+    QFETCH(bool, columnar);
+
+    // A narrow table like the ones for which the per-cell overhead hurts most: an INTEGER primary key, a REAL value, a short
+    // text and a NULL value. This mimics what RowLoader gets from SQLite for each row.
+    const size_t num_rows = 200000;
+    const QByteArray real = "3.14159";
+    const QByteArray text = "name";
+    char integer[32];
+
+    size_t memory = 0;
+    qint64 elapsed = 0;
+    QBENCHMARK {
+        QElapsedTimer timer;
+        timer.start();
+        if(columnar)
+        {
+            CC c;
+            CC::CellRow row(4);
+            for(size_t i = 0; i < num_rows; i++)
+            {
+                row[0] = CC::Cell::fromInteger(static_cast<qint64>(i));
+                row[1] = CC::Cell::fromReal(3.14159);
+                row[2] = CC::Cell::fromBytes(text.constData(), static_cast<size_t>(text.size()));
+                row[3] = CC::Cell::null();
+                c.set(i, row);
+            }
+            elapsed = timer.nsecsElapsed();
+            memory = c.memoryUsage();
+            QCOMPARE(c.numSet(), num_rows);
+        } else {
+            std::vector<Row> c;
+            memory = 0;
+            for(size_t i = 0; i < num_rows; i++)
+            {
+                const int length = std::snprintf(integer, sizeof(integer), "%zu", i);
+                Row row(4);
+                row[0] = QByteArray(integer, length);
+                row[1] = QByteArray(real.constData(), real.size());
+                row[2] = QByteArray(text.constData(), text.size());
+                memory += RowByteSize()(row);
+                c.push_back(std::move(row));
+            }
+            elapsed = timer.nsecsElapsed();
+            QCOMPARE(c.size(), num_rows);
+        }
+    }
+
+    qInfo("%s: %.1f MiB per million rows, %.0f rows/s", QTest::currentDataTag(),
+          static_cast<double>(memory) * (1000000.0 / num_rows) / (1024.0 * 1024.0),
+          num_rows * 1e9 / static_cast<double>(std::max(elapsed, qint64(1))));
+}
@@ -0,0 +1,15 @@
+#ifndef BENCHMARKROWCACHE_H
+#define BENCHMARKROWCACHE_H
+
+#include <QObject>
+
+class BenchmarkRowCache : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void load_data();
+    void load();
+};
+
+#endif
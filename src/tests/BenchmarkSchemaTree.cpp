@@ -0,0 +1,57 @@
+#include <QtTest/QTest>
+#include <QSignalSpy>
+
+#include "BenchmarkSchemaTree.h"
+#include "SchemaTreeHelpers.h"
+
+QTEST_MAIN(BenchmarkSchemaTree)
+
+void BenchmarkSchemaTree::reload_data()
+{
+    QTest::addColumn<bool>("fields");
+
+    // Creating the fields of all tables is what the tree used to do on each reload
+    QTest::newRow("objects") << false;
+    QTest::newRow("objects and fields") << true;
+}
+
+void BenchmarkSchemaTree::reload()
+{
+    QFETCH(bool, fields);
+
+    // 20000 tables with 25 columns each make 500000 fields
+    const schemaMap schemata = generateSchema(20000, 25);
+    SchemaTreeModel model(schemata);
+
+    int nodes = 0;
+    QBENCHMARK {
+        model.reloadData();
+        nodes = model.rowCount(model.index(0, 0)) + fetchGroups(model, fields);
+    }
+
+    qInfo("%s: %d nodes", QTest::currentDataTag(), nodes);
+}
+
+void BenchmarkSchemaTree::update()
+{
+    schemaMap schemata = generateSchema(20000, 25);
+    SchemaTreeModel model(schemata);
+    model.reloadData();
+    fetchGroups(model, false);
+    QSignalSpy resets(&model, &QAbstractItemModel::modelReset);
+
+    // Add and remove a column of a single table over and over again, like ALTER TABLE statements would do
+    const std::string name = tableName(10000);
+    SchemaChanges changes;
+    changes.reset = false;
+    changes.changed.push_back({"table", sqlb::ObjectIdentifier("main", name)});
+
+    size_t columns = 25;
+    QBENCHMARK {
+        columns = columns == 25 ? 26 : 25;
+        schemata["main"].tables[name] = makeTable(name, columns);
+        model.updateData(changes);
+    }
+
+    QCOMPARE(resets.count(), 0);
+}
@@ -0,0 +1,16 @@
+#ifndef BENCHMARKSCHEMATREE_H
+#define BENCHMARKSCHEMATREE_H
+
+#include <QObject>
+
+class BenchmarkSchemaTree : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void reload_data();
+    void reload();
+    void update();
+};
+
+#endif
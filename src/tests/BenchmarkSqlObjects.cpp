@@ -0,0 +1,47 @@
+#include "BenchmarkSqlObjects.h"
+#include "SchemaStatements.h"
+#include "../sql/sqlitetypes.h"
+
+#include <QtTest/QtTest>
+
+#include <algorithm>
+
+QTEST_APPLESS_MAIN(BenchmarkSqlObjects)
+
+using namespace sqlb;
+
+void BenchmarkSqlObjects::parseSchema_data()
+{
+    QTest::addColumn<size_t>("threads");
+
+    QTest::newRow("single thread") << size_t(1);
+    QTest::newRow("all cores") << size_t(0);
+}
+
+void BenchmarkSqlObjects::parseSchema()
+{
+    QFETCH(size_t, threads);
+
+    // This is what opening a database with 20000 tables needs to parse
+    const auto statements = generateSchema(20000);
+
+    size_t parsed = 0;
+    QBENCHMARK {
+        const auto objects = sqlb::parseSchema(statements, threads);
+        parsed = static_cast<size_t>(std::count_if(objects.begin(), objects.end(), [](const ObjectPtr& o) { return o->fullyParsed(); }));
+    }
+
+    qInfo("%s: %zu of %zu statements fully parsed", QTest::currentDataTag(), parsed, statements.size());
+}
+
+void BenchmarkSqlObjects::deserialiseSchema()
+{
+    const std::string data = sqlb::serialiseSchema(sqlb::parseSchema(generateSchema(20000)));
+
+    std::vector<ObjectPtr> objects;
+    QBENCHMARK {
+        QVERIFY(sqlb::deserialiseSchema(data, objects));
+    }
+
+    qInfo("%zu objects restored from %zu bytes", objects.size(), data.size());
+}
@@ -0,0 +1,16 @@
+#ifndef BENCHMARKSQLOBJECTS_H
+#define BENCHMARKSQLOBJECTS_H
+
+#include <QObject>
+
+class BenchmarkSqlObjects : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void parseSchema_data();
+    void parseSchema();
+    void deserialiseSchema();
+};
+
+#endif
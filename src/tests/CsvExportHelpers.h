@@ -0,0 +1,61 @@
+#ifndef CSVEXPORTHELPERS_H
+#define CSVEXPORTHELPERS_H
+
+#include "../CsvWriter.h"
+#include "../Data.h"
+#include "../sqlite.h"
+
+#include <QIODevice>
+#include <QTextStream>
+
+// This is how the CSV export worked before there was the CsvWriter class. It is used as the reference for the output of the writer and
+// for comparing the speed.
+inline void writeCsvStream(QIODevice& device, sqlite3_stmt* stmt, QChar sepChar, QChar quoteChar, const QString& newlineStr)
+{
+    QString quotequoteChar = QString(quoteChar) + quoteChar;
+    std::string special_chars = newlineStr.toStdString() + sepChar.toLatin1() + quoteChar.toLatin1();
+
+    QTextStream stream(&device);
+#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+    stream.setCodec("UTF-8");
+#endif
+    int columns = sqlite3_column_count(stmt);
+    while(sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        for (int i = 0; i < columns; ++i)
+        {
+            QByteArray blob (reinterpret_cast<const char*>(sqlite3_column_blob(stmt, i)),
+                             sqlite3_column_bytes(stmt, i));
+            QString content = QString::fromUtf8(blob);
+
+            if(!isTextOnly(blob))
+                stream << blob.toBase64();
+            else if(quoteChar.isNull() && content.contains(newlineStr))
+                stream << '"' << content.replace('"', "\"\"") << '"';
+            else if(!quoteChar.isNull() && content.toStdString().find_first_of(special_chars) != std::string::npos)
+                stream << quoteChar << content.replace(quoteChar, quotequoteChar) << quoteChar;
+            else
+                stream << content;
+
+            if(i != columns - 1)
+                if(!sepChar.isNull())
+                    stream << sepChar;
+        }
+        stream << newlineStr;
+    }
+    stream.flush();
+}
+
+// Writes the result of a query using the CsvWriter class
+inline bool writeCsv(QIODevice& device, sqlite3_stmt* stmt, QChar sepChar, QChar quoteChar, const QString& newlineStr)
+{
+    CsvWriter writer(device, sepChar, quoteChar, newlineStr);
+    while(sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        if(!writer.writeRow(stmt))
+            return false;
+    }
+    return writer.flush();
+}
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef SCHEMASTATEMENTS_H
+#define SCHEMASTATEMENTS_H
+
+#include <string>
+#include <utility>
+#include <vector>
+
+// The CREATE statements of a schema like the ones of large databases: many similar tables with a few indices and views
+inline std::vector<std::pair<std::string, std::string>> generateSchema(size_t tables)
+{
+    std::vector<std::pair<std::string, std::string>> statements;
+    for(size_t i=0;i<tables;i++)
+    {
+        const std::string name = "table" + std::to_string(i);
+        statements.push_back({"table", "CREATE TABLE \"" + name + "\"(id INTEGER PRIMARY KEY AUTOINCREMENT, name TEXT NOT NULL DEFAULT '', "
+                                       "price REAL CHECK(price >= 0), parent INTEGER REFERENCES \"" + name + "\"(id) ON DELETE CASCADE, "
+                                       "created TEXT DEFAULT CURRENT_TIMESTAMP, UNIQUE(name, parent))"});
+        if(i % 10 == 0)
+            statements.push_back({"index", "CREATE INDEX \"" + name + "_name\" ON \"" + name + "\"(name COLLATE NOCASE, price DESC)"});
+        if(i % 100 == 0)
+            statements.push_back({"view", "CREATE VIEW \"" + name + "_view\" AS SELECT id, name FROM \"" + name + "\""});
+    }
+    return statements;
+}
+
+#endif
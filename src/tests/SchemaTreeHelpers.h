@@ -0,0 +1,83 @@
+#ifndef SCHEMATREEHELPERS_H
+#define SCHEMATREEHELPERS_H
+
+#include "../SchemaTreeModel.h"
+
+#include <cstdio>
+#include <memory>
+#include <string>
+
+inline sqlb::TablePtr makeTable(const std::string& name, size_t columns)
+{
+    auto table = std::make_shared<sqlb::Table>(name);
+    std::string sql = "CREATE TABLE " + sqlb::escapeIdentifier(name) + "(";
+    for(size_t i = 0; i < columns; i++)
+    {
+        table->fields.emplace_back("column" + std::to_string(i), i == 0 ? "INTEGER" : "TEXT");
+        sql += (i == 0 ? "" : ", ") + sqlb::escapeIdentifier(table->fields.back().name()) + " " + table->fields.back().type();
+    }
+    if(columns)
+    {
+        table->addConstraint(sqlb::IndexedColumnVector{sqlb::IndexedColumn("column0", false)}, std::make_shared<sqlb::PrimaryKeyConstraint>());
+        sql += ", PRIMARY KEY(\"column0\")";
+    }
+    table->setOriginalSql(sql + ")");
+    return table;
+}
+
+inline sqlb::IndexPtr makeIndex(const std::string& name, const std::string& table)
+{
+    auto index = std::make_shared<sqlb::Index>(name);
+    index->setTable(table);
+    index->fields.emplace_back("column1", false, "DESC");
+    index->setOriginalSql("CREATE INDEX " + sqlb::escapeIdentifier(name) + " ON " + sqlb::escapeIdentifier(table) + "(\"column1\" DESC)");
+    return index;
+}
+
+inline std::string tableName(size_t i)
+{
+    char name[32];
+    std::snprintf(name, sizeof(name), "table%05zu", i);
+    return name;
+}
+
+// A main schema with the given number of tables and an index for every tenth of them plus an empty temp schema
+inline schemaMap generateSchema(size_t tables, size_t columns)
+{
+    schemaMap schemata;
+    objectMap& objects = schemata["main"];
+    for(size_t i = 0; i < tables; i++)
+    {
+        const std::string name = tableName(i);
+        objects.tables.insert({name, makeTable(name, columns)});
+        if(i % 10 == 0)
+            objects.indices.insert({"index_" + name, makeIndex("index_" + name, name)});
+    }
+    schemata["temp"];
+    return schemata;
+}
+
+// Fetch the objects of all groups below the 'All' node like the tree views do when they expand them
+inline int fetchGroups(SchemaTreeModel& model, bool fields)
+{
+    int nodes = 0;
+    const QModelIndex all = model.index(1, 0);
+    for(int group = 0; group < model.rowCount(all); group++)
+    {
+        const QModelIndex groupIndex = model.index(group, 0, all);
+        if(model.canFetchMore(groupIndex))
+            model.fetchMore(groupIndex);
+        nodes += model.rowCount(groupIndex);
+
+        for(int row = 0; fields && row < model.rowCount(groupIndex); row++)
+        {
+            const QModelIndex objectIndex = model.index(row, 0, groupIndex);
+            if(model.canFetchMore(objectIndex))
+                model.fetchMore(objectIndex);
+            nodes += model.rowCount(objectIndex);
+        }
+    }
+    return nodes;
+}
+
+#endif
@@ -0,0 +1,390 @@
+#include "TestExport.h"
+#include "CsvExportHelpers.h"
+#include "../SqlDumper.h"
+#include "../CompressedFile.h"
+#include "../CsvWriter.h"
+#include "../Data.h"
+#include "../JsonRowWriter.h"
+#include "../sqlite.h"
+
+#include <QBuffer>
+#include <QDir>
+#include <QEventLoop>
+#include <QFileInfo>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QTimer>
+#include <QtTest/QTest>
+
+Q_DECLARE_METATYPE(Compression)
+
+QTEST_MAIN(TestExport)
+
+void TestExport::sqlValues()
+{
+    sqlite3* db;
+    QCOMPARE(sqlite3_open(":memory:", &db), SQLITE_OK);
+
+    const char* query = "SELECT 42, -9223372036854775808, 0.5, 1.0, 0.1, 1e20, 1e999, -1e999, 'it''s', '', x'00ff', x'', NULL, 'a' || char(1), 'Gr' || char(252) || 'n';";
+    sqlite3_stmt* stmt;
+    QCOMPARE(sqlite3_prepare_v2(db, query, -1, &stmt, nullptr), SQLITE_OK);
+    QCOMPARE(sqlite3_step(stmt), SQLITE_ROW);
+
+    QByteArray values;
+    for(int i=0;i<sqlite3_column_count(stmt);i++)
+    {
+        if(i)
+            values.append(',');
+        SqlDumper::appendValue(values, stmt, i);
+    }
+    QCOMPARE(values, QByteArray("42,-9223372036854775808,0.5,1.0,0.1,1e+20,'Inf','-Inf','it''s','',X'00ff',X'',NULL,X'6101','Gr\xC3\xBCn'"));
+
+    sqlite3_finalize(stmt);
+    sqlite3_close(db);
+}
+
+void TestExport::sqlDump_data()
+{
+    QTest::addColumn<size_t>("maxRowsPerInsert");
+    QTest::addColumn<int>("numConnections");
+    QTest::addColumn<QByteArray>("result");
+
+    QTest::newRow("single_rows")
+            << size_t(1) << 1
+            << QByteArray("INSERT INTO \"t1\" VALUES (1,'x');\n"
+                          "INSERT INTO \"t1\" VALUES (2,'y');\n"
+                          "INSERT INTO \"t1\" VALUES (3,'z');\n"
+                          "INSERT INTO \"t3\" VALUES (1.5);\n");
+    QTest::newRow("limited")
+            << size_t(2) << 3
+            << QByteArray("INSERT INTO \"t1\" VALUES (1,'x'),\n"
+                          " (2,'y');\n"
+                          "INSERT INTO \"t1\" VALUES (3,'z');\n"
+                          "INSERT INTO \"t3\" VALUES (1.5);\n");
+    QTest::newRow("unlimited")
+            << size_t(0) << 2
+            << QByteArray("INSERT INTO \"t1\" VALUES (1,'x'),\n"
+                          " (2,'y'),\n"
+                          " (3,'z');\n"
+                          "INSERT INTO \"t3\" VALUES (1.5);\n");
+}
+
+void TestExport::sqlDump()
+{
+    QFETCH(size_t, maxRowsPerInsert);
+    QFETCH(int, numConnections);
+    QFETCH(QByteArray, result);
+
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QByteArray fileName = dir.filePath("test.db").toUtf8();
+
+    std::vector<sqlite3*> connections;
+    for(int i=0;i<numConnections;i++)
+    {
+        sqlite3* db;
+        QCOMPARE(sqlite3_open(fileName.constData(), &db), SQLITE_OK);
+        connections.push_back(db);
+    }
+    QCOMPARE(sqlite3_exec(connections.front(),
+                          "CREATE TABLE t1(a, b); INSERT INTO t1 VALUES(1, 'x'), (2, 'y'), (3, 'z');"
+                          "CREATE TABLE t2(a);"
+                          "CREATE TABLE t3(a); INSERT INTO t3 VALUES(1.5);",
+                          nullptr, nullptr, nullptr), SQLITE_OK);
+
+    // The estimates are wrong on purpose. They must not change the output.
+    std::vector<SqlDumper::Table> tables = {
+        {"SELECT * FROM t1", "INSERT INTO \"t1\" VALUES", 2},
+        {"SELECT * FROM t2", "INSERT INTO \"t2\" VALUES", 5},
+        {"SELECT * FROM t3", "INSERT INTO \"t3\" VALUES", 1},
+    };
+
+    QByteArray output;
+    QBuffer buffer(&output);
+    QVERIFY(buffer.open(QIODevice::WriteOnly));
+
+    SqlDumper dumper(buffer, tables, maxRowsPerInsert);
+    quint64 progress = 0;
+    connect(&dumper, &SqlDumper::progress, this, [&progress](quint64 rows) { progress = rows; }, Qt::QueuedConnection);
+    QEventLoop loop;
+    connect(&dumper, &SqlDumper::finished, &loop, &QEventLoop::quit, Qt::QueuedConnection);
+    QTimer::singleShot(10000, &loop, &QEventLoop::quit);
+    dumper.start(connections);
+    loop.exec();
+    QCoreApplication::processEvents();
+
+    QVERIFY(dumper.success());
+    QCOMPARE(output, result);
+    QCOMPARE(progress, quint64(8));
+
+    for(sqlite3* db : connections)
+        sqlite3_close(db);
+}
+
+void TestExport::compressedFiles_data()
+{
+    QTest::addColumn<Compression>("compression");
+    QTest::addColumn<qint64>("splitSize");
+
+    for(Compression compression : availableCompressions())
+    {
+        const QByteArray name = compressionName(compression).toUtf8();
+        QTest::newRow(name.constData()) << compression << qint64(0);
+        QTest::newRow((name + " split").constData()) << compression << qint64(100 * 1024);
+    }
+}
+
+void TestExport::compressedFiles()
+{
+    QFETCH(Compression, compression);
+    QFETCH(qint64, splitSize);
+
+    // Some text which isn't too easy to compress, written in pieces of different sizes
+    QByteArray data;
+    for(int i=0;i<200000;i++)
+        data += QByteArray::number(i * 7919 % 100003) + (i % 13 ? "," : "\n");
+
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString fileName = dir.filePath("test.csv");
+
+    CompressedFileWriter writer(fileName, compression, splitSize);
+    QVERIFY(writer.open(QIODevice::WriteOnly));
+    for(int pos=0,piece=1;pos<data.size();pos+=piece,piece=piece*3%4099+1)
+        QCOMPARE(writer.write(data.constData() + pos, std::min(piece, data.size() - pos)), static_cast<qint64>(std::min(piece, data.size() - pos)));
+    QVERIFY(writer.commit());
+
+    // Check the names and sizes of the parts
+    const QStringList parts = writer.fileNames();
+    if(splitSize)
+    {
+        QVERIFY(parts.size() > 1);
+        QCOMPARE(parts.front(), fileName + ".001");
+        for(int i=0;i<parts.size()-1;i++)
+        {
+            const qint64 size = QFileInfo(parts.at(i)).size();
+            if(compression == Compression::None)
+                QCOMPARE(size, splitSize);
+            else
+                QVERIFY(size >= splitSize);
+        }
+    } else {
+        QCOMPARE(parts, QStringList(fileName));
+    }
+    QCOMPARE(CompressedFileReader::fileNames(parts.front()), parts);
+    QCOMPARE(QDir(dir.path()).entryList(QStringList("*.part")), QStringList());
+
+    // Read everything back, starting with the first part
+    CompressedFileReader reader(parts.front());
+    QVERIFY(reader.open(QIODevice::ReadOnly));
+    QCOMPARE(reader.compression(), compression);
+    qint64 fileSize = 0;
+    for(const QString& part : parts)
+        fileSize += QFileInfo(part).size();
+    QCOMPARE(reader.fileSize(), fileSize);
+    QCOMPARE(reader.filePosition(), qint64(0));
+    QByteArray result;
+    qint64 filePosition = 0;
+    for(;;)
+    {
+        const QByteArray chunk = reader.read(10000);
+        if(chunk.isEmpty())
+            break;
+        result += chunk;
+
+        // The position in the files on disk only moves forward
+        QVERIFY(reader.filePosition() >= filePosition);
+        QVERIFY(reader.filePosition() <= fileSize);
+        filePosition = reader.filePosition();
+    }
+    QVERIFY(reader.atEnd());
+    QCOMPARE(reader.filePosition(), fileSize);
+    QCOMPARE(result.size(), data.size());
+    QVERIFY(result == data);
+
+    // Only plain files which aren't split are opened without the reader
+    QString error;
+    const std::unique_ptr<QIODevice> device = CompressedFileReader::openFile(parts.front(), error);
+    QVERIFY(device);
+    QCOMPARE(qobject_cast<CompressedFileReader*>(device.get()) == nullptr, compression == Compression::None && !splitSize);
+    QVERIFY(device->readAll() == data);
+    QVERIFY(!CompressedFileReader::openFile(dir.filePath("missing.csv"), error));
+    QVERIFY(!error.isEmpty());
+
+    // Files which aren't committed are removed again
+    {
+        CompressedFileWriter cancelled(dir.filePath("cancelled.csv"), compression, splitSize);
+        QVERIFY(cancelled.open(QIODevice::WriteOnly));
+        cancelled.write(data);
+
+        // Nothing appears under its final name before committing, not even parts which are complete already
+        for(const QString& name : QDir(dir.path()).entryList(QStringList("cancelled.csv*")))
+            QVERIFY(name.endsWith(".part"));
+    }
+    QCOMPARE(QDir(dir.path()).entryList(QStringList("cancelled.csv*")), QStringList());
+}
+
+void TestExport::csvFields_data()
+{
+    QTest::addColumn<QChar>("separator");
+    QTest::addColumn<QChar>("quote");
+    QTest::addColumn<QString>("newline");
+
+    QTest::newRow("comma") << QChar(',') << QChar('"') << QString("\r\n");
+    QTest::newRow("semicolon") << QChar(';') << QChar('\'') << QString("\n");
+    QTest::newRow("tab_no_quote") << QChar('\t') << QChar() << QString("\n");
+    QTest::newRow("no_quote_crlf") << QChar(',') << QChar() << QString("\r\n");
+    QTest::newRow("no_separator") << QChar() << QChar('"') << QString("\n");
+    QTest::newRow("custom_newline") << QChar(',') << QChar('"') << QString("<br>");
+    QTest::newRow("latin1_quote") << QChar('|') << QChar(0xab) << QString("\n");
+}
+
+void TestExport::csvFields()
+{
+    QFETCH(QChar, separator);
+    QFETCH(QChar, quote);
+    QFETCH(QString, newline);
+
+    sqlite3* db;
+    QCOMPARE(sqlite3_open(":memory:", &db), SQLITE_OK);
+
+    // Values with and without special characters, short ones and ones long enough for the SIMD scan, binary data and text
+    // with characters outside of the ASCII range, both valid and invalid.
+    QCOMPARE(sqlite3_exec(db, "CREATE TABLE t(v);"
+                              "INSERT INTO t VALUES"
+                              "(42), (0.5), (NULL), (''), ('plain text'), ('with, comma'), ('with \"quotes\"'), ('apostrophe''s'),"
+                              "('semi;colon'), ('pipe|'), ('line' || char(13, 10) || 'break'), ('only' || char(10) || 'lf'),"
+                              "('tab' || char(9) || 'separated'), ('x<br>y'), ('Gr' || char(252) || 'n'), ('guillemet ' || char(171)),"
+                              "('a longer text with more than sixteen characters, and a comma at the end,'),"
+                              "('a longer text with more than sixteen characters and a quote at the end\"'),"
+                              "('a longer text with more than sixteen characters and a line break at the end' || char(10)),"
+                              "('a longer text with more than sixteen characters and a ' || char(252) || 'mlaut'),"
+                              "('a longer text with more than sixteen characters and a control character' || char(1)),"
+                              "('a' || char(1)), (char(127)), (char(128)), (char(133)), (char(65534)), (char(64976)), (char(128512)),"
+                              "(CAST(X'c3' AS TEXT)), (CAST(X'c0af' AS TEXT)), (CAST(X'eda080' AS TEXT)), (CAST(X'f4908080' AS TEXT)),"
+                              "(X'00ff'), (X'616263'), (X'');",
+                          nullptr, nullptr, nullptr), SQLITE_OK);
+
+    // The writer must produce exactly the same output as the old implementation
+    const char* query = "SELECT v, v FROM t;";
+    QByteArray expected;
+    {
+        sqlite3_stmt* stmt;
+        QCOMPARE(sqlite3_prepare_v2(db, query, -1, &stmt, nullptr), SQLITE_OK);
+        QBuffer buffer(&expected);
+        QVERIFY(buffer.open(QIODevice::WriteOnly));
+        writeCsvStream(buffer, stmt, separator, quote, newline);
+        sqlite3_finalize(stmt);
+    }
+
+    QByteArray output;
+    {
+        sqlite3_stmt* stmt;
+        QCOMPARE(sqlite3_prepare_v2(db, query, -1, &stmt, nullptr), SQLITE_OK);
+        QBuffer buffer(&output);
+        QVERIFY(buffer.open(QIODevice::WriteOnly));
+        QVERIFY(writeCsv(buffer, stmt, separator, quote, newline));
+        sqlite3_finalize(stmt);
+    }
+
+    QCOMPARE(output, expected);
+
+    sqlite3_close(db);
+}
+
+void TestExport::csvHeader()
+{
+    sqlite3* db;
+    QCOMPARE(sqlite3_open(":memory:", &db), SQLITE_OK);
+    sqlite3_stmt* stmt;
+    QCOMPARE(sqlite3_prepare_v2(db, "SELECT 1 AS a, 2 AS \"b,c\", 3 AS \"d\"\"e\", x'01' AS \"f\";", -1, &stmt, nullptr), SQLITE_OK);
+
+    // Column names are never written as binary data
+    QByteArray output;
+    QBuffer buffer(&output);
+    QVERIFY(buffer.open(QIODevice::WriteOnly));
+    CsvWriter writer(buffer, ',', '"', "\n");
+    QVERIFY(writer.writeHeader(stmt));
+    QCOMPARE(sqlite3_step(stmt), SQLITE_ROW);
+    QVERIFY(writer.writeRow(stmt));
+    QVERIFY(writer.flush());
+    QCOMPARE(output, QByteArray("a,\"b,c\",\"d\"\"e\",f\n1,2,3,AQ==\n"));
+
+    sqlite3_finalize(stmt);
+    sqlite3_close(db);
+}
+
+void TestExport::jsonRows_data()
+{
+    QTest::addColumn<int>("style");
+    QTest::addColumn<QByteArray>("expected");
+    QTest::addColumn<QByteArray>("expectedEmpty");
+
+    QTest::newRow("compact") << static_cast<int>(JsonRowWriter::Compact)
+                             << QByteArray("[{\"a\":0.5,\"b\":10,\"c\":null,\"d\":\"quote \\\" backslash \\\\ \\n\\r\\t\\b\\f\\u0001\\u001f\"},"
+                                           "{\"a\":-1.25,\"b\":20,\"c\":\"AP8=\",\"d\":\"Gr\xc3\xbcn\"}]")
+                             << QByteArray("[]");
+    QTest::newRow("pretty") << static_cast<int>(JsonRowWriter::Pretty)
+                            << QByteArray("[\n"
+                                          "    {\n"
+                                          "        \"a\": 0.5,\n"
+                                          "        \"b\": 10,\n"
+                                          "        \"c\": null,\n"
+                                          "        \"d\": \"quote \\\" backslash \\\\ \\n\\r\\t\\b\\f\\u0001\\u001f\"\n"
+                                          "    },\n"
+                                          "    {\n"
+                                          "        \"a\": -1.25,\n"
+                                          "        \"b\": 20,\n"
+                                          "        \"c\": \"AP8=\",\n"
+                                          "        \"d\": \"Gr\xc3\xbcn\"\n"
+                                          "    }\n"
+                                          "]")
+                            << QByteArray("[]");
+    QTest::newRow("lines") << static_cast<int>(JsonRowWriter::Lines)
+                           << QByteArray("{\"a\":0.5,\"b\":10,\"c\":null,\"d\":\"quote \\\" backslash \\\\ \\n\\r\\t\\b\\f\\u0001\\u001f\"}\n"
+                                         "{\"a\":-1.25,\"b\":20,\"c\":\"AP8=\",\"d\":\"Gr\xc3\xbcn\"}\n")
+                           << QByteArray("");
+}
+
+void TestExport::jsonRows()
+{
+    QFETCH(int, style);
+    QFETCH(QByteArray, expected);
+    QFETCH(QByteArray, expectedEmpty);
+
+    sqlite3* db;
+    QCOMPARE(sqlite3_open(":memory:", &db), SQLITE_OK);
+
+    // Numbers, NULL, binary data written as base64, text with characters which need escaping and text outside of the ASCII range.
+    // The keys are sorted and the last of two columns with the same name wins.
+    QCOMPARE(sqlite3_exec(db, "CREATE TABLE t(a, b, c, d);"
+                              "INSERT INTO t VALUES"
+                              "(0.5, 1, NULL, 'quote \" backslash \\ ' || char(10, 13, 9, 8, 12, 1, 31)),"
+                              "(-1.25, 2, X'00ff', 'Gr' || char(252) || 'n');",
+                          nullptr, nullptr, nullptr), SQLITE_OK);
+
+    const auto write = [db](const char* query, JsonRowWriter::Style style, QByteArray& output) {
+        sqlite3_stmt* stmt;
+        if(sqlite3_prepare_v2(db, query, -1, &stmt, nullptr) != SQLITE_OK)
+            return false;
+        QBuffer buffer(&output);
+        buffer.open(QIODevice::WriteOnly);
+        JsonRowWriter writer(buffer, style);
+        writer.setColumns(stmt);
+        bool ok = true;
+        while(ok && sqlite3_step(stmt) == SQLITE_ROW)
+            ok = writer.writeRow(stmt);
+        sqlite3_finalize(stmt);
+        return ok && writer.finish();
+    };
+
+    QByteArray output;
+    QVERIFY(write("SELECT d, b, c, a, b * 10 AS b FROM t ORDER BY rowid;", static_cast<JsonRowWriter::Style>(style), output));
+    QCOMPARE(output, expected);
+
+    QByteArray empty;
+    QVERIFY(write("SELECT * FROM t WHERE 0;", static_cast<JsonRowWriter::Style>(style), empty));
+    QCOMPARE(empty, expectedEmpty);
+
+    sqlite3_close(db);
+}
@@ -0,0 +1,23 @@
+#ifndef TESTEXPORT_H
+#define TESTEXPORT_H
+
+#include <QObject>
+
+class TestExport : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void sqlValues();
+    void sqlDump();
+    void sqlDump_data();
+    void compressedFiles();
+    void compressedFiles_data();
+    void csvFields();
+    void csvFields_data();
+    void csvHeader();
+    void jsonRows();
+    void jsonRows_data();
+};
+
+#endif
@@ -2,15 +2,134 @@
 #undef QT_GUI_LIB
 #include <QTemporaryFile>
 #include <QtTest/QTest>
+#include <QBuffer>
 #include <QCoreApplication>
 #include <QTextStream>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <thread>
 #include <vector>
 
+#include "BoundedQueue.h"
 #include "csvparser.h"
+#include "CsvImportPipeline.h"
+#include "sqlite.h"
+#include "SqlStatementReader.h"
 #include "TestImport.h"
 
 QTEST_MAIN(TestImport)
 
+namespace {
+using Rows = std::vector<std::vector<QByteArray>>;
+
+// Returns a row function for the CSV parser which collects all rows
+CSVParser::csvRowFunction collectRows(Rows& rows)
+{
+    return [&rows](size_t rowNum, const CSVRow& data) -> bool {
+        if(rowNum != rows.size())
+            return false;
+
+        std::vector<QByteArray> row;
+        for(size_t i=0;i<data.num_fields;i++)
+            row.push_back(QByteArray(data.fields[i].data, static_cast<int>(data.fields[i].data_length)));
+        rows.push_back(row);
+        return true;
+    };
+}
+
+// Returns a parse function for the import pipeline which hands the rows made by the row function to it without parsing anything.
+// Without a number of rows, it goes on until the pipeline stops it. The number of rows handed over so far is counted.
+CsvImportPipeline::ParseFunction generateRows(size_t numRows, std::function<std::vector<QByteArray>(size_t)> row,
+                                              std::atomic<size_t>& generated)
+{
+    return [numRows, row, &generated](CSVParser::csvRowFunction rowFunction, CSVProgress* progress) {
+        const std::unique_ptr<CSVProgress> p(progress);
+        p->start();
+        for(size_t rowNum=0;numRows == 0 || rowNum<numRows;rowNum++)
+        {
+            std::vector<QByteArray> values = row(rowNum);
+            std::vector<CSVField> fields(values.size());
+            for(size_t i=0;i<values.size();i++)
+            {
+                fields[i].data = values[i].data();
+                fields[i].data_length = static_cast<uint64_t>(values[i].size());
+            }
+            if(!rowFunction(rowNum, CSVRow{fields.data(), fields.size(), fields.size()}) || !p->update(static_cast<int64_t>(rowNum)))
+                return CSVParser::ParserResultCancelled;
+            generated++;
+        }
+        p->end();
+        return CSVParser::ParserResultSuccess;
+    };
+}
+
+// An in-memory database with a table to import into and the statement for inserting into it
+struct ImportDatabase
+{
+    sqlite3* db;
+    sqlite3_stmt* stmt;
+
+    explicit ImportDatabase(const char* schema)
+    {
+        sqlite3_open(":memory:", &db);
+        sqlite3_exec(db, schema, nullptr, nullptr, nullptr);
+        sqlite3_prepare_v2(db, "INSERT INTO t VALUES(?1, ?2);", -1, &stmt, nullptr);
+    }
+
+    ~ImportDatabase()
+    {
+        sqlite3_finalize(stmt);
+        sqlite3_close(db);
+    }
+
+    // All rows of the table in the order they were inserted
+    Rows rows() const
+    {
+        Rows result;
+        sqlite3_stmt* select;
+        sqlite3_prepare_v2(db, "SELECT a, b FROM t ORDER BY rowid;", -1, &select, nullptr);
+        while(sqlite3_step(select) == SQLITE_ROW)
+        {
+            std::vector<QByteArray> row;
+            for(int i=0;i<2;i++)
+            {
+                if(sqlite3_column_type(select, i) == SQLITE_NULL)
+                    row.emplace_back();
+                else
+                    row.emplace_back(reinterpret_cast<const char*>(sqlite3_column_text(select, i)), sqlite3_column_bytes(select, i));
+            }
+            result.push_back(row);
+        }
+        sqlite3_finalize(select);
+        return result;
+    }
+};
+
+// Joins a thread when leaving the scope, also when a check has failed, after making sure it doesn't wait for anything anymore
+struct ThreadGuard
+{
+    std::thread& thread;
+    std::function<void()> stop;
+
+    ~ThreadGuard()
+    {
+        stop();
+        if(thread.joinable())
+            thread.join();
+    }
+};
+
+CsvImportPipeline::Options pipelineOptions()
+{
+    CsvImportPipeline::Options options;
+    options.skipFirstRow = false;
+    options.localConventions = false;
+    options.importToExistingTable = false;
+    return options;
+}
+}
+
 TestImport::TestImport()
 {
 }
@@ -182,3 +301,377 @@ void TestImport::csvImport_data()
                                << 3
                                << result;
 }
+
+void TestImport::csvImportMapped()
+{
+    QFETCH(QString, csv);
+    QFETCH(char, separator);
+    QFETCH(char, quote);
+    QFETCH(QString, encoding);
+    QFETCH(std::vector<std::vector<QByteArray>>, result);
+
+    if(encoding != "UTF-8")
+        QSKIP("only UTF-8 encoded files are mapped");
+
+    QTemporaryFile file;
+    QVERIFY(file.open());
+    file.write(csv.toUtf8());
+    file.flush();
+
+    // Parse the file sequentially as well as split up into chunks of different sizes
+    for(int64_t chunkSize : {1, 3, 1024 * 1024})
+    {
+        CSVParser csvparser(true, separator, quote);
+        csvparser.setChunkSize(chunkSize);
+
+        Rows parsedCsv;
+        QCOMPARE(csvparser.parse(collectRows(parsedCsv), file), CSVParser::ParserResultSuccess);
+        QCOMPARE(parsedCsv, result);
+    }
+}
+
+void TestImport::csvImportMapped_data()
+{
+    csvImport_data();
+}
+
+void TestImport::csvImportChunked()
+{
+    // Build a file which contains all kinds of records which must not be split up: quoted fields with separators, line breaks and
+    // escaped quotes in them, different line break styles, empty lines, and a last record without a line break.
+    QByteArray csv = "\xEF\xBB\xBF";
+    for(int i=0;i<500;i++)
+    {
+        csv += QByteArray::number(i) + ",\"quoted, with separator\",plain";
+        switch(i % 5)
+        {
+        case 0: csv += ",\"multi\nline\r\nfield\"\n"; break;
+        case 1: csv += ",\"escaped \"\"quotes\"\"\"\r\n"; break;
+        case 2: csv += ",\"\"\r"; break;
+        case 3: csv += ",  padded  \n\n"; break;
+        case 4: csv += ",\"a\"b\"c\"\n"; break;
+        }
+    }
+    csv += "last,\"record\"";
+
+    QTemporaryFile file;
+    QVERIFY(file.open());
+    file.write(csv);
+    file.flush();
+
+    // The stream parser is the reference
+    Rows expected;
+    {
+        CSVParser csvparser;
+        file.seek(0);
+        QTextStream tstream(&file);
+#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+        tstream.setCodec("UTF-8");
+#endif
+        QCOMPARE(csvparser.parse(collectRows(expected), tstream), CSVParser::ParserResultSuccess);
+    }
+    QCOMPARE(expected.size(), static_cast<size_t>(601));
+    QCOMPARE(expected.front().front(), QByteArray("0"));
+    QCOMPARE(expected.back(), (std::vector<QByteArray>{"last", "record"}));
+
+    for(int64_t chunkSize : {1, 7, 64, 4096, 1024 * 1024})
+    {
+        CSVParser csvparser;
+        csvparser.setChunkSize(chunkSize);
+
+        Rows parsedCsv;
+        QCOMPARE(csvparser.parse(collectRows(parsedCsv), file), CSVParser::ParserResultSuccess);
+        QCOMPARE(parsedCsv, expected);
+    }
+
+    // Limiting the number of records and stopping from the row function
+    {
+        CSVParser csvparser;
+        Rows parsedCsv;
+        QCOMPARE(csvparser.parse(collectRows(parsedCsv), file, 10), CSVParser::ParserResultSuccess);
+        QCOMPARE(parsedCsv, Rows(expected.begin(), expected.begin() + 10));
+    }
+    {
+        CSVParser csvparser;
+        csvparser.setChunkSize(64);
+        size_t numRows = 0;
+        QCOMPARE(csvparser.parse([&numRows](size_t, const CSVRow&) { return ++numRows < 100; }, file), CSVParser::ParserResultError);
+        QCOMPARE(numRows, static_cast<size_t>(100));
+    }
+
+    // A quoted field which is never closed
+    {
+        QTemporaryFile unterminated;
+        QVERIFY(unterminated.open());
+        unterminated.write(csv + "\n\"open field" + QByteArray("\nwith, more text").repeated(100));
+        unterminated.flush();
+
+        CSVParser csvparser;
+        csvparser.setChunkSize(64);
+        Rows parsedCsv;
+        QCOMPARE(csvparser.parse(collectRows(parsedCsv), unterminated), CSVParser::ParserResultUnexpectedEOF);
+        QCOMPARE(parsedCsv.size(), expected.size() + 1);
+    }
+}
+
+void TestImport::csvSample()
+{
+    QByteArray csv;
+    for(int i=0;i<10000;i++)
+        csv += QByteArray::number(i) + ",\"text " + QByteArray::number(i) + "\"\n";
+
+    QTemporaryFile file;
+    QVERIFY(file.open());
+    file.write(csv);
+    file.flush();
+
+    // All rows of the head and some rows of each block, each of them complete and in order
+    {
+        CSVParser csvparser;
+        Rows parsedCsv;
+        QCOMPARE(csvparser.sample(collectRows(parsedCsv), file, 10, 8, 100), CSVParser::ParserResultSuccess);
+        QVERIFY(parsedCsv.size() > 10 + 8);
+        QVERIFY(parsedCsv.size() < 10 + 8 * 20);
+        for(size_t i=0;i<10;i++)
+            QCOMPARE(parsedCsv.at(i).front(), QByteArray::number(static_cast<int>(i)));
+
+        int last = -1;
+        for(const auto& row : parsedCsv)
+        {
+            QCOMPARE(row.size(), static_cast<size_t>(2));
+            const int number = row.front().toInt();
+            QVERIFY(number > last);
+            QCOMPARE(row.back(), "text " + row.front());
+            last = number;
+        }
+        QVERIFY(last > 8500);
+    }
+
+    // A file which is shorter than the head is read completely
+    {
+        CSVParser csvparser;
+        Rows expected;
+        QCOMPARE(csvparser.parse(collectRows(expected), file), CSVParser::ParserResultSuccess);
+
+        Rows parsedCsv;
+        QCOMPARE(csvparser.sample(collectRows(parsedCsv), file, 20000, 8, 100), CSVParser::ParserResultSuccess);
+        QCOMPARE(parsedCsv, expected);
+    }
+}
+
+void TestImport::boundedQueue()
+{
+    // The producer can't get further ahead of the consumer than the capacity of the queue
+    BoundedQueue<int> queue(3);
+    std::atomic<int> pushed(0);
+    std::thread producer([&queue, &pushed]() {
+        for(int i=0;i<10;i++)
+        {
+            if(!queue.push(i))
+                return;
+            pushed++;
+        }
+        queue.close();
+    });
+    const ThreadGuard producerGuard{producer, [&queue]() { queue.abort(); }};
+    QTRY_COMPARE(pushed.load(), 3);
+    QTest::qWait(50);
+    QCOMPARE(pushed.load(), 3);
+
+    // The items come out in order and the remaining ones are still delivered after the queue has been closed
+    int item;
+    for(int i=0;i<10;i++)
+    {
+        QVERIFY(queue.pop(item));
+        QCOMPARE(item, i);
+    }
+    QVERIFY(!queue.pop(item));
+    QCOMPARE(pushed.load(), 10);
+
+    // Aborting wakes up a waiting producer and makes all further calls fail
+    BoundedQueue<int> full(1);
+    QVERIFY(full.push(1));
+    std::atomic<bool> pushFailed(false);
+    std::thread blockedProducer([&full, &pushFailed]() { pushFailed = !full.push(2); });
+    const ThreadGuard blockedProducerGuard{blockedProducer, [&full]() { full.abort(); }};
+    QTest::qWait(50);
+    QVERIFY(!pushFailed);
+    full.abort();
+    blockedProducer.join();
+    QVERIFY(pushFailed);
+    QVERIFY(!full.pop(item));
+    QVERIFY(!full.push(3));
+
+    // The same goes for a waiting consumer
+    BoundedQueue<int> empty(1);
+    std::atomic<bool> popFailed(false);
+    std::thread blockedConsumer([&empty, &popFailed]() { int i; popFailed = !empty.pop(i); });
+    const ThreadGuard blockedConsumerGuard{blockedConsumer, [&empty]() { empty.abort(); }};
+    QTest::qWait(50);
+    QVERIFY(!popFailed);
+    empty.abort();
+    blockedConsumer.join();
+    QVERIFY(popFailed);
+}
+
+void TestImport::csvImportPipeline()
+{
+    // Many more rows than fit into a single batch, with some empty values which become NULL in a new table
+    const size_t numRows = 5000;
+    const auto row = [](size_t rowNum) -> std::vector<QByteArray> {
+        if(rowNum == 0)
+            return {"a", "b"};
+        return {QByteArray::number(static_cast<qulonglong>(rowNum)), rowNum % 1000 ? "row " + QByteArray::number(static_cast<qulonglong>(rowNum)) : QByteArray("")};
+    };
+
+    ImportDatabase database("CREATE TABLE t(a, b);");
+    CsvImportPipeline::Options options = pipelineOptions();
+    options.skipFirstRow = true;
+    CsvImportPipeline pipeline(database.stmt, options);
+    std::atomic<bool> finished(false);
+    connect(&pipeline, &CsvImportPipeline::finished, [&finished]() { finished = true; });
+
+    std::atomic<size_t> generated(0);
+    pipeline.start(generateRows(numRows, row, generated));
+    QTRY_VERIFY(finished);
+    QCOMPARE(pipeline.result(), CSVParser::ParserResultSuccess);
+    QCOMPARE(pipeline.lastRowNum(), numRows - 1);
+
+    // All rows are inserted in the order of the file, except for the header
+    const Rows rows = database.rows();
+    QCOMPARE(rows.size(), numRows - 1);
+    for(size_t i=0;i<rows.size();i++)
+    {
+        const std::vector<QByteArray> expected = row(i + 1);
+        QCOMPARE(rows[i].at(0), expected.at(0));
+        if(expected.at(1).isEmpty())
+            QVERIFY(rows[i].at(1).isNull());
+        else
+            QCOMPARE(rows[i].at(1), expected.at(1));
+    }
+}
+
+void TestImport::csvImportPipelineCancel()
+{
+    ImportDatabase database("CREATE TABLE t(a, b);");
+    CsvImportPipeline pipeline(database.stmt, pipelineOptions());
+    std::atomic<bool> finished(false);
+    connect(&pipeline, &CsvImportPipeline::finished, [&finished]() { finished = true; });
+
+    // Cancel while rows are still coming in. The parser is told to stop and nothing else is inserted afterwards.
+    std::atomic<size_t> generated(0);
+    pipeline.start(generateRows(0, [](size_t rowNum) -> std::vector<QByteArray> {
+        return {QByteArray::number(static_cast<qulonglong>(rowNum)), "x"};
+    }, generated));
+    QTRY_VERIFY(generated > 3000);
+    pipeline.cancel();
+    QTRY_VERIFY(finished);
+    QCOMPARE(pipeline.result(), CSVParser::ParserResultCancelled);
+    QVERIFY(pipeline.errorMessage().isEmpty());
+
+    const Rows rows = database.rows();
+    QVERIFY(rows.size() <= generated);
+    for(size_t i=0;i<rows.size();i++)
+        QCOMPARE(rows[i].at(0), QByteArray::number(static_cast<qulonglong>(i)));
+}
+
+void TestImport::csvImportPipelineErrors()
+{
+    const auto row = [](size_t rowNum) -> std::vector<QByteArray> {
+        return {QByteArray::number(static_cast<qulonglong>(rowNum)), rowNum == 2500 ? QByteArray("") : "row " + QByteArray::number(static_cast<qulonglong>(rowNum % 3000))};
+    };
+
+    // A conversion error, here a missing value in a column which must not be empty, stops the import in the row where it happened
+    {
+        ImportDatabase database("CREATE TABLE t(a, b);");
+        CsvImportPipeline::Options options = pipelineOptions();
+        options.importToExistingTable = true;
+        options.nullValues = {QByteArray(), QByteArray()};
+        options.failOnMissing = {false, true};
+        CsvImportPipeline pipeline(database.stmt, options);
+        std::atomic<bool> finished(false);
+        connect(&pipeline, &CsvImportPipeline::finished, [&finished]() { finished = true; });
+
+        std::atomic<size_t> generated(0);
+        pipeline.start(generateRows(5000, row, generated));
+        QTRY_VERIFY(finished);
+        QCOMPARE(pipeline.result(), CSVParser::ParserResultError);
+        QCOMPARE(pipeline.lastRowNum(), size_t(2500));
+        QCOMPARE(pipeline.errorMessage(), QString("Missing value in column 2"));
+        QVERIFY(database.rows().size() <= 2500);
+    }
+
+    // So does an error when inserting, here a duplicate value in a unique column
+    {
+        ImportDatabase database("CREATE TABLE t(a, b UNIQUE);");
+        CsvImportPipeline pipeline(database.stmt, pipelineOptions());
+        std::atomic<bool> finished(false);
+        connect(&pipeline, &CsvImportPipeline::finished, [&finished]() { finished = true; });
+
+        std::atomic<size_t> generated(0);
+        pipeline.start(generateRows(5000, row, generated));
+        QTRY_VERIFY(finished);
+        QCOMPARE(pipeline.result(), CSVParser::ParserResultError);
+        QCOMPARE(pipeline.lastRowNum(), size_t(3000));
+        QVERIFY(pipeline.errorMessage().contains("UNIQUE"));
+        QCOMPARE(database.rows().size(), size_t(3000));
+    }
+}
+
+void TestImport::sqlStatements()
+{
+    const std::vector<QByteArray> expected = {
+        "CREATE TABLE t(a);",
+        "\nINSERT INTO t VALUES('x;y');",
+        "\n-- comment; with semicolon\nINSERT INTO t VALUES(1);",
+        "CREATE TRIGGER tr AFTER INSERT ON t BEGIN SELECT 1; SELECT 2; END;",
+        "\n/* block; comment */ SELECT [a;b], `c;d`, \"e;f\" FROM t;",
+        "\nCreate Temp Trigger tr2 After Delete On t Begin Delete From t Where a = 'end;'; End;",
+        "\nEXPLAIN CREATE TRIGGER tr3 AFTER UPDATE ON t BEGIN SELECT 4; END;",
+        "\nSELECT 3\n  \n"
+    };
+    QByteArray sql = "\xEF\xBB\xBF";
+    for(const auto& statement : expected)
+        sql += statement;
+
+    for(int chunkSize : {1, 5, 1024 * 1024})
+    {
+        QBuffer buffer(&sql);
+        QVERIFY(buffer.open(QIODevice::ReadOnly));
+
+        SqlStatementReader reader(buffer, chunkSize);
+        std::vector<QByteArray> statements;
+        QByteArray statement;
+        while(reader.next(statement))
+            statements.push_back(statement);
+
+        QCOMPARE(statements, expected);
+        QCOMPARE(reader.position(), static_cast<qint64>(sql.size()));
+        QVERIFY(!reader.hasError());
+    }
+
+    // A long statement spanning many chunks with semicolons in it
+    {
+        QByteArray value;
+        for(int i=0;i<100000;i++)
+            value += "x;";
+        QByteArray longStatement = "INSERT INTO t VALUES('" + value + "');";
+        QBuffer buffer(&longStatement);
+        QVERIFY(buffer.open(QIODevice::ReadOnly));
+        SqlStatementReader reader(buffer, 7);
+        QByteArray statement;
+        QVERIFY(reader.next(statement));
+        QCOMPARE(statement, longStatement);
+        QVERIFY(!reader.next(statement));
+    }
+
+    // Whitespace at the end is not a statement
+    QByteArray whitespace = "SELECT 1;\n\n";
+    QBuffer buffer(&whitespace);
+    QVERIFY(buffer.open(QIODevice::ReadOnly));
+    SqlStatementReader reader(buffer);
+    QByteArray statement;
+    QVERIFY(reader.next(statement));
+    QCOMPARE(statement, QByteArray("SELECT 1;"));
+    QVERIFY(!reader.next(statement));
+}
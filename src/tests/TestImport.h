@@ -14,6 +14,15 @@ public:
 private slots:
     void csvImport();
     void csvImport_data();
+    void csvImportMapped();
+    void csvImportMapped_data();
+    void csvImportChunked();
+    void csvSample();
+    void boundedQueue();
+    void csvImportPipeline();
+    void csvImportPipelineCancel();
+    void csvImportPipelineErrors();
+    void sqlStatements();
 };
 
 #endif
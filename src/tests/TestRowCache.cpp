@@ -1,7 +1,11 @@
 #include <QtTest/QTest>
 
 #include "TestRowCache.h"
-#include "../RowCache.h"
+#include "../ColumnarRowCache.h"
+
+#include <QByteArray>
+
+#include <vector>
 
 QTEST_APPLESS_MAIN(TestRowCache)
 
@@ -13,7 +17,21 @@ TestRowCache::~TestRowCache()
 {
 }
 
-using C = RowCache<int>;
+using C = ColumnarRowCache;
+using Row = std::vector<QByteArray>;
+
+namespace {
+// Single column rows holding an integer are enough for testing the bookkeeping of rows and chunks
+Row r(int value)
+{
+    return Row{ QByteArray::number(value) };
+}
+
+int value(const C & c, size_t pos)
+{
+    return c.at(pos).at(0).toInt();
+}
+}
 
 void TestRowCache::construction()
 {
@@ -32,11 +50,11 @@ void TestRowCache::setGet()
 {
     C c;
 
-    c.set(1, 10);
-    c.set(5, 50);
-    c.set(0, 0);
-    c.set(6, 60);
-    c.set(100, 1000);
+    c.set(1, r(10));
+    c.set(5, r(50));
+    c.set(0, r(0));
+    c.set(6, r(60));
+    c.set(100, r(1000));
 
     QCOMPARE(c.numSet(), static_cast<size_t>(5));
     QCOMPARE(c.numSegments(), static_cast<size_t>(4)); // the '0' set after the '1' position does not merge currently
@@ -45,8 +63,8 @@ void TestRowCache::setGet()
     const C & cc = c;
     for(size_t i = 0; i < 200; i++) {
         if(c.count(i)) {
-            QCOMPARE(c.at(i), static_cast<int>(10*i));
-            QCOMPARE(cc.at(i), static_cast<int>(10*i));
+            QCOMPARE(value(c, i), static_cast<int>(10*i));
+            QCOMPARE(value(cc, i), static_cast<int>(10*i));
             cnt++;
         } else {
             QVERIFY_EXCEPTION_THROWN(c.at(i), std::out_of_range);
@@ -60,84 +78,84 @@ void TestRowCache::insert()
 {
     C c;
 
-    c.insert(3, 30);
+    c.insert(3, r(30));
     QCOMPARE(c.numSet(), static_cast<size_t>(1));
     QCOMPARE(c.numSegments(), static_cast<size_t>(1));
-    QCOMPARE(c.at(3), 30);
+    QCOMPARE(value(c, 3), 30);
 
-    c.insert(3, 31);
+    c.insert(3, r(31));
     QCOMPARE(c.numSet(), static_cast<size_t>(2));
     QCOMPARE(c.numSegments(), static_cast<size_t>(1));
-    QCOMPARE(c.at(3), 31);
-    QCOMPARE(c.at(4), 30);
+    QCOMPARE(value(c, 3), 31);
+    QCOMPARE(value(c, 4), 30);
 
-    c.insert(0, 0);
+    c.insert(0, r(0));
     QCOMPARE(c.numSet(), static_cast<size_t>(3));
     QCOMPARE(c.numSegments(), static_cast<size_t>(2));
-    QCOMPARE(c.at(0), 0);
+    QCOMPARE(value(c, 0), 0);
     QVERIFY_EXCEPTION_THROWN(c.at(3), std::out_of_range);
-    QCOMPARE(c.at(4), 31);
-    QCOMPARE(c.at(5), 30);
+    QCOMPARE(value(c, 4), 31);
+    QCOMPARE(value(c, 5), 30);
     QVERIFY_EXCEPTION_THROWN(c.at(6), std::out_of_range);
 
-    c.insert(1, 100);
+    c.insert(1, r(100));
     QCOMPARE(c.numSet(), static_cast<size_t>(4));
     QCOMPARE(c.numSegments(), static_cast<size_t>(2));
-    QCOMPARE(c.at(0), 0);
-    QCOMPARE(c.at(1), 100);
-    QCOMPARE(c.at(5), 31);
-    QCOMPARE(c.at(6), 30);
+    QCOMPARE(value(c, 0), 0);
+    QCOMPARE(value(c, 1), 100);
+    QCOMPARE(value(c, 5), 31);
+    QCOMPARE(value(c, 6), 30);
 
-    c.insert(8, 1);
+    c.insert(8, r(1));
     QCOMPARE(c.numSet(), static_cast<size_t>(5));
     QCOMPARE(c.numSegments(), static_cast<size_t>(3));
-    QCOMPARE(c.at(0), 0);
-    QCOMPARE(c.at(1), 100);
-    QCOMPARE(c.at(5), 31);
-    QCOMPARE(c.at(6), 30);
-    QCOMPARE(c.at(8), 1);
+    QCOMPARE(value(c, 0), 0);
+    QCOMPARE(value(c, 1), 100);
+    QCOMPARE(value(c, 5), 31);
+    QCOMPARE(value(c, 6), 30);
+    QCOMPARE(value(c, 8), 1);
 }
 
 void TestRowCache::erase()
 {
     C c;
-    c.insert(3, 30);
-    c.insert(3, 31);
-    c.insert(0, 0);
-    c.insert(8, 1);
+    c.insert(3, r(30));
+    c.insert(3, r(31));
+    c.insert(0, r(0));
+    c.insert(8, r(1));
     QCOMPARE(c.numSet(), static_cast<size_t>(4));
     QCOMPARE(c.numSegments(), static_cast<size_t>(3));
-    QCOMPARE(c.at(0), 0);
-    QCOMPARE(c.at(4), 31);
-    QCOMPARE(c.at(5), 30);
-    QCOMPARE(c.at(8), 1);
+    QCOMPARE(value(c, 0), 0);
+    QCOMPARE(value(c, 4), 31);
+    QCOMPARE(value(c, 5), 30);
+    QCOMPARE(value(c, 8), 1);
 
     // erase entire segment
     c.erase(0);
     QCOMPARE(c.numSet(), static_cast<size_t>(3));
     QCOMPARE(c.numSegments(), static_cast<size_t>(2));
-    QCOMPARE(c.at(3), 31);
-    QCOMPARE(c.at(4), 30);
-    QCOMPARE(c.at(7), 1);
+    QCOMPARE(value(c, 3), 31);
+    QCOMPARE(value(c, 4), 30);
+    QCOMPARE(value(c, 7), 1);
 
     // erase inside segment
     c.erase(4);
     QCOMPARE(c.numSet(), static_cast<size_t>(2));
     QCOMPARE(c.numSegments(), static_cast<size_t>(2));
-    QCOMPARE(c.at(3), 31);
-    QCOMPARE(c.at(6), 1);
+    QCOMPARE(value(c, 3), 31);
+    QCOMPARE(value(c, 6), 1);
 
     // erase non-filled row
     c.erase(5);
     QCOMPARE(c.numSet(), static_cast<size_t>(2));
     QCOMPARE(c.numSegments(), static_cast<size_t>(2));
-    QCOMPARE(c.at(3), 31);
-    QCOMPARE(c.at(5), 1);
+    QCOMPARE(value(c, 3), 31);
+    QCOMPARE(value(c, 5), 1);
 
     c.erase(5);
     QCOMPARE(c.numSet(), static_cast<size_t>(1));
     QCOMPARE(c.numSegments(), static_cast<size_t>(1));
-    QCOMPARE(c.at(3), 31);
+    QCOMPARE(value(c, 3), 31);
 
     c.erase(3);
     QCOMPARE(c.numSet(), static_cast<size_t>(0));
@@ -147,10 +165,10 @@ void TestRowCache::erase()
 void TestRowCache::smallestNonAvailableRange()
 {
     C c;
-    c.insert(3, 0);
-    c.insert(3, 0);
-    c.insert(0, 0);
-    c.insert(8, 0);
+    c.insert(3, r(0));
+    c.insert(3, r(0));
+    c.insert(0, r(0));
+    c.insert(8, r(0));
     QCOMPARE(c.numSet(), static_cast<size_t>(4));
     QVERIFY(c.count(0));
     QVERIFY(c.count(4));
@@ -187,3 +205,333 @@ void TestRowCache::smallestNonAvailableRange()
     QCOMPARE(test( 9,10), P( 9,10));
     QCOMPARE(test(10,10), P(10,10));
 }
+
+void TestRowCache::maxSegmentSize()
+{
+    C c(4);
+    for(size_t i = 0; i < 10; i++)
+        c.set(i, r(static_cast<int>(i)));
+
+    QCOMPARE(c.numSet(), static_cast<size_t>(10));
+    QCOMPARE(c.numSegments(), static_cast<size_t>(3));
+    for(size_t i = 0; i < 10; i++)
+        QCOMPARE(value(c, i), static_cast<int>(i));
+
+    QVERIFY_EXCEPTION_THROWN(C(0), std::invalid_argument);
+}
+
+void TestRowCache::pinning()
+{
+    C c(1);
+    c.set(0, r(1));
+    c.setMemoryLimit(c.memoryUsage() * 2);
+
+    c.pin();
+    QVERIFY(c.isPinned());
+    for(size_t i = 1; i < 5; i++)
+        c.set(i, r(1));
+    QCOMPARE(c.numSet(), static_cast<size_t>(5));
+    QCOMPARE(c.numEvicted(), static_cast<size_t>(0));
+
+    // nested pins
+    c.pin();
+    c.unpin();
+    QCOMPARE(c.numSet(), static_cast<size_t>(5));
+
+    // unpinning evicts down to the limit
+    c.unpin();
+    QVERIFY(!c.isPinned());
+    QVERIFY(c.numSet() < 5);
+    QVERIFY(c.memoryUsage() <= c.memoryLimit());
+    QVERIFY_EXCEPTION_THROWN(c.unpin(), std::logic_error);
+
+    // clearing keeps the pins, so they can be released afterwards
+    c.pin();
+    c.clear();
+    QVERIFY(c.isPinned());
+    c.unpin();
+    QVERIFY(!c.isPinned());
+}
+
+using CC = ColumnarRowCache;
+
+void TestRowCache::columnarSetGet()
+{
+    CC c(3);
+
+    c.set(0, CC::CellRow{ CC::Cell::fromInteger(-42), CC::Cell::fromBytes("abc", 3), CC::Cell::null(), CC::Cell::fromBytes(nullptr, 0) });
+    c.set(1, Row{ "1", "2.5", QByteArray(), "" });
+    c.set(2, Row{ "3" });
+    c.set(10, Row{ "x", "y" });
+
+    QCOMPARE(c.numSet(), static_cast<size_t>(4));
+    QCOMPARE(c.numSegments(), static_cast<size_t>(2));
+    QVERIFY(c.count(0));
+    QVERIFY(c.count(2));
+    QVERIFY(!c.count(3));
+    QVERIFY(c.count(10));
+    QVERIFY_EXCEPTION_THROWN(c.at(3), std::out_of_range);
+
+    QCOMPARE(c.at(0).size(), static_cast<size_t>(4));
+    QCOMPARE(c.at(0).at(0), QByteArray("-42"));
+    QCOMPARE(c.at(0).at(1), QByteArray("abc"));
+    QVERIFY(c.at(0).at(2).isNull());
+    QVERIFY(c.at(0).isNull(2));
+    QVERIFY(!c.at(0).at(3).isNull());
+    QVERIFY(c.at(0).at(3).isEmpty());
+    QVERIFY_EXCEPTION_THROWN(c.at(0).at(4), std::out_of_range);
+
+    // cells are not copied
+    QCOMPARE(c.at(0).cell(0).kind, CC::Cell::Integer);
+    QCOMPARE(c.at(0).cell(0).integer, static_cast<qint64>(-42));
+    QCOMPARE(c.at(0).cell(1).kind, CC::Cell::Bytes);
+    QCOMPARE(QByteArray::fromRawData(c.at(0).cell(1).data, 3), QByteArray("abc"));
+    QVERIFY(c.at(0).cell(1).data == c.at(0).cell(1).data);
+    QCOMPARE(c.at(0).cell(2).kind, CC::Cell::Null);
+    QCOMPARE(c.at(0).cell(3).size, static_cast<size_t>(0));
+    QVERIFY_EXCEPTION_THROWN(c.at(0).cell(4), std::out_of_range);
+
+    QCOMPARE(c.at(1).at(1), QByteArray("2.5"));
+    QVERIFY(c.at(1).at(2).isNull());
+    QVERIFY(!c.at(1).at(3).isNull());
+
+    // shorter rows are padded with NULL values up to the number of columns in their chunk
+    QCOMPARE(c.at(2).size(), static_cast<size_t>(4));
+    QCOMPARE(c.at(2).at(0), QByteArray("3"));
+    QVERIFY(c.at(2).at(1).isNull());
+
+    // replace
+    c.set(1, Row{ "a", "b" });
+    QCOMPARE(c.numSet(), static_cast<size_t>(4));
+    QCOMPARE(c.at(1).at(0), QByteArray("a"));
+    QVERIFY(c.at(1).at(2).isNull());
+
+    using P = std::pair<size_t,size_t>;
+    P p{ 0, 11 };
+    c.smallestNonAvailableRange(p.first, p.second);
+    QCOMPARE(p, P(3, 10));
+    p = P{ 0, 12 };
+    c.smallestNonAvailableRange(p.first, p.second);
+    QCOMPARE(p, P(3, 12));
+
+    c.clear();
+    QCOMPARE(c.numSet(), static_cast<size_t>(0));
+    QCOMPARE(c.memoryUsage(), static_cast<size_t>(0));
+}
+
+void TestRowCache::columnarInsertErase()
+{
+    CC c;
+    c.insert(3, Row{ "30" });
+    c.insert(3, Row{ "31" });
+    c.insert(0, Row{ "0" });
+    c.insert(8, Row{ "1" });
+    QCOMPARE(c.numSet(), static_cast<size_t>(4));
+    QCOMPARE(c.numSegments(), static_cast<size_t>(3));
+    QCOMPARE(c.at(0).at(0), QByteArray("0"));
+    QCOMPARE(c.at(4).at(0), QByteArray("31"));
+    QCOMPARE(c.at(5).at(0), QByteArray("30"));
+    QCOMPARE(c.at(8).at(0), QByteArray("1"));
+
+    // erase entire chunk
+    c.erase(0);
+    QCOMPARE(c.numSet(), static_cast<size_t>(3));
+    QCOMPARE(c.numSegments(), static_cast<size_t>(2));
+    QCOMPARE(c.at(3).at(0), QByteArray("31"));
+    QCOMPARE(c.at(7).at(0), QByteArray("1"));
+
+    // erase inside chunk
+    c.erase(4);
+    QCOMPARE(c.numSet(), static_cast<size_t>(2));
+    QCOMPARE(c.at(3).at(0), QByteArray("31"));
+    QCOMPARE(c.at(6).at(0), QByteArray("1"));
+
+    // erase non-filled row
+    c.erase(5);
+    QCOMPARE(c.at(5).at(0), QByteArray("1"));
+}
+
+void TestRowCache::columnarRemove()
+{
+    CC c;
+    for(size_t i = 0; i < 6; i++)
+        c.set(i, Row{ QByteArray::number(static_cast<int>(i)), "text " + QByteArray::number(static_cast<int>(i)) });
+    c.setFormats(4, { -1, 2 });
+
+    // removing a row in the middle splits its chunk, the following rows stay where they are
+    c.remove(2);
+    QCOMPARE(c.numSet(), static_cast<size_t>(5));
+    QCOMPARE(c.numSegments(), static_cast<size_t>(2));
+    QVERIFY(!c.count(2));
+    QCOMPARE(c.at(1).at(1), QByteArray("text 1"));
+    QCOMPARE(c.at(3).at(0), QByteArray("3"));
+    QCOMPARE(c.at(5).at(1), QByteArray("text 5"));
+    QCOMPARE(c.at(4).format(1), 2);
+    QCOMPARE(c.at(3).format(1), -1);
+
+    size_t row_begin = 0;
+    size_t row_end = 6;
+    c.smallestNonAvailableRange(row_begin, row_end);
+    QCOMPARE(row_begin, static_cast<size_t>(2));
+    QCOMPARE(row_end, static_cast<size_t>(3));
+
+    // the row can be loaded again
+    c.set(2, Row{ "2", "new" });
+    QCOMPARE(c.at(2).at(1), QByteArray("new"));
+    QCOMPARE(c.at(3).at(1), QByteArray("text 3"));
+
+    // removing rows at the ends of chunks and rows which are not there
+    c.remove(0);
+    c.remove(5);
+    c.remove(7);
+    QCOMPARE(c.numSet(), static_cast<size_t>(4));
+    QVERIFY(!c.count(0));
+    QVERIFY(!c.count(5));
+    QCOMPARE(c.at(4).at(0), QByteArray("4"));
+
+    for(size_t i = 1; i < 5; i++)
+        c.remove(i);
+    QCOMPARE(c.numSet(), static_cast<size_t>(0));
+    QCOMPARE(c.numSegments(), static_cast<size_t>(0));
+    QCOMPARE(c.memoryUsage(), static_cast<size_t>(0));
+}
+
+void TestRowCache::columnarReals()
+{
+    QCOMPARE(CC::Cell::formatReal(2.5), QByteArray("2.5"));
+    QCOMPARE(CC::Cell::formatReal(0.1), QByteArray("0.1"));
+    QCOMPARE(CC::Cell::formatReal(-3.0), QByteArray("-3.0"));
+    QCOMPARE(CC::Cell::formatReal(1.0/3.0), QByteArray("0.333333333333333"));
+    QCOMPARE(CC::Cell::formatReal(1e20), QByteArray("1e+20"));
+
+    CC c(4);
+    c.set(0, CC::CellRow{ CC::Cell::fromReal(2.5), CC::Cell::fromBytes("abc", 3), CC::Cell::fromReal(-3.0) });
+    c.set(1, CC::CellRow{ CC::Cell::fromReal(1.0/3.0), CC::Cell::null(), CC::Cell::fromInteger(7) });
+
+    // the value is kept as it is, not as text
+    QCOMPARE(c.at(0).cell(0).kind, CC::Cell::Real);
+    QCOMPARE(c.at(0).cell(0).real, 2.5);
+    QCOMPARE(c.at(1).cell(0).real, 1.0/3.0);
+    QCOMPARE(c.at(0).at(0), QByteArray("2.5"));
+    QCOMPARE(c.at(0).at(1), QByteArray("abc"));
+    QCOMPARE(c.at(0).at(2), QByteArray("-3.0"));
+    QVERIFY(!c.at(0).isNull(0));
+
+    // replacing values of other types by reals and the other way round
+    c.setCell(0, 1, "xyz");
+    c.set(0, CC::CellRow{ CC::Cell::fromBytes("2.5", 3), CC::Cell::fromReal(0.1), CC::Cell::null() });
+    QCOMPARE(c.at(0).cell(0).kind, CC::Cell::Bytes);
+    QCOMPARE(c.at(0).at(0), QByteArray("2.5"));
+    QCOMPARE(c.at(0).cell(1).kind, CC::Cell::Real);
+    QCOMPARE(c.at(0).at(1), QByteArray("0.1"));
+    QVERIFY(c.at(0).at(2).isNull());
+
+    // inserting, erasing and removing rows keeps the reals
+    c.insert(0, Row{ "first" });
+    QCOMPARE(c.at(1).cell(1).real, 0.1);
+    QCOMPARE(c.at(2).cell(0).real, 1.0/3.0);
+    c.erase(0);
+    c.remove(0);
+    QVERIFY(!c.count(0));
+    QCOMPARE(c.at(1).cell(0).kind, CC::Cell::Real);
+    QCOMPARE(c.at(1).cell(0).real, 1.0/3.0);
+    QCOMPARE(c.at(1).at(2), QByteArray("7"));
+
+    // reals do not need any space in the arena
+    CC reals;
+    CC texts;
+    for(size_t i = 0; i < 1000; i++)
+    {
+        const double value = static_cast<double>(i) + 0.25;
+        const QByteArray text = CC::Cell::formatReal(value);
+        reals.set(i, CC::CellRow{ CC::Cell::fromReal(value) });
+        texts.set(i, CC::CellRow{ CC::Cell::fromBytes(text.constData(), static_cast<size_t>(text.size())) });
+        QCOMPARE(reals.at(i).at(0), texts.at(i).at(0));
+    }
+    QVERIFY(reals.memoryUsage() < texts.memoryUsage());
+}
+
+void TestRowCache::columnarSetCell()
+{
+    CC c;
+    c.set(0, Row{ "1", "text" });
+    const size_t before = c.memoryUsage();
+
+    c.setCell(0, 1, QByteArray(10000, 'x'));
+    QCOMPARE(c.at(0).at(1), QByteArray(10000, 'x'));
+    QVERIFY(c.memoryUsage() > before);
+
+    c.setCell(0, 1, QByteArray());
+    QVERIFY(c.at(0).at(1).isNull());
+    QCOMPARE(c.at(0).at(0), QByteArray("1"));
+
+    // overwritten values are eventually dropped from the arena
+    for(int i = 0; i < 10; i++)
+        c.setCell(0, 1, QByteArray(10000, static_cast<char>('a' + i)));
+    QCOMPARE(c.at(0).at(1), QByteArray(10000, 'j'));
+    QVERIFY(c.memoryUsage() < before + 4 * 10000);
+
+    // new columns
+    c.setCell(0, 3, "new");
+    QCOMPARE(c.at(0).size(), static_cast<size_t>(4));
+    QVERIFY(c.at(0).at(2).isNull());
+    QCOMPARE(c.at(0).at(3), QByteArray("new"));
+
+    QVERIFY_EXCEPTION_THROWN(c.setCell(1, 0, "x"), std::out_of_range);
+}
+
+void TestRowCache::columnarFormats()
+{
+    CC c;
+    c.set(0, Row{ "1", "a", "b" });
+    c.set(1, Row{ "2", "c", "d" });
+    QCOMPARE(c.at(0).format(1), -1);
+
+    c.setFormats(1, std::vector<int>{ -1, 2, -1 });
+    QCOMPARE(c.at(0).format(1), -1);
+    QCOMPARE(c.at(1).format(1), 2);
+    QCOMPARE(c.at(1).format(2), -1);
+
+    // formats move along with their rows
+    c.insert(0, Row{ "0", "x", "y" });
+    QCOMPARE(c.at(0).format(1), -1);
+    QCOMPARE(c.at(2).format(1), 2);
+    c.erase(1);
+    QCOMPARE(c.at(1).format(1), 2);
+
+    // unavailable rows are ignored
+    c.setFormats(10, std::vector<int>{ 0, 0, 0 });
+    QCOMPARE(c.count(10), static_cast<size_t>(0));
+}
+
+void TestRowCache::columnarEviction()
+{
+    CC c(10);
+    for(size_t i = 0; i < 30; i++)
+        c.set(i, Row{ QByteArray::number(static_cast<qlonglong>(i)), "some text" });
+    QCOMPARE(c.numSegments(), static_cast<size_t>(3));
+    QCOMPARE(c.numEvicted(), static_cast<size_t>(0));
+
+    // keep the first chunk protected and limit memory to a bit more than two chunks
+    c.setProtectedRange(0, 10);
+    c.setMemoryLimit(c.memoryUsage() * 3 / 4);
+    QCOMPARE(c.numEvicted(), static_cast<size_t>(1));
+    QVERIFY(c.count(0));
+    QVERIFY(!c.count(10));
+    QVERIFY(c.count(20));
+
+    c.pin();
+    c.set(100, Row{ "x" });
+    c.set(200, Row{ "y" });
+    QCOMPARE(c.numEvicted(), static_cast<size_t>(1));
+    c.unpin();
+    QVERIFY(c.memoryUsage() <= c.memoryLimit());
+    QVERIFY(c.count(0));
+
+    // clearing keeps the pins
+    c.pin();
+    c.clear();
+    QVERIFY(c.isPinned());
+    c.unpin();
+    QVERIFY(!c.isPinned());
+}
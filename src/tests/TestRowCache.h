@@ -17,6 +17,15 @@ private slots:
     void insert();
     void erase();
     void smallestNonAvailableRange();
+    void maxSegmentSize();
+    void pinning();
+    void columnarSetGet();
+    void columnarInsertErase();
+    void columnarRemove();
+    void columnarReals();
+    void columnarSetCell();
+    void columnarFormats();
+    void columnarEviction();
 };
 
 #endif
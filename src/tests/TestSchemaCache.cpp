@@ -0,0 +1,104 @@
+#include <QtTest/QTest>
+#include <QDir>
+#include <QFile>
+#include <QTemporaryDir>
+
+#include "TestSchemaCache.h"
+#include "../SchemaCache.h"
+
+QTEST_APPLESS_MAIN(TestSchemaCache)
+
+namespace {
+std::vector<sqlb::ObjectPtr> makeSchema()
+{
+    auto objects = sqlb::parseSchema({
+        {"table", "CREATE TABLE t(id INTEGER PRIMARY KEY, name TEXT NOT NULL UNIQUE, parent INTEGER REFERENCES t(id))"},
+        {"index", "CREATE INDEX t_name ON t(name DESC)"},
+        {"view", "CREATE VIEW v AS SELECT id FROM t"},
+        {"trigger", "CREATE TRIGGER tr AFTER INSERT ON t BEGIN SELECT 1; END"},
+    }, 1);
+    std::static_pointer_cast<sqlb::Table>(objects[2])->fields.emplace_back("id", "INTEGER");
+    std::static_pointer_cast<sqlb::Trigger>(objects[3])->setTable("t");
+    return objects;
+}
+
+// The cache only needs the database file to exist
+QString createFile(const QTemporaryDir& dir, const QString& name)
+{
+    QFile file(dir.filePath(name));
+    file.open(QIODevice::WriteOnly);
+    return file.fileName();
+}
+}
+
+void TestSchemaCache::storeLoad()
+{
+    QTemporaryDir dir;
+    SchemaCache cache(dir.filePath("cache"));
+    const QString database = createFile(dir, "test.db");
+    const auto objects = makeSchema();
+
+    std::vector<sqlb::ObjectPtr> loaded;
+    QVERIFY(!cache.load(database, 1, "digest", loaded));
+    QVERIFY(cache.store(database, 1, "digest", objects));
+
+    // The file can be found by any path pointing to it
+    QVERIFY(cache.load(dir.path() + "/cache/../test.db", 1, "digest", loaded));
+    QCOMPARE(loaded.size(), objects.size());
+    for(size_t i=0;i<objects.size();i++)
+    {
+        QCOMPARE(loaded[i]->name(), objects[i]->name());
+        QCOMPARE(loaded[i]->sql(), objects[i]->sql());
+    }
+    QCOMPARE(std::static_pointer_cast<sqlb::Table>(loaded[2])->fieldNames(), std::static_pointer_cast<sqlb::Table>(objects[2])->fieldNames());
+    QCOMPARE(std::static_pointer_cast<sqlb::Trigger>(loaded[3])->table(), std::string("t"));
+
+    // Storing again replaces the old objects
+    QVERIFY(cache.store(database, 2, "digest", {objects[0]}));
+    QVERIFY(cache.load(database, 2, "digest", loaded));
+    QCOMPARE(loaded.size(), size_t(1));
+}
+
+void TestSchemaCache::mismatch()
+{
+    QTemporaryDir dir;
+    SchemaCache cache(dir.filePath("cache"));
+    const QString database = createFile(dir, "test.db");
+    const QString other_database = createFile(dir, "other.db");
+    QVERIFY(cache.store(database, 1, "digest", makeSchema()));
+
+    std::vector<sqlb::ObjectPtr> loaded;
+    QVERIFY(!cache.load(database, 2, "digest", loaded));
+    QVERIFY(!cache.load(database, 1, "other digest", loaded));
+    QVERIFY(!cache.load(other_database, 1, "digest", loaded));
+    QVERIFY(!cache.load(dir.filePath("missing.db"), 1, "digest", loaded));
+
+    // Files which don't exist can't be cached
+    QVERIFY(!cache.store(dir.filePath("missing.db"), 1, "digest", makeSchema()));
+}
+
+void TestSchemaCache::damagedFile()
+{
+    QTemporaryDir dir;
+    SchemaCache cache(dir.filePath("cache"));
+    const QString database = createFile(dir, "test.db");
+    QVERIFY(cache.store(database, 1, "digest", makeSchema()));
+
+    const QStringList files = QDir(dir.filePath("cache")).entryList(QDir::Files);
+    QCOMPARE(files.size(), 1);
+    QFile file(dir.filePath("cache/" + files.first()));
+    QVERIFY(file.resize(file.size() - 10));
+
+    std::vector<sqlb::ObjectPtr> loaded;
+    QVERIFY(!cache.load(database, 1, "digest", loaded));
+}
+
+void TestSchemaCache::removeOldFiles()
+{
+    QTemporaryDir dir;
+    SchemaCache cache(dir.filePath("cache"));
+    for(int i=0;i<30;i++)
+        QVERIFY(cache.store(createFile(dir, QString("test%1.db").arg(i)), 1, "digest", makeSchema()));
+
+    QCOMPARE(QDir(dir.filePath("cache")).entryList(QDir::Files).size(), 20);
+}
@@ -0,0 +1,17 @@
+#ifndef TESTSCHEMACACHE_H
+#define TESTSCHEMACACHE_H
+
+#include <QObject>
+
+class TestSchemaCache : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void storeLoad();
+    void mismatch();
+    void damagedFile();
+    void removeOldFiles();
+};
+
+#endif
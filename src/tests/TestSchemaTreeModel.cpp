@@ -0,0 +1,201 @@
+#include <QtTest/QTest>
+#include <QSignalSpy>
+#if QT_VERSION >= QT_VERSION_CHECK(5, 11, 0)
+#include <QAbstractItemModelTester>
+#endif
+
+#include "TestSchemaTreeModel.h"
+#include "../SchemaTreeModel.h"
+#include "SchemaTreeHelpers.h"
+
+QTEST_MAIN(TestSchemaTreeModel)
+
+namespace {
+sqlb::TablePtr makeView(const std::string& name, const std::string& table)
+{
+    auto view = std::make_shared<sqlb::View>(name);
+    view->fields.emplace_back("column0", "");
+    view->setOriginalSql("CREATE VIEW " + sqlb::escapeIdentifier(name) + " AS SELECT column0 FROM " + sqlb::escapeIdentifier(table));
+    return view;
+}
+
+sqlb::TriggerPtr makeTrigger(const std::string& name, const std::string& table)
+{
+    auto trigger = std::make_shared<sqlb::Trigger>(name);
+    trigger->setTable(table);
+    trigger->setOriginalSql("CREATE TRIGGER " + sqlb::escapeIdentifier(name) + " AFTER INSERT ON " + sqlb::escapeIdentifier(table) + " BEGIN SELECT 1; END");
+    return trigger;
+}
+
+// Print the texts of all nodes, fetching the lazily populated ones first
+void dump(QAbstractItemModel& model, const QModelIndex& parent, int depth, QStringList& out)
+{
+    if(model.canFetchMore(parent))
+        model.fetchMore(parent);
+
+    for(int row = 0; row < model.rowCount(parent); row++)
+    {
+        QStringList texts;
+        for(int column = 0; column < model.columnCount(parent); column++)
+            texts << model.data(model.index(row, column, parent), Qt::DisplayRole).toString();
+        out << QString(depth, ' ') + texts.join('|');
+
+        dump(model, model.index(row, 0, parent), depth + 1, out);
+    }
+}
+
+QStringList dump(QAbstractItemModel& model)
+{
+    QStringList out;
+    dump(model, QModelIndex(), 0, out);
+    return out;
+}
+
+}
+
+void TestSchemaTreeModel::lazyPopulation()
+{
+    schemaMap schemata;
+    objectMap& objects = schemata["main"];
+    objects.tables.insert({"b", makeTable("b", 3)});
+    objects.tables.insert({"a", makeTable("a", 2)});
+    objects.tables.insert({"v", makeView("v", "a")});
+    objects.indices.insert({"i", makeIndex("i", "a")});
+    objects.triggers.insert({"t", makeTrigger("t", "a")});
+    schemata["temp"];
+    schemata["aux"].tables.insert({"c", makeTable("c", 1)});
+
+    SchemaTreeModel model(schemata);
+    model.reloadData();
+    QCOMPARE(model.rowCount(), 2);
+
+    // The browsable section lists all tables and views, those of the main schema first
+    const QModelIndex browsables = model.index(0, 0);
+    QCOMPARE(model.rowCount(browsables), 4);
+    QCOMPARE(model.data(model.index(0, SchemaTreeModel::ColumnName, browsables), Qt::DisplayRole).toString(), QString("a"));
+    QCOMPARE(model.data(model.index(2, SchemaTreeModel::ColumnName, browsables), Qt::DisplayRole).toString(), QString("v"));
+    QCOMPARE(model.data(model.index(2, SchemaTreeModel::ColumnObjectType, browsables), Qt::DisplayRole).toString(), QString("view"));
+    QCOMPARE(model.data(model.index(3, SchemaTreeModel::ColumnName, browsables), Qt::DisplayRole).toString(), QString("aux.c"));
+    QCOMPARE(model.data(model.index(3, SchemaTreeModel::ColumnName, browsables), Qt::EditRole).toString(), QString("c"));
+    QVERIFY(!model.hasChildren(model.index(0, 0, browsables)));
+
+    // The 'All' node contains the groups and a node for the attached schema but none for the empty temp schema
+    const QModelIndex all = model.index(1, 0);
+    QCOMPARE(model.rowCount(all), 5);
+    QCOMPARE(model.data(model.index(4, SchemaTreeModel::ColumnName, all), Qt::DisplayRole).toString(), QString("aux"));
+    QCOMPARE(model.data(model.index(4, SchemaTreeModel::ColumnObjectType, all), Qt::DisplayRole).toString(), QString("database"));
+
+    // The objects of a group are only created when they are fetched
+    const QModelIndex tables = model.index(0, 0, all);
+    QCOMPARE(model.data(tables, Qt::DisplayRole).toString(), QString("Tables (2)"));
+    QCOMPARE(model.rowCount(tables), 0);
+    QVERIFY(model.hasChildren(tables));
+    QVERIFY(model.canFetchMore(tables));
+    model.fetchMore(tables);
+    QVERIFY(!model.canFetchMore(tables));
+    QCOMPARE(model.rowCount(tables), 2);
+
+    // The same goes for the fields of the objects
+    const QModelIndex table = model.index(1, 0, tables);
+    QCOMPARE(model.data(table, Qt::DisplayRole).toString(), QString("b"));
+    QCOMPARE(model.rowCount(table), 0);
+    QVERIFY(model.hasChildren(table));
+    model.fetchMore(table);
+    QCOMPARE(model.rowCount(table), 3);
+    QCOMPARE(model.data(model.index(0, SchemaTreeModel::ColumnName, table), Qt::DisplayRole).toString(), QString("column0"));
+    QCOMPARE(model.data(model.index(0, SchemaTreeModel::ColumnObjectType, table), Qt::DisplayRole).toString(), QString("field"));
+    QCOMPARE(model.data(model.index(0, SchemaTreeModel::ColumnDataType, table), Qt::DisplayRole).toString(), QString("INTEGER"));
+    QCOMPARE(model.parent(model.index(2, 0, table)), table);
+
+    // Fields of indices show their sort order
+    const QModelIndex indices = model.index(1, 0, all);
+    model.fetchMore(indices);
+    const QModelIndex index = model.index(0, 0, indices);
+    model.fetchMore(index);
+    QCOMPARE(model.rowCount(index), 1);
+    QCOMPARE(model.data(model.index(0, SchemaTreeModel::ColumnDataType, index), Qt::DisplayRole).toString(), QString("DESC"));
+
+    // Triggers don't have any children
+    const QModelIndex triggers = model.index(3, 0, all);
+    model.fetchMore(triggers);
+    QCOMPARE(model.rowCount(triggers), 1);
+    QVERIFY(!model.hasChildren(model.index(0, 0, triggers)));
+    QVERIFY(!model.canFetchMore(model.index(0, 0, triggers)));
+}
+
+void TestSchemaTreeModel::incrementalUpdate()
+{
+    schemaMap schemata = generateSchema(10, 3);
+    schemata["main"].tables.insert({"view", makeView("view", tableName(0))});
+    schemata["main"].triggers.insert({"trigger", makeTrigger("trigger", tableName(0))});
+    schemata["aux"].tables.insert({"x", makeTable("x", 2)});
+
+    SchemaTreeModel model(schemata);
+#if QT_VERSION >= QT_VERSION_CHECK(5, 11, 0)
+    QAbstractItemModelTester tester(&model, QAbstractItemModelTester::FailureReportingMode::QtTest);
+#endif
+    model.reloadData();
+
+    // Fetch the objects and fields first, so the changes need to be applied to existing nodes
+    fetchGroups(model, true);
+    QSignalSpy resets(&model, &QAbstractItemModel::modelReset);
+
+    SchemaChanges changes;
+    changes.reset = false;
+
+    // Drop a table
+    schemata["main"].tables.erase(tableName(3));
+    changes.removed.push_back({"table", sqlb::ObjectIdentifier("main", tableName(3))});
+
+    // Add columns to a table
+    schemata["main"].tables[tableName(5)] = makeTable(tableName(5), 5);
+    changes.changed.push_back({"table", sqlb::ObjectIdentifier("main", tableName(5))});
+
+    // Replace a table by a view of the same name
+    schemata["main"].tables[tableName(7)] = makeView(tableName(7), tableName(0));
+    changes.changed.push_back({"view", sqlb::ObjectIdentifier("main", tableName(7))});
+
+    // Add a table which is sorted in between the existing ones, an index, and a table to the attached schema
+    schemata["main"].tables.insert({"table00004a", makeTable("table00004a", 1)});
+    changes.added.push_back({"table", sqlb::ObjectIdentifier("main", "table00004a")});
+    schemata["main"].indices.insert({"index", makeIndex("index", tableName(1))});
+    changes.added.push_back({"index", sqlb::ObjectIdentifier("main", "index")});
+    schemata["aux"].tables.insert({"w", makeTable("w", 1)});
+    changes.added.push_back({"table", sqlb::ObjectIdentifier("aux", "w")});
+
+    model.updateData(changes);
+    QCOMPARE(resets.count(), 0);
+
+    // The result needs to be the same as when building the tree from scratch
+    SchemaTreeModel reference(schemata);
+    reference.reloadData();
+    QCOMPARE(dump(model), dump(reference));
+}
+
+void TestSchemaTreeModel::resetForNewSchema()
+{
+    schemaMap schemata = generateSchema(10, 3);
+
+    SchemaTreeModel model(schemata);
+    model.reloadData();
+    fetchGroups(model, false);
+    QSignalSpy resets(&model, &QAbstractItemModel::modelReset);
+
+    // The first object in the temp schema needs a new schema node which is only added when reloading
+    schemata["temp"].tables.insert({"t", makeTable("t", 1)});
+    SchemaChanges changes;
+    changes.reset = false;
+    changes.added.push_back({"table", sqlb::ObjectIdentifier("temp", "t")});
+    model.updateData(changes);
+    QCOMPARE(resets.count(), 1);
+
+    SchemaTreeModel reference(schemata);
+    reference.reloadData();
+    QCOMPARE(dump(model), dump(reference));
+
+    // No changes at all don't do anything
+    SchemaChanges unchanged;
+    unchanged.reset = false;
+    model.updateData(unchanged);
+    QCOMPARE(resets.count(), 1);
+}
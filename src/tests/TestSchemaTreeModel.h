@@ -0,0 +1,16 @@
+#ifndef TESTSCHEMATREEMODEL_H
+#define TESTSCHEMATREEMODEL_H
+
+#include <QObject>
+
+class TestSchemaTreeModel : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void lazyPopulation();
+    void incrementalUpdate();
+    void resetForNewSchema();
+};
+
+#endif
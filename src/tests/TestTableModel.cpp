@@ -0,0 +1,237 @@
+#include "TestTableModel.h"
+#include "../sqlitedb.h"
+#include "../sqlitetablemodel.h"
+#include "../Settings.h"
+#include "../sql/Query.h"
+
+#include <QtTest/QTest>
+
+QTEST_MAIN(TestTableModel)
+
+namespace {
+const int num_rows = 1000;
+const int chunk_size = 64;
+}
+
+TestTableModel::TestTableModel()
+{
+}
+
+TestTableModel::~TestTableModel()
+{
+}
+
+void TestTableModel::initTestCase()
+{
+    // Use small chunks, so the ranges below span several of them without needing huge tables. The value is not saved to disk.
+    Settings::setValue("db", "prefetchsize", chunk_size, false);
+}
+
+void TestTableModel::init()
+{
+    db = std::make_unique<DBBrowserDB>();
+    QVERIFY(db->create(":memory:"));
+    QVERIFY(db->executeSQL("CREATE TABLE t(id INTEGER PRIMARY KEY, name TEXT, value REAL);", false));
+    QVERIFY(db->executeSQL("WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i+1 FROM n WHERE i<" + std::to_string(num_rows) + ") "
+                           "INSERT INTO t SELECT i, 'row ' || i, i FROM n;", false));
+}
+
+void TestTableModel::cleanup()
+{
+    // Commit everything first, otherwise closing the database asks whether to save the changes
+    QVERIFY(db->releaseAllSavepoints());
+    QVERIFY(db->close());
+    db.reset();
+}
+
+void TestTableModel::pasteRange()
+{
+    SqliteTableModel model(*db);
+    model.setQuery(sqlb::Query(sqlb::ObjectIdentifier("main", "t")));
+    QTRY_COMPARE(model.rowCount(), num_rows);
+    model.waitUntilIdle();
+
+    // Paste many more rows than fit into one chunk, starting in the middle of the first one. Only the first chunk is loaded so far.
+    const int first_row = chunk_size / 2;
+    const int pasted_rows = 5 * chunk_size;
+    std::vector<std::vector<QByteArray>> values;
+    for(int i=0;i<pasted_rows;i++)
+        values.push_back({"pasted " + QByteArray::number(i), QByteArray::number(i * 10)});
+    QVERIFY(model.setTypedDataRange(model.index(first_row, 2), false, values));
+
+    // Every row of the range is changed, the ones around it aren't
+    const auto value = [this](const std::string& sql) { return db->querySingleValueFromDb(sql, false, DBBrowserDB::Wait); };
+    QCOMPARE(value("SELECT COUNT(*) FROM t WHERE name LIKE 'pasted %';"), QByteArray::number(pasted_rows));
+    QCOMPARE(value("SELECT name FROM t WHERE id=" + std::to_string(first_row) + ";"), QByteArray("row " + QByteArray::number(first_row)));
+    QCOMPARE(value("SELECT name FROM t WHERE id=" + std::to_string(first_row + 1) + ";"), QByteArray("pasted 0"));
+    QCOMPARE(value("SELECT name FROM t WHERE id=" + std::to_string(first_row + pasted_rows) + ";"),
+             QByteArray("pasted " + QByteArray::number(pasted_rows - 1)));
+    QCOMPARE(value("SELECT name FROM t WHERE id=" + std::to_string(first_row + pasted_rows + 1) + ";"),
+             QByteArray("row " + QByteArray::number(first_row + pasted_rows + 1)));
+    QCOMPARE(value("SELECT value FROM t WHERE id=" + std::to_string(first_row + pasted_rows) + ";"),
+             QByteArray::number((pasted_rows - 1) * 10) + ".0");
+
+    // The cache agrees with the database
+    QCOMPARE(model.data(model.index(first_row + pasted_rows - 1, 2)).toString(), QString("pasted %1").arg(pasted_rows - 1));
+
+    // Values beyond the last row are ignored
+    values.resize(2);
+    QVERIFY(model.setTypedDataRange(model.index(num_rows - 1, 2), false, values));
+    QCOMPARE(value("SELECT name FROM t WHERE id=" + std::to_string(num_rows) + ";"), QByteArray("pasted 0"));
+}
+
+void TestTableModel::keysetPagination()
+{
+    SqliteTableModel model(*db);
+    model.setQuery(sqlb::Query(sqlb::ObjectIdentifier("main", "t")));
+    QTRY_COMPARE(model.rowCount(), num_rows);
+    model.waitUntilIdle();
+
+    // Nothing is known about the key values before the first chunk is read
+    QCOMPARE(model.lastFetchMode(), RowLoader::FetchMode::Offset);
+
+    // Jumping far ahead seeks to a key value and reads the right rows
+    model.triggerCacheLoad(800);
+    model.waitUntilIdle();
+    QCOMPARE(model.lastFetchMode(), RowLoader::FetchMode::Keyset);
+    QCOMPARE(model.data(model.index(800, 2)).toString(), QString("row 801"));
+    QCOMPARE(model.data(model.index(300, 2)).toString(), QString("loading..."));
+
+    // Jumping back uses the key values found on the way
+    model.triggerCacheLoad(400);
+    model.waitUntilIdle();
+    QCOMPARE(model.lastFetchMode(), RowLoader::FetchMode::Keyset);
+    QCOMPARE(model.data(model.index(400, 2)).toString(), QString("row 401"));
+
+    // Queries sorted by more than one column have no single key and use offsets
+    sqlb::Query query(sqlb::ObjectIdentifier("main", "t"));
+    query.setOrderBy({sqlb::OrderBy("value", sqlb::OrderBy::Descending), sqlb::OrderBy("name", sqlb::OrderBy::Ascending)});
+    model.setQuery(query);
+    QTRY_COMPARE(model.rowCount(), num_rows);
+    model.triggerCacheLoad(800);
+    model.waitUntilIdle();
+    QCOMPARE(model.lastFetchMode(), RowLoader::FetchMode::Offset);
+    QCOMPARE(model.data(model.index(800, 2)).toString(), QString("row 200"));
+}
+
+void TestTableModel::findFunctions()
+{
+    const auto value = [this](const std::string& sql, const DBBrowserDB::BindValues& values) {
+        return db->querySingleValueFromDb(sql, values, false, DBBrowserDB::Wait);
+    };
+    const std::string match = "SELECT sqlb_find_match(?1, ?2, ?3, ?4, ?5);";
+    const std::string replace = "SELECT sqlb_find_replace(?1, ?2, ?3, ?4, ?5, ?6);";
+
+    // Parts of the value, whole values, case sensitive and case insensitive
+    QCOMPARE(value(match, {"Row 12", "row", 0, 0, 0}), QByteArray("1"));
+    QCOMPARE(value(match, {"Row 12", "row", 0, 1, 0}), QByteArray("0"));
+    QCOMPARE(value(match, {"Row 12", "ROW 12", 1, 0, 0}), QByteArray("1"));
+    QCOMPARE(value(match, {"Row 12", "Row 1", 1, 1, 0}), QByteArray("0"));
+
+    // Regular expressions need to match the whole value if requested
+    QCOMPARE(value(match, {"row 12", "\\d$", 0, 1, 1}), QByteArray("1"));
+    QCOMPARE(value(match, {"row 12", "\\d$", 1, 1, 1}), QByteArray("0"));
+    QCOMPARE(value(match, {"row 12", "ROW \\d+", 1, 0, 1}), QByteArray("1"));
+
+    // Numbers are compared in their text representation
+    QCOMPARE(value(match, {2.5, "2.5", 1, 1, 0}), QByteArray("1"));
+    QCOMPARE(value("SELECT sqlb_find_match(value, ?1, 1, 1, 0) FROM t WHERE id=5;", {"5.0"}), QByteArray("1"));
+
+    // All matches are replaced
+    QCOMPARE(value(replace, {"Row row", "row", "x", 0, 0, 0}), QByteArray("x x"));
+    QCOMPARE(value(replace, {"Row row", "row", "x", 0, 1, 0}), QByteArray("Row x"));
+    QCOMPARE(value(replace, {"row 12", "(\\d)", "<\\1>", 0, 1, 1}), QByteArray("row <1><2>"));
+}
+
+void TestTableModel::statementCache()
+{
+    const auto value = [this](const std::string& sql) { return db->querySingleValueFromDb(sql, false, DBBrowserDB::Wait); };
+    const std::string sql = "SELECT name FROM t WHERE id=1;";
+
+    // The statement is prepared once and reused afterwards
+    auto before = db->statementCacheStatistics();
+    QCOMPARE(value(sql), QByteArray("row 1"));
+    QCOMPARE(value(sql), QByteArray("row 1"));
+    auto after = db->statementCacheStatistics();
+    QCOMPARE(after.misses - before.misses, 1u);
+    QCOMPARE(after.hits - before.hits, 1u);
+
+    // Making room for more statements than fit into the cache finalizes the least recently used ones only
+    before = after;
+    for(int i=1;i<=100;i++)
+        QCOMPARE(value("SELECT name FROM t WHERE id=" + std::to_string(i) + ";"), "row " + QByteArray::number(i));
+    after = db->statementCacheStatistics();
+    QVERIFY(after.evictions > before.evictions);
+    QCOMPARE(value("SELECT name FROM t WHERE id=100;"), QByteArray("row 100"));
+    QCOMPARE(db->statementCacheStatistics().hits - after.hits, 1u);
+
+    // Changing the schema throws away all statements, including the one which is being executed
+    QVERIFY(db->executeSQL("CREATE TABLE u(x);", false));
+    QVERIFY(db->executeSQL("CREATE TABLE u2(x);", false));
+    before = db->statementCacheStatistics();
+    QCOMPARE(value("SELECT name FROM t WHERE id=100;"), QByteArray("row 100"));
+    after = db->statementCacheStatistics();
+    QCOMPARE(after.misses - before.misses, 1u);
+    QCOMPARE(after.hits, before.hits);
+}
+
+void TestTableModel::nextMatch()
+{
+    SqliteTableModel model(*db);
+    model.setQuery(sqlb::Query(sqlb::ObjectIdentifier("main", "t")));
+    QTRY_COMPARE(model.rowCount(), num_rows);
+    model.waitUntilIdle();
+
+    // Only the chunk containing the match is loaded, not the rows in between
+    const QModelIndex match = model.nextMatch(model.index(0, 2), {2}, "row 700", Qt::MatchFlags(Qt::MatchContains));
+    QCOMPARE(match, model.index(699, 2));
+    QCOMPARE(model.data(match).toString(), QString("row 700"));
+    QCOMPARE(model.data(model.index(300, 2)).toString(), QString("loading..."));
+
+    // Searching backwards and wrapping around
+    QCOMPARE(model.nextMatch(match, {2}, "ROW 5", Qt::MatchFlags(Qt::MatchContains), true), model.index(598, 2));
+    QCOMPARE(model.nextMatch(model.index(num_rows - 1, 2), {1, 2}, "row 1", Qt::MatchFlags(Qt::MatchWrap)), model.index(0, 2));
+
+    // The database knows there is no match without loading anything
+    QCOMPARE(model.nextMatch(model.index(0, 2), {2}, "no such row", Qt::MatchFlags(Qt::MatchContains | Qt::MatchWrap)), QModelIndex());
+    QCOMPARE(model.data(model.index(300, 2)).toString(), QString("loading..."));
+}
+
+void TestTableModel::replaceAll()
+{
+    SqliteTableModel model(*db);
+    model.setQuery(sqlb::Query(sqlb::ObjectIdentifier("main", "t")));
+    QTRY_COMPARE(model.rowCount(), num_rows);
+    model.waitUntilIdle();
+    QCOMPARE(model.data(model.index(4, 3)).toString(), QString("5.0"));
+
+    // The REAL affinity of the column turns the new value back into the number it was, and the cache needs to show it like that
+    QCOMPARE(model.replaceAll({3}, "5.0", "5", Qt::MatchCaseSensitive), 1);
+    const auto value = [this](const std::string& sql) { return db->querySingleValueFromDb(sql, false, DBBrowserDB::Wait); };
+    QCOMPARE(value("SELECT typeof(value) FROM t WHERE id=5;"), QByteArray("real"));
+    QTRY_COMPARE(model.data(model.index(4, 3)).toString(), QString("5.0"));
+
+    // Rows 1, 10 to 19, 100 to 199 and 1000 match. The ones which are loaded are the same as in the database afterwards.
+    QCOMPARE(model.replaceAll({2}, "ROW 1", "line ", Qt::MatchContains), 112);
+    QCOMPARE(value("SELECT COUNT(*) FROM t WHERE name LIKE 'line %';"), QByteArray("112"));
+    QTRY_COMPARE(model.data(model.index(0, 2)).toString(), QString("line "));
+    QCOMPARE(model.data(model.index(1, 2)).toString(), QString("row 2"));
+    QTRY_COMPARE(model.data(model.index(9, 2)).toString(), QString("line 0"));
+    QCOMPARE(model.rowCount(), num_rows);
+}
+
+void TestTableModel::replaceAllSorted()
+{
+    sqlb::Query query(sqlb::ObjectIdentifier("main", "t"));
+    query.setOrderBy({sqlb::OrderBy("name", sqlb::OrderBy::Descending)});
+    SqliteTableModel model(*db);
+    model.setQuery(query);
+    QTRY_COMPARE(model.rowCount(), num_rows);
+    model.waitUntilIdle();
+    QCOMPARE(model.data(model.index(0, 2)).toString(), QString("row 999"));
+
+    // The changed rows move to the end, so the rows in front of them need to be loaded again
+    QCOMPARE(model.replaceAll({2}, "row 9", "a", Qt::MatchContains | Qt::MatchCaseSensitive), 111);
+    QTRY_COMPARE(model.rowCount(), num_rows);
+    QTRY_COMPARE(model.data(model.index(0, 2)).toString(), QString("row 899"));
+}
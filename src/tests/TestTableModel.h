@@ -0,0 +1,34 @@
+#ifndef TESTTABLEMODEL_H
+#define TESTTABLEMODEL_H
+
+#include <QObject>
+
+#include <memory>
+
+class DBBrowserDB;
+
+class TestTableModel : public QObject
+{
+    Q_OBJECT
+
+public:
+    TestTableModel();
+    ~TestTableModel() override;
+
+private:
+    std::unique_ptr<DBBrowserDB> db;
+
+private slots:
+    void initTestCase();
+    void init();
+    void cleanup();
+    void pasteRange();
+    void keysetPagination();
+    void findFunctions();
+    void statementCache();
+    void nextMatch();
+    void replaceAll();
+    void replaceAllSorted();
+};
+
+#endif
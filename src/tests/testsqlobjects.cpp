@@ -1,9 +1,13 @@
 #include "testsqlobjects.h"
 #include "../sql/ObjectIdentifier.h"
+#include "../sql/Query.h"
 #include "../sql/sqlitetypes.h"
+#include "SchemaStatements.h"
 
 #include <QtTest/QtTest>
 
+#include <typeinfo>
+
 QTEST_APPLESS_MAIN(TestTable)
 Q_DECLARE_METATYPE(std::string)
 
@@ -612,6 +616,106 @@ void TestTable::parseIdentifierWithDollar()
     QCOMPARE(tab.fields.at(0).type(), "INTEGER");
 }
 
+void TestTable::keysetQueries()
+{
+    Query q(ObjectIdentifier("main", "test"));
+    q.setRowIdColumn("_rowid_");
+
+    // Without sort order the key column is sorted in ascending order
+    QCOMPARE(q.buildKeysetQuery("_rowid_", false), "SELECT \"_rowid_\",* FROM \"main\".\"test\"  ORDER BY \"_rowid_\" ASC");
+    QCOMPARE(q.buildKeysetQuery("_rowid_", true), "SELECT \"_rowid_\",* FROM \"main\".\"test\" WHERE \"_rowid_\" >= ?1 ORDER BY \"_rowid_\" ASC");
+    QCOMPARE(q.buildKeysetAnchorQuery("_rowid_", false), "SELECT \"_rowid_\" FROM \"main\".\"test\"  ORDER BY \"_rowid_\" ASC");
+    QCOMPARE(q.buildKeysetAnchorQuery("_rowid_", true), "SELECT \"_rowid_\" FROM \"main\".\"test\" WHERE \"_rowid_\" >= ?1 ORDER BY \"_rowid_\" ASC");
+
+    // Filters are kept apart from the key condition and descending order seeks backwards
+    q.where()["name"] = "LIKE 'a%'";
+    q.setOrderBy({OrderBy("id", OrderBy::Descending)});
+    QCOMPARE(q.buildKeysetQuery("id", true), "SELECT \"_rowid_\",* FROM \"main\".\"test\" WHERE (\"name\" LIKE 'a%') AND \"id\" <= ?1 ORDER BY \"id\" DESC");
+    QCOMPARE(q.buildKeysetAnchorQuery("id", false), "SELECT \"id\" FROM \"main\".\"test\" WHERE \"name\" LIKE 'a%' ORDER BY \"id\" DESC");
+    QCOMPARE(q.buildKeysetAnchorQuery("id", true), "SELECT \"id\" FROM \"main\".\"test\" WHERE (\"name\" LIKE 'a%') AND \"id\" <= ?1 ORDER BY \"id\" DESC");
+}
+
+void TestTable::rowCountQueries()
+{
+    Query q(ObjectIdentifier("main", "test"));
+    q.setRowIdColumn("_rowid_");
+
+    // Without filters the statistics and the rowid range can be used for estimating the row count
+    const std::vector<std::string> estimates = {
+        "SELECT CAST(stat AS INTEGER) FROM \"main\".sqlite_stat1 WHERE tbl='test' LIMIT 1;",
+        "SELECT max(_rowid_) - min(_rowid_) + 1 FROM \"main\".\"test\";"
+    };
+    QCOMPARE(q.buildRowCountEstimateQueries(), estimates);
+    QCOMPARE(q.buildKeyRangeQuery(), "SELECT min(\"_rowid_\"), max(\"_rowid_\") FROM \"main\".\"test\";");
+    QCOMPARE(q.buildRangeCountQuery(), "SELECT COUNT(*) FROM \"main\".\"test\" WHERE \"_rowid_\" >= ?1 AND \"_rowid_\" < ?2;");
+
+    // Filters make the estimates useless but the filtered rows can still be counted in ranges
+    q.where()["name"] = "LIKE 'a%'";
+    QVERIFY(q.buildRowCountEstimateQueries().empty());
+    QCOMPARE(q.buildRangeCountQuery(), "SELECT COUNT(*) FROM \"main\".\"test\" WHERE (\"name\" LIKE 'a%') AND \"_rowid_\" >= ?1 AND \"_rowid_\" < ?2;");
+
+    // Rows identified by more than one column can't be split into ranges
+    q.setRowIdColumns({"a", "b"});
+    QVERIFY(q.buildKeyRangeQuery().empty());
+    QVERIFY(q.buildRangeCountQuery().empty());
+}
+
+void TestTable::findQueries()
+{
+    Query q(ObjectIdentifier("main", "test"));
+    q.setRowIdColumn("_rowid_");
+    const auto condition = [](const std::string& column) { return "instr(" + column + ", ?3) > 0"; };
+
+    // The rows are numbered in key order and the rowid column can be searched like any other column
+    QCOMPARE(q.buildFindQuery({"_rowid_", "name"}, condition, "_rowid_", false),
+             "SELECT sqlb_row,(instr(\"_rowid_\", ?3) > 0) AS sqlb_match0,(instr(\"name\", ?3) > 0) AS sqlb_match1 "
+             "FROM (SELECT ROW_NUMBER() OVER (ORDER BY \"_rowid_\" ASC) - 1 AS sqlb_row,* FROM (SELECT \"_rowid_\" AS \"_rowid_\",* FROM \"main\".\"test\" )) "
+             "WHERE sqlb_row BETWEEN ?1 AND ?2 AND ((instr(\"_rowid_\", ?3) > 0) OR (instr(\"name\", ?3) > 0)) ORDER BY sqlb_row ASC");
+
+    // Filters, sort order and display formats are the same as in the query which loads the rows
+    q.where()["name"] = "LIKE 'a%'";
+    q.setOrderBy({OrderBy("name", OrderBy::Descending)});
+    q.selectedColumns().emplace_back("name", "upper(\"name\")");
+    QCOMPARE(q.buildFindQuery({"name"}, condition, std::string(), true),
+             "SELECT sqlb_row,(instr(\"name\", ?3) > 0) AS sqlb_match0 "
+             "FROM (SELECT ROW_NUMBER() OVER (ORDER BY \"name\" DESC,\"_rowid_\" ASC) - 1 AS sqlb_row,* FROM (SELECT \"_rowid_\" AS \"_rowid_\",upper(\"name\") AS \"name\" "
+             "FROM \"main\".\"test\" WHERE upper(\"name\") LIKE 'a%')) "
+             "WHERE sqlb_row BETWEEN ?1 AND ?2 AND ((instr(\"name\", ?3) > 0)) ORDER BY sqlb_row DESC");
+    QCOMPARE(q.buildQuery(true), "SELECT \"_rowid_\",upper(\"name\") AS \"name\" FROM \"main\".\"test\" WHERE upper(\"name\") LIKE 'a%' "
+                                 "ORDER BY \"name\" DESC,\"_rowid_\" ASC");
+
+    // Without sort order and key column the rows are numbered in rowid order like the query which loads them
+    Query unsorted(ObjectIdentifier("main", "test"));
+    unsorted.setRowIdColumn("_rowid_");
+    QCOMPARE(unsorted.buildFindQuery({"name"}, condition, std::string(), false),
+             "SELECT sqlb_row,(instr(\"name\", ?3) > 0) AS sqlb_match0 "
+             "FROM (SELECT ROW_NUMBER() OVER (ORDER BY \"_rowid_\" ASC) - 1 AS sqlb_row,* FROM (SELECT \"_rowid_\" AS \"_rowid_\",* FROM \"main\".\"test\" )) "
+             "WHERE sqlb_row BETWEEN ?1 AND ?2 AND ((instr(\"name\", ?3) > 0)) ORDER BY sqlb_row ASC");
+    QCOMPARE(unsorted.buildQuery(true), "SELECT \"_rowid_\",* FROM \"main\".\"test\"  ORDER BY \"_rowid_\" ASC");
+
+    // Views without rowid have no defined order
+    Query view(ObjectIdentifier("main", "v"), true);
+    view.setRowIdColumn("_rowid_");
+    QCOMPARE(view.buildQuery(true), "SELECT NULL,* FROM \"main\".\"v\"  ");
+}
+
+void TestTable::updateQueries()
+{
+    Query q(ObjectIdentifier("main", "test"));
+    q.setRowIdColumn("_rowid_");
+    q.setColumnNames({"_rowid_", "name", "value"});
+
+    QCOMPARE(q.buildUpdateQuery("name", "instr(\"name\", ?1) > 0", "replace(\"name\", ?1, ?2)"),
+             "UPDATE \"main\".\"test\" SET \"name\"=replace(\"name\", ?1, ?2) WHERE (instr(\"name\", ?1) > 0)");
+
+    // Rows which are filtered out are not changed
+    q.where()["value"] = "> 10";
+    q.setGlobalWhere({"LIKE '%a%'"});
+    QCOMPARE(q.buildUpdateQuery("name", "instr(\"name\", ?1) > 0", "replace(\"name\", ?1, ?2)"),
+             "UPDATE \"main\".\"test\" SET \"name\"=replace(\"name\", ?1, ?2) WHERE (instr(\"name\", ?1) > 0) AND \"value\" > 10 AND "
+             "(\"_rowid_\" LIKE '%a%' OR \"name\" LIKE '%a%' OR \"value\" LIKE '%a%')");
+}
+
 void TestTable::parseTest()
 {
     QFETCH(std::string, sql);
@@ -832,3 +936,114 @@ void TestTable::parseTest_data()
     QTest::newRow("203") << std::string("CREATE TABLE t(x INTEGER, y, z, PRIMARY KEY(x DESC))");
     QTest::newRow("204") << std::string("CREATE TABLE t(x INTEGER PRIMARY KEY DESC, y, z)");
 }
+
+void TestTable::parseSchema()
+{
+    auto statements = generateSchema(1000);
+    statements.push_back({"table", "CREATE TABLE broken("});
+    statements.push_back({"trigger", "CREATE TRIGGER t AFTER INSERT ON table0 BEGIN SELECT 1; END"});
+    statements.push_back({"unknown", "CREATE SOMETHING"});
+
+    // Parsing in parallel must give the same objects in the same order as parsing one statement after the other
+    const auto objects = sqlb::parseSchema(statements, 8);
+    QCOMPARE(objects.size(), statements.size());
+    for(size_t i=0;i<statements.size()-1;i++)
+    {
+        const std::string& type = statements[i].first;
+        const std::string& sql = statements[i].second;
+        ObjectPtr expected;
+        if(type == "table")
+            expected = Table::parseSQL(sql);
+        else if(type == "index")
+            expected = Index::parseSQL(sql);
+        else if(type == "view")
+            expected = View::parseSQL(sql);
+        else
+            expected = Trigger::parseSQL(sql);
+
+        QVERIFY(objects[i] != nullptr);
+        QCOMPARE(objects[i]->name(), expected->name());
+        QCOMPARE(objects[i]->originalSql(), sql);
+        QCOMPARE(objects[i]->fullyParsed(), expected->fullyParsed());
+        QCOMPARE(objects[i]->sql(), expected->sql());
+    }
+    QVERIFY(objects.back() == nullptr);
+}
+
+void TestTable::serialiseSchema()
+{
+    auto statements = generateSchema(100);
+    statements.push_back({"table", "CREATE TABLE \"gen\"(a INTEGER CONSTRAINT \"nn\" NOT NULL ON CONFLICT IGNORE UNIQUE ON CONFLICT REPLACE, "
+                                   "b TEXT COLLATE NOCASE CHECK(length(b) > 2), c INTEGER GENERATED ALWAYS AS (a * 2) STORED, "
+                                   "CONSTRAINT \"pk\" PRIMARY KEY(a DESC, b) ON CONFLICT ABORT, CONSTRAINT \"chk\" CHECK(a <> c)) WITHOUT ROWID, STRICT"});
+    statements.push_back({"table", "CREATE VIRTUAL TABLE fts USING fts5(a, b)"});
+    statements.push_back({"table", "CREATE TABLE broken("});
+    statements.push_back({"index", "CREATE UNIQUE INDEX \"partial\" ON \"gen\"(a, lower(b)) WHERE a > 0"});
+    statements.push_back({"trigger", "CREATE TRIGGER t AFTER INSERT ON table0 BEGIN SELECT 1; END"});
+    statements.push_back({"unknown", "CREATE SOMETHING"});
+
+    auto objects = sqlb::parseSchema(statements, 1);
+
+    // Add the information which is normally queried from the database
+    auto view = std::static_pointer_cast<Table>(objects[2]);
+    view->fields.emplace_back("id", "INTEGER");
+    view->fields.emplace_back("name", "TEXT");
+    std::static_pointer_cast<Table>(objects[objects.size() - 5])->fields.emplace_back("a", "");
+    std::static_pointer_cast<Table>(objects[objects.size() - 4])->setName("broken");
+    std::static_pointer_cast<Trigger>(objects[objects.size() - 2])->setTable("table0");
+
+    std::vector<ObjectPtr> restored;
+    QVERIFY(sqlb::deserialiseSchema(sqlb::serialiseSchema(objects), restored));
+    QCOMPARE(restored.size(), objects.size());
+    for(size_t i=0;i<objects.size();i++)
+    {
+        if(!objects[i])
+        {
+            QVERIFY(restored[i] == nullptr);
+            continue;
+        }
+
+        QVERIFY(restored[i] != nullptr);
+        QCOMPARE(typeid(*restored[i]).name(), typeid(*objects[i]).name());
+        QCOMPARE(restored[i]->name(), objects[i]->name());
+        QCOMPARE(restored[i]->originalSql(), objects[i]->originalSql());
+        QCOMPARE(restored[i]->fullyParsed(), objects[i]->fullyParsed());
+        QCOMPARE(restored[i]->sql(), objects[i]->sql());
+
+        if(auto table = std::dynamic_pointer_cast<Table>(objects[i]))
+        {
+            auto restored_table = std::static_pointer_cast<Table>(restored[i]);
+            QCOMPARE(restored_table->fieldNames(), table->fieldNames());
+            QCOMPARE(restored_table->virtualUsing(), table->virtualUsing());
+            QCOMPARE(restored_table->rowidColumns(), table->rowidColumns());
+        } else if(auto index = std::dynamic_pointer_cast<Index>(objects[i])) {
+            QCOMPARE(std::static_pointer_cast<Index>(restored[i])->table(), index->table());
+        } else if(auto trigger = std::dynamic_pointer_cast<Trigger>(objects[i])) {
+            QCOMPARE(std::static_pointer_cast<Trigger>(restored[i])->table(), trigger->table());
+        }
+    }
+}
+
+void TestTable::deserialiseDamagedSchema()
+{
+    const std::string data = sqlb::serialiseSchema(sqlb::parseSchema(generateSchema(10), 1));
+    std::vector<ObjectPtr> objects;
+
+    // Cut off data, trailing data and other versions of the format must all be rejected
+    QVERIFY(!sqlb::deserialiseSchema(data.substr(0, data.size() / 2), objects));
+    QVERIFY(objects.empty());
+    QVERIFY(!sqlb::deserialiseSchema(data + "x", objects));
+    QVERIFY(!sqlb::deserialiseSchema(std::string(1, static_cast<char>(data[0] + 1)) + data.substr(1), objects));
+    QVERIFY(!sqlb::deserialiseSchema(std::string(), objects));
+
+    // Reading arbitrarily changed data must not crash
+    for(size_t i=0;i<data.size();i+=7)
+    {
+        std::string damaged = data;
+        damaged[i] = static_cast<char>(~damaged[i]);
+        sqlb::deserialiseSchema(damaged, objects);
+    }
+
+    QVERIFY(sqlb::deserialiseSchema(data, objects));
+    QCOMPARE(objects.size(), generateSchema(10).size());
+}
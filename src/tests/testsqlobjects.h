@@ -44,9 +44,17 @@ private slots:
     void moduloOperator();
     void complexExpression();
     void parseIdentifierWithDollar();
+    void keysetQueries();
+    void rowCountQueries();
+    void findQueries();
+    void updateQueries();
 
     void parseTest();
     void parseTest_data();
+
+    void parseSchema();
+    void serialiseSchema();
+    void deserialiseDamagedSchema();
 };
 
 #endif